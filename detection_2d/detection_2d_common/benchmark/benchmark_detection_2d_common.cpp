@@ -0,0 +1,280 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <random>
+#include <tuple>
+#include <vector>
+
+#include "detection_2d_common/byte_tracker.hpp"
+#include "detection_2d_common/fused_preprocess.hpp"
+#include "detection_2d_common/nms.hpp"
+
+using namespace easy_deploy;
+
+// a 1080p camera frame, letterboxed into `state.range(0) x state.range(0)`
+static cv::Mat GenerateFrame()
+{
+  cv::Mat                            frame(1080, 1920, CV_8UC3);
+  std::mt19937                       generator(0);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  for (int y = 0; y < frame.rows; ++y)
+  {
+    for (int x = 0; x < frame.cols * 3; ++x)
+    {
+      frame.ptr<uint8_t>(y)[x] = static_cast<uint8_t>(distribution(generator));
+    }
+  }
+  return frame;
+}
+
+static void benchmark_det_preprocess_reference(benchmark::State &state)
+{
+  const cv::Mat      frame = GenerateFrame();
+  const int          size  = state.range(0);
+  std::vector<float> blob(3 * size * size);
+  for (auto _ : state)
+  {
+    FusedLetterboxNormalizeReference(frame, blob.data(), size, size, FusedDetPreProcessParams{});
+    benchmark::DoNotOptimize(blob.data());
+  }
+  state.SetBytesProcessed(state.iterations() * blob.size() * sizeof(float));
+}
+
+static void benchmark_det_preprocess_fused(benchmark::State &state)
+{
+  const cv::Mat      frame = GenerateFrame();
+  const int          size  = state.range(0);
+  std::vector<float> blob(3 * size * size);
+  for (auto _ : state)
+  {
+    FusedLetterboxNormalize(frame, blob.data(), size, size, FusedDetPreProcessParams{});
+    benchmark::DoNotOptimize(blob.data());
+  }
+  state.SetBytesProcessed(state.iterations() * blob.size() * sizeof(float));
+}
+
+// `state.range(0)` candidates of 80 classes, clustered around `num / 20` objects as the anchors of
+// a detector are
+static std::vector<DetectionCandidate> GenerateCandidates(int num)
+{
+  constexpr int                         kClsNumber = 80;
+  std::mt19937                          generator(0);
+  std::uniform_real_distribution<float> distribution(0.f, 1.f);
+  std::vector<DetectionCandidate>       objects(std::max(1, num / 20));
+  for (auto &object : objects)
+  {
+    object.cx  = 640.f * distribution(generator);
+    object.cy  = 640.f * distribution(generator);
+    object.w   = 10.f + 150.f * distribution(generator);
+    object.h   = 10.f + 200.f * distribution(generator);
+    object.cls = generator() % kClsNumber;
+  }
+  std::vector<DetectionCandidate> candidates(num);
+  for (auto &candidate : candidates)
+  {
+    const auto &object = objects[generator() % objects.size()];
+    candidate.cx       = object.cx + 10.f * (distribution(generator) - 0.5f);
+    candidate.cy       = object.cy + 10.f * (distribution(generator) - 0.5f);
+    candidate.w        = object.w * (0.8f + 0.4f * distribution(generator));
+    candidate.h        = object.h * (0.8f + 0.4f * distribution(generator));
+    candidate.conf     = distribution(generator);
+    candidate.cls      = object.cls;
+  }
+  return candidates;
+}
+
+static void benchmark_nms_naive(benchmark::State &state)
+{
+  const auto candidates = GenerateCandidates(state.range(0));
+  NmsConfig  config;
+  config.max_detections = 0;
+  size_t num_kept       = 0;
+  for (auto _ : state)
+  {
+    num_kept = NmsNaive(candidates.data(), candidates.size(), 0.f, config).size();
+  }
+  state.counters["kept"] = num_kept;
+}
+
+static void benchmark_nms_engine(benchmark::State &state)
+{
+  const auto candidates = GenerateCandidates(state.range(0));
+  NmsConfig  config;
+  config.max_detections = 0;
+  NmsEngine engine(config);
+  size_t    num_kept = 0;
+  for (auto _ : state)
+  {
+    num_kept = engine.Run(candidates.data(), candidates.size(), 0.f).size();
+  }
+  state.counters["kept"] = num_kept;
+}
+
+// a recorded sequence : the ground truth of every frame, `TrackedBBox2D` with the object id, and
+// the detections of a detector on it
+struct RecordedFrame {
+  std::vector<TrackedBBox2D> objects;
+  std::vector<BBox2D>        detections;
+};
+
+// `num` pedestrians walking across a 1080p camera for 600 frames, detected with position noise,
+// occasional misses or low scores, and a few false positives per frame
+static const std::vector<RecordedFrame> &RecordSequence(int num)
+{
+  static std::map<int, std::vector<RecordedFrame>> sequences;
+  auto                                           &sequence = sequences[num];
+  if (!sequence.empty())
+  {
+    return sequence;
+  }
+
+  std::mt19937                          generator(0);
+  std::uniform_real_distribution<float> uniform(0.f, 1.f);
+  std::normal_distribution<float>       noise(0.f, 1.f);
+  std::vector<TrackedBBox2D>            objects(num);
+  std::vector<float>                    speeds(num);
+  for (int i = 0; i < num; ++i)
+  {
+    const float scale   = 0.5f + uniform(generator);
+    objects[i].box.x    = 1920.f * uniform(generator);
+    objects[i].box.y    = 200.f + 800.f * uniform(generator);
+    objects[i].box.w    = 40.f * scale;
+    objects[i].box.h    = 100.f * scale;
+    objects[i].box.cls  = 0.f;
+    objects[i].box.conf = 1.f;
+    objects[i].track_id = i;
+    speeds[i] = (uniform(generator) < 0.5f ? -1.f : 1.f) * (1.f + 2.f * uniform(generator));
+  }
+
+  for (int f = 0; f < 600; ++f)
+  {
+    RecordedFrame frame;
+    for (int i = 0; i < num; ++i)
+    {
+      auto &object = objects[i];
+      object.box.x += speeds[i];
+      // leaving the image, a new pedestrian enters on the other side
+      if (object.box.x < 0.f || object.box.x > 1920.f)
+      {
+        object.box.x = object.box.x < 0.f ? 1920.f : 0.f;
+        object.track_id += num;
+      }
+      frame.objects.push_back(object);
+
+      const float draw = uniform(generator);
+      if (draw < 0.05f)
+      {
+        continue;
+      }
+      BBox2D detection = object.box;
+      detection.x += 0.02f * detection.w * noise(generator);
+      detection.y += 0.02f * detection.h * noise(generator);
+      detection.w *= 1.f + 0.03f * noise(generator);
+      detection.h *= 1.f + 0.03f * noise(generator);
+      detection.conf = draw < 0.15f ? 0.2f + 0.2f * uniform(generator)
+                                    : 0.6f + 0.4f * uniform(generator);
+      frame.detections.push_back(detection);
+    }
+    for (int i = 0; i < 3; ++i)
+    {
+      frame.detections.push_back({1920.f * uniform(generator), 1080.f * uniform(generator), 40.f,
+                                  100.f, 0.f, 0.1f + 0.6f * uniform(generator)});
+    }
+    sequence.push_back(std::move(frame));
+  }
+  return sequence;
+}
+
+static float BoxIoU(const BBox2D &a, const BBox2D &b)
+{
+  const float inter_w = std::max(
+      0.f, std::min(a.x + a.w / 2, b.x + b.w / 2) - std::max(a.x - a.w / 2, b.x - b.w / 2));
+  const float inter_h = std::max(
+      0.f, std::min(a.y + a.h / 2, b.y + b.h / 2) - std::max(a.y - a.h / 2, b.y - b.h / 2));
+  const float inter = inter_w * inter_h;
+  return inter / (a.w * a.h + b.w * b.h - inter);
+}
+
+// replays the sequence of `state.range(0)` objects, detected every `state.range(1)` frames and
+// predicted in between. Reports the tracked frames/sec, the id switches (an object matched at IoU
+// 0.5 by another track than on its last match) and the coverage (the objects matched by a track)
+static void benchmark_byte_tracker_replay(benchmark::State &state)
+{
+  const auto &sequence        = RecordSequence(state.range(0));
+  const int   detect_interval = state.range(1);
+
+  std::vector<std::vector<TrackedBBox2D>> tracks(sequence.size());
+  for (auto _ : state)
+  {
+    ByteTracker tracker;
+    for (size_t f = 0; f < sequence.size(); ++f)
+    {
+      tracks[f] = f % detect_interval == 0 ? tracker.Update(sequence[f].detections)
+                                           : tracker.Predict();
+    }
+  }
+  state.counters["frames/sec"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * sequence.size()), benchmark::Counter::kIsRate);
+
+  // the replay is deterministic, the tracks of the last one are scored. The objects and the tracks
+  // of a frame are matched one to one, by descending IoU.
+  std::map<int, int>                       track_of_object;
+  std::vector<std::tuple<float, int, int>> pairs;
+  size_t                                   id_switches = 0;
+  size_t                                   matched     = 0;
+  size_t                                   objects     = 0;
+  for (size_t f = 0; f < sequence.size(); ++f)
+  {
+    const auto &frame_objects = sequence[f].objects;
+    pairs.clear();
+    for (size_t i = 0; i < frame_objects.size(); ++i)
+    {
+      for (size_t k = 0; k < tracks[f].size(); ++k)
+      {
+        const float iou = BoxIoU(frame_objects[i].box, tracks[f][k].box);
+        if (iou >= 0.5f)
+        {
+          pairs.emplace_back(iou, i, k);
+        }
+      }
+    }
+    std::sort(pairs.begin(), pairs.end(), std::greater<>());
+
+    std::vector<bool> object_done(frame_objects.size()), track_done(tracks[f].size());
+    for (const auto &pair : pairs)
+    {
+      const int i = std::get<1>(pair);
+      const int k = std::get<2>(pair);
+      if (object_done[i] || track_done[k])
+      {
+        continue;
+      }
+      object_done[i] = track_done[k] = true;
+      matched += 1;
+      const int  object_id = frame_objects[i].track_id;
+      const auto last      = track_of_object.find(object_id);
+      if (last != track_of_object.end() && last->second != tracks[f][k].track_id)
+      {
+        id_switches += 1;
+      }
+      track_of_object[object_id] = tracks[f][k].track_id;
+    }
+    objects += frame_objects.size();
+  }
+  state.counters["id_switches"] = id_switches;
+  state.counters["coverage"]    = static_cast<double>(matched) / std::max<size_t>(objects, 1);
+}
+
+BENCHMARK(benchmark_det_preprocess_reference)->Arg(320)->Arg(640)->Arg(1024)->UseRealTime();
+BENCHMARK(benchmark_det_preprocess_fused)->Arg(320)->Arg(640)->Arg(1024)->UseRealTime();
+BENCHMARK(benchmark_nms_naive)->Arg(100)->Arg(1000)->Arg(5000)->Arg(20000)->UseRealTime();
+BENCHMARK(benchmark_nms_engine)->Arg(100)->Arg(1000)->Arg(5000)->Arg(20000)->UseRealTime();
+
+BENCHMARK(benchmark_byte_tracker_replay)
+    ->ArgsProduct({{20, 100, 300}, {1, 2, 3, 5}})
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
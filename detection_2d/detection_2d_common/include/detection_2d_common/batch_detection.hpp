@@ -0,0 +1,131 @@
+#pragma once
+
+#include <mutex>
+
+#include "deploy_core/base_detection.hpp"
+#include "deploy_core/base_infer_core.hpp"
+
+#include "detection_2d_common/fused_preprocess.hpp"
+
+namespace easy_deploy {
+
+/**
+ * @brief `BaseDetectionModel` which also detects a batch of images in one inference. The batch
+ * capacity is the first dimension of the input blob of the infer core, larger batches are split,
+ * and an infer core with a capacity of 1 detects the images one by one.
+ *
+ */
+class BaseBatchDetectionModel : public BaseDetectionModel {
+public:
+  /**
+   * @brief Detect objects on every image of `images`.
+   *
+   * @param images Could be of different sizes, and views of a larger image : a preprocess which is
+   * a `IStridedDetectionPreProcess` reads them in place, others get a dense copy.
+   * @param results One list of boxes per image, in the same order as `images`.
+   * @param conf_thresh
+   * @param isRGB
+   * @return true
+   * @return false
+   */
+  bool DetectBatch(const std::vector<cv::Mat>        &images,
+                   std::vector<std::vector<BBox2D>> &results,
+                   float                             conf_thresh,
+                   bool                              isRGB = false);
+
+  /**
+   * @brief Images detected in one inference at most.
+   *
+   * @return int
+   */
+  int GetMaxBatchSize() const
+  {
+    return max_batch_size_;
+  }
+
+  ~BaseBatchDetectionModel() override = default;
+
+protected:
+  BaseBatchDetectionModel(const std::shared_ptr<BaseInferCore>        &infer_core,
+                          const std::shared_ptr<IDetectionPreProcess> &preprocess_block,
+                          const std::string                           &input_blob_name,
+                          int                                          input_height,
+                          int                                          input_width,
+                          int                                          input_channel);
+
+  /**
+   * @brief Decode the results of the `batch_index`-th image of a batch inference.
+   *
+   * @param blobs_buffer
+   * @param batch_index
+   * @param conf_thresh
+   * @param transform_scale The scale of this image returned by the preprocess.
+   * @param results
+   * @return true
+   * @return false
+   */
+  virtual bool PostProcessBatchItem(IBlobsBuffer        *blobs_buffer,
+                                    size_t               batch_index,
+                                    float                conf_thresh,
+                                    float                transform_scale,
+                                    std::vector<BBox2D> &results) = 0;
+
+  /**
+   * @brief Pointers to the outputs of the `batch_index`-th image of a batch inference, the
+   * outputs should be of 4-byte elements and batched on their first dimension.
+   *
+   * @param blobs_buffer
+   * @param output_blobs_name
+   * @param batch_index
+   * @return std::vector<void *> In the order of `output_blobs_name`.
+   */
+  static std::vector<void *> GetBatchItemOutputs(IBlobsBuffer                   *blobs_buffer,
+                                                 const std::vector<std::string> &output_blobs_name,
+                                                 size_t                          batch_index);
+
+private:
+  bool InferBatch(const cv::Mat       *images,
+                  size_t               batch_size,
+                  std::vector<BBox2D> *results,
+                  float                conf_thresh,
+                  bool                 isRGB);
+
+private:
+  const std::shared_ptr<BaseInferCore>        batch_infer_core_;
+  const std::shared_ptr<IDetectionPreProcess> batch_preprocess_block_;
+  // the same preprocess if it reads views in place, else null
+  const std::shared_ptr<IStridedDetectionPreProcess> strided_preprocess_block_;
+  const std::string                           batch_input_blob_name_;
+  const int                                   batch_input_height_;
+  const int                                   batch_input_width_;
+  const int                                   batch_input_channel_;
+  int                                         max_batch_size_ = 1;
+
+  // the images are preprocessed one by one into `stage_buffer_`, then gathered into the input
+  // blob of `batch_buffer_`
+  std::mutex                    batch_mtx_;
+  std::shared_ptr<IBlobsBuffer> batch_buffer_;
+  std::shared_ptr<IBlobsBuffer> stage_buffer_;
+  cv::Mat                       dense_image_;
+};
+
+/**
+ * @brief Detect views into a larger image, e.g. tiles or regions of interest : in batches if
+ * `detection_model` is a `BaseBatchDetectionModel`, else pipelined through its async api, which
+ * takes dense images, so the views which are not continuous are replaced by a copy.
+ *
+ * @param detection_model
+ * @param views
+ * @param results One list of boxes per view, in the coordinates of the view.
+ * @param conf_thresh
+ * @param isRGB
+ * @return true
+ * @return false
+ */
+bool DetectViews(const std::shared_ptr<BaseDetectionModel> &detection_model,
+                 std::vector<cv::Mat>                      &views,
+                 std::vector<std::vector<BBox2D>>          &results,
+                 float                                      conf_thresh,
+                 bool                                       isRGB = false);
+
+} // namespace easy_deploy
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "deploy_core/base_detection.hpp"
+
+namespace easy_deploy {
+
+/**
+ * @brief A box with the id of its track, stable across frames.
+ *
+ */
+struct TrackedBBox2D {
+  BBox2D box;
+  int    track_id;
+};
+
+struct ByteTrackConfig {
+  // detections above it are associated first and may start tracks, the ones between
+  // `low_thresh` and it only keep the tracks they match alive
+  float high_thresh = 0.5f;
+  float low_thresh  = 0.1f;
+  // a detection unmatched by any track starts a new one above it
+  float new_track_thresh = 0.6f;
+  // the min IoU of a match : high detections to tracks, low detections to the remaining tracks,
+  // and detections to the tracks started on the previous frame
+  float high_match_iou = 0.2f;
+  float low_match_iou  = 0.5f;
+  float new_match_iou  = 0.3f;
+  // a track unmatched for more frames is dropped
+  int max_lost_frames = 30;
+  // only match detections and tracks of the same class
+  bool class_aware = true;
+};
+
+/**
+ * @brief ByteTrack multi-object tracker : every track is a constant-velocity Kalman filter on
+ * (cx, cy, w / h, h), the detections are associated by IoU in two passes, the confident ones
+ * first then the low score ones, which keeps occluded objects tracked. The tracks are stored as
+ * a struct of arrays, the filter as the four independent (position, velocity) blocks the ByteTrack
+ * filter is made of, and the matching is solved per group of overlapping tracks and detections.
+ * Not thread-safe.
+ *
+ */
+class ByteTracker {
+public:
+  explicit ByteTracker(const ByteTrackConfig &config = ByteTrackConfig());
+
+  /**
+   * @brief Move the tracks to the next frame and associate `detections` to them.
+   *
+   * @param detections Of the new frame, below `low_thresh` are ignored.
+   * @return const std::vector<TrackedBBox2D>& The confirmed tracks matched on this frame, their
+   * filtered boxes. Valid until the next call.
+   */
+  const std::vector<TrackedBBox2D> &Update(const std::vector<BBox2D> &detections);
+
+  /**
+   * @brief Move the tracks to the next frame without detections, their boxes are the predicted
+   * ones.
+   *
+   * @return const std::vector<TrackedBBox2D>& The confirmed tracks not lost.
+   */
+  const std::vector<TrackedBBox2D> &Predict();
+
+  void Reset();
+
+  size_t GetTrackNum() const
+  {
+    return track_id_.size();
+  }
+
+private:
+  enum TrackState : int { kTentative, kTracked, kLost };
+
+  void PredictTracks();
+
+  void AddTrack(const BBox2D &detection, TrackState state);
+
+  void UpdateTrack(int track, const BBox2D &detection);
+
+  // matches `tracks` to `detections` maximizing the IoU above `min_iou`, the matched entries
+  // of both lists are set to -1
+  void Associate(std::vector<int>          &tracks,
+                 std::vector<int>          &detections,
+                 const std::vector<BBox2D> &boxes,
+                 float                      min_iou);
+
+  // swapped with the last track
+  void RemoveTrack(int track);
+
+  const std::vector<TrackedBBox2D> &CollectResults();
+
+private:
+  const ByteTrackConfig config_;
+  int                   next_track_id_ = 0;
+  bool                  first_frame_   = true;
+
+  // struct of arrays, one slot per track
+  std::vector<int>   track_id_;
+  std::vector<int>   state_;
+  std::vector<int>   lost_frames_;
+  std::vector<float> cls_;
+  std::vector<float> conf_;
+  // kalman filter of each of (cx, cy, aspect, h) : position, velocity and their covariance
+  std::array<std::vector<float>, 4> pos_;
+  std::array<std::vector<float>, 4> vel_;
+  std::array<std::vector<float>, 4> cov_pp_;
+  std::array<std::vector<float>, 4> cov_pv_;
+  std::array<std::vector<float>, 4> cov_vv_;
+  // predicted corners, read by the association
+  std::vector<float> x0_;
+  std::vector<float> y0_;
+  std::vector<float> x1_;
+  std::vector<float> y1_;
+
+  // scratch of the association : the tracks and detections of each pass, the corners of the
+  // tracks gathered by left edge, the pairs above the min IoU and their groups, a cost matrix per
+  // group
+  std::vector<int>     high_detections_;
+  std::vector<int>     low_detections_;
+  std::vector<int>     confirmed_tracks_;
+  std::vector<int>     tentative_tracks_;
+  std::vector<int>     remaining_tracks_;
+  std::vector<uint8_t> removed_;
+  std::vector<int>     track_order_;
+  std::vector<float>   track_x0_;
+  std::vector<float>   track_y0_;
+  std::vector<float>   track_x1_;
+  std::vector<float>   track_y1_;
+  std::vector<float>   iou_row_;
+  std::vector<int>     pair_track_;
+  std::vector<int>     pair_detection_;
+  std::vector<float>   pair_iou_;
+  std::vector<int>     group_parent_;
+  std::vector<int>     pair_root_;
+  std::vector<int>     pair_order_;
+  std::vector<int>     node_local_;
+  std::vector<int>     group_tracks_;
+  std::vector<int>     group_detections_;
+  std::vector<double>  cost_;
+  std::vector<int>     row_match_;
+
+  std::vector<std::pair<int, int>> matches_;
+
+  std::vector<TrackedBBox2D> results_;
+};
+
+/**
+ * @brief Optional construction params of the tracked detection model.
+ *
+ */
+struct TrackedDetectionConfig {
+  ByteTrackConfig tracker;
+  // run the detector every `detect_interval` frames, the frames in between get the predicted
+  // tracks
+  int detect_interval = 1;
+};
+
+/**
+ * @brief Detection on a video stream with stable track ids, by `ByteTracker`. The detector runs
+ * every `detect_interval` frames only, the other frames are served by the prediction of the
+ * tracks.
+ *
+ */
+class BaseTrackedDetectionModel {
+public:
+  /**
+   * @brief Detect or predict the objects of the next frame of the stream.
+   *
+   * @param frame
+   * @param results
+   * @param isRGB
+   * @return true
+   * @return false
+   */
+  virtual bool Track(const cv::Mat              &frame,
+                     std::vector<TrackedBBox2D> &results,
+                     bool                        isRGB = false) = 0;
+
+  /**
+   * @brief Drop the tracks, the next frame starts a new stream.
+   *
+   */
+  virtual void Reset() = 0;
+
+  virtual ~BaseTrackedDetectionModel() = default;
+};
+
+class BaseTrackedDetectionFactory {
+public:
+  virtual std::shared_ptr<BaseTrackedDetectionModel> Create() = 0;
+
+  virtual ~BaseTrackedDetectionFactory() = default;
+};
+
+/**
+ * @brief Create a tracked detection model.
+ *
+ * @param detection_model Called with `config.tracker.low_thresh` as confidence threshold.
+ * @param config
+ * @return std::shared_ptr<BaseTrackedDetectionModel>
+ */
+std::shared_ptr<BaseTrackedDetectionModel> CreateTrackedDetectionModel(
+    const std::shared_ptr<BaseDetectionModel> &detection_model,
+    const TrackedDetectionConfig              &config = {});
+
+std::shared_ptr<BaseTrackedDetectionFactory> CreateTrackedDetectionModelFactory(
+    std::shared_ptr<BaseDetection2DFactory> detection_factory,
+    const TrackedDetectionConfig           &config = {});
+
+} // namespace easy_deploy
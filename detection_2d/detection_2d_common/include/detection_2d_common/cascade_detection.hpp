@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+
+#include "deploy_core/base_detection.hpp"
+
+namespace easy_deploy {
+
+/**
+ * @brief Optional construction params of the cascade detection model.
+ *
+ */
+struct CascadeDetectionConfig {
+  // the detections of the small model scoring in `[ambiguous_conf_low, ambiguous_conf_high)` are
+  // ambiguous, the small model detects down to `ambiguous_conf_low` to see them
+  float ambiguous_conf_low  = 0.1f;
+  float ambiguous_conf_high = 0.5f;
+  // escalate to the large model with more ambiguous detections than it
+  int max_ambiguous_num = 0;
+  // or with more confident detections than it, the small objects of crowded scenes are lost at the
+  // low resolution
+  int max_detections_num = 30;
+};
+
+/**
+ * @brief Counters of the cascade since its creation or the last `ResetStats`.
+ *
+ */
+struct CascadeDetectionStats {
+  size_t images    = 0;
+  size_t escalated = 0;
+
+  float EscalationRate() const
+  {
+    return images == 0 ? 0.f : static_cast<float>(escalated) / images;
+  }
+};
+
+/**
+ * @brief Detection by a cascade of two models of the same detector at different input sizes,
+ * e.g. 320 then 640 : every image goes through the small model, and only the images on which its
+ * results are ambiguous are detected again by the large one.
+ *
+ */
+class BaseCascadeDetectionModel {
+public:
+  /**
+   * @brief Detect objects on `image`, by the large model if the small one is not confident.
+   *
+   * @param image
+   * @param results Of the model which decided.
+   * @param conf_thresh
+   * @param isRGB
+   * @return true
+   * @return false
+   */
+  virtual bool Detect(const cv::Mat       &image,
+                      std::vector<BBox2D> &results,
+                      float                conf_thresh,
+                      bool                 isRGB = false) = 0;
+
+  virtual CascadeDetectionStats GetStats() const = 0;
+
+  virtual void ResetStats() = 0;
+
+  virtual ~BaseCascadeDetectionModel() = default;
+};
+
+class BaseCascadeDetectionFactory {
+public:
+  virtual std::shared_ptr<BaseCascadeDetectionModel> Create() = 0;
+
+  virtual ~BaseCascadeDetectionFactory() = default;
+};
+
+/**
+ * @brief Whether the results of the small model are ambiguous, and the image should be detected
+ * by the large one.
+ *
+ * @param small_results Of the small model, detected at `ambiguous_conf_low` or lower.
+ * @param config
+ * @return true
+ * @return false
+ */
+bool NeedEscalation(const std::vector<BBox2D> &small_results, const CascadeDetectionConfig &config);
+
+/**
+ * @brief Create a cascade detection model.
+ *
+ * @param small_model The model of the small input size, run on every image.
+ * @param large_model The model of the large input size, run on the ambiguous images only.
+ * @param config
+ * @return std::shared_ptr<BaseCascadeDetectionModel>
+ */
+std::shared_ptr<BaseCascadeDetectionModel> CreateCascadeDetectionModel(
+    const std::shared_ptr<BaseDetectionModel> &small_model,
+    const std::shared_ptr<BaseDetectionModel> &large_model,
+    const CascadeDetectionConfig              &config = {});
+
+std::shared_ptr<BaseCascadeDetectionFactory> CreateCascadeDetectionModelFactory(
+    std::shared_ptr<BaseDetection2DFactory> small_model_factory,
+    std::shared_ptr<BaseDetection2DFactory> large_model_factory,
+    const CascadeDetectionConfig           &config = {});
+
+} // namespace easy_deploy
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include <opencv2/opencv.hpp>
+
+#include "deploy_core/base_detection.hpp"
+
+namespace easy_deploy {
+
+/**
+ * @brief Params of the fused cpu preprocess, the same as `CreateCpuDetPreProcess`.
+ *
+ */
+struct FusedDetPreProcessParams {
+  // per channel of the model input, `(pixel - mean) / stddev`
+  std::array<float, 3> mean{0.f, 0.f, 0.f};
+  std::array<float, 3> stddev{255.f, 255.f, 255.f};
+  // the model takes RGB : BGR images have their first and third channel swapped, RGB ones are
+  // kept. `false` for BGR models, which swap RGB images instead.
+  bool swap_rb = true;
+  // `true` writes planar (CHW) floats, `false` writes the resized and padded image as interleaved
+  // (HWC) uint8, as the rknn models take it
+  bool normalize = true;
+};
+
+/**
+ * @brief A preprocess which also takes a `cv::Mat` with a row stride, as a ROI view of a larger
+ * image. The images described by `IPipelineImageData` are dense, so a view passed through it has
+ * to be copied first.
+ *
+ */
+class IStridedDetectionPreProcess {
+public:
+  /**
+   * @brief Preprocess `image` into `dst`, on host side.
+   *
+   * @param image Could be a view, `image.step` is honored.
+   * @param dst The input blob of one image.
+   * @param dst_height
+   * @param dst_width
+   * @param isRGB The channel order of `image`, as the `isRGB` of `BaseDetectionModel::Detect`.
+   * @return float The resize scale, as `IDetectionPreProcess::Preprocess`.
+   */
+  virtual float PreprocessMat(const cv::Mat &image,
+                              void          *dst,
+                              int            dst_height,
+                              int            dst_width,
+                              bool           isRGB) = 0;
+
+  virtual ~IStridedDetectionPreProcess() = default;
+};
+
+/**
+ * @brief Letterbox `image` into `dst_height x dst_width` in one pass : the image is resized
+ * bilinearly (same sampling as `cv::resize`) keeping its aspect ratio, placed at the top-left
+ * corner and padded with zero pixels, then the channels are swapped, normalized and transposed to
+ * planes while they are written. Output rows are processed in parallel, the vertical blend and the
+ * normalization run on SIMD (AVX2 on x86 cpus that support it, NEON on arm), and so does the
+ * horizontal gather with AVX2.
+ *
+ * @param image `CV_8UC3`, could be a view.
+ * @param dst `3 x dst_height x dst_width` floats if `params.normalize`, else `dst_height x
+ * dst_width x 3` uint8.
+ * @param dst_height
+ * @param dst_width
+ * @param params
+ * @param isRGB The channel order of `image`, BGR by default.
+ * @return float The resize scale, the `transform_scale` of the detection models.
+ */
+float FusedLetterboxNormalize(const cv::Mat                  &image,
+                              void                           *dst,
+                              int                             dst_height,
+                              int                             dst_width,
+                              const FusedDetPreProcessParams &params,
+                              bool                            isRGB = false);
+
+/**
+ * @brief The same letterbox with plain opencv calls (resize, pad, cvtColor, convertTo, split),
+ * kept as reference for tests and benchmarks.
+ *
+ */
+float FusedLetterboxNormalizeReference(const cv::Mat                  &image,
+                                       void                           *dst,
+                                       int                             dst_height,
+                                       int                             dst_width,
+                                       const FusedDetPreProcessParams &params,
+                                       bool                            isRGB = false);
+
+/**
+ * @brief Create the fused cpu preprocess, a drop-in replacement of `CreateCpuDetPreProcess`
+ * which writes the input blob in one pass. It is also a `IStridedDetectionPreProcess`.
+ *
+ * @param mean
+ * @param stddev
+ * @param swap_rb
+ * @param normalize
+ * @return std::shared_ptr<IDetectionPreProcess>
+ */
+std::shared_ptr<IDetectionPreProcess> CreateFusedCpuDetPreProcess(
+    const std::array<float, 3> &mean      = {0.f, 0.f, 0.f},
+    const std::array<float, 3> &stddev    = {255.f, 255.f, 255.f},
+    bool                        swap_rb   = true,
+    bool                        normalize = true);
+
+std::shared_ptr<BaseDetectionPreprocessFactory> CreateFusedCpuDetPreProcessFactory(
+    const std::array<float, 3> &mean      = {0.f, 0.f, 0.f},
+    const std::array<float, 3> &stddev    = {255.f, 255.f, 255.f},
+    bool                        swap_rb   = true,
+    bool                        normalize = true);
+
+} // namespace easy_deploy
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vector>
+
+#include "deploy_core/base_detection.hpp"
+
+namespace easy_deploy {
+
+/**
+ * @brief A decoded box before NMS, `cx/cy/w/h` as in `BBox2D`.
+ *
+ */
+struct DetectionCandidate {
+  float cx;
+  float cy;
+  float w;
+  float h;
+  float conf;
+  int   cls;
+};
+
+struct NmsConfig {
+  // a box overlapping a better box of the same class by more IoU is dropped
+  float iou_thresh = 0.45f;
+  // the most confident candidates kept before NMS, `<= 0` keeps all
+  int pre_nms_top_k = 30000;
+  // the most confident boxes kept after NMS, `<= 0` keeps all
+  int max_detections = 300;
+  // suppress across classes too
+  bool class_agnostic = false;
+  // indexed by class, a box is kept above the larger of its class threshold and the threshold of
+  // the call. Classes out of the list only use the threshold of the call.
+  std::vector<float> class_conf_thresh;
+};
+
+/**
+ * @brief Class-aware greedy NMS in O(n log n). The candidates are filtered by their class
+ * thresholds, capped to the `pre_nms_top_k` most confident and sorted once by (class,
+ * confidence). Each class is then suppressed against the boxes already kept, looked up in a
+ * uniform grid over the extent of the class, so a box is only compared with the boxes it could
+ * overlap. The buffers are kept between calls, not thread-safe.
+ *
+ */
+class NmsEngine {
+public:
+  explicit NmsEngine(const NmsConfig &config = NmsConfig());
+
+  /**
+   * @brief Run NMS on `candidates`.
+   *
+   * @param candidates
+   * @param num
+   * @param conf_thresh
+   * @return const std::vector<int>& Indices of the kept candidates by descending confidence, at
+   * most `max_detections`. Valid until the next call.
+   */
+  const std::vector<int> &Run(const DetectionCandidate *candidates, size_t num, float conf_thresh);
+
+  /**
+   * @brief Run NMS on `boxes` in place, for postprocesses which decode into `BBox2D` directly.
+   *
+   * @param boxes
+   * @param conf_thresh
+   */
+  void Run(std::vector<BBox2D> &boxes, float conf_thresh);
+
+  /**
+   * @brief The confidence threshold of `cls` for a call with `conf_thresh`.
+   *
+   */
+  float ClassThreshold(int cls, float conf_thresh) const;
+
+  /**
+   * @brief The lowest threshold over `cls_number` classes, decoders reject the anchors below it
+   * before decoding their box.
+   *
+   */
+  float MinThreshold(int cls_number, float conf_thresh) const;
+
+  const NmsConfig &GetConfig() const
+  {
+    return config_;
+  }
+
+private:
+  struct Corners {
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+    float area;
+  };
+
+  void SuppressClass(int begin, int end);
+
+private:
+  const NmsConfig config_;
+
+  std::vector<int>     order_;
+  std::vector<Corners> corners_;
+  std::vector<int>     kept_;
+  std::vector<int>     kept_order_;
+  // grid of the kept boxes of a class : a linked list of entries per cell
+  std::vector<int> cell_head_;
+  std::vector<int> entry_next_;
+  std::vector<int> entry_box_;
+  std::vector<int> touched_cells_;
+  // the last candidate compared with a kept box, a box spanning several cells is checked once
+  std::vector<int> checked_by_;
+
+  std::vector<DetectionCandidate> box_candidates_;
+  std::vector<BBox2D>             box_results_;
+};
+
+/**
+ * @brief The straightforward O(n^2) greedy NMS with the same config, kept as reference for tests
+ * and benchmarks.
+ *
+ */
+std::vector<int> NmsNaive(const DetectionCandidate *candidates,
+                          size_t                    num,
+                          float                     conf_thresh,
+                          const NmsConfig          &config);
+
+} // namespace easy_deploy
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+
+#include "deploy_core/base_detection.hpp"
+
+namespace easy_deploy {
+
+/**
+ * @brief Optional construction params of the roi detection model.
+ *
+ */
+struct RoiDetectionConfig {
+  // the input size of the detection model
+  int input_height = 640;
+  int input_width  = 640;
+  // a region smaller than the model input is grown around its center to the input size, and
+  // detected at the native scale with its surroundings as context. Otherwise it is enlarged.
+  bool upscale_small_roi = false;
+  // drop the boxes whose center is out of their region, the ones of the grown context included
+  bool clip_to_roi = true;
+  // the boxes of overlapping regions are merged by NMS
+  float merge_iou_thresh = 0.5f;
+  bool  class_agnostic   = false;
+};
+
+/**
+ * @brief A region of the frame and its crop, the boxes detected on the crop are shifted by its
+ * origin back to the frame, the letterbox scale is already undone by the model.
+ *
+ */
+struct RoiCrop {
+  cv::Rect roi;
+  cv::Rect crop;
+};
+
+/**
+ * @brief Detection restricted to regions of interest of the frame, given per request : the
+ * regions are cropped as views into the frame, letterboxed from their native pixels, detected in
+ * batches (a `BaseBatchDetectionModel`) or pipelined through the async api of the model, and their
+ * boxes are mapped back to the frame.
+ *
+ */
+class BaseRoiDetectionModel {
+public:
+  /**
+   * @brief Detect objects in the regions `rois` of `image`.
+   *
+   * @param image
+   * @param rois In the frame, clipped to it. An empty list is the whole frame.
+   * @param results In the frame, by descending confidence.
+   * @param conf_thresh
+   * @param isRGB
+   * @return true
+   * @return false
+   */
+  virtual bool Detect(const cv::Mat               &image,
+                      const std::vector<cv::Rect> &rois,
+                      std::vector<BBox2D>         &results,
+                      float                        conf_thresh,
+                      bool                         isRGB = false) = 0;
+
+  virtual ~BaseRoiDetectionModel() = default;
+};
+
+class BaseRoiDetectionFactory {
+public:
+  virtual std::shared_ptr<BaseRoiDetectionModel> Create() = 0;
+
+  virtual ~BaseRoiDetectionFactory() = default;
+};
+
+/**
+ * @brief The crops of `rois` in a `image_height x image_width` frame. The regions are clipped to
+ * the frame, the empty ones dropped, and grown around their center to the aspect ratio of the
+ * model input, the context then fills what would be letterbox padding. The regions smaller than the
+ * model input are grown to it unless `config.upscale_small_roi`. A crop is moved inside the frame,
+ * and is clipped to it if larger.
+ *
+ * @param image_height
+ * @param image_width
+ * @param rois
+ * @param config
+ * @return std::vector<RoiCrop>
+ */
+std::vector<RoiCrop> ComputeRoiCrops(int                          image_height,
+                                     int                          image_width,
+                                     const std::vector<cv::Rect> &rois,
+                                     const RoiDetectionConfig    &config);
+
+/**
+ * @brief Map `boxes` detected on `crop.crop` back to the frame, and drop the ones out of
+ * `crop.roi` if `clip_to_roi`.
+ *
+ * @param crop
+ * @param boxes
+ * @param clip_to_roi
+ */
+void MapBoxesToFrame(const RoiCrop &crop, std::vector<BBox2D> &boxes, bool clip_to_roi);
+
+/**
+ * @brief Create a roi detection model.
+ *
+ * @param detection_model Detects the regions, in batches if it is a `BaseBatchDetectionModel`.
+ * Otherwise the regions go through `DetectAsync`, and the async pipeline of the model should be
+ * initialized.
+ * @param config
+ * @return std::shared_ptr<BaseRoiDetectionModel>
+ */
+std::shared_ptr<BaseRoiDetectionModel> CreateRoiDetectionModel(
+    const std::shared_ptr<BaseDetectionModel> &detection_model,
+    const RoiDetectionConfig                  &config = {});
+
+std::shared_ptr<BaseRoiDetectionFactory> CreateRoiDetectionModelFactory(
+    std::shared_ptr<BaseDetection2DFactory> detection_factory,
+    const RoiDetectionConfig               &config = {});
+
+} // namespace easy_deploy
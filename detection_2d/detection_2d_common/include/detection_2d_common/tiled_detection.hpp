@@ -0,0 +1,116 @@
+#pragma once
+
+#include <vector>
+
+#include "deploy_core/base_detection.hpp"
+
+namespace easy_deploy {
+
+enum class TileMergeMethod {
+  // keep the best of the overlapping boxes
+  NMS,
+  // fuse the overlapping boxes into their confidence-weighted mean
+  WBF
+};
+
+/**
+ * @brief Optional construction params of the tiled detection model.
+ *
+ */
+struct TiledDetectionConfig {
+  // size of the tiles in the original image, usually the input size of the model
+  int tile_height = 640;
+  int tile_width  = 640;
+  // overlap of neighbouring tiles, as a ratio of the tile size, so that an object cut by a tile
+  // border is whole in another tile
+  float overlap_ratio = 0.2f;
+  // also detect on the whole image letterboxed as usual, for the objects larger than a tile
+  bool with_full_image = true;
+  // how the boxes of the tiles are merged, boxes overlapping by more IoU are merged
+  TileMergeMethod merge_method     = TileMergeMethod::NMS;
+  float           merge_iou_thresh = 0.5f;
+  bool            class_agnostic   = false;
+  // the most confident boxes kept after merging, `<= 0` keeps all
+  int max_detections = 300;
+};
+
+/**
+ * @brief Detection on high resolution images by overlapping tiles : the tiles are views into the
+ * input image, detected in batches (a `BaseBatchDetectionModel`) or pipelined through the async
+ * api of the model, then their boxes are moved back to the original image and merged across the
+ * tile borders.
+ *
+ */
+class BaseTiledDetectionModel {
+public:
+  /**
+   * @brief Detect objects on `image` tile by tile.
+   *
+   * @param image
+   * @param results In the original image, by descending confidence.
+   * @param conf_thresh
+   * @param isRGB
+   * @return true
+   * @return false
+   */
+  virtual bool Detect(const cv::Mat       &image,
+                      std::vector<BBox2D> &results,
+                      float                conf_thresh,
+                      bool                 isRGB = false) = 0;
+
+  virtual ~BaseTiledDetectionModel() = default;
+};
+
+class BaseTiledDetectionFactory {
+public:
+  virtual std::shared_ptr<BaseTiledDetectionModel> Create() = 0;
+
+  virtual ~BaseTiledDetectionFactory() = default;
+};
+
+/**
+ * @brief The tiles of a `image_height x image_width` image, row by row. The tiles have the same
+ * size, the last tile of a row or a column is moved back inside the image instead of being cut,
+ * and an image smaller than a tile is a single tile.
+ *
+ * @param image_height
+ * @param image_width
+ * @param config
+ * @return std::vector<cv::Rect>
+ */
+std::vector<cv::Rect> ComputeTiles(int                         image_height,
+                                   int                         image_width,
+                                   const TiledDetectionConfig &config);
+
+/**
+ * @brief Weighted boxes fusion in place : the boxes are visited by descending confidence, a box
+ * overlapping a fused box of its class by more than `iou_thresh` joins it, others start a new one.
+ * A fused box is the confidence-weighted mean of its boxes, with their max confidence, so that an
+ * object seen by a single tile keeps its score.
+ *
+ * @param boxes
+ * @param iou_thresh
+ * @param class_agnostic
+ */
+void WeightedBoxesFusion(std::vector<BBox2D> &boxes,
+                         float                iou_thresh,
+                         bool                 class_agnostic = false);
+
+/**
+ * @brief Create a tiled detection model.
+ *
+ * @param detection_model Detects the tiles, in batches if it is a `BaseBatchDetectionModel`.
+ * Otherwise the tiles go through `DetectAsync`, and the async pipeline of the model should be
+ * initialized.
+ * @param config
+ * @return std::shared_ptr<BaseTiledDetectionModel>
+ */
+std::shared_ptr<BaseTiledDetectionModel> CreateTiledDetectionModel(
+    const std::shared_ptr<BaseDetectionModel> &detection_model,
+    const TiledDetectionConfig                &config = {});
+
+std::shared_ptr<BaseTiledDetectionFactory> CreateTiledDetectionModelFactory(
+    std::shared_ptr<BaseDetection2DFactory> detection_factory,
+    const TiledDetectionConfig             &config = {});
+
+} // namespace easy_deploy
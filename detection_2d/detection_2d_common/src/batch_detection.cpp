@@ -0,0 +1,187 @@
+#include "detection_2d_common/batch_detection.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+
+#include "deploy_core/wrapper.hpp"
+
+namespace easy_deploy {
+
+BaseBatchDetectionModel::BaseBatchDetectionModel(
+    const std::shared_ptr<BaseInferCore>        &infer_core,
+    const std::shared_ptr<IDetectionPreProcess> &preprocess_block,
+    const std::string                           &input_blob_name,
+    int                                          input_height,
+    int                                          input_width,
+    int                                          input_channel)
+    : BaseDetectionModel(infer_core),
+      batch_infer_core_(infer_core),
+      batch_preprocess_block_(preprocess_block),
+      strided_preprocess_block_(
+          std::dynamic_pointer_cast<IStridedDetectionPreProcess>(preprocess_block)),
+      batch_input_blob_name_(input_blob_name),
+      batch_input_height_(input_height),
+      batch_input_width_(input_width),
+      batch_input_channel_(input_channel)
+{
+  // the batch capacity of the infer core is the max batch dimension of its input blob
+  auto        blobs_buffer = batch_infer_core_->AllocBlobsBuffer();
+  const auto &input_shape  = blobs_buffer->GetTensor(batch_input_blob_name_)->GetShape();
+  if (input_shape.size() == 4 && input_shape[0] > 1)
+  {
+    max_batch_size_ = static_cast<int>(input_shape[0]);
+  }
+}
+
+bool BaseBatchDetectionModel::DetectBatch(const std::vector<cv::Mat>        &images,
+                                          std::vector<std::vector<BBox2D>> &results,
+                                          float                             conf_thresh,
+                                          bool                              isRGB)
+{
+  results.clear();
+  results.resize(images.size());
+  for (const auto &image : images)
+  {
+    CHECK_STATE(!image.empty(), "[BaseBatchDetectionModel] DetectBatch got empty image!!!");
+  }
+
+  // a preprocess reading views in place goes through the batch path even one image at a time
+  if (max_batch_size_ == 1 && strided_preprocess_block_ == nullptr)
+  {
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+      const cv::Mat image = images[i].isContinuous() ? images[i] : images[i].clone();
+      CHECK_STATE(Detect(image, results[i], conf_thresh, isRGB),
+                  "[BaseBatchDetectionModel] DetectBatch detection failed!!!");
+    }
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(batch_mtx_);
+  for (size_t begin = 0; begin < images.size(); begin += max_batch_size_)
+  {
+    const size_t batch_size = std::min(images.size() - begin, static_cast<size_t>(max_batch_size_));
+    CHECK_STATE(InferBatch(images.data() + begin, batch_size, results.data() + begin, conf_thresh,
+                           isRGB),
+                "[BaseBatchDetectionModel] DetectBatch batch inference failed!!!");
+  }
+  return true;
+}
+
+bool BaseBatchDetectionModel::InferBatch(const cv::Mat       *images,
+                                         size_t               batch_size,
+                                         std::vector<BBox2D> *results,
+                                         float                conf_thresh,
+                                         bool                 isRGB)
+{
+  if (batch_buffer_ == nullptr)
+  {
+    batch_buffer_ = batch_infer_core_->AllocBlobsBuffer();
+    stage_buffer_ = batch_infer_core_->AllocBlobsBuffer();
+  }
+
+  // 1. Preprocess every image on its own, keeping its scale, and gather them on host
+  auto        *batch_input  = batch_buffer_->GetTensor(batch_input_blob_name_);
+  auto        *stage_input  = stage_buffer_->GetTensor(batch_input_blob_name_);
+  const size_t image_floats = static_cast<size_t>(batch_input_channel_) * batch_input_height_ *
+                              batch_input_width_;
+  batch_input->SetBufferLocation(DataLocation::HOST);
+  float             *batch_input_ptr = batch_input->Cast<float>();
+  std::vector<float> transform_scales(batch_size);
+  for (size_t i = 0; i < batch_size; ++i)
+  {
+    // written straight into its slot of the batch, views included
+    if (strided_preprocess_block_ != nullptr)
+    {
+      transform_scales[i] = strided_preprocess_block_->PreprocessMat(
+          images[i], batch_input_ptr + i * image_floats, batch_input_height_, batch_input_width_,
+          isRGB);
+      continue;
+    }
+    const cv::Mat *image = &images[i];
+    if (!image->isContinuous())
+    {
+      image->copyTo(dense_image_);
+      image = &dense_image_;
+    }
+    auto image_data     = std::make_shared<PipelineCvImageWrapper>(*image, isRGB);
+    transform_scales[i] = batch_preprocess_block_->Preprocess(
+        image_data, stage_input, batch_input_height_, batch_input_width_);
+    // a device side preprocess is copied back to host here
+    stage_input->SetBufferLocation(DataLocation::HOST);
+    std::memcpy(batch_input_ptr + i * image_floats, stage_input->Cast<float>(),
+                image_floats * sizeof(float));
+  }
+
+  // 2. One inference on the whole batch
+  batch_input->SetShape({batch_size, static_cast<uint64_t>(batch_input_channel_),
+                         static_cast<uint64_t>(batch_input_height_),
+                         static_cast<uint64_t>(batch_input_width_)});
+  CHECK_STATE(batch_infer_core_->SyncInfer(batch_buffer_.get(), static_cast<int>(batch_size)),
+              "[BaseBatchDetectionModel] batch inference failed!!!");
+
+  // 3. Decode every image with its own scale
+  for (size_t i = 0; i < batch_size; ++i)
+  {
+    CHECK_STATE(PostProcessBatchItem(batch_buffer_.get(), i, conf_thresh, transform_scales[i],
+                                     results[i]),
+                "[BaseBatchDetectionModel] batch postprocess failed!!!");
+  }
+  return true;
+}
+
+std::vector<void *> BaseBatchDetectionModel::GetBatchItemOutputs(
+    IBlobsBuffer                   *blobs_buffer,
+    const std::vector<std::string> &output_blobs_name,
+    size_t                          batch_index)
+{
+  std::vector<void *> outputs;
+  outputs.reserve(output_blobs_name.size());
+  for (const auto &output_blob_name : output_blobs_name)
+  {
+    auto       *tensor     = blobs_buffer->GetTensor(output_blob_name);
+    const auto &shape      = tensor->GetShape();
+    size_t      item_elems = 1;
+    for (size_t d = 1; d < shape.size(); ++d)
+    {
+      item_elems *= shape[d];
+    }
+    outputs.push_back(tensor->Cast<float>() + batch_index * item_elems);
+  }
+  return outputs;
+}
+
+bool DetectViews(const std::shared_ptr<BaseDetectionModel> &detection_model,
+                 std::vector<cv::Mat>                      &views,
+                 std::vector<std::vector<BBox2D>>          &results,
+                 float                                      conf_thresh,
+                 bool                                       isRGB)
+{
+  // in batches, a preprocess reading views in place keeps them zero-copy
+  auto batch_model = std::dynamic_pointer_cast<BaseBatchDetectionModel>(detection_model);
+  if (batch_model != nullptr)
+  {
+    return batch_model->DetectBatch(views, results, conf_thresh, isRGB);
+  }
+
+  std::vector<std::future<std::vector<BBox2D>>> futures;
+  for (auto &view : views)
+  {
+    if (!view.isContinuous())
+    {
+      view = view.clone();
+    }
+    futures.push_back(detection_model->DetectAsync(view, conf_thresh, isRGB));
+    CHECK_STATE(futures.back().valid(),
+                "[DetectViews] Async detection failed, is the pipeline initialized?");
+  }
+  results.resize(futures.size());
+  for (size_t i = 0; i < futures.size(); ++i)
+  {
+    results[i] = futures[i].get();
+  }
+  return true;
+}
+
+} // namespace easy_deploy
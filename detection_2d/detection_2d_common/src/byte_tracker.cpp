@@ -0,0 +1,658 @@
+#include "detection_2d_common/byte_tracker.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+
+namespace easy_deploy {
+
+namespace {
+
+// noise of the ByteTrack filter relative to the box height, the aspect ratio has fixed ones
+constexpr float kStdWeightPosition = 1.f / 20;
+constexpr float kStdWeightVelocity = 1.f / 160;
+constexpr int   kAspect            = 2;
+// cost of a pair which is not a candidate
+constexpr double kForbiddenCost = 1e6;
+
+// the (cx, cy, w / h, h) measurement of a box
+inline std::array<float, 4> Measure(const BBox2D &box)
+{
+  return {box.x, box.y, box.w / std::max(box.h, 1e-3f), box.h};
+}
+
+inline int FindRoot(std::vector<int> &parent, int node)
+{
+  while (parent[node] != node)
+  {
+    parent[node] = parent[parent[node]];
+    node         = parent[node];
+  }
+  return node;
+}
+
+// min cost assignment of a `rows x cols` matrix by the hungarian algorithm. The matrix is extended
+// to `rows + cols` squared, so that leaving a row and a column unmatched costs `cost_limit` and a
+// pair is only matched below it, as `lap.lapjv(..., cost_limit)` does in ByteTrack.
+void SolveAssignment(const std::vector<double> &cost,
+                     int                        rows,
+                     int                        cols,
+                     double                     cost_limit,
+                     std::vector<int>          &row_match)
+{
+  const int n             = rows + cols;
+  auto      extended_cost = [&](int i, int j) {
+    if (i < rows && j < cols)
+    {
+      return cost[i * cols + j];
+    }
+    if (i < rows)
+    {
+      return j - cols == i ? cost_limit / 2 : kForbiddenCost;
+    }
+    if (j < cols)
+    {
+      return i - rows == j ? cost_limit / 2 : kForbiddenCost;
+    }
+    return 0.;
+  };
+
+  // potentials `u, v` of the rows and columns, `match[j]` the row of column `j`, 1-based
+  const double        inf = std::numeric_limits<double>::infinity();
+  std::vector<double> u(n + 1, 0.), v(n + 1, 0.), min_reduced(n + 1);
+  std::vector<int>    match(n + 1, 0), way(n + 1, 0);
+  std::vector<bool>   used(n + 1);
+  for (int i = 1; i <= n; ++i)
+  {
+    match[0] = i;
+    int j0   = 0;
+    std::fill(min_reduced.begin(), min_reduced.end(), inf);
+    std::fill(used.begin(), used.end(), false);
+    do
+    {
+      used[j0] = true;
+
+      const int i0    = match[j0];
+      double    delta = inf;
+      int       j1    = 0;
+      for (int j = 1; j <= n; ++j)
+      {
+        if (used[j])
+        {
+          continue;
+        }
+        const double reduced = extended_cost(i0 - 1, j - 1) - u[i0] - v[j];
+        if (reduced < min_reduced[j])
+        {
+          min_reduced[j] = reduced;
+          way[j]         = j0;
+        }
+        if (min_reduced[j] < delta)
+        {
+          delta = min_reduced[j];
+          j1    = j;
+        }
+      }
+      for (int j = 0; j <= n; ++j)
+      {
+        if (used[j])
+        {
+          u[match[j]] += delta;
+          v[j] -= delta;
+        } else
+        {
+          min_reduced[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (match[j0] != 0);
+    do
+    {
+      const int j1 = way[j0];
+      match[j0]    = match[j1];
+      j0           = j1;
+    } while (j0 != 0);
+  }
+
+  row_match.assign(rows, -1);
+  for (int j = 1; j <= cols; ++j)
+  {
+    const int i = match[j] - 1;
+    if (i >= 0 && i < rows && cost[i * cols + j - 1] < cost_limit)
+    {
+      row_match[i] = j - 1;
+    }
+  }
+}
+
+} // namespace
+
+ByteTracker::ByteTracker(const ByteTrackConfig &config) : config_(config)
+{
+  if (config_.low_thresh > config_.high_thresh || config_.max_lost_frames < 0)
+  {
+    throw std::invalid_argument("[ByteTracker] Got INVALID config!!!");
+  }
+}
+
+void ByteTracker::Reset()
+{
+  for (auto *values : {&track_id_, &state_, &lost_frames_})
+  {
+    values->clear();
+  }
+  for (auto *values : {&cls_, &conf_, &x0_, &y0_, &x1_, &y1_})
+  {
+    values->clear();
+  }
+  for (int d = 0; d < 4; ++d)
+  {
+    for (auto *values : {&pos_[d], &vel_[d], &cov_pp_[d], &cov_pv_[d], &cov_vv_[d]})
+    {
+      values->clear();
+    }
+  }
+  next_track_id_ = 0;
+  first_frame_   = true;
+}
+
+void ByteTracker::PredictTracks()
+{
+  const int num_tracks = static_cast<int>(track_id_.size());
+  for (int t = 0; t < num_tracks; ++t)
+  {
+    // the height of a track not matched on the last frame stops changing
+    if (state_[t] != kTracked)
+    {
+      vel_[3][t] = 0.f;
+    }
+  }
+
+  // one dimension at a time over all tracks. The noise scales with the height before the
+  // prediction, which is predicted last.
+  const float *height = pos_[3].data();
+  for (int d = 0; d < 4; ++d)
+  {
+    float *pos    = pos_[d].data();
+    float *vel    = vel_[d].data();
+    float *cov_pp = cov_pp_[d].data();
+    float *cov_pv = cov_pv_[d].data();
+    float *cov_vv = cov_vv_[d].data();
+    for (int t = 0; t < num_tracks; ++t)
+    {
+      const float std_pos = d == kAspect ? 1e-2f : kStdWeightPosition * height[t];
+      const float std_vel = d == kAspect ? 1e-5f : kStdWeightVelocity * height[t];
+      pos[t] += vel[t];
+      cov_pp[t] += 2 * cov_pv[t] + cov_vv[t] + std_pos * std_pos;
+      cov_pv[t] += cov_vv[t];
+      cov_vv[t] += std_vel * std_vel;
+    }
+  }
+
+  for (int t = 0; t < num_tracks; ++t)
+  {
+    const float h = pos_[3][t];
+    const float w = pos_[2][t] * h;
+    x0_[t]        = pos_[0][t] - w / 2;
+    y0_[t]        = pos_[1][t] - h / 2;
+    x1_[t]        = pos_[0][t] + w / 2;
+    y1_[t]        = pos_[1][t] + h / 2;
+  }
+}
+
+void ByteTracker::AddTrack(const BBox2D &detection, TrackState state)
+{
+  const auto  measurement = Measure(detection);
+  const float h           = measurement[3];
+  track_id_.push_back(next_track_id_++);
+  state_.push_back(state);
+  lost_frames_.push_back(0);
+  cls_.push_back(detection.cls);
+  conf_.push_back(detection.conf);
+  for (int d = 0; d < 4; ++d)
+  {
+    const float std_pos = d == kAspect ? 1e-2f : 2 * kStdWeightPosition * h;
+    const float std_vel = d == kAspect ? 1e-5f : 10 * kStdWeightVelocity * h;
+    pos_[d].push_back(measurement[d]);
+    vel_[d].push_back(0.f);
+    cov_pp_[d].push_back(std_pos * std_pos);
+    cov_pv_[d].push_back(0.f);
+    cov_vv_[d].push_back(std_vel * std_vel);
+  }
+  x0_.push_back(detection.x - detection.w / 2);
+  y0_.push_back(detection.y - detection.h / 2);
+  x1_.push_back(detection.x + detection.w / 2);
+  y1_.push_back(detection.y + detection.h / 2);
+}
+
+void ByteTracker::UpdateTrack(int track, const BBox2D &detection)
+{
+  const auto  measurement = Measure(detection);
+  const float h           = pos_[3][track];
+  for (int d = 0; d < 4; ++d)
+  {
+    const float std_measure = d == kAspect ? 1e-1f : kStdWeightPosition * h;
+    float      &cov_pp      = cov_pp_[d][track];
+    float      &cov_pv      = cov_pv_[d][track];
+    float      &cov_vv      = cov_vv_[d][track];
+    const float innovation  = measurement[d] - pos_[d][track];
+    const float gain_pos    = cov_pp / (cov_pp + std_measure * std_measure);
+    const float gain_vel    = cov_pv / (cov_pp + std_measure * std_measure);
+    pos_[d][track] += gain_pos * innovation;
+    vel_[d][track] += gain_vel * innovation;
+    cov_vv -= gain_vel * cov_pv;
+    cov_pv -= gain_pos * cov_pv;
+    cov_pp -= gain_pos * cov_pp;
+  }
+  cls_[track]         = detection.cls;
+  conf_[track]        = detection.conf;
+  state_[track]       = kTracked;
+  lost_frames_[track] = 0;
+}
+
+void ByteTracker::RemoveTrack(int track)
+{
+  auto swap_pop = [track](auto &values) {
+    values[track] = values.back();
+    values.pop_back();
+  };
+  swap_pop(track_id_);
+  swap_pop(state_);
+  swap_pop(lost_frames_);
+  swap_pop(cls_);
+  swap_pop(conf_);
+  swap_pop(x0_);
+  swap_pop(y0_);
+  swap_pop(x1_);
+  swap_pop(y1_);
+  for (int d = 0; d < 4; ++d)
+  {
+    swap_pop(pos_[d]);
+    swap_pop(vel_[d]);
+    swap_pop(cov_pp_[d]);
+    swap_pop(cov_pv_[d]);
+    swap_pop(cov_vv_[d]);
+  }
+}
+
+void ByteTracker::Associate(std::vector<int>          &tracks,
+                            std::vector<int>          &detections,
+                            const std::vector<BBox2D> &boxes,
+                            float                      min_iou)
+{
+  // the entries matched by an earlier pass
+  tracks.erase(std::remove(tracks.begin(), tracks.end(), -1), tracks.end());
+  detections.erase(std::remove(detections.begin(), detections.end(), -1), detections.end());
+  const int num_tracks     = static_cast<int>(tracks.size());
+  const int num_detections = static_cast<int>(detections.size());
+  if (num_tracks == 0 || num_detections == 0)
+  {
+    return;
+  }
+
+  // 1. The corners of the tracks gathered by ascending left edge : a detection only overlaps the
+  // contiguous run of tracks starting less than the widest track before it, over which its IoU
+  // vectorizes. The pairs above `min_iou` are the candidates.
+  track_order_.resize(num_tracks);
+  std::iota(track_order_.begin(), track_order_.end(), 0);
+  std::sort(track_order_.begin(), track_order_.end(),
+            [this, &tracks](int a, int b) { return x0_[tracks[a]] < x0_[tracks[b]]; });
+  track_x0_.resize(num_tracks);
+  track_y0_.resize(num_tracks);
+  track_x1_.resize(num_tracks);
+  track_y1_.resize(num_tracks);
+  iou_row_.resize(num_tracks);
+  float max_track_width = 0.f;
+  for (int k = 0; k < num_tracks; ++k)
+  {
+    const int t     = tracks[track_order_[k]];
+    track_x0_[k]    = x0_[t];
+    track_y0_[k]    = y0_[t];
+    track_x1_[k]    = x1_[t];
+    track_y1_[k]    = y1_[t];
+    max_track_width = std::max(max_track_width, x1_[t] - x0_[t]);
+  }
+  pair_track_.clear();
+  pair_detection_.clear();
+  pair_iou_.clear();
+  for (int j = 0; j < num_detections; ++j)
+  {
+    const BBox2D &box      = boxes[detections[j]];
+    const float   box_x0   = box.x - box.w / 2;
+    const float   box_y0   = box.y - box.h / 2;
+    const float   box_x1   = box.x + box.w / 2;
+    const float   box_y1   = box.y + box.h / 2;
+    const float   box_area = box.w * box.h;
+    const auto    first =
+        std::lower_bound(track_x0_.begin(), track_x0_.end(), box_x0 - max_track_width);
+    const int begin = first - track_x0_.begin();
+    const int end   = std::lower_bound(first, track_x0_.end(), box_x1) - track_x0_.begin();
+    for (int k = begin; k < end; ++k)
+    {
+      const float inter_w =
+          std::max(0.f, std::min(track_x1_[k], box_x1) - std::max(track_x0_[k], box_x0));
+      const float inter_h =
+          std::max(0.f, std::min(track_y1_[k], box_y1) - std::max(track_y0_[k], box_y0));
+      const float track_area = (track_x1_[k] - track_x0_[k]) * (track_y1_[k] - track_y0_[k]);
+      const float inter      = inter_w * inter_h;
+      iou_row_[k]            = inter / std::max(track_area + box_area - inter, 1e-6f);
+    }
+    for (int k = begin; k < end; ++k)
+    {
+      const int track = track_order_[k];
+      if (iou_row_[k] > min_iou && (!config_.class_aware || cls_[tracks[track]] == box.cls))
+      {
+        pair_track_.push_back(track);
+        pair_detection_.push_back(j);
+        pair_iou_.push_back(iou_row_[k]);
+      }
+    }
+  }
+
+  // 2. Groups of tracks and detections linked by candidate pairs, matched independently : most
+  // groups are a single pair, the assignment stays small with hundreds of tracks
+  const int num_pairs = static_cast<int>(pair_track_.size());
+  group_parent_.resize(num_tracks + num_detections);
+  std::iota(group_parent_.begin(), group_parent_.end(), 0);
+  for (int p = 0; p < num_pairs; ++p)
+  {
+    group_parent_[FindRoot(group_parent_, pair_track_[p])] =
+        FindRoot(group_parent_, num_tracks + pair_detection_[p]);
+  }
+  pair_root_.resize(num_pairs);
+  for (int p = 0; p < num_pairs; ++p)
+  {
+    pair_root_[p] = FindRoot(group_parent_, pair_track_[p]);
+  }
+  pair_order_.resize(num_pairs);
+  std::iota(pair_order_.begin(), pair_order_.end(), 0);
+  std::sort(pair_order_.begin(), pair_order_.end(),
+            [this](int a, int b) { return pair_root_[a] < pair_root_[b]; });
+
+  // 3. The min cost assignment of each group, the cost is `1 - IoU`
+  node_local_.assign(num_tracks + num_detections, -1);
+  matches_.clear();
+  for (int begin = 0; begin < num_pairs;)
+  {
+    int end = begin;
+    while (end < num_pairs && pair_root_[pair_order_[end]] == pair_root_[pair_order_[begin]])
+    {
+      ++end;
+    }
+    if (end - begin == 1)
+    {
+      matches_.emplace_back(pair_track_[pair_order_[begin]], pair_detection_[pair_order_[begin]]);
+      begin = end;
+      continue;
+    }
+
+    group_tracks_.clear();
+    group_detections_.clear();
+    for (int q = begin; q < end; ++q)
+    {
+      const int p = pair_order_[q];
+      if (node_local_[pair_track_[p]] < 0)
+      {
+        node_local_[pair_track_[p]] = static_cast<int>(group_tracks_.size());
+        group_tracks_.push_back(pair_track_[p]);
+      }
+      if (node_local_[num_tracks + pair_detection_[p]] < 0)
+      {
+        node_local_[num_tracks + pair_detection_[p]] = static_cast<int>(group_detections_.size());
+        group_detections_.push_back(pair_detection_[p]);
+      }
+    }
+    const int rows = static_cast<int>(group_tracks_.size());
+    const int cols = static_cast<int>(group_detections_.size());
+    cost_.assign(rows * cols, kForbiddenCost);
+    for (int q = begin; q < end; ++q)
+    {
+      const int p = pair_order_[q];
+      cost_[node_local_[pair_track_[p]] * cols + node_local_[num_tracks + pair_detection_[p]]] =
+          1. - pair_iou_[p];
+    }
+    SolveAssignment(cost_, rows, cols, 1. - min_iou, row_match_);
+    for (int r = 0; r < rows; ++r)
+    {
+      if (row_match_[r] >= 0)
+      {
+        matches_.emplace_back(group_tracks_[r], group_detections_[row_match_[r]]);
+      }
+    }
+    begin = end;
+  }
+
+  for (const auto &match : matches_)
+  {
+    UpdateTrack(tracks[match.first], boxes[detections[match.second]]);
+    tracks[match.first]      = -1;
+    detections[match.second] = -1;
+  }
+}
+
+const std::vector<TrackedBBox2D> &ByteTracker::Update(const std::vector<BBox2D> &detections)
+{
+  PredictTracks();
+  const int num_tracks = static_cast<int>(track_id_.size());
+
+  high_detections_.clear();
+  low_detections_.clear();
+  for (int i = 0; i < static_cast<int>(detections.size()); ++i)
+  {
+    if (detections[i].conf >= config_.high_thresh)
+    {
+      high_detections_.push_back(i);
+    } else if (detections[i].conf >= config_.low_thresh)
+    {
+      low_detections_.push_back(i);
+    }
+  }
+
+  // 1. The tracked and lost tracks against the confident detections
+  confirmed_tracks_.clear();
+  tentative_tracks_.clear();
+  for (int t = 0; t < num_tracks; ++t)
+  {
+    (state_[t] == kTentative ? tentative_tracks_ : confirmed_tracks_).push_back(t);
+  }
+  Associate(confirmed_tracks_, high_detections_, detections, config_.high_match_iou);
+
+  // 2. The tracks still unmatched against the low score ones, which are occluded objects more
+  // often than false positives when they overlap a track. The unmatched tracks are lost.
+  remaining_tracks_.clear();
+  for (const int t : confirmed_tracks_)
+  {
+    if (t >= 0 && state_[t] == kTracked)
+    {
+      remaining_tracks_.push_back(t);
+    }
+  }
+  Associate(remaining_tracks_, low_detections_, detections, config_.low_match_iou);
+  for (const int t : remaining_tracks_)
+  {
+    if (t >= 0)
+    {
+      state_[t] = kLost;
+    }
+  }
+
+  // 3. The tracks started on the last frame are confirmed by a confident detection, or dropped
+  Associate(tentative_tracks_, high_detections_, detections, config_.new_match_iou);
+  removed_.assign(num_tracks, 0);
+  for (const int t : tentative_tracks_)
+  {
+    if (t >= 0)
+    {
+      removed_[t] = 1;
+    }
+  }
+  for (const int t : confirmed_tracks_)
+  {
+    if (t >= 0 && state_[t] == kLost && ++lost_frames_[t] > config_.max_lost_frames)
+    {
+      removed_[t] = 1;
+    }
+  }
+  for (int t = num_tracks - 1; t >= 0; --t)
+  {
+    if (removed_[t])
+    {
+      RemoveTrack(t);
+    }
+  }
+
+  // 4. New tracks from the confident detections left, confirmed at once on the first frame
+  for (const int i : high_detections_)
+  {
+    if (i >= 0 && detections[i].conf >= config_.new_track_thresh)
+    {
+      AddTrack(detections[i], first_frame_ ? kTracked : kTentative);
+    }
+  }
+  first_frame_ = false;
+  return CollectResults();
+}
+
+const std::vector<TrackedBBox2D> &ByteTracker::Predict()
+{
+  PredictTracks();
+  for (int t = static_cast<int>(track_id_.size()) - 1; t >= 0; --t)
+  {
+    if (state_[t] == kLost && ++lost_frames_[t] > config_.max_lost_frames)
+    {
+      RemoveTrack(t);
+    }
+  }
+  return CollectResults();
+}
+
+const std::vector<TrackedBBox2D> &ByteTracker::CollectResults()
+{
+  results_.clear();
+  for (size_t t = 0; t < track_id_.size(); ++t)
+  {
+    if (state_[t] != kTracked)
+    {
+      continue;
+    }
+    TrackedBBox2D result;
+    result.box.h    = pos_[3][t];
+    result.box.w    = pos_[2][t] * result.box.h;
+    result.box.x    = pos_[0][t];
+    result.box.y    = pos_[1][t];
+    result.box.cls  = cls_[t];
+    result.box.conf = conf_[t];
+    result.track_id = track_id_[t];
+    results_.push_back(result);
+  }
+  return results_;
+}
+
+class TrackedDetection : public BaseTrackedDetectionModel {
+public:
+  TrackedDetection(const std::shared_ptr<BaseDetectionModel> &detection_model,
+                   const TrackedDetectionConfig              &config);
+
+  bool Track(const cv::Mat &frame, std::vector<TrackedBBox2D> &results, bool isRGB) override;
+
+  void Reset() override;
+
+private:
+  const std::shared_ptr<BaseDetectionModel> detection_model_;
+  const TrackedDetectionConfig              config_;
+
+  std::mutex          mtx_;
+  ByteTracker         tracker_;
+  size_t              frame_index_ = 0;
+  std::vector<BBox2D> detections_;
+};
+
+TrackedDetection::TrackedDetection(const std::shared_ptr<BaseDetectionModel> &detection_model,
+                                   const TrackedDetectionConfig              &config)
+    : detection_model_(detection_model), config_(config), tracker_(config.tracker)
+{
+  if (detection_model_ == nullptr)
+  {
+    throw std::invalid_argument("[TrackedDetection] Got INVALID detection model ptr!!!");
+  }
+  if (config_.detect_interval < 1)
+  {
+    throw std::invalid_argument("[TrackedDetection] `detect_interval` should be positive!!!");
+  }
+}
+
+bool TrackedDetection::Track(const cv::Mat              &frame,
+                             std::vector<TrackedBBox2D> &results,
+                             bool                        isRGB)
+{
+  CHECK_STATE(!frame.empty(), "[TrackedDetection] Track got empty frame!!!");
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  // the frames between two detections only cost the prediction of the tracks
+  if (frame_index_ % config_.detect_interval != 0)
+  {
+    results = tracker_.Predict();
+    ++frame_index_;
+    return true;
+  }
+  CHECK_STATE(
+      detection_model_->Detect(frame, detections_, config_.tracker.low_thresh, isRGB),
+      "[TrackedDetection] Detection failed!!!");
+  results = tracker_.Update(detections_);
+  ++frame_index_;
+  return true;
+}
+
+void TrackedDetection::Reset()
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  tracker_.Reset();
+  frame_index_ = 0;
+}
+
+std::shared_ptr<BaseTrackedDetectionModel> CreateTrackedDetectionModel(
+    const std::shared_ptr<BaseDetectionModel> &detection_model,
+    const TrackedDetectionConfig              &config)
+{
+  return std::make_shared<TrackedDetection>(detection_model, config);
+}
+
+struct TrackedDetectionParams {
+  std::shared_ptr<BaseDetection2DFactory> detection_factory;
+  TrackedDetectionConfig                  config;
+};
+
+class TrackedDetectionFactory : public BaseTrackedDetectionFactory {
+public:
+  TrackedDetectionFactory(const TrackedDetectionParams &params) : params_(params)
+  {}
+
+  std::shared_ptr<BaseTrackedDetectionModel> Create() override
+  {
+    return CreateTrackedDetectionModel(params_.detection_factory->Create(), params_.config);
+  }
+
+private:
+  TrackedDetectionParams params_;
+};
+
+std::shared_ptr<BaseTrackedDetectionFactory> CreateTrackedDetectionModelFactory(
+    std::shared_ptr<BaseDetection2DFactory> detection_factory,
+    const TrackedDetectionConfig           &config)
+{
+  if (detection_factory == nullptr)
+  {
+    throw std::invalid_argument(
+        "[CreateTrackedDetectionModelFactory] Got invalid input arguments!");
+  }
+
+  TrackedDetectionParams params;
+  params.detection_factory = detection_factory;
+  params.config            = config;
+
+  return std::make_shared<TrackedDetectionFactory>(params);
+}
+
+} // namespace easy_deploy
@@ -0,0 +1,148 @@
+#include "detection_2d_common/cascade_detection.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace easy_deploy {
+
+bool NeedEscalation(const std::vector<BBox2D> &small_results, const CascadeDetectionConfig &config)
+{
+  int ambiguous_num  = 0;
+  int detections_num = 0;
+  for (const auto &box : small_results)
+  {
+    ambiguous_num += box.conf >= config.ambiguous_conf_low && box.conf < config.ambiguous_conf_high;
+    detections_num += box.conf >= config.ambiguous_conf_high;
+  }
+  return ambiguous_num > config.max_ambiguous_num || detections_num > config.max_detections_num;
+}
+
+class CascadeDetection : public BaseCascadeDetectionModel {
+public:
+  CascadeDetection(const std::shared_ptr<BaseDetectionModel> &small_model,
+                   const std::shared_ptr<BaseDetectionModel> &large_model,
+                   const CascadeDetectionConfig              &config);
+
+  bool Detect(const cv::Mat       &image,
+              std::vector<BBox2D> &results,
+              float                conf_thresh,
+              bool                 isRGB) override;
+
+  CascadeDetectionStats GetStats() const override;
+
+  void ResetStats() override;
+
+private:
+  const std::shared_ptr<BaseDetectionModel> small_model_;
+  const std::shared_ptr<BaseDetectionModel> large_model_;
+  const CascadeDetectionConfig              config_;
+
+  std::atomic<size_t> images_{0};
+  std::atomic<size_t> escalated_{0};
+};
+
+CascadeDetection::CascadeDetection(const std::shared_ptr<BaseDetectionModel> &small_model,
+                                   const std::shared_ptr<BaseDetectionModel> &large_model,
+                                   const CascadeDetectionConfig              &config)
+    : small_model_(small_model), large_model_(large_model), config_(config)
+{
+  if (small_model_ == nullptr || large_model_ == nullptr)
+  {
+    throw std::invalid_argument("[CascadeDetection] Got INVALID detection model ptr!!!");
+  }
+  if (config_.ambiguous_conf_low > config_.ambiguous_conf_high)
+  {
+    throw std::invalid_argument("[CascadeDetection] Got INVALID ambiguous confidence range!!!");
+  }
+}
+
+bool CascadeDetection::Detect(const cv::Mat       &image,
+                              std::vector<BBox2D> &results,
+                              float                conf_thresh,
+                              bool                 isRGB)
+{
+  CHECK_STATE(!image.empty(), "[CascadeDetection] Detect got empty image!!!");
+
+  // 1. The small model, low enough to see the ambiguous detections
+  CHECK_STATE(small_model_->Detect(image, results,
+                                   std::min(conf_thresh, config_.ambiguous_conf_low), isRGB),
+              "[CascadeDetection] Small model detection failed!!!");
+  images_.fetch_add(1, std::memory_order_relaxed);
+
+  if (!NeedEscalation(results, config_))
+  {
+    auto below_thresh = [conf_thresh](const BBox2D &box) { return box.conf < conf_thresh; };
+    results.erase(std::remove_if(results.begin(), results.end(), below_thresh), results.end());
+    return true;
+  }
+
+  // 2. Or the large model on the ambiguous images
+  escalated_.fetch_add(1, std::memory_order_relaxed);
+  CHECK_STATE(large_model_->Detect(image, results, conf_thresh, isRGB),
+              "[CascadeDetection] Large model detection failed!!!");
+  return true;
+}
+
+CascadeDetectionStats CascadeDetection::GetStats() const
+{
+  CascadeDetectionStats stats;
+  stats.images    = images_.load(std::memory_order_relaxed);
+  stats.escalated = escalated_.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void CascadeDetection::ResetStats()
+{
+  images_.store(0, std::memory_order_relaxed);
+  escalated_.store(0, std::memory_order_relaxed);
+}
+
+std::shared_ptr<BaseCascadeDetectionModel> CreateCascadeDetectionModel(
+    const std::shared_ptr<BaseDetectionModel> &small_model,
+    const std::shared_ptr<BaseDetectionModel> &large_model,
+    const CascadeDetectionConfig              &config)
+{
+  return std::make_shared<CascadeDetection>(small_model, large_model, config);
+}
+
+struct CascadeDetectionParams {
+  std::shared_ptr<BaseDetection2DFactory> small_model_factory;
+  std::shared_ptr<BaseDetection2DFactory> large_model_factory;
+  CascadeDetectionConfig                  config;
+};
+
+class CascadeDetectionFactory : public BaseCascadeDetectionFactory {
+public:
+  CascadeDetectionFactory(const CascadeDetectionParams &params) : params_(params)
+  {}
+
+  std::shared_ptr<BaseCascadeDetectionModel> Create() override
+  {
+    return CreateCascadeDetectionModel(params_.small_model_factory->Create(),
+                                       params_.large_model_factory->Create(), params_.config);
+  }
+
+private:
+  CascadeDetectionParams params_;
+};
+
+std::shared_ptr<BaseCascadeDetectionFactory> CreateCascadeDetectionModelFactory(
+    std::shared_ptr<BaseDetection2DFactory> small_model_factory,
+    std::shared_ptr<BaseDetection2DFactory> large_model_factory,
+    const CascadeDetectionConfig           &config)
+{
+  if (small_model_factory == nullptr || large_model_factory == nullptr)
+  {
+    throw std::invalid_argument(
+        "[CreateCascadeDetectionModelFactory] Got invalid input arguments!");
+  }
+
+  CascadeDetectionParams params;
+  params.small_model_factory = small_model_factory;
+  params.large_model_factory = large_model_factory;
+  params.config              = config;
+
+  return std::make_shared<CascadeDetectionFactory>(params);
+}
+
+} // namespace easy_deploy
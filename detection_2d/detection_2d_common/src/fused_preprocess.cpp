@@ -0,0 +1,470 @@
+#include "detection_2d_common/fused_preprocess.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define DET_PREPROCESS_NEON
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+// AVX2 is not in the baseline x86 flags, the kernels are compiled for it with target attributes
+// and picked at runtime
+#define DET_PREPROCESS_X86_DISPATCH
+#endif
+
+namespace easy_deploy {
+
+namespace {
+
+// Bilinear source index and weight of one output coordinate, with the same half-pixel centers
+// and border clamping as `cv::resize`.
+struct SampleTap {
+  int   index0;
+  int   index1;
+  float weight1;
+};
+
+std::vector<SampleTap> BuildSampleTaps(int len, float ratio, int source_len)
+{
+  std::vector<SampleTap> taps(len);
+  for (int i = 0; i < len; ++i)
+  {
+    const float coord = (i + 0.5f) * ratio - 0.5f;
+    int         index = static_cast<int>(std::floor(coord));
+    float       w     = coord - index;
+    if (index < 0)
+    {
+      index = 0;
+      w     = 0.f;
+    }
+    if (index >= source_len - 1)
+    {
+      index = source_len - 1;
+      w     = 0.f;
+    }
+    taps[i] = {index, std::min(index + 1, source_len - 1), w};
+  }
+  return taps;
+}
+
+// `out[i] = (row0[i] + (row1[i] - row0[i]) * w1) * alpha[i % 3] + beta[i % 3]` for `i` in
+// [begin, len)
+void BlendRowsNormalizedScalar(const uint8_t *row0,
+                               const uint8_t *row1,
+                               float          w1,
+                               const float   *alpha,
+                               const float   *beta,
+                               int            begin,
+                               int            len,
+                               float         *out)
+{
+  for (int i = begin; i < len; ++i)
+  {
+    const float v = row0[i] + (row1[i] - row0[i]) * w1;
+    out[i]        = v * alpha[i % 3] + beta[i % 3];
+  }
+}
+
+// `planes[plane_of_channel[c]][x]` blends the channel `c` of the two pixels at `index0[x]` and
+// `index1[x]` of `row`, for `x` in [begin, len)
+void BlendColumnsToPlanesScalar(const float  *row,
+                                const int    *index0,
+                                const int    *index1,
+                                const float  *weight1,
+                                int           begin,
+                                int           len,
+                                const int     plane_of_channel[3],
+                                float *const *planes)
+{
+  for (int x = begin; x < len; ++x)
+  {
+    const float *p0 = row + index0[x];
+    const float *p1 = row + index1[x];
+    const float  w1 = weight1[x];
+    for (int c = 0; c < 3; ++c)
+    {
+      planes[plane_of_channel[c]][x] = p0[c] + (p1[c] - p0[c]) * w1;
+    }
+  }
+}
+
+#if defined(DET_PREPROCESS_X86_DISPATCH)
+
+__attribute__((target("avx2"))) void BlendRowsNormalizedAvx2(const uint8_t *row0,
+                                                              const uint8_t *row1,
+                                                              float          w1,
+                                                              const float   *alpha,
+                                                              const float   *beta,
+                                                              int            len,
+                                                              float         *out)
+{
+  const __m256 vw1 = _mm256_set1_ps(w1);
+  int          i   = 0;
+  for (; i + 24 <= len; i += 24)
+  {
+    for (int k = 0; k < 24; k += 8)
+    {
+      const __m256 a = _mm256_cvtepi32_ps(
+          _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(row0 + i + k))));
+      const __m256 b = _mm256_cvtepi32_ps(
+          _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(row1 + i + k))));
+      const __m256 v = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), vw1));
+      _mm256_storeu_ps(out + i + k, _mm256_add_ps(_mm256_mul_ps(v, _mm256_loadu_ps(alpha + k)),
+                                                  _mm256_loadu_ps(beta + k)));
+    }
+  }
+  BlendRowsNormalizedScalar(row0, row1, w1, alpha, beta, i, len, out);
+}
+
+__attribute__((target("avx2"))) void BlendColumnsToPlanesAvx2(const float  *row,
+                                                               const int    *index0,
+                                                               const int    *index1,
+                                                               const float  *weight1,
+                                                               int           len,
+                                                               const int     plane_of_channel[3],
+                                                               float *const *planes)
+{
+  int x = 0;
+  for (; x + 8 <= len; x += 8)
+  {
+    const __m256i i0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(index0 + x));
+    const __m256i i1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(index1 + x));
+    const __m256  w1 = _mm256_loadu_ps(weight1 + x);
+    for (int c = 0; c < 3; ++c)
+    {
+      const __m256 v0 = _mm256_i32gather_ps(row + c, i0, 4);
+      const __m256 v1 = _mm256_i32gather_ps(row + c, i1, 4);
+      _mm256_storeu_ps(planes[plane_of_channel[c]] + x,
+                       _mm256_add_ps(v0, _mm256_mul_ps(_mm256_sub_ps(v1, v0), w1)));
+    }
+  }
+  BlendColumnsToPlanesScalar(row, index0, index1, weight1, x, len, plane_of_channel, planes);
+}
+
+bool CpuHasAvx2()
+{
+  static const bool has_avx2 = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+  }();
+  return has_avx2;
+}
+
+#endif
+
+// `out[i] = (row0[i] + (row1[i] - row0[i]) * w1) * alpha[i % 3] + beta[i % 3]` over `len`
+// interleaved pixels. `alpha` and `beta` hold the per channel factors repeated over 24 lanes, a
+// whole number of pixels and of SIMD vectors.
+void BlendRowsNormalized(const uint8_t *row0,
+                         const uint8_t *row1,
+                         float          w1,
+                         const float   *alpha,
+                         const float   *beta,
+                         int            len,
+                         float         *out)
+{
+#if defined(DET_PREPROCESS_X86_DISPATCH)
+  if (CpuHasAvx2())
+  {
+    BlendRowsNormalizedAvx2(row0, row1, w1, alpha, beta, len, out);
+    return;
+  }
+#endif
+  int i = 0;
+#if defined(DET_PREPROCESS_NEON)
+  const float32x4_t vw1 = vdupq_n_f32(w1);
+  for (; i + 24 <= len; i += 24)
+  {
+    for (int k = 0; k < 24; k += 8)
+    {
+      const uint16x8_t a16 = vmovl_u8(vld1_u8(row0 + i + k));
+      const uint16x8_t b16 = vmovl_u8(vld1_u8(row1 + i + k));
+      for (int h = 0; h < 2; ++h)
+      {
+        const float32x4_t a = vcvtq_f32_u32(vmovl_u16(h == 0 ? vget_low_u16(a16)
+                                                             : vget_high_u16(a16)));
+        const float32x4_t b = vcvtq_f32_u32(vmovl_u16(h == 0 ? vget_low_u16(b16)
+                                                             : vget_high_u16(b16)));
+        const float32x4_t v = vmlaq_f32(a, vsubq_f32(b, a), vw1);
+        vst1q_f32(out + i + k + h * 4,
+                  vmlaq_f32(vld1q_f32(beta + k + h * 4), v, vld1q_f32(alpha + k + h * 4)));
+      }
+    }
+  }
+#endif
+  BlendRowsNormalizedScalar(row0, row1, w1, alpha, beta, i, len, out);
+}
+
+// horizontal blend of the normalized row into the three planes of the output row
+void BlendColumnsToPlanes(const float  *row,
+                          const int    *index0,
+                          const int    *index1,
+                          const float  *weight1,
+                          int           len,
+                          const int     plane_of_channel[3],
+                          float *const *planes)
+{
+#if defined(DET_PREPROCESS_X86_DISPATCH)
+  if (CpuHasAvx2())
+  {
+    BlendColumnsToPlanesAvx2(row, index0, index1, weight1, len, plane_of_channel, planes);
+    return;
+  }
+#endif
+  BlendColumnsToPlanesScalar(row, index0, index1, weight1, 0, len, plane_of_channel, planes);
+}
+
+struct LetterboxGeometry {
+  float scale;
+  int   resized_height;
+  int   resized_width;
+};
+
+LetterboxGeometry ComputeLetterbox(const cv::Mat &image, int dst_height, int dst_width)
+{
+  LetterboxGeometry geometry;
+  geometry.scale          = std::min(static_cast<float>(dst_height) / image.rows,
+                                     static_cast<float>(dst_width) / image.cols);
+  geometry.resized_height = std::min(
+      dst_height, std::max(1, static_cast<int>(std::round(image.rows * geometry.scale))));
+  geometry.resized_width = std::min(
+      dst_width, std::max(1, static_cast<int>(std::round(image.cols * geometry.scale))));
+  return geometry;
+}
+
+void CheckLetterboxInput(const cv::Mat &image, const void *dst, int dst_height, int dst_width)
+{
+  if (image.empty() || image.type() != CV_8UC3 || dst == nullptr || dst_height <= 0 ||
+      dst_width <= 0)
+  {
+    throw std::invalid_argument("[FusedLetterboxNormalize] Got INVALID input arguments!!!");
+  }
+}
+
+// resized, padded, interleaved uint8 output of the `normalize == false` mode
+void LetterboxInterleaved(const cv::Mat                  &image,
+                          void                           *dst,
+                          int                             dst_height,
+                          int                             dst_width,
+                          const LetterboxGeometry        &geometry,
+                          bool                            swap_rb)
+{
+  cv::Mat output(dst_height, dst_width, CV_8UC3, dst);
+  output.setTo(cv::Scalar(0, 0, 0));
+  cv::Mat resized = output(cv::Rect(0, 0, geometry.resized_width, geometry.resized_height));
+  cv::resize(image, resized, resized.size(), 0, 0, cv::INTER_LINEAR);
+  if (swap_rb)
+  {
+    cv::cvtColor(resized, resized, cv::COLOR_BGR2RGB);
+  }
+}
+
+} // namespace
+
+float FusedLetterboxNormalize(const cv::Mat                  &image,
+                              void                           *dst,
+                              int                             dst_height,
+                              int                             dst_width,
+                              const FusedDetPreProcessParams &params,
+                              bool                            isRGB)
+{
+  CheckLetterboxInput(image, dst, dst_height, dst_width);
+  const LetterboxGeometry geometry = ComputeLetterbox(image, dst_height, dst_width);
+  // swap only when the channel order of the image differs from the model's
+  const bool swap_rb = params.swap_rb != isRGB;
+  if (!params.normalize)
+  {
+    LetterboxInterleaved(image, dst, dst_height, dst_width, geometry, swap_rb);
+    return geometry.scale;
+  }
+
+  // channel `c` of the image goes to plane `plane_of_channel[c]`, normalized by its factors
+  const int plane_of_channel[3] = {swap_rb ? 2 : 0, 1, swap_rb ? 0 : 2};
+  float     alpha[24], beta[24];
+  for (int i = 0; i < 24; ++i)
+  {
+    const int plane = plane_of_channel[i % 3];
+    alpha[i]        = 1.f / params.stddev[plane];
+    beta[i]         = -params.mean[plane] / params.stddev[plane];
+  }
+
+  const auto row_taps = BuildSampleTaps(
+      geometry.resized_height, static_cast<float>(image.rows) / geometry.resized_height,
+      image.rows);
+  const auto col_taps = BuildSampleTaps(
+      geometry.resized_width, static_cast<float>(image.cols) / geometry.resized_width,
+      image.cols);
+  // column taps as offsets into the interleaved row, for the gather
+  std::vector<int>   col_index0(col_taps.size()), col_index1(col_taps.size());
+  std::vector<float> col_weight1(col_taps.size());
+  for (size_t x = 0; x < col_taps.size(); ++x)
+  {
+    col_index0[x]  = col_taps[x].index0 * 3;
+    col_index1[x]  = col_taps[x].index1 * 3;
+    col_weight1[x] = col_taps[x].weight1;
+  }
+
+  float *const planes[3] = {static_cast<float *>(dst),
+                            static_cast<float *>(dst) + dst_height * dst_width,
+                            static_cast<float *>(dst) + 2 * dst_height * dst_width};
+  const int    row_len   = image.cols * 3;
+  cv::parallel_for_(
+      cv::Range(0, dst_height),
+      [&](const cv::Range &range) {
+        // vertical blend of two image rows, normalized, reused by every pixel of the output row
+        std::vector<float> blended_row(row_len);
+        for (int y = range.start; y < range.end; ++y)
+        {
+          float *const out_rows[3] = {planes[0] + y * dst_width, planes[1] + y * dst_width,
+                                      planes[2] + y * dst_width};
+          int          x_begin     = 0;
+          if (y < geometry.resized_height)
+          {
+            const SampleTap &row_tap = row_taps[y];
+            BlendRowsNormalized(image.ptr<uint8_t>(row_tap.index0),
+                                image.ptr<uint8_t>(row_tap.index1), row_tap.weight1, alpha, beta,
+                                row_len, blended_row.data());
+            BlendColumnsToPlanes(blended_row.data(), col_index0.data(), col_index1.data(),
+                                 col_weight1.data(), geometry.resized_width, plane_of_channel,
+                                 out_rows);
+            x_begin = geometry.resized_width;
+          }
+          // padding, a zero pixel once normalized
+          for (int c = 0; c < 3; ++c)
+          {
+            std::fill(out_rows[plane_of_channel[c]] + x_begin,
+                      out_rows[plane_of_channel[c]] + dst_width, beta[c]);
+          }
+        }
+      },
+      // a few stripes per thread, each stripe amortizes its row buffer
+      std::max(1, dst_height / 32));
+
+  return geometry.scale;
+}
+
+float FusedLetterboxNormalizeReference(const cv::Mat                  &image,
+                                       void                           *dst,
+                                       int                             dst_height,
+                                       int                             dst_width,
+                                       const FusedDetPreProcessParams &params,
+                                       bool                            isRGB)
+{
+  CheckLetterboxInput(image, dst, dst_height, dst_width);
+  const LetterboxGeometry geometry = ComputeLetterbox(image, dst_height, dst_width);
+  // swap only when the channel order of the image differs from the model's
+  const bool swap_rb = params.swap_rb != isRGB;
+  if (!params.normalize)
+  {
+    LetterboxInterleaved(image, dst, dst_height, dst_width, geometry, swap_rb);
+    return geometry.scale;
+  }
+
+  cv::Mat resized, padded;
+  cv::resize(image, resized, {geometry.resized_width, geometry.resized_height}, 0, 0,
+             cv::INTER_LINEAR);
+  cv::copyMakeBorder(resized, padded, 0, dst_height - geometry.resized_height, 0,
+                     dst_width - geometry.resized_width, cv::BORDER_CONSTANT, cv::Scalar(0, 0, 0));
+  if (swap_rb)
+  {
+    cv::cvtColor(padded, padded, cv::COLOR_BGR2RGB);
+  }
+  std::vector<cv::Mat> channels;
+  cv::split(padded, channels);
+  for (int c = 0; c < 3; ++c)
+  {
+    cv::Mat plane(dst_height, dst_width, CV_32FC1,
+                  static_cast<float *>(dst) + c * dst_height * dst_width);
+    channels[c].convertTo(plane, CV_32F, 1. / params.stddev[c],
+                          -params.mean[c] / params.stddev[c]);
+  }
+  return geometry.scale;
+}
+
+class FusedCpuDetPreProcess : public IDetectionPreProcess, public IStridedDetectionPreProcess {
+public:
+  explicit FusedCpuDetPreProcess(const FusedDetPreProcessParams &params) : params_(params)
+  {}
+
+  float Preprocess(std::shared_ptr<IPipelineImageData> input_image_data,
+                   ITensor                            *blob_buffer,
+                   int                                 dst_height,
+                   int                                 dst_width) override
+  {
+    const auto &image_info = input_image_data->GetImageDataInfo();
+    if (image_info.location != DataLocation::HOST || image_info.image_channels != 3)
+    {
+      throw std::invalid_argument(
+          "[FusedCpuDetPreProcess] Only takes 3-channel images on host side!!!");
+    }
+    const cv::Mat image(image_info.image_height, image_info.image_width, CV_8UC3,
+                        image_info.data_pointer);
+    // written on host side, the infer core uploads it if needed
+    blob_buffer->SetBufferLocation(DataLocation::HOST);
+    return FusedLetterboxNormalize(image, blob_buffer->RawPtr(), dst_height, dst_width, params_,
+                                   image_info.format == ImageDataFormat::RGB);
+  }
+
+  float PreprocessMat(const cv::Mat &image,
+                      void          *dst,
+                      int            dst_height,
+                      int            dst_width,
+                      bool           isRGB) override
+  {
+    return FusedLetterboxNormalize(image, dst, dst_height, dst_width, params_, isRGB);
+  }
+
+private:
+  const FusedDetPreProcessParams params_;
+};
+
+static FusedDetPreProcessParams MakeFusedDetPreProcessParams(const std::array<float, 3> &mean,
+                                                             const std::array<float, 3> &stddev,
+                                                             bool                        swap_rb,
+                                                             bool                        normalize)
+{
+  FusedDetPreProcessParams params;
+  params.mean      = mean;
+  params.stddev    = stddev;
+  params.swap_rb   = swap_rb;
+  params.normalize = normalize;
+  return params;
+}
+
+std::shared_ptr<IDetectionPreProcess> CreateFusedCpuDetPreProcess(
+    const std::array<float, 3> &mean,
+    const std::array<float, 3> &stddev,
+    bool                        swap_rb,
+    bool                        normalize)
+{
+  return std::make_shared<FusedCpuDetPreProcess>(
+      MakeFusedDetPreProcessParams(mean, stddev, swap_rb, normalize));
+}
+
+class FusedCpuDetPreProcessFactory : public BaseDetectionPreprocessFactory {
+public:
+  explicit FusedCpuDetPreProcessFactory(const FusedDetPreProcessParams &params) : params_(params)
+  {}
+
+  std::shared_ptr<IDetectionPreProcess> Create() override
+  {
+    return std::make_shared<FusedCpuDetPreProcess>(params_);
+  }
+
+private:
+  const FusedDetPreProcessParams params_;
+};
+
+std::shared_ptr<BaseDetectionPreprocessFactory> CreateFusedCpuDetPreProcessFactory(
+    const std::array<float, 3> &mean,
+    const std::array<float, 3> &stddev,
+    bool                        swap_rb,
+    bool                        normalize)
+{
+  return std::make_shared<FusedCpuDetPreProcessFactory>(
+      MakeFusedDetPreProcessParams(mean, stddev, swap_rb, normalize));
+}
+
+} // namespace easy_deploy
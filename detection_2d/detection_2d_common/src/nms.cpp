@@ -0,0 +1,329 @@
+#include "detection_2d_common/nms.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace easy_deploy {
+
+namespace {
+
+// cells of the grid of a class along each axis at most
+constexpr int kMaxGridSize = 32;
+
+// cells along an axis of `extent`, about `side` wide
+inline int GridSize(float extent, float side)
+{
+  return std::max(1, static_cast<int>(std::min(extent / side, static_cast<float>(kMaxGridSize))));
+}
+
+// descending confidence, then ascending index : a strict order, so that the top-k and the ties
+// do not depend on the sort
+inline bool MoreConfident(const DetectionCandidate *candidates, int a, int b)
+{
+  return candidates[a].conf > candidates[b].conf ||
+         (candidates[a].conf == candidates[b].conf && a < b);
+}
+
+template <typename CornersT>
+inline CornersT MakeCorners(const DetectionCandidate &candidate)
+{
+  CornersT corners;
+  corners.x0   = candidate.cx - candidate.w / 2;
+  corners.y0   = candidate.cy - candidate.h / 2;
+  corners.x1   = candidate.cx + candidate.w / 2;
+  corners.y1   = candidate.cy + candidate.h / 2;
+  corners.area = candidate.w * candidate.h;
+  return corners;
+}
+
+// `IoU(a, b) > iou_thresh`, without the division
+template <typename CornersT>
+inline bool IoUAbove(const CornersT &a, const CornersT &b, float iou_thresh)
+{
+  const float inter_w = std::min(a.x1, b.x1) - std::max(a.x0, b.x0);
+  const float inter_h = std::min(a.y1, b.y1) - std::max(a.y0, b.y0);
+  if (inter_w <= 0.f || inter_h <= 0.f)
+  {
+    return false;
+  }
+  const float inter = inter_w * inter_h;
+  return inter > iou_thresh * (a.area + b.area - inter);
+}
+
+// the candidates above their class threshold, capped to the `pre_nms_top_k` most confident
+template <typename ThresholdFunc>
+void FilterTopK(const DetectionCandidate *candidates,
+                size_t                    num,
+                int                       pre_nms_top_k,
+                ThresholdFunc             class_threshold,
+                std::vector<int>         &order)
+{
+  order.clear();
+  for (size_t i = 0; i < num; ++i)
+  {
+    if (candidates[i].conf >= class_threshold(candidates[i].cls))
+    {
+      order.push_back(static_cast<int>(i));
+    }
+  }
+  if (pre_nms_top_k > 0 && order.size() > static_cast<size_t>(pre_nms_top_k))
+  {
+    std::nth_element(order.begin(), order.begin() + pre_nms_top_k, order.end(),
+                     [candidates](int a, int b) { return MoreConfident(candidates, a, b); });
+    order.resize(pre_nms_top_k);
+  }
+}
+
+} // namespace
+
+NmsEngine::NmsEngine(const NmsConfig &config) : config_(config)
+{
+  if (config_.iou_thresh < 0.f || config_.iou_thresh > 1.f)
+  {
+    throw std::invalid_argument("[NmsEngine] `iou_thresh` should be in [0, 1]!!!");
+  }
+  cell_head_.assign(kMaxGridSize * kMaxGridSize, -1);
+}
+
+float NmsEngine::ClassThreshold(int cls, float conf_thresh) const
+{
+  if (cls >= 0 && static_cast<size_t>(cls) < config_.class_conf_thresh.size())
+  {
+    return std::max(conf_thresh, config_.class_conf_thresh[cls]);
+  }
+  return conf_thresh;
+}
+
+float NmsEngine::MinThreshold(int cls_number, float conf_thresh) const
+{
+  // a class out of the list falls back to `conf_thresh`, the lowest possible
+  if (cls_number <= 0 || config_.class_conf_thresh.size() < static_cast<size_t>(cls_number))
+  {
+    return conf_thresh;
+  }
+  float min_thresh = std::numeric_limits<float>::infinity();
+  for (int c = 0; c < cls_number; ++c)
+  {
+    min_thresh = std::min(min_thresh, ClassThreshold(c, conf_thresh));
+  }
+  return min_thresh;
+}
+
+const std::vector<int> &NmsEngine::Run(const DetectionCandidate *candidates,
+                                       size_t                    num,
+                                       float                     conf_thresh)
+{
+  FilterTopK(
+      candidates, num, config_.pre_nms_top_k,
+      [this, conf_thresh](int cls) { return ClassThreshold(cls, conf_thresh); }, order_);
+
+  // the only sort of the candidates : grouped by class, each class by descending confidence
+  const bool class_agnostic = config_.class_agnostic;
+  std::sort(order_.begin(), order_.end(), [candidates, class_agnostic](int a, int b) {
+    const int cls_a = class_agnostic ? 0 : candidates[a].cls;
+    const int cls_b = class_agnostic ? 0 : candidates[b].cls;
+    return cls_a != cls_b ? cls_a < cls_b : MoreConfident(candidates, a, b);
+  });
+
+  const int num_ordered = static_cast<int>(order_.size());
+  corners_.resize(num_ordered);
+  for (int k = 0; k < num_ordered; ++k)
+  {
+    corners_[k] = MakeCorners<Corners>(candidates[order_[k]]);
+  }
+  checked_by_.assign(num_ordered, -1);
+
+  kept_.clear();
+  for (int begin = 0; begin < num_ordered;)
+  {
+    int end = begin + 1;
+    while (end < num_ordered &&
+           (class_agnostic || candidates[order_[end]].cls == candidates[order_[begin]].cls))
+    {
+      ++end;
+    }
+    SuppressClass(begin, end);
+    begin = end;
+  }
+
+  // back to candidate indices, by descending confidence over all classes
+  kept_order_.clear();
+  for (const int k : kept_)
+  {
+    kept_order_.push_back(order_[k]);
+  }
+  auto more_confident = [candidates](int a, int b) { return MoreConfident(candidates, a, b); };
+  const size_t max_detections = static_cast<size_t>(config_.max_detections);
+  if (config_.max_detections > 0 && kept_order_.size() > max_detections)
+  {
+    std::partial_sort(kept_order_.begin(), kept_order_.begin() + max_detections,
+                      kept_order_.end(), more_confident);
+    kept_order_.resize(max_detections);
+  } else
+  {
+    std::sort(kept_order_.begin(), kept_order_.end(), more_confident);
+  }
+  return kept_order_;
+}
+
+void NmsEngine::SuppressClass(int begin, int end)
+{
+  // a grid over the extent of the class, with cells about the size of its boxes
+  float x0 = std::numeric_limits<float>::infinity(), y0 = x0;
+  float x1 = -x0, y1 = -x0, side_sum = 0.f;
+  for (int k = begin; k < end; ++k)
+  {
+    const Corners &box = corners_[k];
+    x0                 = std::min(x0, box.x0);
+    y0                 = std::min(y0, box.y0);
+    x1                 = std::max(x1, box.x1);
+    y1                 = std::max(y1, box.y1);
+    side_sum += std::max(box.x1 - box.x0, box.y1 - box.y0);
+  }
+  const float extent_w    = std::max(x1 - x0, 1e-3f);
+  const float extent_h    = std::max(y1 - y0, 1e-3f);
+  const float mean_side   = std::max(side_sum / (end - begin), 1e-3f);
+  const int   grid_w      = GridSize(extent_w, mean_side);
+  const int   grid_h      = GridSize(extent_h, mean_side);
+  const float cells_per_x = grid_w / extent_w;
+  const float cells_per_y = grid_h / extent_h;
+
+  auto cell_x = [&](float x) {
+    return std::clamp(static_cast<int>((x - x0) * cells_per_x), 0, grid_w - 1);
+  };
+  auto cell_y = [&](float y) {
+    return std::clamp(static_cast<int>((y - y0) * cells_per_y), 0, grid_h - 1);
+  };
+
+  for (int k = begin; k < end; ++k)
+  {
+    const Corners &box = corners_[k];
+    const int      gx0 = cell_x(box.x0), gx1 = cell_x(box.x1);
+    const int      gy0 = cell_y(box.y0), gy1 = cell_y(box.y1);
+
+    // compared only with the kept boxes sharing a cell, an overlapping box always does
+    auto suppressed = [&]() {
+      for (int gy = gy0; gy <= gy1; ++gy)
+      {
+        for (int gx = gx0; gx <= gx1; ++gx)
+        {
+          for (int e = cell_head_[gy * grid_w + gx]; e != -1; e = entry_next_[e])
+          {
+            const int kept = entry_box_[e];
+            if (checked_by_[kept] == k)
+            {
+              continue;
+            }
+            checked_by_[kept] = k;
+            if (IoUAbove(corners_[kept], box, config_.iou_thresh))
+            {
+              return true;
+            }
+          }
+        }
+      }
+      return false;
+    };
+    if (suppressed())
+    {
+      continue;
+    }
+
+    kept_.push_back(k);
+    for (int gy = gy0; gy <= gy1; ++gy)
+    {
+      for (int gx = gx0; gx <= gx1; ++gx)
+      {
+        const int cell = gy * grid_w + gx;
+        if (cell_head_[cell] == -1)
+        {
+          touched_cells_.push_back(cell);
+        }
+        entry_box_.push_back(k);
+        entry_next_.push_back(cell_head_[cell]);
+        cell_head_[cell] = static_cast<int>(entry_box_.size()) - 1;
+      }
+    }
+  }
+
+  for (const int cell : touched_cells_)
+  {
+    cell_head_[cell] = -1;
+  }
+  touched_cells_.clear();
+  entry_box_.clear();
+  entry_next_.clear();
+}
+
+void NmsEngine::Run(std::vector<BBox2D> &boxes, float conf_thresh)
+{
+  box_candidates_.resize(boxes.size());
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    box_candidates_[i] = {boxes[i].x,    boxes[i].y,    boxes[i].w,
+                          boxes[i].h,    boxes[i].conf, static_cast<int>(boxes[i].cls)};
+  }
+  const auto &kept = Run(box_candidates_.data(), box_candidates_.size(), conf_thresh);
+
+  box_results_.clear();
+  for (const int index : kept)
+  {
+    box_results_.push_back(boxes[index]);
+  }
+  boxes.swap(box_results_);
+}
+
+std::vector<int> NmsNaive(const DetectionCandidate *candidates,
+                          size_t                    num,
+                          float                     conf_thresh,
+                          const NmsConfig          &config)
+{
+  struct Corners {
+    float x0;
+    float y0;
+    float x1;
+    float y1;
+    float area;
+  };
+
+  std::vector<int> order;
+  FilterTopK(
+      candidates, num, config.pre_nms_top_k,
+      [&config, conf_thresh](int cls) {
+        return cls >= 0 && static_cast<size_t>(cls) < config.class_conf_thresh.size()
+                   ? std::max(conf_thresh, config.class_conf_thresh[cls])
+                   : conf_thresh;
+      },
+      order);
+  std::sort(order.begin(), order.end(),
+            [candidates](int a, int b) { return MoreConfident(candidates, a, b); });
+
+  std::vector<int> kept;
+  for (const int index : order)
+  {
+    const auto box        = MakeCorners<Corners>(candidates[index]);
+    bool       suppressed = false;
+    for (const int kept_index : kept)
+    {
+      if ((config.class_agnostic || candidates[kept_index].cls == candidates[index].cls) &&
+          IoUAbove(MakeCorners<Corners>(candidates[kept_index]), box, config.iou_thresh))
+      {
+        suppressed = true;
+        break;
+      }
+    }
+    if (!suppressed)
+    {
+      kept.push_back(index);
+    }
+  }
+  if (config.max_detections > 0 && kept.size() > static_cast<size_t>(config.max_detections))
+  {
+    kept.resize(config.max_detections);
+  }
+  return kept;
+}
+
+} // namespace easy_deploy
@@ -0,0 +1,217 @@
+#include "detection_2d_common/roi_detection.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+#include "detection_2d_common/batch_detection.hpp"
+#include "detection_2d_common/nms.hpp"
+
+namespace easy_deploy {
+
+// `length` pixels centered on the range `[begin, begin + size)`, moved inside `[0, extent)`
+static std::pair<int, int> GrowRange(int begin, int size, int length, int extent)
+{
+  length          = std::min(length, extent);
+  const int start = begin + size / 2 - length / 2;
+  return {std::max(0, std::min(start, extent - length)), length};
+}
+
+std::vector<RoiCrop> ComputeRoiCrops(int                          image_height,
+                                     int                          image_width,
+                                     const std::vector<cv::Rect> &rois,
+                                     const RoiDetectionConfig    &config)
+{
+  if (image_height <= 0 || image_width <= 0 || config.input_height <= 0 || config.input_width <= 0)
+  {
+    throw std::invalid_argument("[ComputeRoiCrops] Got INVALID input arguments!!!");
+  }
+  const cv::Rect frame(0, 0, image_width, image_height);
+  const float    input_aspect = static_cast<float>(config.input_width) / config.input_height;
+
+  std::vector<RoiCrop> crops;
+  for (const auto &roi : rois.empty() ? std::vector<cv::Rect>{frame} : rois)
+  {
+    const cv::Rect clipped = roi & frame;
+    if (clipped.empty())
+    {
+      continue;
+    }
+    // grown to the aspect ratio of the input, the context replaces the letterbox padding
+    float crop_width  = clipped.width;
+    float crop_height = clipped.height;
+    if (crop_width > crop_height * input_aspect)
+    {
+      crop_height = crop_width / input_aspect;
+    } else
+    {
+      crop_width = crop_height * input_aspect;
+    }
+    // and to the input size, detected at the native scale
+    if (!config.upscale_small_roi && crop_width < config.input_width)
+    {
+      crop_width  = config.input_width;
+      crop_height = config.input_height;
+    }
+
+    const auto x_range = GrowRange(clipped.x, clipped.width, std::lround(crop_width), image_width);
+    const auto y_range =
+        GrowRange(clipped.y, clipped.height, std::lround(crop_height), image_height);
+    RoiCrop crop;
+    crop.roi  = clipped;
+    crop.crop = cv::Rect(x_range.first, y_range.first, x_range.second, y_range.second);
+    crops.push_back(crop);
+  }
+  return crops;
+}
+
+void MapBoxesToFrame(const RoiCrop &crop, std::vector<BBox2D> &boxes, bool clip_to_roi)
+{
+  for (auto &box : boxes)
+  {
+    box.x += crop.crop.x;
+    box.y += crop.crop.y;
+  }
+  if (!clip_to_roi)
+  {
+    return;
+  }
+  auto out_of_roi = [&crop](const BBox2D &box) {
+    return box.x < crop.roi.x || box.x >= crop.roi.x + crop.roi.width || box.y < crop.roi.y ||
+           box.y >= crop.roi.y + crop.roi.height;
+  };
+  boxes.erase(std::remove_if(boxes.begin(), boxes.end(), out_of_roi), boxes.end());
+}
+
+class RoiDetection : public BaseRoiDetectionModel {
+public:
+  RoiDetection(const std::shared_ptr<BaseDetectionModel> &detection_model,
+               const RoiDetectionConfig                  &config);
+
+  bool Detect(const cv::Mat               &image,
+              const std::vector<cv::Rect> &rois,
+              std::vector<BBox2D>         &results,
+              float                        conf_thresh,
+              bool                         isRGB) override;
+
+private:
+  const std::shared_ptr<BaseDetectionModel> detection_model_;
+  const RoiDetectionConfig                  config_;
+
+  std::mutex                       mtx_;
+  NmsEngine                        nms_;
+  std::vector<RoiCrop>             crops_;
+  std::vector<cv::Mat>             crop_images_;
+  std::vector<std::vector<BBox2D>> crop_results_;
+};
+
+static NmsConfig MakeMergeNmsConfig(const RoiDetectionConfig &config)
+{
+  NmsConfig nms_config;
+  nms_config.iou_thresh     = config.merge_iou_thresh;
+  nms_config.pre_nms_top_k  = 0;
+  nms_config.max_detections = 0;
+  nms_config.class_agnostic = config.class_agnostic;
+  return nms_config;
+}
+
+RoiDetection::RoiDetection(const std::shared_ptr<BaseDetectionModel> &detection_model,
+                           const RoiDetectionConfig                  &config)
+    : detection_model_(detection_model), config_(config), nms_(MakeMergeNmsConfig(config))
+{
+  if (detection_model_ == nullptr)
+  {
+    throw std::invalid_argument("[RoiDetection] Got INVALID detection model ptr!!!");
+  }
+  if (config_.input_height <= 0 || config_.input_width <= 0)
+  {
+    throw std::invalid_argument("[RoiDetection] Got INVALID input size!!!");
+  }
+}
+
+bool RoiDetection::Detect(const cv::Mat               &image,
+                          const std::vector<cv::Rect> &rois,
+                          std::vector<BBox2D>         &results,
+                          float                        conf_thresh,
+                          bool                         isRGB)
+{
+  CHECK_STATE(!image.empty(), "[RoiDetection] Detect got empty image!!!");
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  // 1. Views into `image`, no pixel is copied here
+  results.clear();
+  crops_ = ComputeRoiCrops(image.rows, image.cols, rois, config_);
+  if (crops_.empty())
+  {
+    return true;
+  }
+  crop_images_.clear();
+  for (const auto &crop : crops_)
+  {
+    crop_images_.emplace_back(image, crop.crop);
+  }
+
+  // 2. In batches, or pipelined through the async api
+  CHECK_STATE(DetectViews(detection_model_, crop_images_, crop_results_, conf_thresh, isRGB),
+              "[RoiDetection] Roi detection failed!!!");
+
+  // 3. Back to the frame, the boxes of overlapping regions merged
+  for (size_t i = 0; i < crops_.size(); ++i)
+  {
+    MapBoxesToFrame(crops_[i], crop_results_[i], config_.clip_to_roi);
+    results.insert(results.end(), crop_results_[i].begin(), crop_results_[i].end());
+  }
+  if (crops_.size() > 1)
+  {
+    nms_.Run(results, 0.f);
+  } else
+  {
+    std::stable_sort(results.begin(), results.end(),
+                     [](const BBox2D &a, const BBox2D &b) { return a.conf > b.conf; });
+  }
+  return true;
+}
+
+std::shared_ptr<BaseRoiDetectionModel> CreateRoiDetectionModel(
+    const std::shared_ptr<BaseDetectionModel> &detection_model,
+    const RoiDetectionConfig                  &config)
+{
+  return std::make_shared<RoiDetection>(detection_model, config);
+}
+
+struct RoiDetectionParams {
+  std::shared_ptr<BaseDetection2DFactory> detection_factory;
+  RoiDetectionConfig                      config;
+};
+
+class RoiDetectionFactory : public BaseRoiDetectionFactory {
+public:
+  RoiDetectionFactory(const RoiDetectionParams &params) : params_(params)
+  {}
+
+  std::shared_ptr<BaseRoiDetectionModel> Create() override
+  {
+    return CreateRoiDetectionModel(params_.detection_factory->Create(), params_.config);
+  }
+
+private:
+  RoiDetectionParams params_;
+};
+
+std::shared_ptr<BaseRoiDetectionFactory> CreateRoiDetectionModelFactory(
+    std::shared_ptr<BaseDetection2DFactory> detection_factory,
+    const RoiDetectionConfig               &config)
+{
+  if (detection_factory == nullptr)
+  {
+    throw std::invalid_argument("[CreateRoiDetectionModelFactory] Got invalid input arguments!");
+  }
+
+  RoiDetectionParams params;
+  params.detection_factory = detection_factory;
+  params.config            = config;
+
+  return std::make_shared<RoiDetectionFactory>(params);
+}
+
+} // namespace easy_deploy
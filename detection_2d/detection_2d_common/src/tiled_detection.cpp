@@ -0,0 +1,290 @@
+#include "detection_2d_common/tiled_detection.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <numeric>
+
+#include "detection_2d_common/batch_detection.hpp"
+#include "detection_2d_common/nms.hpp"
+
+namespace easy_deploy {
+
+// origins of the tiles along an axis, the last one moved back so that it ends at the border
+static std::vector<int> TileOrigins(int extent, int tile, int stride)
+{
+  std::vector<int> origins;
+  if (extent <= tile)
+  {
+    origins.push_back(0);
+    return origins;
+  }
+  for (int origin = 0;; origin += stride)
+  {
+    if (origin + tile >= extent)
+    {
+      origins.push_back(extent - tile);
+      break;
+    }
+    origins.push_back(origin);
+  }
+  return origins;
+}
+
+std::vector<cv::Rect> ComputeTiles(int                         image_height,
+                                   int                         image_width,
+                                   const TiledDetectionConfig &config)
+{
+  if (image_height <= 0 || image_width <= 0 || config.tile_height <= 0 ||
+      config.tile_width <= 0 || config.overlap_ratio < 0.f || config.overlap_ratio >= 1.f)
+  {
+    throw std::invalid_argument("[ComputeTiles] Got INVALID input arguments!!!");
+  }
+  const int tile_height = std::min(config.tile_height, image_height);
+  const int tile_width  = std::min(config.tile_width, image_width);
+  const int stride_y =
+      std::max(1, static_cast<int>(std::lround(tile_height * (1.f - config.overlap_ratio))));
+  const int stride_x =
+      std::max(1, static_cast<int>(std::lround(tile_width * (1.f - config.overlap_ratio))));
+
+  std::vector<cv::Rect> tiles;
+  for (const int y : TileOrigins(image_height, tile_height, stride_y))
+  {
+    for (const int x : TileOrigins(image_width, tile_width, stride_x))
+    {
+      tiles.emplace_back(x, y, tile_width, tile_height);
+    }
+  }
+  return tiles;
+}
+
+static float BoxIoU(const BBox2D &a, const BBox2D &b)
+{
+  const float inter_w =
+      std::min(a.x + a.w / 2, b.x + b.w / 2) - std::max(a.x - a.w / 2, b.x - b.w / 2);
+  const float inter_h =
+      std::min(a.y + a.h / 2, b.y + b.h / 2) - std::max(a.y - a.h / 2, b.y - b.h / 2);
+  if (inter_w <= 0.f || inter_h <= 0.f)
+  {
+    return 0.f;
+  }
+  const float inter = inter_w * inter_h;
+  return inter / (a.w * a.h + b.w * b.h - inter);
+}
+
+void WeightedBoxesFusion(std::vector<BBox2D> &boxes, float iou_thresh, bool class_agnostic)
+{
+  // the confidence-weighted sums of the corners of the boxes of a fused box
+  struct Cluster {
+    BBox2D fused;
+    double weight = 0;
+    double x0     = 0;
+    double y0     = 0;
+    double x1     = 0;
+    double y1     = 0;
+  };
+
+  std::vector<int> order(boxes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&boxes](int a, int b) { return boxes[a].conf > boxes[b].conf; });
+
+  std::vector<Cluster> clusters;
+  for (const int index : order)
+  {
+    const BBox2D &box      = boxes[index];
+    Cluster      *matched  = nullptr;
+    float         best_iou = iou_thresh;
+    for (auto &cluster : clusters)
+    {
+      if (!class_agnostic && cluster.fused.cls != box.cls)
+      {
+        continue;
+      }
+      const float iou = BoxIoU(cluster.fused, box);
+      if (iou > best_iou)
+      {
+        best_iou = iou;
+        matched  = &cluster;
+      }
+    }
+    if (matched == nullptr)
+    {
+      clusters.emplace_back();
+      matched        = &clusters.back();
+      matched->fused = box;
+    }
+
+    const double weight = std::max(box.conf, 1e-6f);
+    matched->weight += weight;
+    matched->x0 += weight * (box.x - box.w / 2);
+    matched->y0 += weight * (box.y - box.h / 2);
+    matched->x1 += weight * (box.x + box.w / 2);
+    matched->y1 += weight * (box.y + box.h / 2);
+
+    const float x0      = matched->x0 / matched->weight;
+    const float y0      = matched->y0 / matched->weight;
+    const float x1      = matched->x1 / matched->weight;
+    const float y1      = matched->y1 / matched->weight;
+    matched->fused.x    = (x0 + x1) / 2;
+    matched->fused.y    = (y0 + y1) / 2;
+    matched->fused.w    = x1 - x0;
+    matched->fused.h    = y1 - y0;
+    matched->fused.conf = std::max(matched->fused.conf, box.conf);
+  }
+
+  boxes.clear();
+  for (const auto &cluster : clusters)
+  {
+    boxes.push_back(cluster.fused);
+  }
+}
+
+class TiledDetection : public BaseTiledDetectionModel {
+public:
+  TiledDetection(const std::shared_ptr<BaseDetectionModel> &detection_model,
+                 const TiledDetectionConfig                &config);
+
+  bool Detect(const cv::Mat       &image,
+              std::vector<BBox2D> &results,
+              float                conf_thresh,
+              bool                 isRGB) override;
+
+private:
+  bool DetectTiles(const cv::Mat &image, float conf_thresh, bool isRGB);
+
+private:
+  const std::shared_ptr<BaseDetectionModel> detection_model_;
+  const TiledDetectionConfig                config_;
+
+  std::mutex                       mtx_;
+  NmsEngine                        nms_;
+  std::vector<cv::Rect>            tiles_;
+  std::vector<cv::Mat>             tile_images_;
+  std::vector<std::vector<BBox2D>> tile_results_;
+};
+
+static NmsConfig MakeMergeNmsConfig(const TiledDetectionConfig &config)
+{
+  NmsConfig nms_config;
+  nms_config.iou_thresh     = config.merge_iou_thresh;
+  nms_config.pre_nms_top_k  = 0;
+  nms_config.max_detections = config.max_detections;
+  nms_config.class_agnostic = config.class_agnostic;
+  return nms_config;
+}
+
+TiledDetection::TiledDetection(const std::shared_ptr<BaseDetectionModel> &detection_model,
+                               const TiledDetectionConfig                &config)
+    : detection_model_(detection_model), config_(config), nms_(MakeMergeNmsConfig(config))
+{
+  if (detection_model_ == nullptr)
+  {
+    throw std::invalid_argument("[TiledDetection] Got INVALID detection model ptr!!!");
+  }
+  if (config_.tile_height <= 0 || config_.tile_width <= 0 || config_.overlap_ratio < 0.f ||
+      config_.overlap_ratio >= 1.f)
+  {
+    throw std::invalid_argument("[TiledDetection] Got INVALID tile config!!!");
+  }
+}
+
+bool TiledDetection::DetectTiles(const cv::Mat &image, float conf_thresh, bool isRGB)
+{
+  // 1. Views into `image`, no pixel is copied here
+  tiles_ = ComputeTiles(image.rows, image.cols, config_);
+  tile_images_.clear();
+  for (const auto &tile : tiles_)
+  {
+    tile_images_.emplace_back(image, tile);
+  }
+  if (config_.with_full_image && tiles_.size() > 1)
+  {
+    tiles_.emplace_back(0, 0, image.cols, image.rows);
+    tile_images_.push_back(image);
+  }
+
+  // 2. In batches, or pipelined through the async api
+  return DetectViews(detection_model_, tile_images_, tile_results_, conf_thresh, isRGB);
+}
+
+bool TiledDetection::Detect(const cv::Mat       &image,
+                            std::vector<BBox2D> &results,
+                            float                conf_thresh,
+                            bool                 isRGB)
+{
+  CHECK_STATE(!image.empty(), "[TiledDetection] Detect got empty image!!!");
+  std::lock_guard<std::mutex> lock(mtx_);
+
+  CHECK_STATE(DetectTiles(image, conf_thresh, isRGB), "[TiledDetection] Tile detection failed!!!");
+
+  // 3. Back to the original image, then merged across the tile borders
+  results.clear();
+  for (size_t i = 0; i < tiles_.size(); ++i)
+  {
+    for (auto box : tile_results_[i])
+    {
+      box.x += tiles_[i].x;
+      box.y += tiles_[i].y;
+      results.push_back(box);
+    }
+  }
+
+  if (config_.merge_method == TileMergeMethod::NMS)
+  {
+    nms_.Run(results, 0.f);
+    return true;
+  }
+  WeightedBoxesFusion(results, config_.merge_iou_thresh, config_.class_agnostic);
+  std::stable_sort(results.begin(), results.end(),
+                   [](const BBox2D &a, const BBox2D &b) { return a.conf > b.conf; });
+  if (config_.max_detections > 0 && results.size() > static_cast<size_t>(config_.max_detections))
+  {
+    results.resize(config_.max_detections);
+  }
+  return true;
+}
+
+std::shared_ptr<BaseTiledDetectionModel> CreateTiledDetectionModel(
+    const std::shared_ptr<BaseDetectionModel> &detection_model,
+    const TiledDetectionConfig                &config)
+{
+  return std::make_shared<TiledDetection>(detection_model, config);
+}
+
+struct TiledDetectionParams {
+  std::shared_ptr<BaseDetection2DFactory> detection_factory;
+  TiledDetectionConfig                    config;
+};
+
+class TiledDetectionFactory : public BaseTiledDetectionFactory {
+public:
+  TiledDetectionFactory(const TiledDetectionParams &params) : params_(params)
+  {}
+
+  std::shared_ptr<BaseTiledDetectionModel> Create() override
+  {
+    return CreateTiledDetectionModel(params_.detection_factory->Create(), params_.config);
+  }
+
+private:
+  TiledDetectionParams params_;
+};
+
+std::shared_ptr<BaseTiledDetectionFactory> CreateTiledDetectionModelFactory(
+    std::shared_ptr<BaseDetection2DFactory> detection_factory,
+    const TiledDetectionConfig             &config)
+{
+  if (detection_factory == nullptr)
+  {
+    throw std::invalid_argument("[CreateTiledDetectionModelFactory] Got invalid input arguments!");
+  }
+
+  TiledDetectionParams params;
+  params.detection_factory = detection_factory;
+  params.config            = config;
+
+  return std::make_shared<TiledDetectionFactory>(params);
+}
+
+} // namespace easy_deploy
@@ -0,0 +1,605 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "detection_2d_common/byte_tracker.hpp"
+#include "detection_2d_common/cascade_detection.hpp"
+#include "detection_2d_common/fused_preprocess.hpp"
+#include "detection_2d_common/nms.hpp"
+#include "detection_2d_common/roi_detection.hpp"
+#include "detection_2d_common/tiled_detection.hpp"
+
+using namespace easy_deploy;
+
+// smooth random image, so the bilinear samples are not dominated by the fixed-point rounding of
+// `cv::resize`
+static cv::Mat GenerateImage(int height, int width)
+{
+  cv::Mat                            image(height, width, CV_8UC3);
+  std::mt19937                       generator(0);
+  std::uniform_int_distribution<int> distribution(0, 255);
+  for (int y = 0; y < height; ++y)
+  {
+    for (int x = 0; x < width * 3; ++x)
+    {
+      image.ptr<uint8_t>(y)[x] = static_cast<uint8_t>(distribution(generator));
+    }
+  }
+  cv::GaussianBlur(image, image, {5, 5}, 0);
+  return image;
+}
+
+static float MaxAbsDiff(const std::vector<float> &a, const std::vector<float> &b)
+{
+  float max_diff = 0.f;
+  for (size_t i = 0; i < a.size(); ++i)
+  {
+    max_diff = std::max(max_diff, std::abs(a[i] - b[i]));
+  }
+  return max_diff;
+}
+
+TEST(FusedPreProcessTest, test_fused_matches_reference)
+{
+  // downscale, upscale, non-square input and non-square output
+  const std::vector<std::vector<int>> shapes = {
+      {1080, 1920, 640, 640}, {480, 640, 640, 640}, {333, 517, 320, 320},
+      {100, 50, 1024, 1024},  {720, 1280, 384, 640}};
+  FusedDetPreProcessParams params;
+  params.mean   = {0.485f * 255, 0.456f * 255, 0.406f * 255};
+  params.stddev = {0.229f * 255, 0.224f * 255, 0.225f * 255};
+  for (const auto &shape : shapes)
+  {
+    const cv::Mat image = GenerateImage(shape[0], shape[1]);
+    for (const bool swap_rb : {true, false})
+    {
+      params.swap_rb = swap_rb;
+      std::vector<float> expected(3 * shape[2] * shape[3]);
+      std::vector<float> fused(expected.size(), -100.f);
+      const float        expected_scale =
+          FusedLetterboxNormalizeReference(image, expected.data(), shape[2], shape[3], params);
+      const float        scale =
+          FusedLetterboxNormalize(image, fused.data(), shape[2], shape[3], params);
+
+      EXPECT_FLOAT_EQ(scale, expected_scale);
+      // `cv::resize` rounds its uint8 output, one pixel level at most once normalized
+      EXPECT_LT(MaxAbsDiff(fused, expected), 1.f / (0.224f * 255) + 1e-4f);
+    }
+  }
+}
+
+TEST(FusedPreProcessTest, test_swap_and_padding)
+{
+  // a constant BGR image is constant on each plane, and the padding is the normalized zero pixel
+  cv::Mat            image(200, 400, CV_8UC3, cv::Scalar(10, 20, 30));
+  const int          dst_size = 320;
+  std::vector<float> output(3 * dst_size * dst_size);
+  const float        scale =
+      FusedLetterboxNormalize(image, output.data(), dst_size, dst_size, FusedDetPreProcessParams{});
+  EXPECT_FLOAT_EQ(scale, 0.8f);
+
+  const int resized_height = 160;
+  for (int y : {0, resized_height - 1, resized_height, dst_size - 1})
+  {
+    for (int x : {0, dst_size - 1})
+    {
+      const bool  inside = y < resized_height;
+      const float r      = output[y * dst_size + x];
+      const float g      = output[dst_size * dst_size + y * dst_size + x];
+      const float b      = output[2 * dst_size * dst_size + y * dst_size + x];
+      EXPECT_NEAR(r, inside ? 30.f / 255 : 0.f, 1e-6f);
+      EXPECT_NEAR(g, inside ? 20.f / 255 : 0.f, 1e-6f);
+      EXPECT_NEAR(b, inside ? 10.f / 255 : 0.f, 1e-6f);
+    }
+  }
+}
+
+TEST(FusedPreProcessTest, test_rgb_input_matches_reference)
+{
+  // an RGB image comes out as its BGR version does, for RGB and BGR models
+  const cv::Mat image = GenerateImage(480, 640);
+  cv::Mat       rgb;
+  cv::cvtColor(image, rgb, cv::COLOR_BGR2RGB);
+  for (const bool swap_rb : {true, false})
+  {
+    FusedDetPreProcessParams params;
+    params.swap_rb = swap_rb;
+    std::vector<float> expected(3 * 320 * 320), fused(expected.size(), -100.f);
+    FusedLetterboxNormalizeReference(image, expected.data(), 320, 320, params, false);
+    FusedLetterboxNormalize(rgb, fused.data(), 320, 320, params, true);
+    EXPECT_LT(MaxAbsDiff(fused, expected), 1.f / 255 + 1e-4f);
+
+    params.normalize = false;
+    std::vector<uint8_t> expected_pixels(320 * 320 * 3), pixels(expected_pixels.size(), 255);
+    FusedLetterboxNormalizeReference(image, expected_pixels.data(), 320, 320, params, false);
+    FusedLetterboxNormalize(rgb, pixels.data(), 320, 320, params, true);
+    EXPECT_EQ(pixels, expected_pixels);
+  }
+}
+
+TEST(FusedPreProcessTest, test_interleaved_uint8_output)
+{
+  // the rknn mode, resized and padded uint8 pixels without normalization
+  const cv::Mat            image = GenerateImage(480, 640);
+  FusedDetPreProcessParams params;
+  params.normalize = false;
+  params.swap_rb   = true;
+
+  std::vector<uint8_t> output(640 * 640 * 3, 255);
+  FusedLetterboxNormalize(image, output.data(), 640, 640, params);
+
+  cv::Mat expected(640, 640, CV_8UC3, cv::Scalar(0, 0, 0));
+  cv::Mat rgb;
+  cv::cvtColor(image, rgb, cv::COLOR_BGR2RGB);
+  rgb.copyTo(expected(cv::Rect(0, 0, 640, 480)));
+  EXPECT_EQ(cv::norm(cv::Mat(640, 640, CV_8UC3, output.data()), expected, cv::NORM_INF), 0);
+}
+
+TEST(FusedPreProcessTest, test_invalid_input)
+{
+  std::vector<float> output(3 * 64 * 64);
+  EXPECT_THROW(FusedLetterboxNormalize(cv::Mat(), output.data(), 64, 64, {}),
+               std::invalid_argument);
+  EXPECT_THROW(FusedLetterboxNormalize(cv::Mat(32, 32, CV_8UC1), output.data(), 64, 64, {}),
+               std::invalid_argument);
+}
+
+TEST(FusedPreProcessTest, test_strided_view_matches_dense)
+{
+  const cv::Mat image = GenerateImage(720, 1280);
+  // a view with a row stride, as the tiles of `BaseTiledDetectionModel`
+  const cv::Mat view(image, cv::Rect(300, 100, 640, 480));
+  ASSERT_FALSE(view.isContinuous());
+
+  auto strided_preprocess =
+      std::dynamic_pointer_cast<IStridedDetectionPreProcess>(CreateFusedCpuDetPreProcess());
+  ASSERT_NE(strided_preprocess, nullptr);
+  std::vector<float> expected(3 * 640 * 640), output(3 * 640 * 640);
+  const float        expected_scale =
+      FusedLetterboxNormalize(view.clone(), expected.data(), 640, 640, FusedDetPreProcessParams{});
+  EXPECT_FLOAT_EQ(strided_preprocess->PreprocessMat(view, output.data(), 640, 640, false),
+                  expected_scale);
+  EXPECT_EQ(output, expected);
+
+  // an RGB view keeps its channel order
+  FusedLetterboxNormalize(view.clone(), expected.data(), 640, 640, FusedDetPreProcessParams{},
+                          true);
+  strided_preprocess->PreprocessMat(view, output.data(), 640, 640, true);
+  EXPECT_EQ(output, expected);
+}
+
+// clusters of jittered boxes, mostly of the class of their cluster
+static std::vector<DetectionCandidate> GenerateCandidates(int num, int cls_number, unsigned seed)
+{
+  std::mt19937                          generator(seed);
+  std::uniform_real_distribution<float> distribution(0.f, 1.f);
+  std::vector<DetectionCandidate>       objects(std::max(1, num / 20));
+  for (auto &object : objects)
+  {
+    object.cx  = 1920.f * distribution(generator);
+    object.cy  = 1080.f * distribution(generator);
+    object.w   = 20.f + 200.f * distribution(generator);
+    object.h   = 20.f + 300.f * distribution(generator);
+    object.cls = generator() % cls_number;
+  }
+  std::vector<DetectionCandidate> candidates(num);
+  for (auto &candidate : candidates)
+  {
+    const auto &object = objects[generator() % objects.size()];
+    candidate.cx       = object.cx + 20.f * (distribution(generator) - 0.5f);
+    candidate.cy       = object.cy + 20.f * (distribution(generator) - 0.5f);
+    candidate.w        = object.w * (0.8f + 0.4f * distribution(generator));
+    candidate.h        = object.h * (0.8f + 0.4f * distribution(generator));
+    candidate.conf     = distribution(generator);
+    candidate.cls      = distribution(generator) < 0.8f ? object.cls : generator() % cls_number;
+  }
+  return candidates;
+}
+
+TEST(NmsEngineTest, test_matches_naive_greedy_nms)
+{
+  std::vector<NmsConfig> configs(5);
+  configs[1].class_agnostic    = true;
+  configs[2].pre_nms_top_k     = 50;
+  configs[2].max_detections    = 20;
+  configs[3].class_conf_thresh = {0.9f, 0.1f, 0.5f};
+  configs[3].iou_thresh        = 0.7f;
+  configs[4].iou_thresh        = 0.f;
+  for (const auto &config : configs)
+  {
+    NmsEngine engine(config);
+    for (const int num : {0, 1, 5, 100, 1000, 5000})
+    {
+      const auto candidates = GenerateCandidates(num, 10, num);
+      // the engine is reused between calls
+      for (const float conf_thresh : {0.f, 0.2f})
+      {
+        EXPECT_EQ(engine.Run(candidates.data(), candidates.size(), conf_thresh),
+                  NmsNaive(candidates.data(), candidates.size(), conf_thresh, config));
+      }
+    }
+  }
+}
+
+TEST(NmsEngineTest, test_class_thresholds_and_limits)
+{
+  // two overlapping boxes of class 0, one of class 1 on them, one far away of class 2
+  auto make_box = [](float x, float y, float cls, float conf) {
+    BBox2D box;
+    box.x    = x;
+    box.y    = y;
+    box.w    = 50.f;
+    box.h    = 50.f;
+    box.cls  = cls;
+    box.conf = conf;
+    return box;
+  };
+  const std::vector<BBox2D> boxes = {make_box(100.f, 100.f, 0.f, 0.9f),
+                                     make_box(105.f, 100.f, 0.f, 0.8f),
+                                     make_box(100.f, 105.f, 1.f, 0.7f),
+                                     make_box(500.f, 500.f, 2.f, 0.3f)};
+
+  NmsConfig config;
+  config.class_conf_thresh = {0.f, 0.f, 0.5f};
+  NmsEngine engine(config);
+  EXPECT_FLOAT_EQ(engine.ClassThreshold(2, 0.2f), 0.5f);
+  EXPECT_FLOAT_EQ(engine.ClassThreshold(7, 0.2f), 0.2f);
+  EXPECT_FLOAT_EQ(engine.MinThreshold(3, 0.2f), 0.2f);
+
+  auto results = boxes;
+  engine.Run(results, 0.2f);
+  ASSERT_EQ(results.size(), 2u);
+  EXPECT_FLOAT_EQ(results[0].conf, 0.9f);
+  EXPECT_FLOAT_EQ(results[1].conf, 0.7f);
+
+  config.class_agnostic = true;
+  config.max_detections = 1;
+  NmsEngine agnostic_engine(config);
+  results = boxes;
+  agnostic_engine.Run(results, 0.f);
+  ASSERT_EQ(results.size(), 1u);
+  EXPECT_FLOAT_EQ(results[0].conf, 0.9f);
+
+  config.iou_thresh = 1.5f;
+  EXPECT_THROW(NmsEngine{config}, std::invalid_argument);
+}
+
+TEST(TiledDetectionTest, test_tiles_cover_image_with_overlap)
+{
+  TiledDetectionConfig config;
+  const int            stride = static_cast<int>(std::lround(640 * (1.f - config.overlap_ratio)));
+  for (const auto &image_size : {cv::Size(4000, 3000), cv::Size(640, 640), cv::Size(500, 300),
+                                 cv::Size(1000, 641)})
+  {
+    const auto tiles = ComputeTiles(image_size.height, image_size.width, config);
+    ASSERT_FALSE(tiles.empty());
+    std::vector<int> xs, ys;
+    for (const auto &tile : tiles)
+    {
+      EXPECT_EQ(tile.width, std::min(640, image_size.width));
+      EXPECT_EQ(tile.height, std::min(640, image_size.height));
+      EXPECT_GE(tile.x, 0);
+      EXPECT_GE(tile.y, 0);
+      EXPECT_LE(tile.x + tile.width, image_size.width);
+      EXPECT_LE(tile.y + tile.height, image_size.height);
+      xs.push_back(tile.x);
+      ys.push_back(tile.y);
+    }
+    // along each axis, the tiles start at the border, end at the border and overlap
+    for (auto *origins : {&xs, &ys})
+    {
+      std::sort(origins->begin(), origins->end());
+      origins->erase(std::unique(origins->begin(), origins->end()), origins->end());
+      for (size_t i = 1; i < origins->size(); ++i)
+      {
+        EXPECT_LE((*origins)[i] - (*origins)[i - 1], stride);
+      }
+    }
+    EXPECT_EQ(xs.front(), 0);
+    EXPECT_EQ(ys.front(), 0);
+    EXPECT_EQ(xs.back() + tiles.back().width, image_size.width);
+    EXPECT_EQ(ys.back() + tiles.back().height, image_size.height);
+    EXPECT_EQ(tiles.size(), xs.size() * ys.size());
+  }
+
+  config.overlap_ratio = 1.f;
+  EXPECT_THROW(ComputeTiles(3000, 4000, config), std::invalid_argument);
+}
+
+TEST(TiledDetectionTest, test_weighted_boxes_fusion)
+{
+  auto make_box = [](float x, float cls, float conf) {
+    BBox2D box;
+    box.x    = x;
+    box.y    = 100.f;
+    box.w    = 50.f;
+    box.h    = 50.f;
+    box.cls  = cls;
+    box.conf = conf;
+    return box;
+  };
+  // the same object seen by two tiles, and an object of another class at the same place
+  const std::vector<BBox2D> boxes = {make_box(110.f, 0.f, 0.3f), make_box(100.f, 0.f, 0.9f),
+                                     make_box(100.f, 1.f, 0.5f)};
+
+  auto results = boxes;
+  WeightedBoxesFusion(results, 0.5f);
+  ASSERT_EQ(results.size(), 2u);
+  EXPECT_FLOAT_EQ(results[0].x, (0.9f * 100.f + 0.3f * 110.f) / 1.2f);
+  EXPECT_FLOAT_EQ(results[0].w, 50.f);
+  EXPECT_FLOAT_EQ(results[0].cls, 0.f);
+  EXPECT_FLOAT_EQ(results[0].conf, 0.9f);
+  EXPECT_FLOAT_EQ(results[1].cls, 1.f);
+
+  results = boxes;
+  WeightedBoxesFusion(results, 0.5f, true);
+  ASSERT_EQ(results.size(), 1u);
+
+  results = boxes;
+  WeightedBoxesFusion(results, 0.95f);
+  EXPECT_EQ(results.size(), 3u);
+}
+
+// `num` objects of 80x160 moving at constant speeds on a 1920x1080 frame, bouncing on its borders
+static std::vector<std::vector<BBox2D>> GenerateTrajectories(int num, int num_frames, unsigned seed)
+{
+  std::mt19937                          generator(seed);
+  std::uniform_real_distribution<float> distribution(0.f, 1.f);
+  std::vector<BBox2D>                   objects(num);
+  std::vector<cv::Point2f>              speeds(num);
+  for (int i = 0; i < num; ++i)
+  {
+    objects[i].x    = 100.f + 1720.f * distribution(generator);
+    objects[i].y    = 100.f + 880.f * distribution(generator);
+    objects[i].w    = 80.f;
+    objects[i].h    = 160.f;
+    objects[i].cls  = 0.f;
+    objects[i].conf = 0.9f;
+    speeds[i]       = {8.f * distribution(generator) - 4.f, 8.f * distribution(generator) - 4.f};
+  }
+  std::vector<std::vector<BBox2D>> frames;
+  for (int f = 0; f < num_frames; ++f)
+  {
+    frames.push_back(objects);
+    for (int i = 0; i < num; ++i)
+    {
+      if (objects[i].x + speeds[i].x < 50.f || objects[i].x + speeds[i].x > 1870.f)
+      {
+        speeds[i].x = -speeds[i].x;
+      }
+      if (objects[i].y + speeds[i].y < 90.f || objects[i].y + speeds[i].y > 990.f)
+      {
+        speeds[i].y = -speeds[i].y;
+      }
+      objects[i].x += speeds[i].x;
+      objects[i].y += speeds[i].y;
+    }
+  }
+  return frames;
+}
+
+TEST(ByteTrackerTest, test_tracks_keep_ids_and_predict_motion)
+{
+  const auto  frames = GenerateTrajectories(3, 40, 0);
+  ByteTracker tracker;
+  // the id of each object, the results are matched to the objects by their position
+  std::vector<int> object_ids(3, -1);
+  for (int f = 0; f < 30; ++f)
+  {
+    const auto &results = tracker.Update(frames[f]);
+    ASSERT_EQ(results.size(), 3u);
+    for (const auto &result : results)
+    {
+      for (int i = 0; i < 3; ++i)
+      {
+        if (std::abs(result.box.x - frames[f][i].x) < 5.f &&
+            std::abs(result.box.y - frames[f][i].y) < 5.f)
+        {
+          if (object_ids[i] == -1)
+          {
+            object_ids[i] = result.track_id;
+          }
+          EXPECT_EQ(result.track_id, object_ids[i]);
+        }
+      }
+    }
+  }
+  EXPECT_NE(object_ids[0], object_ids[1]);
+  EXPECT_NE(object_ids[1], object_ids[2]);
+
+  // frames without detections follow the learnt velocity
+  for (int f = 30; f < 33; ++f)
+  {
+    const auto &results = tracker.Predict();
+    ASSERT_EQ(results.size(), 3u);
+    for (const auto &result : results)
+    {
+      const int i = std::find(object_ids.begin(), object_ids.end(), result.track_id) -
+                    object_ids.begin();
+      ASSERT_LT(i, 3);
+      EXPECT_NEAR(result.box.x, frames[f][i].x, 3.f);
+      EXPECT_NEAR(result.box.y, frames[f][i].y, 3.f);
+    }
+  }
+  EXPECT_EQ(tracker.Update(frames[33]).size(), 3u);
+}
+
+TEST(ByteTrackerTest, test_low_score_detections_keep_tracks)
+{
+  auto frames = GenerateTrajectories(1, 20, 1);
+  // occluded between frames 5 and 10, detected with a low score
+  for (int f = 5; f < 10; ++f)
+  {
+    frames[f][0].conf = 0.3f;
+  }
+
+  ByteTrackConfig config;
+  ByteTracker     tracker(config);
+  config.low_thresh = config.high_thresh;
+  ByteTracker high_only_tracker(config);
+  for (int f = 0; f < 20; ++f)
+  {
+    const auto &results           = tracker.Update(frames[f]);
+    const auto &high_only_results = high_only_tracker.Update(frames[f]);
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_EQ(results[0].track_id, 0);
+    // without the second association the track is lost while occluded, then found again
+    EXPECT_EQ(high_only_results.size(), f >= 5 && f < 10 ? 0u : 1u);
+  }
+  EXPECT_EQ(high_only_tracker.Update(frames[19])[0].track_id, 0);
+
+  // the lost track is dropped after `max_lost_frames` frames
+  for (int f = 0; f <= config.max_lost_frames; ++f)
+  {
+    tracker.Predict();
+    tracker.Update({});
+  }
+  EXPECT_EQ(tracker.GetTrackNum(), 0u);
+}
+
+TEST(ByteTrackerTest, test_hundreds_of_tracks_without_id_switch)
+{
+  // a 20 x 15 grid of objects circling around their cell, each overlapping its neighbours
+  const int   cols        = 20;
+  const int   num_objects = cols * 15;
+  const float cell_width  = 64.f;
+  const float cell_height = 48.f;
+  const float radius      = 12.f;
+
+  ByteTracker      tracker;
+  std::vector<int> track_of_object(num_objects, -1);
+  int              id_switches = 0;
+  for (int f = 0; f < 60; ++f)
+  {
+    std::vector<BBox2D> detections(num_objects);
+    for (int i = 0; i < num_objects; ++i)
+    {
+      const float phase  = 0.1f * f + 0.7f * i;
+      detections[i].x    = 100.f + cell_width * (i % cols) + radius * std::cos(phase);
+      detections[i].y    = 100.f + cell_height * (i / cols) + radius * std::sin(phase);
+      detections[i].w    = 80.f;
+      detections[i].h    = 60.f;
+      detections[i].cls  = 0.f;
+      detections[i].conf = 0.9f;
+    }
+
+    const auto &results = tracker.Update(detections);
+    ASSERT_EQ(results.size(), static_cast<size_t>(num_objects));
+    for (const auto &result : results)
+    {
+      // the object of a result is the nearest one
+      int   object   = 0;
+      float distance = INFINITY;
+      for (int i = 0; i < num_objects; ++i)
+      {
+        const float d = std::hypot(result.box.x - detections[i].x, result.box.y - detections[i].y);
+        if (d < distance)
+        {
+          object   = i;
+          distance = d;
+        }
+      }
+      if (track_of_object[object] != -1 && track_of_object[object] != result.track_id)
+      {
+        ++id_switches;
+      }
+      track_of_object[object] = result.track_id;
+    }
+  }
+  EXPECT_EQ(id_switches, 0);
+  EXPECT_EQ(tracker.GetTrackNum(), static_cast<size_t>(num_objects));
+}
+
+TEST(CascadeDetectionTest, test_escalation_on_ambiguous_results)
+{
+  CascadeDetectionConfig config;
+  config.ambiguous_conf_low  = 0.1f;
+  config.ambiguous_conf_high = 0.5f;
+  config.max_ambiguous_num   = 1;
+  config.max_detections_num  = 3;
+
+  auto make_results = [](const std::vector<float> &confs) {
+    std::vector<BBox2D> results;
+    for (const float conf : confs)
+    {
+      results.push_back({100.f, 100.f, 50.f, 50.f, 0.f, conf});
+    }
+    return results;
+  };
+  // confident results, or a single ambiguous detection
+  EXPECT_FALSE(NeedEscalation({}, config));
+  EXPECT_FALSE(NeedEscalation(make_results({0.9f, 0.8f, 0.3f}), config));
+  // detections below `ambiguous_conf_low` are background
+  EXPECT_FALSE(NeedEscalation(make_results({0.9f, 0.05f, 0.05f, 0.05f}), config));
+  // more ambiguous detections than allowed
+  EXPECT_TRUE(NeedEscalation(make_results({0.9f, 0.3f, 0.2f}), config));
+  EXPECT_TRUE(NeedEscalation(make_results({0.9f, 0.15f, 0.12f}), config));
+  // a crowded image, by its confident detections only
+  EXPECT_TRUE(NeedEscalation(make_results({0.9f, 0.8f, 0.7f, 0.6f}), config));
+  EXPECT_FALSE(NeedEscalation(make_results({0.9f, 0.8f, 0.7f, 0.3f}), config));
+}
+
+TEST(RoiDetectionTest, test_roi_crops_in_frame)
+{
+  RoiDetectionConfig config;
+  config.input_height = 640;
+  config.input_width  = 640;
+
+  auto expect_rect = [](const cv::Rect &rect, int x, int y, int width, int height) {
+    EXPECT_EQ(rect.x, x);
+    EXPECT_EQ(rect.y, y);
+    EXPECT_EQ(rect.width, width);
+    EXPECT_EQ(rect.height, height);
+  };
+  // the whole frame, by an empty list
+  auto crops = ComputeRoiCrops(1080, 1920, {}, config);
+  ASSERT_EQ(crops.size(), 1u);
+  expect_rect(crops[0].crop, 0, 0, 1920, 1080);
+
+  // small regions grown to the input size in the frame, the ones out of the frame dropped
+  crops = ComputeRoiCrops(
+      1080, 1920, {{100, 100, 200, 100}, {1800, 1000, 300, 200}, {-50, -50, 10, 10}}, config);
+  ASSERT_EQ(crops.size(), 2u);
+  expect_rect(crops[0].roi, 100, 100, 200, 100);
+  expect_rect(crops[0].crop, 0, 0, 640, 640);
+  expect_rect(crops[1].roi, 1800, 1000, 120, 80);
+  expect_rect(crops[1].crop, 1280, 440, 640, 640);
+
+  // a wide region grown to the aspect ratio of the input, clipped to the frame
+  crops = ComputeRoiCrops(1080, 1920, {{0, 200, 1600, 400}}, config);
+  ASSERT_EQ(crops.size(), 1u);
+  expect_rect(crops[0].crop, 0, 0, 1600, 1080);
+
+  // or enlarged
+  config.upscale_small_roi = true;
+  crops                    = ComputeRoiCrops(1080, 1920, {{100, 100, 200, 100}}, config);
+  ASSERT_EQ(crops.size(), 1u);
+  expect_rect(crops[0].crop, 100, 50, 200, 200);
+}
+
+TEST(RoiDetectionTest, test_map_boxes_to_frame)
+{
+  RoiCrop crop;
+  crop.roi  = cv::Rect(1800, 1000, 120, 80);
+  crop.crop = cv::Rect(1280, 440, 640, 640);
+
+  const std::vector<BBox2D> boxes = {{550.f, 600.f, 40.f, 40.f, 0.f, 0.9f},
+                                     {100.f, 100.f, 40.f, 40.f, 1.f, 0.8f}};
+  auto                      mapped = boxes;
+  MapBoxesToFrame(crop, mapped, false);
+  ASSERT_EQ(mapped.size(), 2u);
+  EXPECT_FLOAT_EQ(mapped[0].x, 1830.f);
+  EXPECT_FLOAT_EQ(mapped[0].y, 1040.f);
+  EXPECT_FLOAT_EQ(mapped[1].x, 1380.f);
+  EXPECT_FLOAT_EQ(mapped[1].y, 540.f);
+  EXPECT_FLOAT_EQ(mapped[0].w, 40.f);
+
+  // the box of the context is out of the region
+  mapped = boxes;
+  MapBoxesToFrame(crop, mapped, true);
+  ASSERT_EQ(mapped.size(), 1u);
+  EXPECT_FLOAT_EQ(mapped[0].x, 1830.f);
+}
@@ -1,10 +1,11 @@
 #pragma once
 
 #include "deploy_core/base_detection.hpp"
+#include "detection_2d_common/batch_detection.hpp"
 
 namespace easy_deploy {
 
-std::shared_ptr<BaseDetectionModel> CreateRTDetrDetectionModel(
+std::shared_ptr<BaseBatchDetectionModel> CreateRTDetrDetectionModel(
     const std::shared_ptr<BaseInferCore>        &infer_core,
     const std::shared_ptr<IDetectionPreProcess> &preprocess_block,
     const int                                    input_height,
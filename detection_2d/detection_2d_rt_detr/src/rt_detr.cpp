@@ -2,7 +2,7 @@
 
 namespace easy_deploy {
 
-class RTDetrDetection : public BaseDetectionModel {
+class RTDetrDetection : public BaseBatchDetectionModel {
 public:
   RTDetrDetection(const std::shared_ptr<BaseInferCore>        &infer_core,
                   const std::shared_ptr<IDetectionPreProcess> &preprocess_block,
@@ -20,6 +20,12 @@ private:
 
   bool PostProcess(std::shared_ptr<IPipelinePackage> pipeline_unit) override;
 
+  bool PostProcessBatchItem(IBlobsBuffer        *blobs_buffer,
+                            size_t               batch_index,
+                            float                conf_thresh,
+                            float                transform_scale,
+                            std::vector<BBox2D> &results) override;
+
 private:
   const std::vector<std::string> input_blobs_name_;
   const std::vector<std::string> output_blobs_name_;
@@ -40,7 +46,12 @@ RTDetrDetection::RTDetrDetection(const std::shared_ptr<BaseInferCore>        &in
                                  const int                                    cls_number,
                                  const std::vector<std::string>              &input_blobs_name,
                                  const std::vector<std::string>              &output_blobs_name)
-    : BaseDetectionModel(infer_core),
+    : BaseBatchDetectionModel(infer_core,
+                              preprocess_block,
+                              input_blobs_name.at(0),
+                              input_height,
+                              input_width,
+                              input_channel),
       input_blobs_name_(input_blobs_name),
       output_blobs_name_(output_blobs_name),
       input_height_(input_height),
@@ -95,17 +106,24 @@ bool RTDetrDetection::PostProcess(std::shared_ptr<IPipelinePackage> _package)
               "[RTDetrDetection] PostProcess the `_package` instance does not belong to "
               "`DetectionPipelinePackage`");
 
-  const auto &blobs_tensor = package->GetInferBuffer();
+  return PostProcessBatchItem(package->GetInferBuffer(), 0, package->conf_thresh,
+                              package->transform_scale, package->results);
+}
 
-  // RTDetrDetection outputs: labels <int32> (1, 300); boxes (1, 300, 4); scores (1, 300)
+bool RTDetrDetection::PostProcessBatchItem(IBlobsBuffer        *blobs_buffer,
+                                           size_t               batch_index,
+                                           float                conf_thresh,
+                                           float                transform_scale,
+                                           std::vector<BBox2D> &results)
+{
+  // RTDetrDetection outputs: labels <int32> (B, 300); boxes (B, 300, 4); scores (B, 300)
+  const auto outputs = GetBatchItemOutputs(blobs_buffer, output_blobs_name_, batch_index);
 
-  float *labels_ptr = blobs_tensor->GetTensor(output_blobs_name_[0])->Cast<float>();
-  float *boxes_ptr  = blobs_tensor->GetTensor(output_blobs_name_[1])->Cast<float>();
-  float *scores_ptr = blobs_tensor->GetTensor(output_blobs_name_[2])->Cast<float>();
+  float *labels_ptr = static_cast<float *>(outputs[0]);
+  float *boxes_ptr  = static_cast<float *>(outputs[1]);
+  float *scores_ptr = static_cast<float *>(outputs[2]);
 
-  const int   CANDIDATES_NUM = 300;
-  const float conf_thresh    = package->conf_thresh;
-  const float transf_scale   = package->transform_scale;
+  const int CANDIDATES_NUM = 300;
 
   std::vector<BBox2D> valid_boxes;
   for (int i = 0; i < CANDIDATES_NUM; ++i)
@@ -118,22 +136,22 @@ bool RTDetrDetection::PostProcess(std::shared_ptr<IPipelinePackage> _package)
       float y1 = boxes_ptr[i * 4 + 3];
 
       BBox2D box;
-      box.x    = (x0 + x1) / 2 / transf_scale;
-      box.y    = (y0 + y1) / 2 / transf_scale;
-      box.w    = (x1 - x0) / transf_scale;
-      box.h    = (y1 - y0) / transf_scale;
+      box.x    = (x0 + x1) / 2 / transform_scale;
+      box.y    = (y0 + y1) / 2 / transform_scale;
+      box.w    = (x1 - x0) / transform_scale;
+      box.h    = (y1 - y0) / transform_scale;
       box.cls  = static_cast<float>(labels_ptr[i]);
       box.conf = scores_ptr[i];
       valid_boxes.push_back(box);
     }
   }
 
-  package->results = std::move(valid_boxes);
+  results = std::move(valid_boxes);
 
   return true;
 }
 
-std::shared_ptr<BaseDetectionModel> CreateRTDetrDetectionModel(
+std::shared_ptr<BaseBatchDetectionModel> CreateRTDetrDetectionModel(
     const std::shared_ptr<BaseInferCore>        &infer_core,
     const std::shared_ptr<IDetectionPreProcess> &preprocess_block,
     const int                                    input_height,
@@ -1,11 +1,131 @@
 #include <gtest/gtest.h>
 
+#include "detection_2d_common/byte_tracker.hpp"
+#include "detection_2d_common/cascade_detection.hpp"
+#include "detection_2d_common/fused_preprocess.hpp"
+#include "detection_2d_common/roi_detection.hpp"
+#include "detection_2d_common/tiled_detection.hpp"
 #include "detection_2d_util/detection_2d_util.hpp"
 #include "detection_2d_yolov8/yolov8.hpp"
+#include "detection_2d_yolov8/yolov8_postprocess.hpp"
 #include "benchmark_utils/detection_2d_benchmark_utils.hpp"
 
 using namespace easy_deploy;
 
+// `DetectBatch` on `state.range(0)` copies of the test image per call, reports the images/sec.
+// A batch size of 1 goes through the batch path too, as the baseline of the sweep.
+static void benchmark_detection_2d_batch(benchmark::State                        &state,
+                                         std::shared_ptr<BaseBatchDetectionModel> model)
+{
+  cv::Mat                          image = cv::imread("/workspace/test_data/persons.jpg");
+  const std::vector<cv::Mat>       images(state.range(0), image);
+  std::vector<std::vector<BBox2D>> results;
+  for (auto _ : state)
+  {
+    model->DetectBatch(images, results, 0.4);
+  }
+  state.counters["images/sec"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * images.size()), benchmark::Counter::kIsRate);
+}
+
+// `BaseTiledDetectionModel` on the test image upscaled to 4k, with tiles of `state.range(0)`
+// pixels, reports the images/sec and the tiles per image
+static void benchmark_detection_2d_tiled(benchmark::State                   &state,
+                                         std::shared_ptr<BaseDetectionModel> model)
+{
+  cv::Mat image = cv::imread("/workspace/test_data/persons.jpg");
+  cv::resize(image, image, {3840, 2160});
+  TiledDetectionConfig config;
+  config.tile_height = state.range(0);
+  config.tile_width  = state.range(0);
+
+  auto                tiled_model = CreateTiledDetectionModel(model, config);
+  std::vector<BBox2D> results;
+  for (auto _ : state)
+  {
+    tiled_model->Detect(image, results, 0.4);
+  }
+  state.counters["images/sec"] =
+      benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  // and the whole image
+  state.counters["tiles"] = ComputeTiles(image.rows, image.cols, config).size() + 1;
+  state.counters["boxes"] = results.size();
+}
+
+// `BaseTrackedDetectionModel` replaying a camera panning across the test image upscaled to 4k, 720p
+// frames moving 4 pixels a frame, detected every `state.range(0)` frames. Reports the effective
+// frames/sec and the tracks of the last frame.
+static void benchmark_detection_2d_tracked(benchmark::State                   &state,
+                                           std::shared_ptr<BaseDetectionModel> model)
+{
+  cv::Mat image = cv::imread("/workspace/test_data/persons.jpg");
+  cv::resize(image, image, {3840, 2160});
+  std::vector<cv::Mat> frames;
+  for (int x = 0; x + 1280 <= image.cols && frames.size() < 300; x += 4)
+  {
+    frames.emplace_back(image, cv::Rect(x, 720, 1280, 720));
+  }
+  TrackedDetectionConfig config;
+  config.detect_interval = state.range(0);
+
+  auto                       tracked_model = CreateTrackedDetectionModel(model, config);
+  std::vector<TrackedBBox2D> results;
+  size_t                     frame_index = 0;
+  for (auto _ : state)
+  {
+    tracked_model->Track(frames[frame_index++ % frames.size()], results);
+  }
+  state.counters["frames/sec"] =
+      benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["tracks"] = results.size();
+}
+
+// `BaseCascadeDetectionModel` on the test image, the detections of the small model scoring below
+// `state.range(0)` percent are ambiguous. Reports the images/sec and the escalation rate.
+static void benchmark_detection_2d_cascade(benchmark::State                   &state,
+                                           std::shared_ptr<BaseDetectionModel> small_model,
+                                           std::shared_ptr<BaseDetectionModel> large_model)
+{
+  cv::Mat                image = cv::imread("/workspace/test_data/persons.jpg");
+  CascadeDetectionConfig config;
+  config.ambiguous_conf_high = state.range(0) / 100.f;
+  config.max_ambiguous_num   = 2;
+
+  auto                cascade_model = CreateCascadeDetectionModel(small_model, large_model, config);
+  std::vector<BBox2D> results;
+  for (auto _ : state)
+  {
+    cascade_model->Detect(image, results, 0.4);
+  }
+  state.counters["images/sec"] =
+      benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["escalation"] = cascade_model->GetStats().EscalationRate();
+}
+
+// `BaseRoiDetectionModel` on the test image upscaled to 4k, with `state.range(0)` regions of
+// 640x640 along a diagonal, the whole frame for 0. Reports the images/sec.
+static void benchmark_detection_2d_roi(benchmark::State                   &state,
+                                       std::shared_ptr<BaseDetectionModel> model)
+{
+  cv::Mat image = cv::imread("/workspace/test_data/persons.jpg");
+  cv::resize(image, image, {3840, 2160});
+  std::vector<cv::Rect> rois;
+  for (int i = 0; i < state.range(0); ++i)
+  {
+    rois.emplace_back(i * 640, i * 380, 640, 640);
+  }
+
+  auto                roi_model = CreateRoiDetectionModel(model);
+  std::vector<BBox2D> results;
+  for (auto _ : state)
+  {
+    roi_model->Detect(image, rois, results, 0.4);
+  }
+  state.counters["images/sec"] =
+      benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["boxes"] = results.size();
+}
+
 #ifdef ENABLE_TENSORRT
 
 #include "trt_core/trt_core.hpp"
@@ -41,13 +161,37 @@ static void benchmark_detection_2d_yolov8_tensorrt_async(benchmark::State &state
 BENCHMARK(benchmark_detection_2d_yolov8_tensorrt_sync)->Arg(1000)->UseRealTime();
 BENCHMARK(benchmark_detection_2d_yolov8_tensorrt_async)->Arg(1000)->UseRealTime();
 
+std::shared_ptr<BaseBatchDetectionModel> CreateYolov8TensorRTBatchModel()
+{
+  const int max_batch_size = 8;
+  const int cls_number     = 80;
+  auto      infer_core_factory =
+      CreateTrtInferCoreFactory("/workspace/models/yolov8n_dynamic_batch.engine",
+                                {{"images", {max_batch_size, 3, 640, 640}}},
+                                {{"output0", {max_batch_size, 4 + cls_number, 8400}}});
+  return CreateYolov8DetectionModel(infer_core_factory->Create(), CreateCudaDetPreProcess(),
+                                    CreateYolov8PostProcessCpuOrigin(640, 640, cls_number), 640,
+                                    640, 3, cls_number, {"images"}, {"output0"});
+}
+
+static void benchmark_detection_2d_yolov8_tensorrt_batch(benchmark::State &state)
+{
+  benchmark_detection_2d_batch(state, CreateYolov8TensorRTBatchModel());
+}
+BENCHMARK(benchmark_detection_2d_yolov8_tensorrt_batch)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+
 #endif
 
 #ifdef ENABLE_ORT
 
 #include "ort_core/ort_core.hpp"
 
-std::shared_ptr<BaseDetectionModel> CreateYolov8OnnxRuntimeModel()
+std::shared_ptr<BaseDetectionModel> CreateYolov8OnnxRuntimeModel(
+    std::shared_ptr<IDetectionPreProcess> preprocess =
+        CreateCpuDetPreProcess({0, 0, 0}, {255, 255, 255}, true, true))
 {
   std::string                    model_path        = "/workspace/models/yolov8n.onnx";
   const int                      input_height      = 640;
@@ -58,7 +202,6 @@ std::shared_ptr<BaseDetectionModel> CreateYolov8OnnxRuntimeModel()
   const std::vector<std::string> output_blobs_name = {"output0"};
 
   auto infer_core  = CreateOrtInferCore(model_path);
-  auto preprocess  = CreateCpuDetPreProcess({0, 0, 0}, {255, 255, 255}, true, true);
   auto postprocess = CreateYolov8PostProcessCpuOrigin(input_height, input_width, cls_number);
 
   auto yolov8_model =
@@ -78,6 +221,106 @@ static void benchmark_detection_2d_yolov8_onnxruntime_async(benchmark::State &st
 BENCHMARK(benchmark_detection_2d_yolov8_onnxruntime_sync)->Arg(200)->UseRealTime();
 BENCHMARK(benchmark_detection_2d_yolov8_onnxruntime_async)->Arg(200)->UseRealTime();
 
+// the detector every `state.range(0)` frames of a video stream, the tracks predicted in between
+static void benchmark_detection_2d_yolov8_onnxruntime_tracked(benchmark::State &state)
+{
+  benchmark_detection_2d_tracked(state, CreateYolov8OnnxRuntimeModel());
+}
+BENCHMARK(benchmark_detection_2d_yolov8_onnxruntime_tracked)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(3)
+    ->Arg(5)
+    ->UseRealTime();
+
+// yolov8n exported at 320 escalating to the 640 one
+static void benchmark_detection_2d_yolov8_onnxruntime_cascade(benchmark::State &state)
+{
+  auto small_model = CreateYolov8DetectionModel(
+      CreateOrtInferCore("/workspace/models/yolov8n_320.onnx"), CreateFusedCpuDetPreProcess(),
+      CreateYolov8PostProcessCpuSimd(320, 320, 80), 320, 320, 3, 80, {"images"}, {"output0"});
+  benchmark_detection_2d_cascade(state, small_model,
+                                 CreateYolov8OnnxRuntimeModel(CreateFusedCpuDetPreProcess()));
+}
+BENCHMARK(benchmark_detection_2d_yolov8_onnxruntime_cascade)
+    ->Arg(30)
+    ->Arg(50)
+    ->Arg(70)
+    ->UseRealTime();
+
+// the same model with the fused letterbox/normalize/transpose preprocess
+static void benchmark_detection_2d_yolov8_onnxruntime_fused_preprocess_sync(
+    benchmark::State &state)
+{
+  benchmark_detection_2d_sync(state, CreateYolov8OnnxRuntimeModel(CreateFusedCpuDetPreProcess()));
+}
+BENCHMARK(benchmark_detection_2d_yolov8_onnxruntime_fused_preprocess_sync)
+    ->Arg(200)
+    ->UseRealTime();
+
+std::shared_ptr<BaseBatchDetectionModel> CreateYolov8OnnxRuntimeBatchModel()
+{
+  const int max_batch_size = 8;
+  const int cls_number     = 80;
+  auto      infer_core_factory =
+      CreateOrtInferCoreFactory("/workspace/models/yolov8n_dynamic_batch.onnx",
+                                {{"images", {max_batch_size, 3, 640, 640}}},
+                                {{"output0", {max_batch_size, 4 + cls_number, 8400}}});
+  return CreateYolov8DetectionModel(
+      infer_core_factory->Create(), CreateCpuDetPreProcess({0, 0, 0}, {255, 255, 255}, true, true),
+      CreateYolov8PostProcessCpuOrigin(640, 640, cls_number), 640, 640, 3, cls_number, {"images"},
+      {"output0"});
+}
+
+static void benchmark_detection_2d_yolov8_onnxruntime_batch(benchmark::State &state)
+{
+  benchmark_detection_2d_batch(state, CreateYolov8OnnxRuntimeBatchModel());
+}
+BENCHMARK(benchmark_detection_2d_yolov8_onnxruntime_batch)
+    ->RangeMultiplier(2)
+    ->Range(1, 8)
+    ->UseRealTime();
+
+// the tiles in batches of 8, read in place by the fused preprocess
+static void benchmark_detection_2d_yolov8_onnxruntime_tiled(benchmark::State &state)
+{
+  const int cls_number = 80;
+  auto      infer_core_factory =
+      CreateOrtInferCoreFactory("/workspace/models/yolov8n_dynamic_batch.onnx",
+                                {{"images", {8, 3, 640, 640}}},
+                                {{"output0", {8, 4 + cls_number, 8400}}});
+  benchmark_detection_2d_tiled(
+      state, CreateYolov8DetectionModel(infer_core_factory->Create(), CreateFusedCpuDetPreProcess(),
+                                        CreateYolov8PostProcessCpuSimd(640, 640, cls_number), 640,
+                                        640, 3, cls_number, {"images"}, {"output0"}));
+}
+BENCHMARK(benchmark_detection_2d_yolov8_onnxruntime_tiled)
+    ->Arg(320)
+    ->Arg(640)
+    ->Arg(960)
+    ->Arg(1280)
+    ->UseRealTime();
+
+// the regions in batches of 8, read in place by the fused preprocess
+static void benchmark_detection_2d_yolov8_onnxruntime_roi(benchmark::State &state)
+{
+  const int cls_number = 80;
+  auto      infer_core_factory =
+      CreateOrtInferCoreFactory("/workspace/models/yolov8n_dynamic_batch.onnx",
+                                {{"images", {8, 3, 640, 640}}},
+                                {{"output0", {8, 4 + cls_number, 8400}}});
+  benchmark_detection_2d_roi(
+      state, CreateYolov8DetectionModel(infer_core_factory->Create(), CreateFusedCpuDetPreProcess(),
+                                        CreateYolov8PostProcessCpuSimd(640, 640, cls_number), 640,
+                                        640, 3, cls_number, {"images"}, {"output0"}));
+}
+BENCHMARK(benchmark_detection_2d_yolov8_onnxruntime_roi)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->UseRealTime();
+
 #endif
 
 #ifdef ENABLE_RKNN
@@ -0,0 +1,272 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <random>
+#include <vector>
+
+#include "detection_2d_util/detection_2d_util.hpp"
+#include "detection_2d_yolov8/yolov8_divide_postprocess.hpp"
+#include "detection_2d_yolov8/yolov8_postprocess.hpp"
+
+using namespace easy_deploy;
+
+// yolov8n, 640x640 input : `output0` is {84, 8400}
+static constexpr int kClsNumber  = 80;
+static constexpr int kNumAnchors = 8400;
+
+// `output0` of yolov8n on `persons.jpg`, recorded by `tools/dump_yolov8_output.py`. Without the
+// recording, a synthetic output with a few confident anchors among low background scores.
+static const std::vector<float> &LoadRecordedOutput()
+{
+  static const std::vector<float> output = [] {
+    std::vector<float> output((4 + kClsNumber) * kNumAnchors);
+    std::ifstream      file("/workspace/test_data/yolov8n_output0.bin", std::ios::binary);
+    if (file.read(reinterpret_cast<char *>(output.data()), output.size() * sizeof(float)))
+    {
+      return output;
+    }
+    std::mt19937                          generator(0);
+    std::uniform_real_distribution<float> distribution(0.f, 1.f);
+    for (int i = 0; i < 4 * kNumAnchors; ++i)
+    {
+      output[i] = 10.f + 600.f * distribution(generator);
+    }
+    for (int i = 4 * kNumAnchors; i < (4 + kClsNumber) * kNumAnchors; ++i)
+    {
+      output[i] = 0.02f * distribution(generator);
+    }
+    for (int k = 0; k < 300; ++k)
+    {
+      const int anchor                         = generator() % kNumAnchors;
+      const int cls                            = generator() % kClsNumber;
+      output[(4 + cls) * kNumAnchors + anchor] = 0.2f + 0.8f * distribution(generator);
+    }
+    return output;
+  }();
+  return output;
+}
+
+// `state.range(0)` is the confidence threshold in percent
+static void benchmark_yolov8_decode_naive(benchmark::State &state)
+{
+  const auto                     &output = LoadRecordedOutput();
+  std::vector<DetectionCandidate> candidates(kNumAnchors);
+  size_t                          num_candidates = 0;
+  for (auto _ : state)
+  {
+    num_candidates = DecodeYolov8CandidatesNaive(output.data(), kNumAnchors, kClsNumber,
+                                                 state.range(0) / 100.f, false, candidates.data());
+    benchmark::DoNotOptimize(candidates.data());
+  }
+  state.counters["candidates"] = num_candidates;
+}
+
+// `state.range(1)` is the number of classes read : 80 takes the specialized loops, 79 the generic
+// ones over nearly the same data
+static void benchmark_yolov8_decode_simd(benchmark::State &state)
+{
+  const auto                     &output = LoadRecordedOutput();
+  std::vector<DetectionCandidate> candidates(kNumAnchors);
+  size_t                          num_candidates = 0;
+  for (auto _ : state)
+  {
+    num_candidates = DecodeYolov8Candidates(output.data(), kNumAnchors, state.range(1),
+                                            state.range(0) / 100.f, false, candidates.data());
+    benchmark::DoNotOptimize(candidates.data());
+  }
+  state.counters["candidates"] = num_candidates;
+}
+
+// the whole postprocess, decoding and NMS
+static void benchmark_yolov8_postprocess(benchmark::State                      &state,
+                                         std::shared_ptr<IDetectionPostProcess> postprocess)
+{
+  const auto         &output = LoadRecordedOutput();
+  std::vector<BBox2D> results;
+  for (auto _ : state)
+  {
+    postprocess->Postprocess({const_cast<float *>(output.data())}, results,
+                             state.range(0) / 100.f, 1.f);
+    benchmark::DoNotOptimize(results.data());
+  }
+  state.counters["boxes"] = results.size();
+}
+
+static void benchmark_yolov8_postprocess_cpu_origin(benchmark::State &state)
+{
+  benchmark_yolov8_postprocess(state, CreateYolov8PostProcessCpuOrigin(640, 640, kClsNumber));
+}
+
+static void benchmark_yolov8_postprocess_cpu_simd(benchmark::State &state)
+{
+  benchmark_yolov8_postprocess(state, CreateYolov8PostProcessCpuSimd(640, 640, kClsNumber));
+}
+
+// The rknn "divide" export of yolov8n at 640x640, `{box, cls, sum}` per stride of {8, 16, 32}, as
+// int8 with the quantization of the model outputs, and dequantized to float by the runtime. A
+// synthetic output : low background scores, and a few hundred scoring cells.
+struct DivideOutputs {
+  std::vector<std::vector<int8_t>> int8_outputs;
+  std::vector<std::vector<float>>  float_outputs;
+  std::vector<Int8QuantParams>     quant_params;
+  std::vector<void *>              int8_ptrs;
+  std::vector<void *>              float_ptrs;
+};
+
+static DivideOutputs &GenerateDivideOutputs()
+{
+  static DivideOutputs outputs = [] {
+    const Int8QuantParams box_quant{-10, 0.08f}, cls_quant{-128, 1.f / 255},
+        sum_quant{-128, 1.f / 255};
+    auto quantize = [](float value, const Int8QuantParams &quant) {
+      return static_cast<int8_t>(
+          std::max(-128.f, std::min(127.f, std::round(value / quant.scale) + quant.zero_point)));
+    };
+
+    DivideOutputs                         outputs;
+    std::mt19937                          generator(0);
+    std::uniform_real_distribution<float> distribution(0.f, 1.f);
+    for (const int stride : {8, 16, 32})
+    {
+      const int           hw = (640 / stride) * (640 / stride);
+      std::vector<int8_t> box(64 * hw), sum(hw);
+      std::vector<float>  scores(kClsNumber * hw);
+      for (auto &q : box)
+      {
+        q = static_cast<int8_t>(static_cast<int>(generator() % 256) - 128);
+      }
+      for (auto &score : scores)
+      {
+        score = 0.002f * distribution(generator);
+      }
+      for (int k = 0; k < 100; ++k)
+      {
+        scores[generator() % scores.size()] = 0.2f + 0.8f * distribution(generator);
+      }
+      for (int cell = 0; cell < hw; ++cell)
+      {
+        float total = 0.f;
+        for (int c = 0; c < kClsNumber; ++c)
+        {
+          total += scores[c * hw + cell];
+        }
+        sum[cell] = quantize(std::min(total, 1.f), sum_quant);
+      }
+      std::vector<int8_t> cls(scores.size());
+      for (size_t i = 0; i < scores.size(); ++i)
+      {
+        cls[i] = quantize(scores[i], cls_quant);
+      }
+      outputs.int8_outputs.push_back(std::move(box));
+      outputs.int8_outputs.push_back(std::move(cls));
+      outputs.int8_outputs.push_back(std::move(sum));
+      outputs.quant_params.insert(outputs.quant_params.end(), {box_quant, cls_quant, sum_quant});
+    }
+    for (size_t i = 0; i < outputs.int8_outputs.size(); ++i)
+    {
+      std::vector<float> dequantized;
+      for (const int8_t q : outputs.int8_outputs[i])
+      {
+        dequantized.push_back(Dequantize(q, outputs.quant_params[i]));
+      }
+      outputs.float_outputs.push_back(std::move(dequantized));
+    }
+    for (size_t i = 0; i < outputs.int8_outputs.size(); ++i)
+    {
+      outputs.int8_ptrs.push_back(outputs.int8_outputs[i].data());
+      outputs.float_ptrs.push_back(outputs.float_outputs[i].data());
+    }
+    return outputs;
+  }();
+  return outputs;
+}
+
+// `state.range(0)` is the confidence threshold in percent
+static void benchmark_yolov8_divide_decode_float(benchmark::State &state)
+{
+  auto                           &outputs = GenerateDivideOutputs();
+  Yolov8DivideDecoder             decoder(640, 640, kClsNumber, {8, 16, 32});
+  std::vector<DetectionCandidate> candidates(decoder.GetNumAnchors());
+  size_t                          num_candidates = 0;
+  for (auto _ : state)
+  {
+    num_candidates =
+        decoder.DecodeFloat(outputs.float_ptrs, state.range(0) / 100.f, candidates.data());
+    benchmark::DoNotOptimize(candidates.data());
+  }
+  state.counters["candidates"] = num_candidates;
+}
+
+// `state.range(1)` is the number of classes read, as in `benchmark_yolov8_decode_simd`
+static void benchmark_yolov8_divide_decode_int8(benchmark::State &state)
+{
+  auto                           &outputs = GenerateDivideOutputs();
+  Yolov8DivideDecoder             decoder(640, 640, state.range(1), {8, 16, 32},
+                                          outputs.quant_params);
+  std::vector<DetectionCandidate> candidates(decoder.GetNumAnchors());
+  size_t                          num_candidates = 0;
+  for (auto _ : state)
+  {
+    num_candidates = decoder.Decode(outputs.int8_ptrs, state.range(0) / 100.f, candidates.data());
+    benchmark::DoNotOptimize(candidates.data());
+  }
+  state.counters["candidates"] = num_candidates;
+}
+
+// the whole postprocess, the float one on the dequantized outputs
+static void benchmark_yolov8_divide_postprocess(benchmark::State                      &state,
+                                                std::shared_ptr<IDetectionPostProcess> postprocess,
+                                                const std::vector<void *>             &outputs)
+{
+  std::vector<BBox2D> results;
+  for (auto _ : state)
+  {
+    postprocess->Postprocess(outputs, results, state.range(0) / 100.f, 1.f);
+    benchmark::DoNotOptimize(results.data());
+  }
+  state.counters["boxes"] = results.size();
+}
+
+static void benchmark_yolov8_postprocess_cpu_divide(benchmark::State &state)
+{
+  benchmark_yolov8_divide_postprocess(state, CreateYolov8PostProcessCpuDivide(640, 640, kClsNumber),
+                                      GenerateDivideOutputs().float_ptrs);
+}
+
+static void benchmark_yolov8_postprocess_cpu_divide_int8(benchmark::State &state)
+{
+  auto &outputs = GenerateDivideOutputs();
+  benchmark_yolov8_divide_postprocess(
+      state, CreateYolov8PostProcessCpuDivideInt8(640, 640, kClsNumber, outputs.quant_params),
+      outputs.int8_ptrs);
+}
+
+BENCHMARK(benchmark_yolov8_decode_naive)->Arg(5)->Arg(25)->Arg(40)->Arg(70)->UseRealTime();
+BENCHMARK(benchmark_yolov8_decode_simd)->ArgsProduct({{5, 25, 40, 70}, {80, 79}})->UseRealTime();
+BENCHMARK(benchmark_yolov8_postprocess_cpu_origin)
+    ->Arg(5)
+    ->Arg(25)
+    ->Arg(40)
+    ->Arg(70)
+    ->UseRealTime();
+BENCHMARK(benchmark_yolov8_postprocess_cpu_simd)->Arg(5)->Arg(25)->Arg(40)->Arg(70)->UseRealTime();
+BENCHMARK(benchmark_yolov8_divide_decode_float)->Arg(5)->Arg(25)->Arg(40)->Arg(70)->UseRealTime();
+BENCHMARK(benchmark_yolov8_divide_decode_int8)
+    ->ArgsProduct({{5, 25, 40, 70}, {80, 79}})
+    ->UseRealTime();
+BENCHMARK(benchmark_yolov8_postprocess_cpu_divide)
+    ->Arg(5)
+    ->Arg(25)
+    ->Arg(40)
+    ->Arg(70)
+    ->UseRealTime();
+BENCHMARK(benchmark_yolov8_postprocess_cpu_divide_int8)
+    ->Arg(5)
+    ->Arg(25)
+    ->Arg(40)
+    ->Arg(70)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "deploy_core/base_detection.hpp"
+
+namespace easy_deploy {
+
+// The coco helpers of the standalone evals, which run a model `eval_utils` does not take : the
+// annotations read by `cv::FileStorage`, and the coco mAP of the detections.
+
+inline const std::string kCocoEvalDirPath = "/workspace/test_data/coco2017/coco2017_val";
+inline const std::string kCocoAnnotationsPath =
+    "/workspace/test_data/coco2017/coco2017_annotations/instances_val2017.json";
+
+struct CocoImage {
+  std::string         file_name;
+  std::vector<BBox2D> objects;
+  // the `iscrowd` objects, regions where the detections are neither true nor false positives
+  std::vector<BBox2D> crowds;
+};
+
+// the objects of every image, the coco category ids mapped to the 80 contiguous classes
+inline std::vector<CocoImage> LoadCocoAnnotations(const std::string &path)
+{
+  cv::FileStorage fs(path, cv::FileStorage::READ | cv::FileStorage::FORMAT_JSON);
+  if (!fs.isOpened())
+  {
+    throw std::runtime_error("[LoadCocoAnnotations] Failed to open " + path);
+  }
+
+  std::vector<int> category_ids;
+  for (const auto &category : fs["categories"])
+  {
+    category_ids.push_back(static_cast<int>(category["id"]));
+  }
+  std::sort(category_ids.begin(), category_ids.end());
+
+  std::vector<CocoImage> images;
+  std::map<int, size_t>  image_index;
+  for (const auto &image : fs["images"])
+  {
+    image_index[static_cast<int>(image["id"])] = images.size();
+    images.push_back({static_cast<std::string>(image["file_name"]), {}, {}});
+  }
+
+  for (const auto &annotation : fs["annotations"])
+  {
+    const auto category = std::lower_bound(category_ids.begin(), category_ids.end(),
+                                           static_cast<int>(annotation["category_id"]));
+    const auto bbox     = annotation["bbox"];
+    BBox2D     object;
+    object.w    = static_cast<float>(bbox[2]);
+    object.h    = static_cast<float>(bbox[3]);
+    object.x    = static_cast<float>(bbox[0]) + object.w / 2;
+    object.y    = static_cast<float>(bbox[1]) + object.h / 2;
+    object.cls  = static_cast<float>(category - category_ids.begin());
+    object.conf = 1.f;
+    auto &coco_image = images[image_index[static_cast<int>(annotation["image_id"])]];
+    if (static_cast<int>(annotation["iscrowd"]) != 0)
+    {
+      coco_image.crowds.push_back(object);
+    } else
+    {
+      coco_image.objects.push_back(object);
+    }
+  }
+  return images;
+}
+
+inline float BoxIoU(const BBox2D &a, const BBox2D &b)
+{
+  const float inter_w = std::max(
+      0.f, std::min(a.x + a.w / 2, b.x + b.w / 2) - std::max(a.x - a.w / 2, b.x - b.w / 2));
+  const float inter_h = std::max(
+      0.f, std::min(a.y + a.h / 2, b.y + b.h / 2) - std::max(a.y - a.h / 2, b.y - b.h / 2));
+  const float inter = inter_w * inter_h;
+  return inter / (a.w * a.h + b.w * b.h - inter);
+}
+
+// the overlap of `detection` with a crowd region, over the area of the detection only, as coco
+inline float CrowdOverlap(const BBox2D &crowd, const BBox2D &detection)
+{
+  const BBox2D &a       = crowd;
+  const BBox2D &b       = detection;
+  const float   inter_w = std::max(
+      0.f, std::min(a.x + a.w / 2, b.x + b.w / 2) - std::max(a.x - a.w / 2, b.x - b.w / 2));
+  const float inter_h = std::max(
+      0.f, std::min(a.y + a.h / 2, b.y + b.h / 2) - std::max(a.y - a.h / 2, b.y - b.h / 2));
+  return inter_w * inter_h / (b.w * b.h);
+}
+
+/**
+ * @brief The coco mAP over the IoU thresholds 0.5:0.05:0.95, by 101 points interpolated precision.
+ * The detections of an image are matched by descending confidence to the best unmatched object of
+ * their class. Unmatched detections on a crowd region of their class are ignored, as the official
+ * tool does. Unlike the official tool, it keeps every detection, not only the first 100.
+ *
+ */
+class CocoMapEvaluator {
+public:
+  static constexpr int kIoUThreshNum = 10;
+
+  void AddImage(const std::vector<BBox2D> &objects,
+                std::vector<BBox2D>        detections,
+                const std::vector<BBox2D> &crowds = {})
+  {
+    std::sort(detections.begin(), detections.end(),
+              [](const BBox2D &a, const BBox2D &b) { return a.conf > b.conf; });
+    for (const auto &object : objects)
+    {
+      classes_[static_cast<int>(object.cls)].objects += 1;
+    }
+    std::array<std::vector<bool>, kIoUThreshNum> matched;
+    matched.fill(std::vector<bool>(objects.size(), false));
+    for (const auto &detection : detections)
+    {
+      Detection record;
+      record.conf = detection.conf;
+      for (int t = 0; t < kIoUThreshNum; ++t)
+      {
+        int   best     = -1;
+        float best_iou = IoUThresh(t);
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+          if (matched[t][i] || objects[i].cls != detection.cls)
+          {
+            continue;
+          }
+          const float iou = BoxIoU(objects[i], detection);
+          if (iou >= best_iou)
+          {
+            best     = static_cast<int>(i);
+            best_iou = iou;
+          }
+        }
+        if (best >= 0)
+        {
+          matched[t][best]        = true;
+          record.true_positive[t] = true;
+          continue;
+        }
+        // a crowd region matches any number of detections
+        for (const auto &crowd : crowds)
+        {
+          if (crowd.cls == detection.cls && CrowdOverlap(crowd, detection) >= IoUThresh(t))
+          {
+            record.ignored[t] = true;
+            break;
+          }
+        }
+      }
+      classes_[static_cast<int>(detection.cls)].detections.push_back(record);
+    }
+  }
+
+  /**
+   * @brief The mAP at the IoU thresholds `[first, last)` of 0.5:0.05:0.95, over the classes with
+   * objects.
+   *
+   */
+  float MeanAP(int first = 0, int last = kIoUThreshNum)
+  {
+    double sum = 0;
+    int    num = 0;
+    for (auto &entry : classes_)
+    {
+      auto &cls = entry.second;
+      if (cls.objects == 0)
+      {
+        continue;
+      }
+      std::stable_sort(cls.detections.begin(), cls.detections.end(),
+                       [](const Detection &a, const Detection &b) { return a.conf > b.conf; });
+      for (int t = first; t < last; ++t)
+      {
+        sum += AveragePrecision(cls, t);
+        num += 1;
+      }
+    }
+    return num == 0 ? 0.f : static_cast<float>(sum / num);
+  }
+
+private:
+  struct Detection {
+    float                           conf = 0.f;
+    std::array<bool, kIoUThreshNum> true_positive{};
+    std::array<bool, kIoUThreshNum> ignored{};
+  };
+
+  struct ClassRecords {
+    size_t                 objects = 0;
+    std::vector<Detection> detections;
+  };
+
+  static float IoUThresh(int t)
+  {
+    return 0.5f + 0.05f * t;
+  }
+
+  static double AveragePrecision(const ClassRecords &cls, int t)
+  {
+    std::vector<double> recall, precision;
+    size_t              true_positives = 0, positives = 0;
+    for (const auto &detection : cls.detections)
+    {
+      if (detection.ignored[t])
+      {
+        continue;
+      }
+      true_positives += detection.true_positive[t];
+      positives += 1;
+      recall.push_back(static_cast<double>(true_positives) / cls.objects);
+      precision.push_back(static_cast<double>(true_positives) / positives);
+    }
+    // the precision envelope, sampled at the recalls 0:0.01:1
+    for (int i = static_cast<int>(precision.size()) - 2; i >= 0; --i)
+    {
+      precision[i] = std::max(precision[i], precision[i + 1]);
+    }
+    double sum = 0;
+    for (int r = 0; r <= 100; ++r)
+    {
+      const auto it = std::lower_bound(recall.begin(), recall.end(), r / 100.);
+      if (it != recall.end())
+      {
+        sum += precision[it - recall.begin()];
+      }
+    }
+    return sum / 101;
+  }
+
+private:
+  std::map<int, ClassRecords> classes_;
+};
+
+} // namespace easy_deploy
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "detection_2d_common/cascade_detection.hpp"
+#include "detection_2d_common/fused_preprocess.hpp"
+#include "detection_2d_util/detection_2d_util.hpp"
+#include "detection_2d_yolov8/yolov8.hpp"
+#include "detection_2d_yolov8/yolov8_postprocess.hpp"
+
+#include "coco_eval_utils.hpp"
+
+using namespace easy_deploy;
+
+// mAP and throughput of `BaseCascadeDetectionModel` on coco2017 val, yolov8n at 320 escalating to
+// yolov8n at 640, against the escalation thresholds. The two models alone are the bounds.
+//
+// usage : eval_detection_2d_yolov8_cascade [max_images]
+
+static constexpr float kConfThresh = 0.01f;
+
+struct CascadeSetting {
+  float ambiguous_conf_low;
+  float ambiguous_conf_high;
+  int   max_ambiguous_num;
+};
+static const std::vector<CascadeSetting> kCascadeSettings = {
+    {0.1f, 0.5f, 0}, {0.25f, 0.5f, 0}, {0.25f, 0.5f, 2}, {0.3f, 0.6f, 4}};
+
+#if defined(ENABLE_TENSORRT)
+
+#include "trt_core/trt_core.hpp"
+
+static std::shared_ptr<BaseDetectionModel> CreateEvalModel(int input_size)
+{
+  const std::string model_path = input_size == 640 ? "/workspace/models/yolov8n.engine"
+                                                   : "/workspace/models/yolov8n_320.engine";
+  return CreateYolov8DetectionModel(CreateTrtInferCore(model_path), CreateCudaDetPreProcess(),
+                                    CreateYolov8PostProcessCpuSimd(input_size, input_size, 80),
+                                    input_size, input_size, 3, 80, {"images"}, {"output0"});
+}
+
+#elif defined(ENABLE_ORT)
+
+#include "ort_core/ort_core.hpp"
+
+static std::shared_ptr<BaseDetectionModel> CreateEvalModel(int input_size)
+{
+  const std::string model_path = input_size == 640 ? "/workspace/models/yolov8n.onnx"
+                                                   : "/workspace/models/yolov8n_320.onnx";
+  return CreateYolov8DetectionModel(CreateOrtInferCore(model_path), CreateFusedCpuDetPreProcess(),
+                                    CreateYolov8PostProcessCpuSimd(input_size, input_size, 80),
+                                    input_size, input_size, 3, 80, {"images"}, {"output0"});
+}
+
+#else
+
+static std::shared_ptr<BaseDetectionModel> CreateEvalModel(int)
+{
+  return nullptr;
+}
+
+#endif
+
+struct EvalResult {
+  double images_per_sec = 0;
+  float  map            = 0;
+  float  map50          = 0;
+};
+
+// runs `detect` on every image, the throughput and the mAP
+template <typename DetectFunc>
+static EvalResult EvalDetection(const std::vector<CocoImage> &images, DetectFunc &&detect)
+{
+  CocoMapEvaluator evaluator;
+  double           detect_seconds = 0;
+  size_t           images_num     = 0;
+  for (const auto &image : images)
+  {
+    const cv::Mat input = cv::imread(kCocoEvalDirPath + "/" + image.file_name);
+    if (input.empty())
+    {
+      continue;
+    }
+    std::vector<BBox2D> results;
+    const auto          begin = std::chrono::steady_clock::now();
+    detect(input, results);
+    detect_seconds +=
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    evaluator.AddImage(image.objects, results, image.crowds);
+    images_num += 1;
+  }
+
+  EvalResult result;
+  result.images_per_sec = images_num / std::max(detect_seconds, 1e-9);
+  result.map            = evaluator.MeanAP();
+  result.map50          = evaluator.MeanAP(0, 1);
+  return result;
+}
+
+static void PrintEvalResult(const std::string &name, const EvalResult &result, float escalation)
+{
+  printf("%-28s %10.2f %10.4f %10.4f %12.3f\n", name.c_str(), result.images_per_sec, result.map,
+         result.map50, escalation);
+}
+
+int main(int argc, char **argv)
+{
+  auto small_model = CreateEvalModel(320);
+  auto large_model = CreateEvalModel(640);
+  if (small_model == nullptr || large_model == nullptr)
+  {
+    printf("eval_detection_2d_yolov8_cascade needs tensorrt or onnxruntime!\n");
+    return 1;
+  }
+  auto images = LoadCocoAnnotations(kCocoAnnotationsPath);
+  if (argc > 1)
+  {
+    images.resize(std::min(images.size(), static_cast<size_t>(std::stoul(argv[1]))));
+  }
+
+  printf("%-28s %10s %10s %10s %12s\n", "model", "images/s", "mAP", "mAP50", "escalation");
+  PrintEvalResult("yolov8n_320",
+                  EvalDetection(images,
+                                [&](const cv::Mat &input, std::vector<BBox2D> &results) {
+                                  small_model->Detect(input, results, kConfThresh);
+                                }),
+                  0.f);
+  PrintEvalResult("yolov8n_640",
+                  EvalDetection(images,
+                                [&](const cv::Mat &input, std::vector<BBox2D> &results) {
+                                  large_model->Detect(input, results, kConfThresh);
+                                }),
+                  1.f);
+
+  for (const auto &setting : kCascadeSettings)
+  {
+    CascadeDetectionConfig config;
+    config.ambiguous_conf_low  = setting.ambiguous_conf_low;
+    config.ambiguous_conf_high = setting.ambiguous_conf_high;
+    config.max_ambiguous_num   = setting.max_ambiguous_num;
+    auto cascade_model         = CreateCascadeDetectionModel(small_model, large_model, config);
+
+    const auto result =
+        EvalDetection(images, [&](const cv::Mat &input, std::vector<BBox2D> &results) {
+          cascade_model->Detect(input, results, kConfThresh);
+        });
+    char name[64];
+    snprintf(name, sizeof(name), "cascade[%.2f,%.2f)>%d", setting.ambiguous_conf_low,
+             setting.ambiguous_conf_high, setting.max_ambiguous_num);
+    PrintEvalResult(name, result, cascade_model->GetStats().EscalationRate());
+  }
+  return 0;
+}
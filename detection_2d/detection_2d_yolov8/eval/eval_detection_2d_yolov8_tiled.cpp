@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "detection_2d_common/fused_preprocess.hpp"
+#include "detection_2d_common/tiled_detection.hpp"
+#include "detection_2d_util/detection_2d_util.hpp"
+#include "detection_2d_yolov8/yolov8.hpp"
+#include "detection_2d_yolov8/yolov8_postprocess.hpp"
+
+#include "coco_eval_utils.hpp"
+
+using namespace easy_deploy;
+
+// Recall and throughput of `BaseTiledDetectionModel` against the tile size on coco2017 val, the
+// tile size 0 is the plain letterboxed detection. The detections of an image are matched greedily
+// to the objects of their class at IoU 0.5.
+//
+// usage : eval_detection_2d_yolov8_tiled [max_images]
+
+static const std::vector<int> kTileSizes  = {0, 480, 320, 256};
+static constexpr float        kConfThresh = 0.25f;
+static constexpr float        kMatchIoU   = 0.5f;
+// coco small objects, by their box area here
+static constexpr float kSmallObjArea = 32 * 32;
+
+struct RecallCounter {
+  size_t objects       = 0;
+  size_t found         = 0;
+  size_t small_objects = 0;
+  size_t small_found   = 0;
+  size_t detections    = 0;
+};
+
+// `detections` by descending confidence, each one takes the best unmatched object of its class
+static void MatchDetections(const std::vector<BBox2D> &objects,
+                            const std::vector<BBox2D> &detections,
+                            RecallCounter             &counter)
+{
+  std::vector<bool> matched(objects.size(), false);
+  for (const auto &detection : detections)
+  {
+    int   best     = -1;
+    float best_iou = kMatchIoU;
+    for (size_t i = 0; i < objects.size(); ++i)
+    {
+      if (matched[i] || objects[i].cls != detection.cls)
+      {
+        continue;
+      }
+      const float iou = BoxIoU(objects[i], detection);
+      if (iou >= best_iou)
+      {
+        best     = static_cast<int>(i);
+        best_iou = iou;
+      }
+    }
+    if (best >= 0)
+    {
+      matched[best] = true;
+    }
+  }
+
+  for (size_t i = 0; i < objects.size(); ++i)
+  {
+    const bool small = objects[i].w * objects[i].h < kSmallObjArea;
+    counter.objects += 1;
+    counter.found += matched[i];
+    counter.small_objects += small;
+    counter.small_found += small && matched[i];
+  }
+  counter.detections += detections.size();
+}
+
+#if defined(ENABLE_TENSORRT)
+
+#include "trt_core/trt_core.hpp"
+
+static std::shared_ptr<BaseBatchDetectionModel> CreateEvalModel()
+{
+  const int max_batch_size = 8;
+  const int cls_number     = 80;
+  auto      infer_core_factory =
+      CreateTrtInferCoreFactory("/workspace/models/yolov8n_dynamic_batch.engine",
+                                {{"images", {max_batch_size, 3, 640, 640}}},
+                                {{"output0", {max_batch_size, 4 + cls_number, 8400}}});
+  return CreateYolov8DetectionModel(infer_core_factory->Create(), CreateCudaDetPreProcess(),
+                                    CreateYolov8PostProcessCpuSimd(640, 640, cls_number), 640, 640,
+                                    3, cls_number, {"images"}, {"output0"});
+}
+
+#elif defined(ENABLE_ORT)
+
+#include "ort_core/ort_core.hpp"
+
+static std::shared_ptr<BaseBatchDetectionModel> CreateEvalModel()
+{
+  const int max_batch_size = 8;
+  const int cls_number     = 80;
+  auto      infer_core_factory =
+      CreateOrtInferCoreFactory("/workspace/models/yolov8n_dynamic_batch.onnx",
+                                {{"images", {max_batch_size, 3, 640, 640}}},
+                                {{"output0", {max_batch_size, 4 + cls_number, 8400}}});
+  // the fused preprocess reads the tiles in place
+  return CreateYolov8DetectionModel(infer_core_factory->Create(), CreateFusedCpuDetPreProcess(),
+                                    CreateYolov8PostProcessCpuSimd(640, 640, cls_number), 640, 640,
+                                    3, cls_number, {"images"}, {"output0"});
+}
+
+#else
+
+static std::shared_ptr<BaseBatchDetectionModel> CreateEvalModel()
+{
+  return nullptr;
+}
+
+#endif
+
+int main(int argc, char **argv)
+{
+  auto model = CreateEvalModel();
+  if (model == nullptr)
+  {
+    printf("eval_detection_2d_yolov8_tiled needs tensorrt or onnxruntime!\n");
+    return 1;
+  }
+  auto images = LoadCocoAnnotations(kCocoAnnotationsPath);
+  if (argc > 1)
+  {
+    images.resize(std::min(images.size(), static_cast<size_t>(std::stoul(argv[1]))));
+  }
+
+  printf("%10s %10s %12s %12s %12s\n", "tile_size", "images/s", "recall", "small_recall",
+         "dets/image");
+  for (const int tile_size : kTileSizes)
+  {
+    TiledDetectionConfig config;
+    config.tile_height = tile_size;
+    config.tile_width  = tile_size;
+
+    auto          tiled_model = tile_size > 0 ? CreateTiledDetectionModel(model, config) : nullptr;
+    RecallCounter counter;
+    double        detect_seconds = 0;
+    for (const auto &image : images)
+    {
+      const cv::Mat input = cv::imread(kCocoEvalDirPath + "/" + image.file_name);
+      if (input.empty())
+      {
+        continue;
+      }
+      std::vector<std::vector<BBox2D>> results(1);
+      const auto                       begin = std::chrono::steady_clock::now();
+      if (tiled_model != nullptr)
+      {
+        tiled_model->Detect(input, results[0], kConfThresh);
+      } else
+      {
+        model->DetectBatch({input}, results, kConfThresh);
+      }
+      detect_seconds +=
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+      MatchDetections(image.objects, results[0], counter);
+    }
+
+    printf("%10d %10.2f %12.4f %12.4f %12.2f\n", tile_size, images.size() / detect_seconds,
+           static_cast<double>(counter.found) / std::max<size_t>(counter.objects, 1),
+           static_cast<double>(counter.small_found) / std::max<size_t>(counter.small_objects, 1),
+           static_cast<double>(counter.detections) / std::max<size_t>(images.size(), 1));
+  }
+  return 0;
+}
@@ -2,6 +2,7 @@
 
 #include "deploy_core/base_detection.hpp"
 #include "deploy_core/base_infer_core.hpp"
+#include "detection_2d_common/batch_detection.hpp"
 
 namespace easy_deploy {
 
@@ -18,9 +19,10 @@ namespace easy_deploy {
  * @param input_blob_name
  * @param output_blob_name
  * @param downsample_scales
- * @return std::shared_ptr<BaseDetectionModel>
+ * @return std::shared_ptr<BaseBatchDetectionModel> Batches up to the batch dimension of the
+ * `infer_core` input blob in `DetectBatch`.
  */
-std::shared_ptr<BaseDetectionModel> CreateYolov8DetectionModel(
+std::shared_ptr<BaseBatchDetectionModel> CreateYolov8DetectionModel(
     const std::shared_ptr<BaseInferCore>         &infer_core,
     const std::shared_ptr<IDetectionPreProcess>  &preprocess_block,
     const std::shared_ptr<IDetectionPostProcess> &postprocess_block,
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "deploy_core/base_detection.hpp"
+#include "detection_2d_common/nms.hpp"
+#include "detection_2d_yolov8/yolov8_postprocess.hpp"
+
+namespace easy_deploy {
+
+/**
+ * @brief The affine quantization of an int8 tensor, `real = (q - zero_point) * scale`, as given by
+ * the output attributes of the rknn model (`rknn_tensor_attr::zp` and `rknn_tensor_attr::scale`).
+ *
+ */
+struct Int8QuantParams {
+  int32_t zero_point = 0;
+  float   scale      = 1.f;
+};
+
+inline float Dequantize(int8_t value, const Int8QuantParams &quant)
+{
+  return static_cast<float>(value - quant.zero_point) * quant.scale;
+}
+
+/**
+ * @brief `thresh` in the int8 domain : the lowest value which `Dequantize` maps to `thresh` or
+ * more, so that `q >= QuantizeThreshold(thresh, quant)` and `Dequantize(q, quant) >= thresh` agree
+ * for every `q`.
+ *
+ * @param thresh
+ * @param quant
+ * @return int In `[-128, 128]`, 128 if no int8 value reaches `thresh`.
+ */
+int QuantizeThreshold(float thresh, const Int8QuantParams &quant);
+
+/**
+ * @brief Decoder of the "divide" yolov8 export of rknn. Its outputs are NCHW, three per stride of
+ * `downsample_scales`, in this order :
+ *  - the box distributions `{4 * 16, h, w}`, 16 bins for each of the left/top/right/bottom sides;
+ *  - the class scores after the sigmoid, `{cls_number, h, w}`;
+ *  - the sum of the class scores clipped to 1 (the `ReduceSum` head), `{1, h, w}`.
+ * The anchors are tabulated from `downsample_scales` at construction, and the loops specialized for
+ * the 80 classes of coco.
+ *
+ */
+class Yolov8DivideDecoder {
+public:
+  /**
+   * @brief Construct a new Yolov8DivideDecoder object.
+   *
+   * @param input_height
+   * @param input_width
+   * @param cls_number
+   * @param downsample_scales
+   * @param quant_params One per output, in the order of the outputs. Only needed by `Decode`, not
+   * by `DecodeFloat`.
+   */
+  Yolov8DivideDecoder(int                                 input_height,
+                      int                                 input_width,
+                      int                                 cls_number,
+                      const std::vector<int>             &downsample_scales,
+                      const std::vector<Int8QuantParams> &quant_params = {});
+
+  /**
+   * @brief Decode the int8 outputs : the scores are compared to the thresholds converted to the
+   * int8 domain, the cells whose score sum is below the lowest threshold are skipped before their
+   * classes are read, and only the kept anchors are dequantized, their box distributions through a
+   * table of exponentials. Not thread-safe.
+   *
+   * @param outputs The int8 outputs, in the order of the model.
+   * @param conf_thresh
+   * @param candidates Pre-sized to `GetNumAnchors()` at least, filled in the anchor order, in the
+   * model input coordinates.
+   * @param class_conf_thresh `cls_number` thresholds used instead of `conf_thresh` if not null, as
+   * given by `NmsEngine::ClassThreshold`.
+   * @return size_t The number of candidates written.
+   */
+  size_t Decode(const std::vector<void *> &outputs,
+                float                      conf_thresh,
+                DetectionCandidate        *candidates,
+                const float               *class_conf_thresh = nullptr);
+
+  /**
+   * @brief Decode the float outputs, as dequantized by the runtime : every class score of every
+   * cell is read, and the grid recomputed per anchor. Kept as reference for tests and benchmarks.
+   *
+   */
+  size_t DecodeFloat(const std::vector<void *> &outputs,
+                     float                      conf_thresh,
+                     DetectionCandidate        *candidates,
+                     const float               *class_conf_thresh = nullptr) const;
+
+  int GetNumAnchors() const
+  {
+    return grid_.GetNumAnchors();
+  }
+
+private:
+  const int              cls_number_;
+  const Yolov8AnchorGrid grid_;
+
+  std::vector<Int8QuantParams> quant_params_;
+  // `exp(-d * scale)` of the box output of each level, `d` being the distance of a bin to the
+  // largest bin of its side in the int8 domain
+  std::vector<std::vector<float>> exp_tables_;
+  // the class thresholds of a call in the int8 domain of each level
+  std::vector<int> class_q_thresh_;
+};
+
+/**
+ * @brief Create a cpu postprocess of the int8 outputs of the rknn "divide" yolov8 export, decoded
+ * with `Yolov8DivideDecoder::Decode` into a buffer allocated once, then filtered by `NmsEngine`. An
+ * alternative to `CreateYolov8PostProcessCpuDivide` for an infer core handing out the raw int8
+ * outputs instead of dequantizing them to float.
+ *
+ * @param input_height
+ * @param input_width
+ * @param cls_number
+ * @param quant_params The quantization of every output, in the order of the outputs.
+ * @param nms_config The class thresholds of the config also reject the anchors while decoding.
+ * @param downsample_scales The strides of the heads, three outputs each.
+ * @return std::shared_ptr<IDetectionPostProcess>
+ */
+std::shared_ptr<IDetectionPostProcess> CreateYolov8PostProcessCpuDivideInt8(
+    int                                 input_height,
+    int                                 input_width,
+    int                                 cls_number,
+    const std::vector<Int8QuantParams> &quant_params,
+    const NmsConfig                    &nms_config        = NmsConfig(),
+    const std::vector<int>             &downsample_scales = {8, 16, 32});
+
+std::shared_ptr<BaseDetectionPostprocessFactory> CreateYolov8PostProcessCpuDivideInt8Factory(
+    int                                 input_height,
+    int                                 input_width,
+    int                                 cls_number,
+    const std::vector<Int8QuantParams> &quant_params,
+    const NmsConfig                    &nms_config        = NmsConfig(),
+    const std::vector<int>             &downsample_scales = {8, 16, 32});
+
+} // namespace easy_deploy
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <vector>
+
+#include "deploy_core/base_detection.hpp"
+#include "detection_2d_common/nms.hpp"
+
+namespace easy_deploy {
+
+/**
+ * @brief The anchors of the yolov8 heads, tabulated once from `downsample_scales` : the grid cells
+ * of every stride in the order of the outputs, and their centres in the model input coordinates.
+ *
+ */
+class Yolov8AnchorGrid {
+public:
+  struct Level {
+    int stride;
+    int height;
+    int width;
+    // of the first cell of the level in the anchor tables
+    int anchor_offset;
+  };
+
+  /**
+   * @brief Construct a new Yolov8AnchorGrid object.
+   *
+   * @param input_height
+   * @param input_width
+   * @param downsample_scales The strides of the heads, the input size should be an integer
+   * multiple of each.
+   */
+  Yolov8AnchorGrid(int input_height, int input_width, const std::vector<int> &downsample_scales);
+
+  const std::vector<Level> &GetLevels() const
+  {
+    return levels_;
+  }
+
+  int GetNumAnchors() const
+  {
+    return num_anchors_;
+  }
+
+  const float *GetAnchorCx() const
+  {
+    return anchor_cx_.data();
+  }
+
+  const float *GetAnchorCy() const
+  {
+    return anchor_cy_.data();
+  }
+
+private:
+  std::vector<Level> levels_;
+  int                num_anchors_ = 0;
+  std::vector<float> anchor_cx_;
+  std::vector<float> anchor_cy_;
+};
+
+/**
+ * @brief The lowest confidence threshold of a decode, the one rejecting anchors before their class
+ * is known.
+ *
+ * @param conf_thresh
+ * @param cls_number
+ * @param class_conf_thresh `cls_number` thresholds used instead of `conf_thresh` if not null.
+ * @return float
+ */
+float MinConfThreshold(float conf_thresh, int cls_number, const float *class_conf_thresh);
+
+/**
+ * @brief Decode the channel-major `{4 + cls_number, num_anchors}` yolov8 output. The class rows
+ * are walked in tiles of anchors, the max/argmax of a tile runs on SIMD (AVX/SSE on x86, NEON on
+ * arm) across anchors, and the anchors below `conf_thresh` are rejected before their box is read.
+ * The loops are specialized for the 80 classes of coco, with their trip counts known at compile
+ * time.
+ *
+ * @param output The `output0` blob of a single image.
+ * @param num_anchors
+ * @param cls_number
+ * @param conf_thresh
+ * @param scores_are_logits `true` if the class scores are raw logits : the threshold is moved to
+ * the logit space, and only the kept anchors get their sigmoid.
+ * @param candidates Pre-sized to `num_anchors` at least, filled in the anchor order, in the model
+ * input coordinates.
+ * @param class_conf_thresh `cls_number` thresholds used instead of `conf_thresh` if not null, as
+ * given by `NmsEngine::ClassThreshold`.
+ * @return size_t The number of candidates written.
+ */
+size_t DecodeYolov8Candidates(const float        *output,
+                              int                 num_anchors,
+                              int                 cls_number,
+                              float               conf_thresh,
+                              bool                scores_are_logits,
+                              DetectionCandidate *candidates,
+                              const float        *class_conf_thresh = nullptr);
+
+/**
+ * @brief The straightforward anchor by anchor decoding, with a strided max-class search over the
+ * channel-major output. Kept as reference for tests and benchmarks.
+ *
+ */
+size_t DecodeYolov8CandidatesNaive(const float        *output,
+                                   int                 num_anchors,
+                                   int                 cls_number,
+                                   float               conf_thresh,
+                                   bool                scores_are_logits,
+                                   DetectionCandidate *candidates,
+                                   const float        *class_conf_thresh = nullptr);
+
+/**
+ * @brief Create a cpu postprocess of the yolov8 `output0` blob, decoded with
+ * `DecodeYolov8Candidates` into a buffer allocated once, then filtered by `NmsEngine`. A drop-in
+ * replacement of `CreateYolov8PostProcessCpuOrigin`.
+ *
+ * @param input_height
+ * @param input_width
+ * @param cls_number
+ * @param nms_config The class thresholds of the config also reject the anchors while decoding.
+ * @param scores_are_logits
+ * @param downsample_scales The strides of the heads, the anchors of the output.
+ * @return std::shared_ptr<IDetectionPostProcess>
+ */
+std::shared_ptr<IDetectionPostProcess> CreateYolov8PostProcessCpuSimd(
+    int                     input_height,
+    int                     input_width,
+    int                     cls_number,
+    const NmsConfig        &nms_config        = NmsConfig(),
+    bool                    scores_are_logits = false,
+    const std::vector<int> &downsample_scales = {8, 16, 32});
+
+std::shared_ptr<BaseDetectionPostprocessFactory> CreateYolov8PostProcessCpuSimdFactory(
+    int                     input_height,
+    int                     input_width,
+    int                     cls_number,
+    const NmsConfig        &nms_config        = NmsConfig(),
+    bool                    scores_are_logits = false,
+    const std::vector<int> &downsample_scales = {8, 16, 32});
+
+} // namespace easy_deploy
@@ -2,7 +2,7 @@
 
 namespace easy_deploy {
 
-class Yolov8Detection : public BaseDetectionModel {
+class Yolov8Detection : public BaseBatchDetectionModel {
 public:
   Yolov8Detection(const std::shared_ptr<BaseInferCore>         &infer_core,
                   const std::shared_ptr<IDetectionPreProcess>  &preprocess_block,
@@ -22,6 +22,12 @@ private:
 
   bool PostProcess(std::shared_ptr<IPipelinePackage> pipeline_unit) override;
 
+  bool PostProcessBatchItem(IBlobsBuffer        *blobs_buffer,
+                            size_t               batch_index,
+                            float                conf_thresh,
+                            float                transform_scale,
+                            std::vector<BBox2D> &results) override;
+
 private:
   const std::vector<std::string> input_blobs_name_;
   const std::vector<std::string> output_blobs_name_;
@@ -47,7 +53,12 @@ Yolov8Detection::Yolov8Detection(const std::shared_ptr<BaseInferCore>         &i
                                  const std::vector<std::string>               &input_blobs_name,
                                  const std::vector<std::string>               &output_blobs_name,
                                  const std::vector<int>                        downsample_scales)
-    : BaseDetectionModel(infer_core),
+    : BaseBatchDetectionModel(infer_core,
+                              preprocess_block,
+                              input_blobs_name.at(0),
+                              input_height,
+                              input_width,
+                              input_channel),
       infer_core_(infer_core),
       preprocess_block_(preprocess_block),
       postprocess_block_(postprocess_block),
@@ -117,21 +128,27 @@ bool Yolov8Detection::PostProcess(std::shared_ptr<IPipelinePackage> _package)
               "[Yolov8Detection] PostProcess the `_package` instance does not belong to "
               "`DetectionPipelinePackage`");
 
-  auto                p_blob_buffers = package->GetInferBuffer();
-  std::vector<void *> output_blobs_ptr;
-  for (const std::string &output_blob_name : output_blobs_name_)
-  {
-    void *blob_ptr = p_blob_buffers->GetTensor(output_blob_name)->RawPtr();
-    output_blobs_ptr.push_back(blob_ptr);
-  }
+  return PostProcessBatchItem(package->GetInferBuffer(), 0, package->conf_thresh,
+                              package->transform_scale, package->results);
+}
+
+bool Yolov8Detection::PostProcessBatchItem(IBlobsBuffer        *blobs_buffer,
+                                           size_t               batch_index,
+                                           float                conf_thresh,
+                                           float                transform_scale,
+                                           std::vector<BBox2D> &results)
+{
+  // the outputs of the image are at `batch_index` of the batch dimension
+  const std::vector<void *> output_blobs_ptr =
+      GetBatchItemOutputs(blobs_buffer, output_blobs_name_, batch_index);
 
   postprocess_block_->Postprocess(output_blobs_ptr,
-                                  package->results, // mutable
-                                  package->conf_thresh, package->transform_scale);
+                                  results, // mutable
+                                  conf_thresh, transform_scale);
   return true;
 }
 
-std::shared_ptr<BaseDetectionModel> CreateYolov8DetectionModel(
+std::shared_ptr<BaseBatchDetectionModel> CreateYolov8DetectionModel(
     const std::shared_ptr<BaseInferCore>         &infer_core,
     const std::shared_ptr<IDetectionPreProcess>  &preprocess_block,
     const std::shared_ptr<IDetectionPostProcess> &postprocess_block,
@@ -0,0 +1,447 @@
+#include "detection_2d_yolov8/yolov8_divide_postprocess.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+
+namespace easy_deploy {
+
+namespace {
+
+// bins of the distribution focal loss of a box side
+constexpr int kDflBins = 16;
+
+// Cells of a tile. A tile with more cells passing the score sum than `kDenseTileCells` has its
+// class rows read contiguously, the others the classes of their passing cells only.
+constexpr int kTileCells      = 256;
+constexpr int kDenseTileCells = 32;
+
+// the classes of coco, the decode loops are specialized for them
+constexpr int kCocoClsNumber = 80;
+
+// Max score and its class of `count` cells over the `cls_number` class rows, `row_stride` apart.
+// Branch-free, so that it vectorizes. `kClsNumber` and `kCount`, if not 0, are `cls_number` and
+// `count` known at compile time, and their loops are unrolled.
+template <int kClsNumber, int kCount>
+void TileMaxClass(const int8_t *scores,
+                  size_t        row_stride,
+                  int           cls_number,
+                  int           count,
+                  int8_t       *max_score,
+                  int16_t      *max_cls)
+{
+  cls_number = kClsNumber > 0 ? kClsNumber : cls_number;
+  count      = kCount > 0 ? kCount : count;
+  std::copy(scores, scores + count, max_score);
+  std::fill(max_cls, max_cls + count, 0);
+  for (int c = 1; c < cls_number; ++c)
+  {
+    const int8_t *row = scores + c * row_stride;
+    for (int i = 0; i < count; ++i)
+    {
+      const bool gt = row[i] > max_score[i];
+      max_score[i]  = gt ? row[i] : max_score[i];
+      max_cls[i]    = gt ? static_cast<int16_t>(c) : max_cls[i];
+    }
+  }
+}
+
+// Max score and its class of a single cell, the class scores `row_stride` apart
+template <int kClsNumber>
+inline int CellMaxClass(const int8_t *scores, size_t row_stride, int cls_number, int *max_cls)
+{
+  cls_number    = kClsNumber > 0 ? kClsNumber : cls_number;
+  int max_score = scores[0];
+  *max_cls      = 0;
+  for (int c = 1; c < cls_number; ++c)
+  {
+    if (scores[c * row_stride] > max_score)
+    {
+      max_score = scores[c * row_stride];
+      *max_cls  = c;
+    }
+  }
+  return max_score;
+}
+
+// `dist` are the distances of the left/top/right/bottom sides to the anchor centre, in strides
+inline DetectionCandidate MakeCandidate(
+    float anchor_cx, float anchor_cy, float stride, const float *dist, float conf, int cls)
+{
+  DetectionCandidate candidate;
+  candidate.cx   = anchor_cx + (dist[2] - dist[0]) * stride * 0.5f;
+  candidate.cy   = anchor_cy + (dist[3] - dist[1]) * stride * 0.5f;
+  candidate.w    = (dist[0] + dist[2]) * stride;
+  candidate.h    = (dist[1] + dist[3]) * stride;
+  candidate.conf = conf;
+  candidate.cls  = cls;
+  return candidate;
+}
+
+} // namespace
+
+int QuantizeThreshold(float thresh, const Int8QuantParams &quant)
+{
+  // the rounded estimate, then moved until it agrees with `Dequantize` despite the float rounding
+  const double estimate = std::ceil(quant.zero_point + static_cast<double>(thresh) / quant.scale);
+  int          q        = static_cast<int>(std::max(-128.0, std::min(128.0, estimate)));
+  while (q > -128 && Dequantize(static_cast<int8_t>(q - 1), quant) >= thresh)
+  {
+    --q;
+  }
+  while (q < 128 && Dequantize(static_cast<int8_t>(q), quant) < thresh)
+  {
+    ++q;
+  }
+  return q;
+}
+
+Yolov8DivideDecoder::Yolov8DivideDecoder(int                                 input_height,
+                                         int                                 input_width,
+                                         int                                 cls_number,
+                                         const std::vector<int>             &downsample_scales,
+                                         const std::vector<Int8QuantParams> &quant_params)
+    : cls_number_(cls_number),
+      grid_(input_height, input_width, downsample_scales),
+      quant_params_(quant_params)
+{
+  if (cls_number <= 0)
+  {
+    throw std::invalid_argument("[Yolov8DivideDecoder] Got invalid input arguments!!");
+  }
+  const size_t levels_num = grid_.GetLevels().size();
+  if (!quant_params_.empty() && quant_params_.size() != 3 * levels_num)
+  {
+    throw std::invalid_argument("[Yolov8DivideDecoder] Expect the quantization of every output!!");
+  }
+
+  for (size_t l = 0; l < levels_num && !quant_params_.empty(); ++l)
+  {
+    const Int8QuantParams &box_quant = quant_params_[3 * l];
+    if (box_quant.scale <= 0.f || quant_params_[3 * l + 1].scale <= 0.f ||
+        quant_params_[3 * l + 2].scale <= 0.f)
+    {
+      throw std::invalid_argument("[Yolov8DivideDecoder] Got invalid quantization scale!!");
+    }
+    std::vector<float> exp_table(256);
+    for (int d = 0; d < 256; ++d)
+    {
+      exp_table[d] = std::exp(-d * box_quant.scale);
+    }
+    exp_tables_.push_back(std::move(exp_table));
+  }
+  class_q_thresh_.resize(cls_number_);
+}
+
+size_t Yolov8DivideDecoder::Decode(const std::vector<void *> &outputs,
+                                   float                      conf_thresh,
+                                   DetectionCandidate        *candidates,
+                                   const float               *class_conf_thresh)
+{
+  if (quant_params_.empty() || outputs.size() != 3 * grid_.GetLevels().size())
+  {
+    throw std::invalid_argument("[Yolov8DivideDecoder] Decode got invalid outputs!!");
+  }
+  const float min_thresh = MinConfThreshold(conf_thresh, cls_number_, class_conf_thresh);
+  const bool  coco       = cls_number_ == kCocoClsNumber;
+
+  size_t num_candidates = 0;
+  for (size_t l = 0; l < grid_.GetLevels().size(); ++l)
+  {
+    const auto            &level     = grid_.GetLevels()[l];
+    const size_t           hw        = static_cast<size_t>(level.height) * level.width;
+    const int8_t          *box       = static_cast<const int8_t *>(outputs[3 * l]);
+    const int8_t          *cls       = static_cast<const int8_t *>(outputs[3 * l + 1]);
+    const int8_t          *score_sum = static_cast<const int8_t *>(outputs[3 * l + 2]);
+    const Int8QuantParams &cls_quant = quant_params_[3 * l + 1];
+    const Int8QuantParams &sum_quant = quant_params_[3 * l + 2];
+    const float           *exp_table = exp_tables_[l].data();
+    const float           *anchor_cx = grid_.GetAnchorCx();
+    const float           *anchor_cy = grid_.GetAnchorCy();
+
+    // the sum bounds the top score of its cell, but their roundings may put it below by half a
+    // step of each
+    const int sum_q_thresh =
+        QuantizeThreshold(min_thresh - sum_quant.scale - cls_quant.scale, sum_quant);
+    const int min_q_thresh = QuantizeThreshold(min_thresh, cls_quant);
+    if (class_conf_thresh != nullptr)
+    {
+      for (int c = 0; c < cls_number_; ++c)
+      {
+        class_q_thresh_[c] = QuantizeThreshold(class_conf_thresh[c], cls_quant);
+      }
+    }
+
+    int8_t  max_score[kTileCells];
+    int16_t max_cls[kTileCells];
+    int     passing[kTileCells];
+    for (size_t begin = 0; begin < hw; begin += kTileCells)
+    {
+      const int count = static_cast<int>(std::min<size_t>(kTileCells, hw - begin));
+      // most cells stop here, before their classes are read
+      int passing_num = 0;
+      for (int i = 0; i < count; ++i)
+      {
+        passing[passing_num] = i;
+        passing_num += score_sum[begin + i] >= sum_q_thresh;
+      }
+      const bool dense = passing_num > kDenseTileCells;
+      if (dense)
+      {
+        if (coco && count == kTileCells)
+        {
+          TileMaxClass<kCocoClsNumber, kTileCells>(cls + begin, hw, cls_number_, count, max_score,
+                                                   max_cls);
+        } else
+        {
+          TileMaxClass<0, 0>(cls + begin, hw, cls_number_, count, max_score, max_cls);
+        }
+      }
+
+      for (int p = 0; p < passing_num; ++p)
+      {
+        const size_t cell = begin + passing[p];
+        int          best_q, best_cls;
+        if (dense)
+        {
+          best_q   = max_score[passing[p]];
+          best_cls = max_cls[passing[p]];
+        } else
+        {
+          best_q = coco ? CellMaxClass<kCocoClsNumber>(cls + cell, hw, cls_number_, &best_cls)
+                        : CellMaxClass<0>(cls + cell, hw, cls_number_, &best_cls);
+        }
+        if (best_q < min_q_thresh ||
+            (class_conf_thresh != nullptr && best_q < class_q_thresh_[best_cls]))
+        {
+          continue;
+        }
+
+        // the softmax of the bins relative to the largest one, whose weight is 1
+        float dist[4];
+        for (int side = 0; side < 4; ++side)
+        {
+          const int8_t *bins  = box + side * kDflBins * hw + cell;
+          int           max_q = bins[0];
+          for (int j = 1; j < kDflBins; ++j)
+          {
+            max_q = std::max<int>(max_q, bins[j * hw]);
+          }
+          float weight_sum = 0.f, weighted_sum = 0.f;
+          for (int j = 0; j < kDflBins; ++j)
+          {
+            const float weight = exp_table[max_q - bins[j * hw]];
+            weight_sum += weight;
+            weighted_sum += j * weight;
+          }
+          dist[side] = weighted_sum / weight_sum;
+        }
+        const int anchor             = level.anchor_offset + static_cast<int>(cell);
+        candidates[num_candidates++] = MakeCandidate(anchor_cx[anchor], anchor_cy[anchor],
+                                                     level.stride, dist,
+                                                     Dequantize(best_q, cls_quant), best_cls);
+      }
+    }
+  }
+  return num_candidates;
+}
+
+size_t Yolov8DivideDecoder::DecodeFloat(const std::vector<void *> &outputs,
+                                        float                      conf_thresh,
+                                        DetectionCandidate        *candidates,
+                                        const float               *class_conf_thresh) const
+{
+  if (outputs.size() != 3 * grid_.GetLevels().size())
+  {
+    throw std::invalid_argument("[Yolov8DivideDecoder] DecodeFloat got invalid outputs!!");
+  }
+  const float min_thresh = MinConfThreshold(conf_thresh, cls_number_, class_conf_thresh);
+
+  size_t num_candidates = 0;
+  for (size_t l = 0; l < grid_.GetLevels().size(); ++l)
+  {
+    const auto  &level = grid_.GetLevels()[l];
+    const size_t hw    = static_cast<size_t>(level.height) * level.width;
+    const float *box   = static_cast<const float *>(outputs[3 * l]);
+    const float *cls   = static_cast<const float *>(outputs[3 * l + 1]);
+    for (size_t cell = 0; cell < hw; ++cell)
+    {
+      float best_score = cls[cell];
+      int   best_cls   = 0;
+      for (int c = 1; c < cls_number_; ++c)
+      {
+        const float score = cls[c * hw + cell];
+        if (score > best_score)
+        {
+          best_score = score;
+          best_cls   = c;
+        }
+      }
+      if (best_score < min_thresh ||
+          (class_conf_thresh != nullptr && best_score < class_conf_thresh[best_cls]))
+      {
+        continue;
+      }
+
+      float dist[4];
+      for (int side = 0; side < 4; ++side)
+      {
+        const float *bins      = box + side * kDflBins * hw + cell;
+        float        max_value = bins[0];
+        for (int j = 1; j < kDflBins; ++j)
+        {
+          max_value = std::max(max_value, bins[j * hw]);
+        }
+        float weight_sum = 0.f, weighted_sum = 0.f;
+        for (int j = 0; j < kDflBins; ++j)
+        {
+          const float weight = std::exp(bins[j * hw] - max_value);
+          weight_sum += weight;
+          weighted_sum += j * weight;
+        }
+        dist[side] = weighted_sum / weight_sum;
+      }
+      const float anchor_cx        = (cell % level.width + 0.5f) * level.stride;
+      const float anchor_cy        = (cell / level.width + 0.5f) * level.stride;
+      candidates[num_candidates++] =
+          MakeCandidate(anchor_cx, anchor_cy, level.stride, dist, best_score, best_cls);
+    }
+  }
+  return num_candidates;
+}
+
+class Yolov8PostProcessCpuDivideInt8 : public IDetectionPostProcess {
+public:
+  Yolov8PostProcessCpuDivideInt8(int                                 input_height,
+                                 int                                 input_width,
+                                 int                                 cls_number,
+                                 const std::vector<Int8QuantParams> &quant_params,
+                                 const NmsConfig                    &nms_config,
+                                 const std::vector<int>             &downsample_scales);
+
+  void Postprocess(const std::vector<void *> &output_blobs_ptr,
+                   std::vector<BBox2D>       &results,
+                   float                      conf_threshold,
+                   float                      transform_scale) override;
+
+private:
+  const int cls_number_;
+
+  // allocated once for the worst case, every anchor passing the threshold
+  std::mutex                      mtx_;
+  Yolov8DivideDecoder             decoder_;
+  NmsEngine                       nms_;
+  std::vector<DetectionCandidate> candidates_;
+  std::vector<float>              class_conf_thresh_;
+};
+
+Yolov8PostProcessCpuDivideInt8::Yolov8PostProcessCpuDivideInt8(
+    int                                 input_height,
+    int                                 input_width,
+    int                                 cls_number,
+    const std::vector<Int8QuantParams> &quant_params,
+    const NmsConfig                    &nms_config,
+    const std::vector<int>             &downsample_scales)
+    : cls_number_(cls_number),
+      decoder_(input_height, input_width, cls_number, downsample_scales, quant_params),
+      nms_(nms_config)
+{
+  if (quant_params.empty())
+  {
+    throw std::invalid_argument(
+        "[Yolov8PostProcessCpuDivideInt8] Expect the quantization of every output!!");
+  }
+  candidates_.resize(decoder_.GetNumAnchors());
+  class_conf_thresh_.resize(cls_number_);
+}
+
+void Yolov8PostProcessCpuDivideInt8::Postprocess(const std::vector<void *> &output_blobs_ptr,
+                                                 std::vector<BBox2D>       &results,
+                                                 float                      conf_threshold,
+                                                 float                      transform_scale)
+{
+  results.clear();
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  // the class thresholds of the NMS reject the anchors while decoding
+  for (int c = 0; c < cls_number_; ++c)
+  {
+    class_conf_thresh_[c] = nms_.ClassThreshold(c, conf_threshold);
+  }
+  const size_t num_candidates = decoder_.Decode(output_blobs_ptr, conf_threshold,
+                                                candidates_.data(), class_conf_thresh_.data());
+  const auto  &kept           = nms_.Run(candidates_.data(), num_candidates, conf_threshold);
+
+  // back to the original image
+  results.reserve(kept.size());
+  for (const int index : kept)
+  {
+    const DetectionCandidate &candidate = candidates_[index];
+    BBox2D                    box;
+    box.x    = candidate.cx / transform_scale;
+    box.y    = candidate.cy / transform_scale;
+    box.w    = candidate.w / transform_scale;
+    box.h    = candidate.h / transform_scale;
+    box.cls  = candidate.cls;
+    box.conf = candidate.conf;
+    results.push_back(box);
+  }
+}
+
+std::shared_ptr<IDetectionPostProcess> CreateYolov8PostProcessCpuDivideInt8(
+    int                                 input_height,
+    int                                 input_width,
+    int                                 cls_number,
+    const std::vector<Int8QuantParams> &quant_params,
+    const NmsConfig                    &nms_config,
+    const std::vector<int>             &downsample_scales)
+{
+  return std::make_shared<Yolov8PostProcessCpuDivideInt8>(
+      input_height, input_width, cls_number, quant_params, nms_config, downsample_scales);
+}
+
+struct Yolov8PostProcessCpuDivideInt8Params {
+  int                          input_height;
+  int                          input_width;
+  int                          cls_number;
+  std::vector<Int8QuantParams> quant_params;
+  NmsConfig                    nms_config;
+  std::vector<int>             downsample_scales;
+};
+
+class Yolov8PostProcessCpuDivideInt8Factory : public BaseDetectionPostprocessFactory {
+public:
+  Yolov8PostProcessCpuDivideInt8Factory(const Yolov8PostProcessCpuDivideInt8Params &params)
+      : params_(params)
+  {}
+  std::shared_ptr<IDetectionPostProcess> Create() override
+  {
+    return CreateYolov8PostProcessCpuDivideInt8(params_.input_height, params_.input_width,
+                                                params_.cls_number, params_.quant_params,
+                                                params_.nms_config, params_.downsample_scales);
+  }
+
+private:
+  Yolov8PostProcessCpuDivideInt8Params params_;
+};
+
+std::shared_ptr<BaseDetectionPostprocessFactory> CreateYolov8PostProcessCpuDivideInt8Factory(
+    int                                 input_height,
+    int                                 input_width,
+    int                                 cls_number,
+    const std::vector<Int8QuantParams> &quant_params,
+    const NmsConfig                    &nms_config,
+    const std::vector<int>             &downsample_scales)
+{
+  Yolov8PostProcessCpuDivideInt8Params params;
+  params.input_height      = input_height;
+  params.input_width       = input_width;
+  params.cls_number        = cls_number;
+  params.quant_params      = quant_params;
+  params.nms_config        = nms_config;
+  params.downsample_scales = downsample_scales;
+
+  return std::make_shared<Yolov8PostProcessCpuDivideInt8Factory>(params);
+}
+
+} // namespace easy_deploy
@@ -0,0 +1,391 @@
+#include "detection_2d_yolov8/yolov8_postprocess.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define YOLOV8_DECODE_NEON
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define YOLOV8_DECODE_AVX
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#define YOLOV8_DECODE_SSE
+#endif
+
+namespace easy_deploy {
+
+namespace {
+
+// Anchors of a tile. Their running max and argmax take 2KB and stay in L1, while every class row
+// is read as one contiguous 1KB run.
+constexpr int kTileAnchors = 256;
+
+// the classes of coco, the decode loops are specialized for them
+constexpr int kCocoClsNumber = 80;
+
+// Max score and its class (as float, to blend it in the same registers) of `count` anchors over
+// the `cls_number` class rows, `row_stride` floats apart. `max_score` and `max_cls` are 32-byte
+// aligned, the rows need not be. `kClsNumber` and `kCount`, if not 0, are `cls_number` and `count`
+// known at compile time, and their loops are unrolled.
+template <int kClsNumber, int kCount>
+void TileMaxClass(const float *scores,
+                  size_t       row_stride,
+                  int          cls_number,
+                  int          count,
+                  float       *max_score,
+                  float       *max_cls)
+{
+  cls_number = kClsNumber > 0 ? kClsNumber : cls_number;
+  count      = kCount > 0 ? kCount : count;
+  std::copy(scores, scores + count, max_score);
+  std::fill(max_cls, max_cls + count, 0.f);
+  for (int c = 1; c < cls_number; ++c)
+  {
+    const float *row = scores + c * row_stride;
+    const float  cls = static_cast<float>(c);
+    int          i   = 0;
+#if defined(YOLOV8_DECODE_AVX)
+    const __m256 vcls = _mm256_set1_ps(cls);
+    for (; i + 8 <= count; i += 8)
+    {
+      const __m256 s  = _mm256_loadu_ps(row + i);
+      const __m256 m  = _mm256_load_ps(max_score + i);
+      const __m256 gt = _mm256_cmp_ps(s, m, _CMP_GT_OQ);
+      _mm256_store_ps(max_score + i, _mm256_max_ps(s, m));
+      // and/andnot rather than blendv, which gcc turns into per-lane branches here
+      _mm256_store_ps(max_cls + i, _mm256_or_ps(_mm256_and_ps(gt, vcls),
+                                                _mm256_andnot_ps(gt, _mm256_load_ps(max_cls + i))));
+    }
+#elif defined(YOLOV8_DECODE_SSE)
+    const __m128 vcls = _mm_set1_ps(cls);
+    for (; i + 4 <= count; i += 4)
+    {
+      const __m128 s  = _mm_loadu_ps(row + i);
+      const __m128 m  = _mm_load_ps(max_score + i);
+      const __m128 gt = _mm_cmpgt_ps(s, m);
+      _mm_store_ps(max_score + i, _mm_max_ps(s, m));
+      _mm_store_ps(max_cls + i,
+                   _mm_or_ps(_mm_and_ps(gt, vcls), _mm_andnot_ps(gt, _mm_load_ps(max_cls + i))));
+    }
+#elif defined(YOLOV8_DECODE_NEON)
+    const float32x4_t vcls = vdupq_n_f32(cls);
+    for (; i + 4 <= count; i += 4)
+    {
+      const float32x4_t s  = vld1q_f32(row + i);
+      const float32x4_t m  = vld1q_f32(max_score + i);
+      const uint32x4_t  gt = vcgtq_f32(s, m);
+      vst1q_f32(max_score + i, vmaxq_f32(s, m));
+      vst1q_f32(max_cls + i, vbslq_f32(gt, vcls, vld1q_f32(max_cls + i)));
+    }
+#endif
+    for (; i < count; ++i)
+    {
+      if (row[i] > max_score[i])
+      {
+        max_score[i] = row[i];
+        max_cls[i]   = cls;
+      }
+    }
+  }
+}
+
+// `conf_thresh` in the score domain of the output
+float ScoreThreshold(float conf_thresh, bool scores_are_logits)
+{
+  if (!scores_are_logits)
+  {
+    return conf_thresh;
+  }
+  if (conf_thresh <= 0.f)
+  {
+    return -std::numeric_limits<float>::infinity();
+  }
+  if (conf_thresh >= 1.f)
+  {
+    return std::numeric_limits<float>::infinity();
+  }
+  return std::log(conf_thresh / (1.f - conf_thresh));
+}
+
+inline DetectionCandidate MakeCandidate(
+    const float *output, size_t num_anchors, int anchor, float score, int cls, bool logits)
+{
+  DetectionCandidate candidate;
+  candidate.cx   = output[anchor];
+  candidate.cy   = output[num_anchors + anchor];
+  candidate.w    = output[2 * num_anchors + anchor];
+  candidate.h    = output[3 * num_anchors + anchor];
+  candidate.conf = logits ? 1.f / (1.f + std::exp(-score)) : score;
+  candidate.cls  = cls;
+  return candidate;
+}
+
+} // namespace
+
+float MinConfThreshold(float conf_thresh, int cls_number, const float *class_conf_thresh)
+{
+  return class_conf_thresh == nullptr
+             ? conf_thresh
+             : *std::min_element(class_conf_thresh, class_conf_thresh + cls_number);
+}
+
+Yolov8AnchorGrid::Yolov8AnchorGrid(int                     input_height,
+                                   int                     input_width,
+                                   const std::vector<int> &downsample_scales)
+{
+  if (input_height <= 0 || input_width <= 0 || downsample_scales.empty())
+  {
+    throw std::invalid_argument("[Yolov8AnchorGrid] Got invalid input arguments!!");
+  }
+  for (const int s : downsample_scales)
+  {
+    if (s <= 0 || input_height % s != 0 || input_width % s != 0)
+    {
+      throw std::invalid_argument(
+          "[Yolov8AnchorGrid] input size should be an integer multiple of the scales!!");
+    }
+    levels_.push_back({s, input_height / s, input_width / s, num_anchors_});
+    num_anchors_ += (input_height / s) * (input_width / s);
+  }
+
+  anchor_cx_.reserve(num_anchors_);
+  anchor_cy_.reserve(num_anchors_);
+  for (const auto &level : levels_)
+  {
+    for (int y = 0; y < level.height; ++y)
+    {
+      for (int x = 0; x < level.width; ++x)
+      {
+        anchor_cx_.push_back((x + 0.5f) * level.stride);
+        anchor_cy_.push_back((y + 0.5f) * level.stride);
+      }
+    }
+  }
+}
+
+size_t DecodeYolov8Candidates(const float        *output,
+                              int                 num_anchors,
+                              int                 cls_number,
+                              float               conf_thresh,
+                              bool                scores_are_logits,
+                              DetectionCandidate *candidates,
+                              const float        *class_conf_thresh)
+{
+  const float  thresh = ScoreThreshold(MinConfThreshold(conf_thresh, cls_number, class_conf_thresh),
+                                      scores_are_logits);
+  const size_t stride = static_cast<size_t>(num_anchors);
+  const float *scores = output + 4 * stride;
+
+  alignas(32) float max_score[kTileAnchors];
+  alignas(32) float max_cls[kTileAnchors];
+  size_t            num_candidates = 0;
+  for (int begin = 0; begin < num_anchors; begin += kTileAnchors)
+  {
+    const int count = std::min(kTileAnchors, num_anchors - begin);
+    if (cls_number == kCocoClsNumber && count == kTileAnchors)
+    {
+      TileMaxClass<kCocoClsNumber, kTileAnchors>(scores + begin, stride, cls_number, count,
+                                                 max_score, max_cls);
+    } else
+    {
+      TileMaxClass<0, 0>(scores + begin, stride, cls_number, count, max_score, max_cls);
+    }
+    for (int i = 0; i < count; ++i)
+    {
+      // most anchors stop here, before their box is touched
+      if (max_score[i] < thresh)
+      {
+        continue;
+      }
+      const DetectionCandidate candidate = MakeCandidate(
+          output, stride, begin + i, max_score[i], static_cast<int>(max_cls[i]), scores_are_logits);
+      if (class_conf_thresh == nullptr || candidate.conf >= class_conf_thresh[candidate.cls])
+      {
+        candidates[num_candidates++] = candidate;
+      }
+    }
+  }
+  return num_candidates;
+}
+
+size_t DecodeYolov8CandidatesNaive(const float        *output,
+                                   int                 num_anchors,
+                                   int                 cls_number,
+                                   float               conf_thresh,
+                                   bool                scores_are_logits,
+                                   DetectionCandidate *candidates,
+                                   const float        *class_conf_thresh)
+{
+  const float  thresh = ScoreThreshold(MinConfThreshold(conf_thresh, cls_number, class_conf_thresh),
+                                      scores_are_logits);
+  const size_t stride = static_cast<size_t>(num_anchors);
+  const float *scores = output + 4 * stride;
+
+  size_t num_candidates = 0;
+  for (int anchor = 0; anchor < num_anchors; ++anchor)
+  {
+    float best_score = scores[anchor];
+    int   best_cls   = 0;
+    for (int c = 1; c < cls_number; ++c)
+    {
+      const float score = scores[c * stride + anchor];
+      if (score > best_score)
+      {
+        best_score = score;
+        best_cls   = c;
+      }
+    }
+    if (best_score < thresh)
+    {
+      continue;
+    }
+    const DetectionCandidate candidate =
+        MakeCandidate(output, stride, anchor, best_score, best_cls, scores_are_logits);
+    if (class_conf_thresh == nullptr || candidate.conf >= class_conf_thresh[candidate.cls])
+    {
+      candidates[num_candidates++] = candidate;
+    }
+  }
+  return num_candidates;
+}
+
+class Yolov8PostProcessCpuSimd : public IDetectionPostProcess {
+public:
+  Yolov8PostProcessCpuSimd(int                     input_height,
+                           int                     input_width,
+                           int                     cls_number,
+                           const NmsConfig        &nms_config,
+                           bool                    scores_are_logits,
+                           const std::vector<int> &downsample_scales);
+
+  void Postprocess(const std::vector<void *> &output_blobs_ptr,
+                   std::vector<BBox2D>       &results,
+                   float                      conf_threshold,
+                   float                      transform_scale) override;
+
+private:
+  const int  cls_number_;
+  const bool scores_are_logits_;
+  int        num_anchors_ = 0;
+
+  // allocated once for the worst case, every anchor passing the threshold
+  std::mutex                      mtx_;
+  NmsEngine                       nms_;
+  std::vector<DetectionCandidate> candidates_;
+  std::vector<float>              class_conf_thresh_;
+};
+
+Yolov8PostProcessCpuSimd::Yolov8PostProcessCpuSimd(int                     input_height,
+                                                   int                     input_width,
+                                                   int                     cls_number,
+                                                   const NmsConfig        &nms_config,
+                                                   bool                    scores_are_logits,
+                                                   const std::vector<int> &downsample_scales)
+    : cls_number_(cls_number), scores_are_logits_(scores_are_logits), nms_(nms_config)
+{
+  if (cls_number <= 0)
+  {
+    throw std::invalid_argument("[Yolov8PostProcessCpuSimd] Got invalid input arguments!!");
+  }
+  num_anchors_ = Yolov8AnchorGrid(input_height, input_width, downsample_scales).GetNumAnchors();
+  candidates_.resize(num_anchors_);
+  class_conf_thresh_.resize(cls_number_);
+}
+
+void Yolov8PostProcessCpuSimd::Postprocess(const std::vector<void *> &output_blobs_ptr,
+                                           std::vector<BBox2D>       &results,
+                                           float                      conf_threshold,
+                                           float                      transform_scale)
+{
+  results.clear();
+  const float *output = static_cast<const float *>(output_blobs_ptr.at(0));
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  // the class thresholds of the NMS reject the anchors while decoding
+  for (int c = 0; c < cls_number_; ++c)
+  {
+    class_conf_thresh_[c] = nms_.ClassThreshold(c, conf_threshold);
+  }
+  const size_t num_candidates =
+      DecodeYolov8Candidates(output, num_anchors_, cls_number_, conf_threshold,
+                             scores_are_logits_, candidates_.data(), class_conf_thresh_.data());
+  const auto &kept = nms_.Run(candidates_.data(), num_candidates, conf_threshold);
+
+  // back to the original image
+  results.reserve(kept.size());
+  for (const int index : kept)
+  {
+    const DetectionCandidate &candidate = candidates_[index];
+    BBox2D                    box;
+    box.x    = candidate.cx / transform_scale;
+    box.y    = candidate.cy / transform_scale;
+    box.w    = candidate.w / transform_scale;
+    box.h    = candidate.h / transform_scale;
+    box.cls  = candidate.cls;
+    box.conf = candidate.conf;
+    results.push_back(box);
+  }
+}
+
+std::shared_ptr<IDetectionPostProcess> CreateYolov8PostProcessCpuSimd(
+    int                     input_height,
+    int                     input_width,
+    int                     cls_number,
+    const NmsConfig        &nms_config,
+    bool                    scores_are_logits,
+    const std::vector<int> &downsample_scales)
+{
+  return std::make_shared<Yolov8PostProcessCpuSimd>(input_height, input_width, cls_number,
+                                                    nms_config, scores_are_logits,
+                                                    downsample_scales);
+}
+
+struct Yolov8PostProcessCpuSimdParams {
+  int              input_height;
+  int              input_width;
+  int              cls_number;
+  NmsConfig        nms_config;
+  bool             scores_are_logits;
+  std::vector<int> downsample_scales;
+};
+
+class Yolov8PostProcessCpuSimdFactory : public BaseDetectionPostprocessFactory {
+public:
+  Yolov8PostProcessCpuSimdFactory(const Yolov8PostProcessCpuSimdParams &params) : params_(params)
+  {}
+  std::shared_ptr<IDetectionPostProcess> Create() override
+  {
+    return CreateYolov8PostProcessCpuSimd(params_.input_height, params_.input_width,
+                                          params_.cls_number, params_.nms_config,
+                                          params_.scores_are_logits, params_.downsample_scales);
+  }
+
+private:
+  Yolov8PostProcessCpuSimdParams params_;
+};
+
+std::shared_ptr<BaseDetectionPostprocessFactory> CreateYolov8PostProcessCpuSimdFactory(
+    int                     input_height,
+    int                     input_width,
+    int                     cls_number,
+    const NmsConfig        &nms_config,
+    bool                    scores_are_logits,
+    const std::vector<int> &downsample_scales)
+{
+  Yolov8PostProcessCpuSimdParams params;
+  params.input_height      = input_height;
+  params.input_width       = input_width;
+  params.cls_number        = cls_number;
+  params.nms_config        = nms_config;
+  params.scores_are_logits = scores_are_logits;
+  params.downsample_scales = downsample_scales;
+
+  return std::make_shared<Yolov8PostProcessCpuSimdFactory>(params);
+}
+
+} // namespace easy_deploy
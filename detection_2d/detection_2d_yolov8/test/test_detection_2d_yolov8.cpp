@@ -1,11 +1,233 @@
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <fstream>
+#include <random>
+
+#include "detection_2d_common/byte_tracker.hpp"
+#include "detection_2d_common/cascade_detection.hpp"
+#include "detection_2d_common/fused_preprocess.hpp"
+#include "detection_2d_common/roi_detection.hpp"
+#include "detection_2d_common/tiled_detection.hpp"
 #include "detection_2d_util/detection_2d_util.hpp"
 #include "detection_2d_yolov8/yolov8.hpp"
+#include "detection_2d_yolov8/yolov8_divide_postprocess.hpp"
+#include "detection_2d_yolov8/yolov8_postprocess.hpp"
 #include "test_utils/detection_2d_test_utils.hpp"
 
 using namespace easy_deploy;
 
+// every image of a batch gets the boxes of its own single-image detection, mapped back with its
+// own preprocess scale
+static void test_yolov8_batch_correctness(
+    const std::shared_ptr<BaseDetectionModel>      &model,
+    const std::shared_ptr<BaseBatchDetectionModel> &batch_model,
+    const std::string                              &image_path,
+    float                                           conf_threshold)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+  cv::Mat half_image, flipped_image;
+  cv::resize(image, half_image, {image.cols / 2, image.rows / 2});
+  cv::flip(image, flipped_image, 1);
+  // more images than the batch capacity, so that the last batch is partial
+  std::vector<cv::Mat> images;
+  while (images.size() <= static_cast<size_t>(batch_model->GetMaxBatchSize()))
+  {
+    images.push_back(image);
+    images.push_back(half_image);
+    images.push_back(flipped_image);
+  }
+
+  std::vector<std::vector<BBox2D>> batch_results;
+  ASSERT_TRUE(batch_model->DetectBatch(images, batch_results, conf_threshold));
+  ASSERT_EQ(batch_results.size(), images.size());
+
+  for (size_t i = 0; i < images.size(); ++i)
+  {
+    std::vector<BBox2D> expected;
+    ASSERT_TRUE(model->Detect(images[i], expected, conf_threshold));
+    ASSERT_EQ(batch_results[i].size(), expected.size());
+    auto by_position = [](const BBox2D &a, const BBox2D &b) {
+      return std::make_pair(a.x, a.y) < std::make_pair(b.x, b.y);
+    };
+    std::sort(expected.begin(), expected.end(), by_position);
+    std::sort(batch_results[i].begin(), batch_results[i].end(), by_position);
+    for (size_t j = 0; j < expected.size(); ++j)
+    {
+      EXPECT_NEAR(batch_results[i][j].x, expected[j].x, 1.f);
+      EXPECT_NEAR(batch_results[i][j].y, expected[j].y, 1.f);
+      EXPECT_NEAR(batch_results[i][j].w, expected[j].w, 1.f);
+      EXPECT_NEAR(batch_results[i][j].h, expected[j].h, 1.f);
+      EXPECT_EQ(batch_results[i][j].cls, expected[j].cls);
+    }
+  }
+}
+
+// on the image upscaled 3 times, the tiles find every object of the plain detection, scaled up
+static void test_yolov8_tiled_correctness(const std::shared_ptr<BaseDetectionModel> &model,
+                                          const std::shared_ptr<BaseDetectionModel> &tile_model,
+                                          const std::string                         &image_path,
+                                          float                                      conf_threshold)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+  cv::Mat large_image;
+  cv::resize(image, large_image, {image.cols * 3, image.rows * 3});
+
+  std::vector<BBox2D> expected;
+  ASSERT_TRUE(model->Detect(image, expected, conf_threshold));
+
+  TiledDetectionConfig config;
+  auto                 tiled_model = CreateTiledDetectionModel(tile_model, config);
+  std::vector<BBox2D>  results;
+  ASSERT_TRUE(tiled_model->Detect(large_image, results, conf_threshold));
+  ASSERT_GE(results.size(), expected.size());
+
+  auto iou = [](const BBox2D &a, const BBox2D &b) {
+    const float inter_w = std::max(
+        0.f, std::min(a.x + a.w / 2, b.x + b.w / 2) - std::max(a.x - a.w / 2, b.x - b.w / 2));
+    const float inter_h = std::max(
+        0.f, std::min(a.y + a.h / 2, b.y + b.h / 2) - std::max(a.y - a.h / 2, b.y - b.h / 2));
+    return inter_w * inter_h / (a.w * a.h + b.w * b.h - inter_w * inter_h);
+  };
+  for (auto box : expected)
+  {
+    box.x *= 3;
+    box.y *= 3;
+    box.w *= 3;
+    box.h *= 3;
+    const bool found = std::any_of(results.begin(), results.end(), [&](const BBox2D &result) {
+      return result.cls == box.cls && iou(result, box) > 0.5f;
+    });
+    EXPECT_TRUE(found);
+  }
+  for (const auto &result : results)
+  {
+    EXPECT_GE(result.x, 0.f);
+    EXPECT_GE(result.y, 0.f);
+    EXPECT_LE(result.x, large_image.cols);
+    EXPECT_LE(result.y, large_image.rows);
+  }
+}
+
+// a still camera : the tracks are the confident detections, with the same ids on every frame, the
+// frames between two detections included
+static void test_yolov8_tracked_correctness(const std::shared_ptr<BaseDetectionModel> &model,
+                                            const std::string                         &image_path)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+
+  TrackedDetectionConfig config;
+  config.detect_interval = 2;
+  std::vector<BBox2D> expected;
+  ASSERT_TRUE(model->Detect(image, expected, config.tracker.new_track_thresh));
+  ASSERT_FALSE(expected.empty());
+
+  auto                       tracked_model = CreateTrackedDetectionModel(model, config);
+  std::vector<TrackedBBox2D> first_results;
+  ASSERT_TRUE(tracked_model->Track(image, first_results));
+  ASSERT_EQ(first_results.size(), expected.size());
+  for (int f = 1; f < 6; ++f)
+  {
+    std::vector<TrackedBBox2D> results;
+    ASSERT_TRUE(tracked_model->Track(image, results));
+    ASSERT_EQ(results.size(), first_results.size());
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      EXPECT_EQ(results[i].track_id, first_results[i].track_id);
+      EXPECT_NEAR(results[i].box.x, first_results[i].box.x, 1.f);
+      EXPECT_NEAR(results[i].box.y, first_results[i].box.y, 1.f);
+    }
+  }
+}
+
+// the cascade never escalating gives the results of the small model, always escalating the ones
+// of the large model, and counts the escalations
+static void test_yolov8_cascade_correctness(const std::shared_ptr<BaseDetectionModel> &small_model,
+                                            const std::shared_ptr<BaseDetectionModel> &large_model,
+                                            const std::string                         &image_path,
+                                            float                                      conf_thresh)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+
+  std::vector<BBox2D> small_results, large_results, results;
+  ASSERT_TRUE(small_model->Detect(image, small_results, conf_thresh));
+  ASSERT_TRUE(large_model->Detect(image, large_results, conf_thresh));
+
+  CascadeDetectionConfig config;
+  config.max_ambiguous_num  = INT_MAX;
+  config.max_detections_num = INT_MAX;
+  auto cascade_model        = CreateCascadeDetectionModel(small_model, large_model, config);
+  ASSERT_TRUE(cascade_model->Detect(image, results, conf_thresh));
+  ASSERT_EQ(results.size(), small_results.size());
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    EXPECT_FLOAT_EQ(results[i].x, small_results[i].x);
+    EXPECT_FLOAT_EQ(results[i].conf, small_results[i].conf);
+  }
+  EXPECT_EQ(cascade_model->GetStats().EscalationRate(), 0.f);
+
+  config.max_detections_num = -1;
+  cascade_model             = CreateCascadeDetectionModel(small_model, large_model, config);
+  for (int i = 0; i < 2; ++i)
+  {
+    ASSERT_TRUE(cascade_model->Detect(image, results, conf_thresh));
+    ASSERT_EQ(results.size(), large_results.size());
+  }
+  EXPECT_EQ(cascade_model->GetStats().images, 2ul);
+  EXPECT_EQ(cascade_model->GetStats().EscalationRate(), 1.f);
+}
+
+// the whole frame as region gives the plain detection, and a region gives the objects of the plain
+// detection lying in it, and no box out of it
+static void test_yolov8_roi_correctness(const std::shared_ptr<BaseDetectionModel> &model,
+                                        const std::string                         &image_path,
+                                        float                                      conf_threshold)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+
+  std::vector<BBox2D> expected, results;
+  ASSERT_TRUE(model->Detect(image, expected, conf_threshold));
+
+  auto roi_model = CreateRoiDetectionModel(model);
+  ASSERT_TRUE(roi_model->Detect(image, {}, results, conf_threshold));
+  ASSERT_EQ(results.size(), expected.size());
+  for (const auto &box : expected)
+  {
+    const bool found = std::any_of(results.begin(), results.end(), [&](const BBox2D &result) {
+      return result.cls == box.cls && std::abs(result.x - box.x) < 1.f &&
+             std::abs(result.y - box.y) < 1.f;
+    });
+    EXPECT_TRUE(found);
+  }
+
+  // the left half of the frame
+  const cv::Rect roi(0, 0, image.cols / 2, image.rows);
+  ASSERT_TRUE(roi_model->Detect(image, {roi}, results, conf_threshold));
+  for (const auto &result : results)
+  {
+    EXPECT_LT(result.x, roi.width);
+  }
+  for (const auto &box : expected)
+  {
+    if (box.x + box.w / 2 > roi.width)
+    {
+      continue;
+    }
+    const bool found = std::any_of(results.begin(), results.end(), [&](const BBox2D &result) {
+      return result.cls == box.cls && std::abs(result.x - box.x) < box.w / 4 &&
+             std::abs(result.y - box.y) < box.h / 4;
+    });
+    EXPECT_TRUE(found);
+  }
+}
+
 #define GEN_TEST_CASES(Tag, FixtureClass)                                                      \
   TEST_F(FixtureClass, test_yolov8_##Tag##_correctness)                                        \
   {                                                                                            \
@@ -19,6 +241,13 @@ using namespace easy_deploy;
                                                   test_visual_result_save_path_);              \
   }
 
+#define GEN_BATCH_TEST_CASES(Tag, FixtureClass)                                                \
+  TEST_F(FixtureClass, test_yolov8_##Tag##_batch_correctness)                                  \
+  {                                                                                            \
+    test_yolov8_batch_correctness(yolov8_model_, CreateBatchModel(), test_image_path_,         \
+                                  conf_threshold_);                                            \
+  }
+
 class BaseYolov8Fixture : public testing::Test {
 protected:
   std::shared_ptr<BaseDetectionModel> yolov8_model_;
@@ -58,9 +287,24 @@ public:
     conf_threshold_               = 0.4;
     expected_obj_num_             = 10ul;
   }
+
+  // the engine with a dynamic batch dimension of `tools/yolov8_export_onnx.py` and
+  // `tools/cvt_onnx2trt_all.sh`, only loaded by the tests running batches
+  std::shared_ptr<BaseBatchDetectionModel> CreateBatchModel()
+  {
+    const int max_batch_size = 4;
+    auto      batch_infer_core_factory =
+        CreateTrtInferCoreFactory("/workspace/models/yolov8n_dynamic_batch.engine",
+                                  {{"images", {max_batch_size, 3, 640, 640}}},
+                                  {{"output0", {max_batch_size, 4 + 80, 8400}}});
+    return CreateYolov8DetectionModel(
+        batch_infer_core_factory->Create(), CreateCudaDetPreProcess(),
+        CreateYolov8PostProcessCpuOrigin(640, 640, 80), 640, 640, 3, 80, {"images"}, {"output0"});
+  }
 };
 
 GEN_TEST_CASES(tensorrt, Yolov8_TensorRT_Fixture);
+GEN_BATCH_TEST_CASES(tensorrt, Yolov8_TensorRT_Fixture);
 
 #endif
 
@@ -93,9 +337,69 @@ public:
     conf_threshold_               = 0.4;
     expected_obj_num_             = 11ul;
   }
+
+  // the model with a dynamic batch dimension of `tools/yolov8_export_onnx.py`, only loaded by the
+  // tests running batches
+  std::shared_ptr<BaseBatchDetectionModel> CreateBatchModel()
+  {
+    const int max_batch_size = 4;
+    auto      batch_infer_core_factory =
+        CreateOrtInferCoreFactory("/workspace/models/yolov8n_dynamic_batch.onnx",
+                                  {{"images", {max_batch_size, 3, 640, 640}}},
+                                  {{"output0", {max_batch_size, 4 + 80, 8400}}});
+    return CreateYolov8DetectionModel(
+        batch_infer_core_factory->Create(),
+        CreateCpuDetPreProcess({0, 0, 0}, {255, 255, 255}, true, true),
+        CreateYolov8PostProcessCpuOrigin(640, 640, 80), 640, 640, 3, 80, {"images"}, {"output0"});
+  }
 };
 
 GEN_TEST_CASES(onnxruntime, Yolov8_OnnxRuntime_Fixture);
+GEN_BATCH_TEST_CASES(onnxruntime, Yolov8_OnnxRuntime_Fixture);
+
+TEST_F(Yolov8_OnnxRuntime_Fixture, test_yolov8_onnxruntime_simd_postprocess_correctness)
+{
+  auto model = CreateYolov8DetectionModel(
+      CreateOrtInferCore("/workspace/models/yolov8n.onnx"),
+      CreateCpuDetPreProcess({0, 0, 0}, {255, 255, 255}, true, true),
+      CreateYolov8PostProcessCpuSimd(640, 640, 80), 640, 640, 3, 80, {"images"}, {"output0"});
+  test_detection_2d_algorithm_correctness(model, test_image_path_, conf_threshold_,
+                                          expected_obj_num_, test_visual_result_save_path_);
+}
+
+// the tiles in batches, read in place by the fused preprocess
+TEST_F(Yolov8_OnnxRuntime_Fixture, test_yolov8_onnxruntime_tiled_correctness)
+{
+  const int max_batch_size = 4;
+  auto      batch_infer_core_factory =
+      CreateOrtInferCoreFactory("/workspace/models/yolov8n_dynamic_batch.onnx",
+                                {{"images", {max_batch_size, 3, 640, 640}}},
+                                {{"output0", {max_batch_size, 4 + 80, 8400}}});
+  auto tile_model = CreateYolov8DetectionModel(
+      batch_infer_core_factory->Create(), CreateFusedCpuDetPreProcess(),
+      CreateYolov8PostProcessCpuSimd(640, 640, 80), 640, 640, 3, 80, {"images"}, {"output0"});
+  test_yolov8_tiled_correctness(yolov8_model_, tile_model, test_image_path_, conf_threshold_);
+}
+
+TEST_F(Yolov8_OnnxRuntime_Fixture, test_yolov8_onnxruntime_tracked_correctness)
+{
+  test_yolov8_tracked_correctness(yolov8_model_, test_image_path_);
+}
+
+TEST_F(Yolov8_OnnxRuntime_Fixture, test_yolov8_onnxruntime_cascade_correctness)
+{
+  // yolov8n exported at 320x320
+  auto small_model = CreateYolov8DetectionModel(
+      CreateOrtInferCore("/workspace/models/yolov8n_320.onnx"), CreateFusedCpuDetPreProcess(),
+      CreateYolov8PostProcessCpuSimd(320, 320, 80), 320, 320, 3, 80, {"images"}, {"output0"});
+  test_yolov8_cascade_correctness(small_model, yolov8_model_, test_image_path_, conf_threshold_);
+}
+
+// the regions in batches
+TEST_F(Yolov8_OnnxRuntime_Fixture, test_yolov8_onnxruntime_roi_correctness)
+{
+  test_yolov8_roi_correctness(CreateBatchModel(), test_image_path_, conf_threshold_);
+}
 
 #endif
 
@@ -135,3 +439,380 @@ public:
 GEN_TEST_CASES(rknn, Yolov8_Rknn_Fixture);
 
 #endif
+
+// A channel-major `{4 + cls_number, num_anchors}` output : low background scores, and a few
+// objects each hit by a cluster of overlapping anchors of the same class.
+static std::vector<float> GenerateYolov8Output(int num_anchors, int cls_number, bool logits)
+{
+  std::vector<float>                    output((4 + cls_number) * num_anchors);
+  std::mt19937                          generator(0);
+  std::uniform_real_distribution<float> distribution(0.f, 1.f);
+  for (int i = 0; i < 4 * num_anchors; ++i)
+  {
+    output[i] = 10.f + 600.f * distribution(generator);
+  }
+  for (int i = 4 * num_anchors; i < (4 + cls_number) * num_anchors; ++i)
+  {
+    output[i] = 0.02f * distribution(generator);
+  }
+  for (int object = 0; object < 10; ++object)
+  {
+    const int   cls = object * 7 % cls_number;
+    const float cx = 50.f + 55.f * object, cy = 320.f, w = 40.f, h = 80.f;
+    for (int k = 0; k < 5; ++k)
+    {
+      const int anchor                         = object * 97 + k * 13;
+      output[anchor]                           = cx + k;
+      output[num_anchors + anchor]             = cy - k;
+      output[2 * num_anchors + anchor]         = w;
+      output[3 * num_anchors + anchor]         = h;
+      output[(4 + cls) * num_anchors + anchor] = 0.9f - 0.1f * k;
+    }
+  }
+  if (logits)
+  {
+    for (int i = 4 * num_anchors; i < (4 + cls_number) * num_anchors; ++i)
+    {
+      output[i] = std::log(output[i] / (1.f - output[i]));
+    }
+  }
+  return output;
+}
+
+TEST(Yolov8PostProcessTest, test_simd_decode_matches_naive)
+{
+  // 8400 anchors of a 640x640 input, and an odd count to cover the scalar tails, with the 80
+  // classes of the specialized loops and others
+  for (const int cls_number : {80, 17})
+  {
+    for (const int num_anchors : {8400, 1003})
+    {
+      for (const bool logits : {false, true})
+      {
+        const auto output = GenerateYolov8Output(num_anchors, cls_number, logits);
+        for (const float conf_thresh : {0.01f, 0.25f, 0.6f})
+        {
+          std::vector<DetectionCandidate> expected(num_anchors), candidates(num_anchors);
+
+          const size_t expected_num = DecodeYolov8CandidatesNaive(
+              output.data(), num_anchors, cls_number, conf_thresh, logits, expected.data());
+          const size_t num          = DecodeYolov8Candidates(
+              output.data(), num_anchors, cls_number, conf_thresh, logits, candidates.data());
+          ASSERT_EQ(num, expected_num);
+          for (size_t i = 0; i < num; ++i)
+          {
+            EXPECT_EQ(candidates[i].cls, expected[i].cls);
+            EXPECT_FLOAT_EQ(candidates[i].conf, expected[i].conf);
+            EXPECT_FLOAT_EQ(candidates[i].cx, expected[i].cx);
+            EXPECT_FLOAT_EQ(candidates[i].h, expected[i].h);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(Yolov8PostProcessTest, test_anchor_grid_tables)
+{
+  Yolov8AnchorGrid grid(640, 480, {8, 16, 32});
+  ASSERT_EQ(grid.GetNumAnchors(), 80 * 60 + 40 * 30 + 20 * 15);
+  ASSERT_EQ(grid.GetLevels().size(), 3u);
+  EXPECT_EQ(grid.GetLevels()[1].anchor_offset, 4800);
+  EXPECT_EQ(grid.GetLevels()[2].stride, 32);
+  EXPECT_EQ(grid.GetLevels()[2].width, 15);
+  // the centres of the cells, the one of row 2 and column 5 of stride 16
+  EXPECT_FLOAT_EQ(grid.GetAnchorCx()[0], 4.f);
+  EXPECT_FLOAT_EQ(grid.GetAnchorCy()[0], 4.f);
+  EXPECT_FLOAT_EQ(grid.GetAnchorCx()[4800 + 2 * 30 + 5], 88.f);
+  EXPECT_FLOAT_EQ(grid.GetAnchorCy()[4800 + 2 * 30 + 5], 40.f);
+
+  EXPECT_THROW(Yolov8AnchorGrid(640, 640, {7}), std::invalid_argument);
+  EXPECT_THROW(Yolov8AnchorGrid(640, 640, {}), std::invalid_argument);
+}
+
+TEST(Yolov8PostProcessTest, test_postprocess_keeps_one_box_per_object)
+{
+  for (const bool logits : {false, true})
+  {
+    const auto output      = GenerateYolov8Output(8400, 80, logits);
+    auto       postprocess = CreateYolov8PostProcessCpuSimd(640, 640, 80, NmsConfig(), logits);
+
+    std::vector<BBox2D> results;
+    postprocess->Postprocess({const_cast<float *>(output.data())}, results, 0.25f, 0.5f);
+    ASSERT_EQ(results.size(), 10u);
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      // the best anchor of each cluster, mapped back by the preprocess scale
+      EXPECT_NEAR(results[i].conf, 0.9f, 1e-5f);
+      EXPECT_NEAR(results[i].w, 80.f, 1e-4f);
+      EXPECT_NEAR(results[i].h, 160.f, 1e-4f);
+    }
+  }
+}
+
+TEST(Yolov8PostProcessTest, test_class_thresholds_reject_while_decoding)
+{
+  const auto         output = GenerateYolov8Output(8400, 80, false);
+  std::vector<float> class_conf_thresh(80, 0.25f);
+  // the objects of class 0 score 0.9 at most, all rejected
+  class_conf_thresh[0] = 0.95f;
+
+  std::vector<DetectionCandidate> expected(8400), candidates(8400);
+
+  const size_t expected_num = DecodeYolov8CandidatesNaive(
+      output.data(), 8400, 80, 0.25f, false, expected.data(), class_conf_thresh.data());
+  const size_t num          = DecodeYolov8Candidates(output.data(), 8400, 80, 0.25f, false,
+                                                     candidates.data(), class_conf_thresh.data());
+  ASSERT_EQ(num, expected_num);
+  for (size_t i = 0; i < num; ++i)
+  {
+    EXPECT_NE(candidates[i].cls, 0);
+    EXPECT_EQ(candidates[i].cls, expected[i].cls);
+  }
+
+  // the same through the NMS config of the postprocess
+  NmsConfig nms_config;
+  nms_config.class_conf_thresh = class_conf_thresh;
+  auto                postprocess = CreateYolov8PostProcessCpuSimd(640, 640, 80, nms_config);
+  std::vector<BBox2D> results;
+  postprocess->Postprocess({const_cast<float *>(output.data())}, results, 0.25f, 1.f);
+  EXPECT_EQ(results.size(), 9u);
+}
+
+static int8_t Quantize(float value, const Int8QuantParams &quant)
+{
+  return static_cast<int8_t>(
+      std::max(-128.f, std::min(127.f, std::round(value / quant.scale) + quant.zero_point)));
+}
+
+// The int8 outputs of the rknn "divide" export at 640x640, `{box, cls, sum}` per stride : low
+// background scores, a few ambiguous cells, and three objects per stride, each on two neighbouring
+// cells of the same class with boxes of 4 strides around their anchor.
+static std::vector<std::vector<int8_t>> GenerateYolov8DivideOutputs(
+    int cls_number, std::vector<Int8QuantParams> &quant_params)
+{
+  const Int8QuantParams box_quant{-10, 0.08f}, cls_quant{-128, 1.f / 255},
+      sum_quant{-100, 1.f / 200};
+
+  std::vector<std::vector<int8_t>>      outputs;
+  std::mt19937                          generator(0);
+  std::uniform_real_distribution<float> distribution(0.f, 1.f);
+  quant_params.clear();
+  for (const int stride : {8, 16, 32})
+  {
+    const int           width = 640 / stride;
+    const int           hw    = width * width;
+    std::vector<int8_t> box(64 * hw), cls(cls_number * hw), sum(hw);
+    std::vector<float>  scores(cls_number * hw);
+    for (auto &q : box)
+    {
+      q = static_cast<int8_t>(static_cast<int>(generator() % 256) - 128);
+    }
+    for (auto &score : scores)
+    {
+      score = 0.002f * distribution(generator);
+    }
+    for (int k = 0; k < 50; ++k)
+    {
+      scores[generator() % scores.size()] = 0.05f + 0.5f * distribution(generator);
+    }
+    for (int object = 0; object < 3; ++object)
+    {
+      const int c    = (object * 29 + stride) % cls_number;
+      const int cell = (object * 7 + 3) * width + object * 5 + 2;
+      for (int k = 0; k < 2; ++k)
+      {
+        scores[c * hw + cell + k] = 0.9f - 0.1f * k;
+        for (int bin = 0; bin < 64; ++bin)
+        {
+          box[bin * hw + cell + k] = bin % 16 == 2 ? 127 : -128;
+        }
+      }
+    }
+    for (int cell = 0; cell < hw; ++cell)
+    {
+      float total = 0.f;
+      for (int c = 0; c < cls_number; ++c)
+      {
+        total += scores[c * hw + cell];
+      }
+      sum[cell] = Quantize(std::min(total, 1.f), sum_quant);
+    }
+    for (size_t i = 0; i < scores.size(); ++i)
+    {
+      cls[i] = Quantize(scores[i], cls_quant);
+    }
+    outputs.push_back(std::move(box));
+    outputs.push_back(std::move(cls));
+    outputs.push_back(std::move(sum));
+    quant_params.insert(quant_params.end(), {box_quant, cls_quant, sum_quant});
+  }
+  return outputs;
+}
+
+// The raw int8 outputs of the rknn "divide" export of yolov8n on `persons.jpg`, recorded on the
+// board by `tools/dump_yolov8_divide_output.cpp` : the zero point and the scale of the output
+// tensor attributes, and the values of each output, in the order of the model.
+static bool LoadRecordedYolov8DivideOutputs(std::vector<std::vector<int8_t>> &outputs,
+                                            std::vector<Int8QuantParams>     &quant_params)
+{
+  std::ifstream file("/workspace/test_data/yolov8n_divide_outputs.bin", std::ios::binary);
+  outputs.clear();
+  quant_params.clear();
+  for (const int stride : {8, 16, 32})
+  {
+    const size_t hw = static_cast<size_t>(640 / stride) * (640 / stride);
+    for (const size_t channels : {64, 80, 1})
+    {
+      Int8QuantParams     quant;
+      std::vector<int8_t> output(channels * hw);
+      file.read(reinterpret_cast<char *>(&quant.zero_point), sizeof(quant.zero_point));
+      file.read(reinterpret_cast<char *>(&quant.scale), sizeof(quant.scale));
+      file.read(reinterpret_cast<char *>(output.data()), output.size());
+      outputs.push_back(std::move(output));
+      quant_params.push_back(quant);
+    }
+  }
+  return static_cast<bool>(file);
+}
+
+// `Decode` of the int8 outputs against `DecodeFloat` of the float outputs the runtime would hand
+// out for them
+static void test_yolov8_divide_decode_matches_float(
+    std::vector<std::vector<int8_t>>   &outputs,
+    const std::vector<Int8QuantParams> &quant_params,
+    int                                 cls_number)
+{
+  // the float outputs of the runtime
+  std::vector<std::vector<float>> float_outputs;
+  std::vector<void *>             int8_ptrs, float_ptrs;
+  for (size_t i = 0; i < outputs.size(); ++i)
+  {
+    std::vector<float> dequantized;
+    for (const int8_t q : outputs[i])
+    {
+      dequantized.push_back(Dequantize(q, quant_params[i]));
+    }
+    float_outputs.push_back(std::move(dequantized));
+    int8_ptrs.push_back(outputs[i].data());
+    float_ptrs.push_back(float_outputs[i].data());
+  }
+
+  Yolov8DivideDecoder decoder(640, 640, cls_number, {8, 16, 32}, quant_params);
+  ASSERT_EQ(decoder.GetNumAnchors(), 8400);
+  std::vector<float> class_conf_thresh(cls_number, 0.2f);
+  class_conf_thresh[8] = 0.95f;
+  for (const float *class_thresh : std::vector<const float *>{nullptr, class_conf_thresh.data()})
+  {
+    for (const float conf_thresh : {0.01f, 0.25f, 0.4f, 0.6f})
+    {
+      std::vector<DetectionCandidate> expected(8400), candidates(8400);
+
+      const size_t expected_num =
+          decoder.DecodeFloat(float_ptrs, conf_thresh, expected.data(), class_thresh);
+      const size_t num = decoder.Decode(int8_ptrs, conf_thresh, candidates.data(), class_thresh);
+      ASSERT_EQ(num, expected_num);
+      ASSERT_GT(num, 0u);
+      for (size_t i = 0; i < num; ++i)
+      {
+        EXPECT_EQ(candidates[i].cls, expected[i].cls);
+        EXPECT_FLOAT_EQ(candidates[i].conf, expected[i].conf);
+        EXPECT_NEAR(candidates[i].cx, expected[i].cx, 1e-3f);
+        EXPECT_NEAR(candidates[i].cy, expected[i].cy, 1e-3f);
+        EXPECT_NEAR(candidates[i].w, expected[i].w, 1e-3f);
+        EXPECT_NEAR(candidates[i].h, expected[i].h, 1e-3f);
+      }
+    }
+  }
+}
+
+TEST(Yolov8DividePostProcessTest, test_int8_decode_matches_float)
+{
+  // the 80 classes of the specialized loops, and others
+  for (const int cls_number : {80, 17})
+  {
+    std::vector<Int8QuantParams> quant_params;
+    auto                         outputs = GenerateYolov8DivideOutputs(cls_number, quant_params);
+    test_yolov8_divide_decode_matches_float(outputs, quant_params, cls_number);
+  }
+}
+
+TEST(Yolov8DividePostProcessTest, test_recorded_int8_decode_matches_float)
+{
+  std::vector<std::vector<int8_t>> outputs;
+  std::vector<Int8QuantParams>     quant_params;
+  if (!LoadRecordedYolov8DivideOutputs(outputs, quant_params))
+  {
+    GTEST_SKIP() << "No recorded outputs, run `tools/dump_yolov8_divide_output.cpp` on the board";
+  }
+  test_yolov8_divide_decode_matches_float(outputs, quant_params, 80);
+
+  // and the int8 postprocess keeps the boxes of the float one
+  std::vector<std::vector<float>> float_outputs;
+  std::vector<void *>             int8_ptrs, float_ptrs;
+  for (size_t i = 0; i < outputs.size(); ++i)
+  {
+    std::vector<float> dequantized;
+    for (const int8_t q : outputs[i])
+    {
+      dequantized.push_back(Dequantize(q, quant_params[i]));
+    }
+    float_outputs.push_back(std::move(dequantized));
+    int8_ptrs.push_back(outputs[i].data());
+    float_ptrs.push_back(float_outputs[i].data());
+  }
+  std::vector<BBox2D> expected, results;
+  CreateYolov8PostProcessCpuDivide(640, 640, 80)->Postprocess(float_ptrs, expected, 0.4f, 1.f);
+  CreateYolov8PostProcessCpuDivideInt8(640, 640, 80, quant_params)
+      ->Postprocess(int8_ptrs, results, 0.4f, 1.f);
+  ASSERT_GT(expected.size(), 0u);
+  ASSERT_EQ(results.size(), expected.size());
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    EXPECT_EQ(results[i].cls, expected[i].cls);
+    EXPECT_FLOAT_EQ(results[i].conf, expected[i].conf);
+    EXPECT_NEAR(results[i].x, expected[i].x, 1e-2f);
+    EXPECT_NEAR(results[i].y, expected[i].y, 1e-2f);
+  }
+}
+
+TEST(Yolov8DividePostProcessTest, test_quantized_threshold_agrees_with_dequantize)
+{
+  for (const Int8QuantParams quant : {Int8QuantParams{-128, 1.f / 255},
+                                      Int8QuantParams{-100, 1.f / 200}, Int8QuantParams{3, 0.1f}})
+  {
+    for (const float thresh : {-1.f, 0.f, 0.01f, 0.25f, 0.4f, 0.5f, 1.f, 100.f})
+    {
+      const int q_thresh = QuantizeThreshold(thresh, quant);
+      for (int q = -128; q < 128; ++q)
+      {
+        EXPECT_EQ(q >= q_thresh, Dequantize(static_cast<int8_t>(q), quant) >= thresh);
+      }
+    }
+  }
+}
+
+TEST(Yolov8DividePostProcessTest, test_postprocess_keeps_one_box_per_object)
+{
+  std::vector<Int8QuantParams> quant_params;
+  auto                         outputs = GenerateYolov8DivideOutputs(80, quant_params);
+  std::vector<void *>          output_ptrs;
+  for (auto &output : outputs)
+  {
+    output_ptrs.push_back(output.data());
+  }
+
+  auto postprocess = CreateYolov8PostProcessCpuDivideInt8(640, 640, 80, quant_params);
+  std::vector<BBox2D> results;
+  postprocess->Postprocess(output_ptrs, results, 0.6f, 0.5f);
+  ASSERT_EQ(results.size(), 9u);
+  for (const auto &result : results)
+  {
+    // the best cell of each object, its box of 4 strides mapped back by the preprocess scale
+    EXPECT_NEAR(result.conf, 0.9f, 1e-2f);
+    EXPECT_NEAR(result.w, result.h, 1e-3f);
+    const float stride = result.w / 4 * 0.5f;
+    EXPECT_TRUE(std::abs(stride - 8) < 0.1f || std::abs(stride - 16) < 0.1f ||
+                std::abs(stride - 32) < 0.1f);
+  }
+}
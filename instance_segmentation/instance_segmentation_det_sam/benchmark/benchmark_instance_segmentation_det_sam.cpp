@@ -0,0 +1,187 @@
+#include <benchmark/benchmark.h>
+
+#include "detection_2d_util/detection_2d_util.hpp"
+#include "detection_2d_yolov8/yolov8.hpp"
+#include "instance_segmentation_det_sam/det_sam.hpp"
+#include "sam_mobilesam/mobilesam.hpp"
+
+using namespace easy_deploy;
+
+// Detector + sam on one image, `state.range(0)` selects the pipeline :
+//  0 : sequential baseline, the detector and sam each preprocess the original image, and every
+//      detection is decoded on its own
+//  1 : fused, batched box decoding but no shared pyramid nor concurrent encoding
+//  2 : fused, shared resize pyramid and the encoder running concurrently with the detector
+// Reports the fps and the average latency of every stage.
+static void benchmark_det_sam(benchmark::State                   &state,
+                              std::shared_ptr<BaseDetectionModel> detection_model,
+                              std::shared_ptr<BaseMobileSamModel> sam_model)
+{
+  cv::Mat   image = cv::imread("/workspace/test_data/persons.jpg");
+  const int mode  = state.range(0);
+
+  DetSamConfig config;
+  config.share_resize_pyramid = mode == 2;
+  config.concurrent_encoding  = mode == 2;
+  auto det_sam_model          = CreateDetSamModel(detection_model, sam_model, config);
+
+  std::vector<InstanceSegmentationResult> results;
+  DetSamStageLatency                      latency, latency_sum;
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    sam_model->ClearEmbeddingCache();
+    state.ResumeTiming();
+
+    if (mode == 0)
+    {
+      std::vector<BBox2D> detections;
+      detection_model->Detect(image, detections, config.conf_thresh);
+      for (const auto &box : detections)
+      {
+        cv::Mat mask;
+        sam_model->GenerateMask(image, std::vector<BBox2D>{box}, mask);
+      }
+      continue;
+    }
+
+    det_sam_model->Segment(image, results, false, &latency);
+    latency_sum.pyramid_ms += latency.pyramid_ms;
+    latency_sum.detection_ms += latency.detection_ms;
+    latency_sum.encoder_ms += latency.encoder_ms;
+    latency_sum.detection_encoder_ms += latency.detection_encoder_ms;
+    latency_sum.decoder_ms += latency.decoder_ms;
+    latency_sum.total_ms += latency.total_ms;
+  }
+
+  state.counters["fps"] =
+      benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  if (mode != 0)
+  {
+    const double iterations              = static_cast<double>(state.iterations());
+    state.counters["pyramid_ms"]         = latency_sum.pyramid_ms / iterations;
+    state.counters["detection_ms"]       = latency_sum.detection_ms / iterations;
+    state.counters["encoder_ms"]         = latency_sum.encoder_ms / iterations;
+    state.counters["det_and_encoder_ms"] = latency_sum.detection_encoder_ms / iterations;
+    state.counters["decoder_ms"]         = latency_sum.decoder_ms / iterations;
+    state.counters["total_ms"]           = latency_sum.total_ms / iterations;
+  }
+}
+
+#ifdef ENABLE_TENSORRT
+
+#include "trt_core/trt_core.hpp"
+
+std::shared_ptr<BaseDetectionModel> CreateYolov8TensorRTModel()
+{
+  const int cls_number = 80;
+  return CreateYolov8DetectionModel(CreateTrtInferCore("/workspace/models/yolov8n.engine"),
+                                    CreateCudaDetPreProcess(),
+                                    CreateYolov8PostProcessCpuOrigin(640, 640, cls_number), 640,
+                                    640, 3, cls_number, {"images"}, {"output0"});
+}
+
+std::shared_ptr<BaseMobileSamModel> CreateSAMTensorRTModel()
+{
+  const int SAM_MAX_BOX    = 8;
+  const int SAM_MAX_POINTS = 8;
+
+  auto box_decoder_factory =
+      CreateTrtInferCoreFactory("/workspace/models/modified_mobile_sam_box.engine",
+                                {
+                                    {"image_embeddings", {1, 256, 64, 64}},
+                                    {"boxes", {1, SAM_MAX_BOX, 4}},
+                                    {"mask_input", {1, 1, 256, 256}},
+                                    {"has_mask_input", {1}},
+                                },
+                                {{"masks", {1, SAM_MAX_BOX, 256, 256}},
+                                 {"scores", {1, SAM_MAX_BOX}}});
+
+  auto point_decoder_factory =
+      CreateTrtInferCoreFactory("/workspace/models/modified_mobile_sam_point.engine",
+                                {
+                                    {"image_embeddings", {1, 256, 64, 64}},
+                                    {"point_coords", {1, SAM_MAX_POINTS, 2}},
+                                    {"point_labels", {1, SAM_MAX_POINTS}},
+                                    {"mask_input", {1, 1, 256, 256}},
+                                    {"has_mask_input", {1}},
+                                },
+                                {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
+
+  MobileSamConfig sam_config;
+  sam_config.max_box_number = SAM_MAX_BOX;
+
+  return CreateMobileSamModel(
+      CreateTrtInferCore("/workspace/models/mobile_sam_encoder.engine"),
+      point_decoder_factory->Create(), box_decoder_factory->Create(), CreateCudaDetPreProcess(),
+      kMobileSamEncoderBlobNames, kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames,
+      sam_config);
+}
+
+static void benchmark_det_sam_tensorrt(benchmark::State &state)
+{
+  benchmark_det_sam(state, CreateYolov8TensorRTModel(), CreateSAMTensorRTModel());
+}
+BENCHMARK(benchmark_det_sam_tensorrt)->Arg(0)->Arg(1)->Arg(2)->UseRealTime();
+
+#endif
+
+#ifdef ENABLE_ORT
+
+#include "ort_core/ort_core.hpp"
+
+std::shared_ptr<BaseDetectionModel> CreateYolov8OnnxRuntimeModel()
+{
+  const int cls_number = 80;
+  return CreateYolov8DetectionModel(CreateOrtInferCore("/workspace/models/yolov8n.onnx"),
+                                    CreateCpuDetPreProcess({0, 0, 0}, {255, 255, 255}, true, true),
+                                    CreateYolov8PostProcessCpuOrigin(640, 640, cls_number), 640,
+                                    640, 3, cls_number, {"images"}, {"output0"});
+}
+
+std::shared_ptr<BaseMobileSamModel> CreateSAMOnnxRuntimeModel()
+{
+  const int SAM_MAX_BOX    = 8;
+  const int SAM_MAX_POINTS = 8;
+
+  auto box_decoder_factory =
+      CreateOrtInferCoreFactory("/workspace/models/modified_mobile_sam_box.onnx",
+                                {
+                                    {"image_embeddings", {1, 256, 64, 64}},
+                                    {"boxes", {1, SAM_MAX_BOX, 4}},
+                                    {"mask_input", {1, 1, 256, 256}},
+                                    {"has_mask_input", {1}},
+                                },
+                                {{"masks", {1, SAM_MAX_BOX, 256, 256}},
+                                 {"scores", {1, SAM_MAX_BOX}}});
+
+  auto point_decoder_factory =
+      CreateOrtInferCoreFactory("/workspace/models/modified_mobile_sam_point.onnx",
+                                {
+                                    {"image_embeddings", {1, 256, 64, 64}},
+                                    {"point_coords", {1, SAM_MAX_POINTS, 2}},
+                                    {"point_labels", {1, SAM_MAX_POINTS}},
+                                    {"mask_input", {1, 1, 256, 256}},
+                                    {"has_mask_input", {1}},
+                                },
+                                {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
+
+  MobileSamConfig sam_config;
+  sam_config.max_box_number = SAM_MAX_BOX;
+
+  return CreateMobileSamModel(
+      CreateOrtInferCore("/workspace/models/mobile_sam_encoder.onnx"),
+      point_decoder_factory->Create(), box_decoder_factory->Create(),
+      CreateCpuDetPreProcess({0, 0, 0}, {255, 255, 255}, true, true), kMobileSamEncoderBlobNames,
+      kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames, sam_config);
+}
+
+static void benchmark_det_sam_onnxruntime(benchmark::State &state)
+{
+  benchmark_det_sam(state, CreateYolov8OnnxRuntimeModel(), CreateSAMOnnxRuntimeModel());
+}
+BENCHMARK(benchmark_det_sam_onnxruntime)->Arg(0)->Arg(1)->Arg(2)->UseRealTime();
+
+#endif
+
+BENCHMARK_MAIN();
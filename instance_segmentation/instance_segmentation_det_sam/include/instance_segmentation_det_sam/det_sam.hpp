@@ -0,0 +1,103 @@
+#pragma once
+
+#include "deploy_core/base_detection.hpp"
+#include "deploy_core/base_sam.hpp"
+
+#include "sam_mobilesam/mobilesam.hpp"
+
+namespace easy_deploy {
+
+/**
+ * @brief Optional construction params of the detector + sam instance segmentation model.
+ *
+ */
+struct DetSamConfig {
+  // input sizes of the detector and of the sam encoder, also the levels of the resize pyramid
+  int detection_input_height = 640;
+  int detection_input_width  = 640;
+  int sam_input_height       = 1024;
+  int sam_input_width        = 1024;
+  // detections below it are not segmented
+  float conf_thresh = 0.4f;
+  // resize each image once to the sam level, and the detector level from the sam level, instead
+  // of letting both preprocessors resize the full image
+  bool share_resize_pyramid = true;
+  // run the sam encoder on a worker thread while the detector runs
+  bool concurrent_encoding = true;
+};
+
+/**
+ * @brief One detected instance, its box and its mask in the original image.
+ *
+ */
+struct InstanceSegmentationResult {
+  BBox2D         box;
+  SamCroppedMask mask;
+};
+
+/**
+ * @brief Latency of each stage of one `Segment` call, in milliseconds.
+ *
+ */
+struct DetSamStageLatency {
+  double pyramid_ms   = 0;
+  double detection_ms = 0;
+  double encoder_ms   = 0;
+  // wall time of detection and encoding, close to the max of both if they overlap
+  double detection_encoder_ms = 0;
+  double decoder_ms           = 0;
+  double total_ms             = 0;
+};
+
+/**
+ * @brief Instance segmentation by a 2d detector and a sam model : every detection is a box prompt
+ * of sam. Both models share one resize pyramid of the image, the sam encoder runs concurrently
+ * with the detector, and the detections are decoded in batches.
+ *
+ */
+class BaseDetSamModel {
+public:
+  /**
+   * @brief Detect and segment the instances in `image`.
+   *
+   * @param image
+   * @param results In the order of the detections.
+   * @param isRGB
+   * @param latency Filled if not null.
+   * @return true
+   * @return false
+   */
+  virtual bool Segment(const cv::Mat                           &image,
+                       std::vector<InstanceSegmentationResult> &results,
+                       bool                                     isRGB   = false,
+                       DetSamStageLatency                      *latency = nullptr) = 0;
+
+  virtual ~BaseDetSamModel() = default;
+};
+
+class BaseDetSamFactory {
+public:
+  virtual std::shared_ptr<BaseDetSamModel> Create() = 0;
+
+  virtual ~BaseDetSamFactory() = default;
+};
+
+/**
+ * @brief Create a detector + sam instance segmentation model.
+ *
+ * @param detection_model
+ * @param sam_model Should be a `BaseMobileSamModel`.
+ * @param config
+ * @return std::shared_ptr<BaseDetSamModel>
+ */
+std::shared_ptr<BaseDetSamModel> CreateDetSamModel(
+    const std::shared_ptr<BaseDetectionModel> &detection_model,
+    const std::shared_ptr<BaseSamModel>       &sam_model,
+    const DetSamConfig                        &config = {});
+
+std::shared_ptr<BaseDetSamFactory> CreateDetSamModelFactory(
+    std::shared_ptr<BaseDetection2DFactory> detection_factory,
+    std::shared_ptr<BaseSamFactory>         sam_factory,
+    const DetSamConfig                     &config = {});
+
+} // namespace easy_deploy
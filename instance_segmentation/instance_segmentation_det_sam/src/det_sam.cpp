@@ -0,0 +1,190 @@
+#include "instance_segmentation_det_sam/det_sam.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+
+namespace easy_deploy {
+
+static double ElapsedMs(const std::chrono::steady_clock::time_point &begin)
+{
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin)
+      .count();
+}
+
+class DetSam : public BaseDetSamModel {
+public:
+  DetSam(const std::shared_ptr<BaseDetectionModel> &detection_model,
+         const std::shared_ptr<BaseSamModel>       &sam_model,
+         const DetSamConfig                        &config);
+
+  bool Segment(const cv::Mat                           &image,
+               std::vector<InstanceSegmentationResult> &results,
+               bool                                     isRGB,
+               DetSamStageLatency                      *latency) override;
+
+private:
+  // a level of the resize pyramid : `image` is the original image resized by `scale`, its sides
+  // rounded to `scale_x/scale_y`
+  struct PyramidLevel {
+    cv::Mat image;
+    float   scale   = 1.f;
+    float   scale_x = 1.f;
+    float   scale_y = 1.f;
+  };
+
+  // the original `image` resized to fit in `height x width`, never upscaled. It is resized from
+  // the smaller `source` level if that is large enough.
+  static PyramidLevel MakePyramidLevel(const cv::Mat      &image,
+                                       const PyramidLevel &source,
+                                       int                 height,
+                                       int                 width);
+
+private:
+  const std::shared_ptr<BaseDetectionModel> detection_model_;
+  const std::shared_ptr<BaseMobileSamModel> sam_model_;
+  const DetSamConfig                        config_;
+};
+
+DetSam::DetSam(const std::shared_ptr<BaseDetectionModel> &detection_model,
+               const std::shared_ptr<BaseSamModel>       &sam_model,
+               const DetSamConfig                        &config)
+    : detection_model_(detection_model),
+      sam_model_(std::dynamic_pointer_cast<BaseMobileSamModel>(sam_model)),
+      config_(config)
+{
+  if (detection_model_ == nullptr)
+  {
+    throw std::invalid_argument("[DetSam] Got INVALID detection model ptr!!!");
+  }
+  if (sam_model_ == nullptr)
+  {
+    throw std::invalid_argument("[DetSam] sam model should be a `BaseMobileSamModel`!!!");
+  }
+  if (config_.detection_input_height <= 0 || config_.detection_input_width <= 0 ||
+      config_.sam_input_height <= 0 || config_.sam_input_width <= 0)
+  {
+    throw std::invalid_argument("[DetSam] input sizes should be positive!!!");
+  }
+}
+
+DetSam::PyramidLevel DetSam::MakePyramidLevel(const cv::Mat      &image,
+                                              const PyramidLevel &source,
+                                              int                 height,
+                                              int                 width)
+{
+  const float scale = std::min(1.f, std::min(static_cast<float>(height) / image.rows,
+                                             static_cast<float>(width) / image.cols));
+  const int   level_width  = std::max(1, static_cast<int>(std::round(image.cols * scale)));
+  const int   level_height = std::max(1, static_cast<int>(std::round(image.rows * scale)));
+  if (level_width == source.image.cols && level_height == source.image.rows)
+  {
+    return source;
+  }
+
+  const cv::Mat &resize_source =
+      source.image.cols >= level_width && source.image.rows >= level_height ? source.image : image;
+  PyramidLevel level;
+  cv::resize(resize_source, level.image, {level_width, level_height});
+  level.scale   = scale;
+  level.scale_x = static_cast<float>(level_width) / image.cols;
+  level.scale_y = static_cast<float>(level_height) / image.rows;
+  return level;
+}
+
+bool DetSam::Segment(const cv::Mat                           &image,
+                     std::vector<InstanceSegmentationResult> &results,
+                     bool                                     isRGB,
+                     DetSamStageLatency                      *latency)
+{
+  CHECK_STATE(!image.empty(), "[DetSam] Segment got empty image!!!");
+  DetSamStageLatency stage_latency;
+  const auto         total_begin = std::chrono::steady_clock::now();
+
+  // 1. Resize pyramid : original -> sam level -> detection level, the full image is resized once
+  // and the preprocessors only pad the levels
+  PyramidLevel original;
+  original.image               = image;
+  PyramidLevel sam_level       = original;
+  PyramidLevel detection_level = original;
+  if (config_.share_resize_pyramid)
+  {
+    const auto begin = std::chrono::steady_clock::now();
+    sam_level =
+        MakePyramidLevel(image, original, config_.sam_input_height, config_.sam_input_width);
+    detection_level = MakePyramidLevel(image, sam_level, config_.detection_input_height,
+                                       config_.detection_input_width);
+    stage_latency.pyramid_ms = ElapsedMs(begin);
+  }
+
+  // 2. Encode while detecting
+  const auto detection_encoder_begin = std::chrono::steady_clock::now();
+  auto       encode                  = [&]() {
+    const auto begin     = std::chrono::steady_clock::now();
+    // sam keeps the aspect ratio, the level is encoded at its unrounded scale
+    auto embedding = sam_model_->EncodeScaledImage(sam_level.image, sam_level.scale, image.size(),
+                                                   "", isRGB);
+    stage_latency.encoder_ms = ElapsedMs(begin);
+    return embedding;
+  };
+  std::future<std::shared_ptr<const SamImageEmbedding>> embedding_future;
+  if (config_.concurrent_encoding)
+  {
+    embedding_future = std::async(std::launch::async, encode);
+  }
+
+  std::vector<BBox2D> detections;
+  const auto          detection_begin = std::chrono::steady_clock::now();
+  const bool          detected =
+      detection_model_->Detect(detection_level.image, detections, config_.conf_thresh, isRGB);
+  stage_latency.detection_ms = ElapsedMs(detection_begin);
+
+  auto embedding = config_.concurrent_encoding ? embedding_future.get() : encode();
+  stage_latency.detection_encoder_ms = ElapsedMs(detection_encoder_begin);
+  CHECK_STATE(detected, "[DetSam] Segment detection failed!!!");
+  CHECK_STATE(embedding != nullptr, "[DetSam] Segment image encoding failed!!!");
+
+  // 3. Detections back to the original image, then decoded in batches
+  for (auto &box : detections)
+  {
+    box.x /= detection_level.scale_x;
+    box.w /= detection_level.scale_x;
+    box.y /= detection_level.scale_y;
+    box.h /= detection_level.scale_y;
+  }
+
+  results.clear();
+  if (!detections.empty())
+  {
+    const auto                  begin = std::chrono::steady_clock::now();
+    std::vector<SamCroppedMask> masks;
+    CHECK_STATE(sam_model_->DecodeCroppedMasks(embedding, detections, masks),
+                "[DetSam] Segment mask decoding failed!!!");
+    stage_latency.decoder_ms = ElapsedMs(begin);
+
+    results.resize(detections.size());
+    for (size_t i = 0; i < detections.size(); ++i)
+    {
+      results[i].box  = detections[i];
+      results[i].mask = std::move(masks[i]);
+    }
+  }
+
+  stage_latency.total_ms = ElapsedMs(total_begin);
+  if (latency != nullptr)
+  {
+    *latency = stage_latency;
+  }
+  return true;
+}
+
+std::shared_ptr<BaseDetSamModel> CreateDetSamModel(
+    const std::shared_ptr<BaseDetectionModel> &detection_model,
+    const std::shared_ptr<BaseSamModel>       &sam_model,
+    const DetSamConfig                        &config)
+{
+  return std::make_shared<DetSam>(detection_model, sam_model, config);
+}
+
+} // namespace easy_deploy
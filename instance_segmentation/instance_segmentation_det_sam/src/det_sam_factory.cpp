@@ -0,0 +1,44 @@
+#include "instance_segmentation_det_sam/det_sam.hpp"
+
+namespace easy_deploy {
+
+struct DetSamParams {
+  std::shared_ptr<BaseDetection2DFactory> detection_factory;
+  std::shared_ptr<BaseSamFactory>         sam_factory;
+  DetSamConfig                            config;
+};
+
+class DetSamFactory : public BaseDetSamFactory {
+public:
+  DetSamFactory(const DetSamParams &params) : params_(params)
+  {}
+
+  std::shared_ptr<BaseDetSamModel> Create() override
+  {
+    return CreateDetSamModel(params_.detection_factory->Create(), params_.sam_factory->Create(),
+                             params_.config);
+  }
+
+private:
+  DetSamParams params_;
+};
+
+std::shared_ptr<BaseDetSamFactory> CreateDetSamModelFactory(
+    std::shared_ptr<BaseDetection2DFactory> detection_factory,
+    std::shared_ptr<BaseSamFactory>         sam_factory,
+    const DetSamConfig                     &config)
+{
+  if (detection_factory == nullptr || sam_factory == nullptr)
+  {
+    throw std::invalid_argument("[CreateDetSamModelFactory] Got invalid input arguments!");
+  }
+
+  DetSamParams params;
+  params.detection_factory = detection_factory;
+  params.sam_factory       = sam_factory;
+  params.config            = config;
+
+  return std::make_shared<DetSamFactory>(params);
+}
+
+} // namespace easy_deploy
@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+
+#include "detection_2d_util/detection_2d_util.hpp"
+#include "detection_2d_yolov8/yolov8.hpp"
+#include "instance_segmentation_det_sam/det_sam.hpp"
+#include "sam_mobilesam/mobilesam.hpp"
+
+using namespace easy_deploy;
+
+static cv::Mat ToDenseMask(const SamCroppedMask &mask, const cv::Size &image_size)
+{
+  cv::Mat dense_mask = cv::Mat::zeros(image_size, CV_8UC1);
+  if (!mask.roi.empty())
+  {
+    mask.mask.copyTo(dense_mask(mask.roi));
+  }
+  return dense_mask;
+}
+
+static float ComputeMaskIoU(const cv::Mat &mask_a, const cv::Mat &mask_b)
+{
+  const int intersection = cv::countNonZero(mask_a & mask_b);
+  const int union_area   = cv::countNonZero(mask_a | mask_b);
+  return union_area == 0 ? 1.f : static_cast<float>(intersection) / union_area;
+}
+
+// every detection gets a mask in its box, and the masks decoded from the shared resize pyramid
+// match the masks of the same boxes decoded from the original image
+static void test_det_sam_correctness(const std::shared_ptr<BaseDetectionModel> &detection_model,
+                                     const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                                     const std::string                         &image_path,
+                                     size_t                                     min_obj_num)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+
+  auto det_sam_model = CreateDetSamModel(detection_model, sam_model);
+
+  std::vector<InstanceSegmentationResult> results;
+  DetSamStageLatency                      latency;
+  ASSERT_TRUE(det_sam_model->Segment(image, results, false, &latency));
+  EXPECT_GE(results.size(), min_obj_num);
+  EXPECT_GT(latency.detection_ms, 0);
+  EXPECT_GT(latency.encoder_ms, 0);
+  EXPECT_LE(latency.detection_encoder_ms, latency.total_ms);
+
+  const cv::Rect      image_rect(0, 0, image.cols, image.rows);
+  std::vector<BBox2D> boxes;
+  for (const auto &result : results)
+  {
+    const auto    &box = result.box;
+    const cv::Rect box_rect(box.x - box.w / 2, box.y - box.h / 2, box.w, box.h);
+    EXPECT_EQ(result.mask.roi & image_rect, result.mask.roi);
+    EXPECT_FALSE((result.mask.roi & box_rect).empty());
+    boxes.push_back(box);
+  }
+
+  auto embedding = sam_model->EncodeImage(image);
+  ASSERT_NE(embedding, nullptr);
+  std::vector<SamCroppedMask> expected_masks;
+  ASSERT_TRUE(sam_model->DecodeCroppedMasks(embedding, boxes, expected_masks));
+  for (size_t i = 0; i < results.size(); ++i)
+  {
+    EXPECT_GT(ComputeMaskIoU(ToDenseMask(results[i].mask, image.size()),
+                             ToDenseMask(expected_masks[i], image.size())),
+              0.9f);
+  }
+
+  // the same detections without the pyramid nor the concurrent encoding
+  DetSamConfig sequential_config;
+  sequential_config.share_resize_pyramid = false;
+  sequential_config.concurrent_encoding  = false;
+  std::vector<InstanceSegmentationResult> sequential_results;
+  ASSERT_TRUE(CreateDetSamModel(detection_model, sam_model, sequential_config)
+                  ->Segment(image, sequential_results));
+  EXPECT_GE(sequential_results.size(), min_obj_num);
+}
+
+#define GEN_TEST_CASES(Tag, FixtureClass)                                                   \
+  TEST_F(FixtureClass, test_det_sam_##Tag##_correctness)                                    \
+  {                                                                                         \
+    test_det_sam_correctness(yolov8_model_, mobilesam_model_, test_image_path_,             \
+                             min_obj_num_);                                                 \
+  }
+
+class BaseDetSamFixture : public testing::Test {
+protected:
+  std::shared_ptr<BaseDetectionModel> yolov8_model_;
+  std::shared_ptr<BaseMobileSamModel> mobilesam_model_;
+
+  std::string test_image_path_;
+  size_t      min_obj_num_;
+};
+
+#ifdef ENABLE_TENSORRT
+
+#include "trt_core/trt_core.hpp"
+
+class DetSam_TensorRT_Fixture : public BaseDetSamFixture {
+public:
+  void SetUp() override
+  {
+    yolov8_model_ = CreateYolov8DetectionModel(
+        CreateTrtInferCore("/workspace/models/yolov8n.engine"), CreateCudaDetPreProcess(),
+        CreateYolov8PostProcessCpuOrigin(640, 640, 80), 640, 640, 3, 80, {"images"},
+        {"output0"});
+
+    const int SAM_MAX_BOX    = 8;
+    const int SAM_MAX_POINTS = 8;
+
+    auto box_decoder_factory =
+        CreateTrtInferCoreFactory("/workspace/models/modified_mobile_sam_box.engine",
+                                  {
+                                      {"image_embeddings", {1, 256, 64, 64}},
+                                      {"boxes", {1, SAM_MAX_BOX, 4}},
+                                      {"mask_input", {1, 1, 256, 256}},
+                                      {"has_mask_input", {1}},
+                                  },
+                                  {{"masks", {1, SAM_MAX_BOX, 256, 256}},
+                                   {"scores", {1, SAM_MAX_BOX}}});
+
+    auto point_decoder_factory =
+        CreateTrtInferCoreFactory("/workspace/models/modified_mobile_sam_point.engine",
+                                  {
+                                      {"image_embeddings", {1, 256, 64, 64}},
+                                      {"point_coords", {1, SAM_MAX_POINTS, 2}},
+                                      {"point_labels", {1, SAM_MAX_POINTS}},
+                                      {"mask_input", {1, 1, 256, 256}},
+                                      {"has_mask_input", {1}},
+                                  },
+                                  {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
+
+    MobileSamConfig sam_config;
+    sam_config.max_box_number = SAM_MAX_BOX;
+
+    mobilesam_model_ = CreateMobileSamModel(
+        CreateTrtInferCore("/workspace/models/mobile_sam_encoder.engine"),
+        point_decoder_factory->Create(), box_decoder_factory->Create(), CreateCudaDetPreProcess(),
+        kMobileSamEncoderBlobNames, kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames,
+        sam_config);
+
+    test_image_path_ = "/workspace/test_data/persons.jpg";
+    min_obj_num_     = 5ul;
+  }
+};
+
+GEN_TEST_CASES(tensorrt, DetSam_TensorRT_Fixture);
+
+#endif
+
+#ifdef ENABLE_ORT
+
+#include "ort_core/ort_core.hpp"
+
+class DetSam_OnnxRuntime_Fixture : public BaseDetSamFixture {
+public:
+  void SetUp() override
+  {
+    yolov8_model_ = CreateYolov8DetectionModel(
+        CreateOrtInferCore("/workspace/models/yolov8n.onnx"),
+        CreateCpuDetPreProcess({0, 0, 0}, {255, 255, 255}, true, true),
+        CreateYolov8PostProcessCpuOrigin(640, 640, 80), 640, 640, 3, 80, {"images"},
+        {"output0"});
+
+    const int SAM_MAX_BOX    = 8;
+    const int SAM_MAX_POINTS = 8;
+
+    auto box_decoder_factory =
+        CreateOrtInferCoreFactory("/workspace/models/modified_mobile_sam_box.onnx",
+                                  {
+                                      {"image_embeddings", {1, 256, 64, 64}},
+                                      {"boxes", {1, SAM_MAX_BOX, 4}},
+                                      {"mask_input", {1, 1, 256, 256}},
+                                      {"has_mask_input", {1}},
+                                  },
+                                  {{"masks", {1, SAM_MAX_BOX, 256, 256}},
+                                   {"scores", {1, SAM_MAX_BOX}}});
+
+    auto point_decoder_factory =
+        CreateOrtInferCoreFactory("/workspace/models/modified_mobile_sam_point.onnx",
+                                  {
+                                      {"image_embeddings", {1, 256, 64, 64}},
+                                      {"point_coords", {1, SAM_MAX_POINTS, 2}},
+                                      {"point_labels", {1, SAM_MAX_POINTS}},
+                                      {"mask_input", {1, 1, 256, 256}},
+                                      {"has_mask_input", {1}},
+                                  },
+                                  {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
+
+    MobileSamConfig sam_config;
+    sam_config.max_box_number = SAM_MAX_BOX;
+
+    mobilesam_model_ = CreateMobileSamModel(
+        CreateOrtInferCore("/workspace/models/mobile_sam_encoder.onnx"),
+        point_decoder_factory->Create(), box_decoder_factory->Create(),
+        CreateCpuDetPreProcess({0, 0, 0}, {255, 255, 255}, true, true), kMobileSamEncoderBlobNames,
+        kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames, sam_config);
+
+    test_image_path_ = "/workspace/test_data/persons.jpg";
+    min_obj_num_     = 5ul;
+  }
+};
+
+GEN_TEST_CASES(onnxruntime, DetSam_OnnxRuntime_Fixture);
+
+#endif
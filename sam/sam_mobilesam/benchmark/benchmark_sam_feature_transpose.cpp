@@ -0,0 +1,57 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+#include "sam_mobilesam/feature_transpose.hpp"
+
+using namespace easy_deploy;
+
+// MobileSam image features : {1, 256, 64, 64}
+static constexpr int kFeatureChannels = 256;
+static constexpr int kFeatureHeight   = 64;
+static constexpr int kFeatureWidth    = 64;
+
+static std::vector<float> GenerateFeatures()
+{
+  std::vector<float>                    features(kFeatureChannels * kFeatureHeight * kFeatureWidth);
+  std::mt19937                          generator(0);
+  std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+  for (auto &value : features)
+  {
+    value = distribution(generator);
+  }
+  return features;
+}
+
+static void benchmark_sam_feature_transpose_naive(benchmark::State &state)
+{
+  const auto         nchw = GenerateFeatures();
+  std::vector<float> nhwc(nchw.size());
+  for (auto _ : state)
+  {
+    TransposeNchwToNhwcNaive(nchw.data(), nhwc.data(), 1, kFeatureChannels, kFeatureHeight,
+                             kFeatureWidth);
+    benchmark::DoNotOptimize(nhwc.data());
+  }
+  state.SetBytesProcessed(state.iterations() * nchw.size() * sizeof(float));
+}
+
+// `state.range(0)` is the number of threads
+static void benchmark_sam_feature_transpose_tiled(benchmark::State &state)
+{
+  const auto         nchw = GenerateFeatures();
+  std::vector<float> nhwc(nchw.size());
+  for (auto _ : state)
+  {
+    TransposeNchwToNhwc(nchw.data(), nhwc.data(), 1, kFeatureChannels, kFeatureHeight,
+                        kFeatureWidth, state.range(0));
+    benchmark::DoNotOptimize(nhwc.data());
+  }
+  state.SetBytesProcessed(state.iterations() * nchw.size() * sizeof(float));
+}
+
+BENCHMARK(benchmark_sam_feature_transpose_naive)->UseRealTime();
+BENCHMARK(benchmark_sam_feature_transpose_tiled)->Arg(1)->Arg(2)->Arg(4)->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,139 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "sam_mobilesam/mask_postprocess.hpp"
+
+using namespace easy_deploy;
+
+// MobileSam low-res mask : {256, 256} logits of the {1024, 1024} encoder input
+static constexpr int kLowResSize = 256;
+static constexpr int kInputSize  = 1024;
+
+// an object blob with noisy edges, in the logits value range
+static std::vector<float> GenerateLogits()
+{
+  std::vector<float>              logits(kLowResSize * kLowResSize);
+  std::mt19937                    generator(0);
+  std::normal_distribution<float> noise(0.f, 3.f);
+  for (int y = 0; y < kLowResSize; ++y)
+  {
+    for (int x = 0; x < kLowResSize; ++x)
+    {
+      logits[y * kLowResSize + x] = 60.f - std::hypot(y - 80.f, x - 100.f) + noise(generator);
+    }
+  }
+  return logits;
+}
+
+// `state.range(0)`/`state.range(1)` are the original image height/width
+static SamMaskGeometry MakeGeometry(const benchmark::State &state)
+{
+  SamMaskGeometry geometry;
+  geometry.low_res_height = kLowResSize;
+  geometry.low_res_width  = kLowResSize;
+  geometry.input_height   = kInputSize;
+  geometry.input_width    = kInputSize;
+  geometry.image_height   = state.range(0);
+  geometry.image_width    = state.range(1);
+  geometry.scale          = static_cast<float>(kInputSize) /
+                   std::max(geometry.image_height, geometry.image_width);
+  return geometry;
+}
+
+static void benchmark_sam_mask_postprocess_reference(benchmark::State &state)
+{
+  const auto logits   = GenerateLogits();
+  const auto geometry = MakeGeometry(state);
+  cv::Mat    mask;
+  for (auto _ : state)
+  {
+    ConvertLowResMaskReference(logits.data(), geometry, mask);
+    benchmark::DoNotOptimize(mask.data);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void benchmark_sam_mask_postprocess_fused(benchmark::State &state)
+{
+  const auto logits   = GenerateLogits();
+  const auto geometry = MakeGeometry(state);
+  cv::Mat    mask;
+  for (auto _ : state)
+  {
+    ConvertLowResMaskFused(logits.data(), geometry, mask);
+    benchmark::DoNotOptimize(mask.data);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// a box prompt covering 2% of the image around the object
+static cv::Rect MakeSmallObjectRoi(const SamMaskGeometry &geometry)
+{
+  const float ratio = std::sqrt(0.02f);
+  const int   w     = geometry.image_width * ratio;
+  const int   h     = geometry.image_height * ratio;
+  const int   cx    = (100.f + 0.5f) * kInputSize / kLowResSize / geometry.scale;
+  const int   cy    = (80.f + 0.5f) * kInputSize / kLowResSize / geometry.scale;
+  return cv::Rect(cx - w / 2, cy - h / 2, w, h);
+}
+
+static void benchmark_sam_mask_postprocess_cropped(benchmark::State &state)
+{
+  const auto     logits   = GenerateLogits();
+  const auto     geometry = MakeGeometry(state);
+  const auto     roi      = MakeSmallObjectRoi(geometry);
+  SamCroppedMask mask;
+  for (auto _ : state)
+  {
+    ConvertLowResMaskCropped(logits.data(), geometry, roi, mask);
+    benchmark::DoNotOptimize(mask.mask.data);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void benchmark_sam_mask_postprocess_rle(benchmark::State &state)
+{
+  const auto logits   = GenerateLogits();
+  const auto geometry = MakeGeometry(state);
+  const auto roi      = MakeSmallObjectRoi(geometry);
+  SamRleMask mask;
+  for (auto _ : state)
+  {
+    ConvertLowResMaskRle(logits.data(), geometry, roi, mask);
+    benchmark::DoNotOptimize(mask.counts.data());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// 720p, 1080p, 4K
+BENCHMARK(benchmark_sam_mask_postprocess_reference)
+    ->Args({720, 1280})
+    ->Args({1080, 1920})
+    ->Args({2160, 3840})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(benchmark_sam_mask_postprocess_fused)
+    ->Args({720, 1280})
+    ->Args({1080, 1920})
+    ->Args({2160, 3840})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK(benchmark_sam_mask_postprocess_cropped)
+    ->Args({720, 1280})
+    ->Args({1080, 1920})
+    ->Args({2160, 3840})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(benchmark_sam_mask_postprocess_rle)
+    ->Args({720, 1280})
+    ->Args({1080, 1920})
+    ->Args({2160, 3840})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -2,22 +2,317 @@
 
 #include "detection_2d_util/detection_2d_util.hpp"
 #include "sam_mobilesam/mobilesam.hpp"
+#include "sam_mobilesam/video_sam.hpp"
 #include "benchmark_utils/sam_benchmark_utils.hpp"
 
 using namespace easy_deploy;
 
+// Encode once and decode with `state.range(0)` prompts, as the interactive labelling does on one
+// frame. All but the first `EncodeImage` should hit the embedding cache.
+static void benchmark_sam_cached_prompts(benchmark::State                    &state,
+                                         std::shared_ptr<BaseMobileSamModel> sam_model)
+{
+  cv::Mat image = cv::imread("/workspace/test_data/persons.jpg");
+  BBox2D  box;
+  box.x = 225;
+  box.y = 370;
+  box.w = 110;
+  box.h = 300;
+
+  const int prompt_number = state.range(0);
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    sam_model->ClearEmbeddingCache();
+    state.ResumeTiming();
+    for (int i = 0; i < prompt_number; ++i)
+    {
+      auto    embedding = sam_model->EncodeImage(image);
+      cv::Mat mask;
+      sam_model->DecodeMask(embedding, {box}, mask);
+    }
+  }
+
+  const auto stats              = sam_model->GetEmbeddingCacheStats();
+  state.counters["cache_hits"]  = stats.hits;
+  state.counters["cache_miss"]  = stats.misses;
+  state.counters["prompts/sec"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * prompt_number), benchmark::Counter::kIsRate);
+}
+
+// Masks/sec against box number on one encoded image. `state.range(0)` is the box number,
+// `state.range(1)` selects batched decoding (1) or one decoder call per box (0).
+static void benchmark_sam_multi_box(benchmark::State                    &state,
+                                    std::shared_ptr<BaseMobileSamModel> sam_model)
+{
+  cv::Mat image = cv::imread("/workspace/test_data/persons.jpg");
+
+  const int           box_number = state.range(0);
+  const bool          batched    = state.range(1) != 0;
+  std::vector<BBox2D> boxes;
+  for (int i = 0; i < box_number; ++i)
+  {
+    BBox2D box;
+    box.x = 60 + (i * 97) % (image.cols - 120);
+    box.y = image.rows / 2;
+    box.w = 110;
+    box.h = 300;
+    boxes.push_back(box);
+  }
+
+  auto embedding = sam_model->EncodeImage(image);
+  for (auto _ : state)
+  {
+    std::vector<cv::Mat> masks;
+    if (batched)
+    {
+      sam_model->DecodeMasks(embedding, boxes, masks);
+    } else
+    {
+      for (const auto &box : boxes)
+      {
+        cv::Mat mask;
+        sam_model->DecodeMask(embedding, {box}, mask);
+        masks.push_back(mask);
+      }
+    }
+  }
+
+  state.counters["masks/sec"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * box_number), benchmark::Counter::kIsRate);
+}
+
+// Frames/sec of the pipelined execution, `state.range(0)` frames are queued per iteration so the
+// encoder of a frame overlaps the decoder of the previous one. Reports the stage utilisation.
+static void benchmark_sam_pipelined(benchmark::State                    &state,
+                                    std::shared_ptr<BaseMobileSamModel> sam_model)
+{
+  cv::Mat image = cv::imread("/workspace/test_data/persons.jpg");
+  BBox2D  box;
+  box.x = 225;
+  box.y = 370;
+  box.w = 110;
+  box.h = 300;
+
+  const int frame_number = state.range(0);
+  for (auto _ : state)
+  {
+    std::vector<std::future<std::vector<cv::Mat>>> futures;
+    for (int i = 0; i < frame_number; ++i)
+    {
+      futures.push_back(sam_model->GenerateMasksPipelined(image, {box}));
+    }
+    for (auto &future : futures)
+    {
+      future.get();
+    }
+  }
+
+  state.counters["fps"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * frame_number), benchmark::Counter::kIsRate);
+  for (const auto &stage_stats : sam_model->GetPipelineStats())
+  {
+    state.counters[stage_stats.stage + "_util"] = stage_stats.utilisation;
+  }
+}
+
+// Point decoding latency while the prompt number changes every call, cycling from 1 to
+// `state.range(0)` points, as clicks are added in interactive labelling. Compare a model with and
+// without prompt buckets.
+static void benchmark_sam_prompt_bucketing(benchmark::State                    &state,
+                                           std::shared_ptr<BaseMobileSamModel> sam_model)
+{
+  cv::Mat image = cv::imread("/workspace/test_data/persons.jpg");
+
+  const int                        max_point_number = state.range(0);
+  std::vector<std::pair<int, int>> points;
+  std::vector<int>                 labels;
+  for (int i = 0; i < max_point_number; ++i)
+  {
+    points.emplace_back(225 + (i % 2) * 20, 370 + i * 30);
+    labels.push_back(1);
+  }
+
+  auto embedding    = sam_model->EncodeImage(image);
+  int  point_number = 0;
+  for (auto _ : state)
+  {
+    point_number = point_number % max_point_number + 1;
+    const std::vector<std::pair<int, int>> prompt_points(points.begin(),
+                                                         points.begin() + point_number);
+    const std::vector<int> prompt_labels(labels.begin(), labels.begin() + point_number);
+    cv::Mat                mask;
+    sam_model->DecodeMask(embedding, prompt_points, prompt_labels, mask);
+  }
+
+  state.counters["decodes/sec"] =
+      benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+// Interactive clicks on one encoded image, cycling from 1 to `state.range(0)` clicks per object.
+// `state.range(1)` selects refinement (1), each click decoded alone against the previous mask,
+// or re-sending the whole click history (0) every time.
+static void benchmark_sam_refinement(benchmark::State                    &state,
+                                     std::shared_ptr<BaseMobileSamModel> sam_model)
+{
+  cv::Mat image = cv::imread("/workspace/test_data/persons.jpg");
+
+  const int                        max_click_number = state.range(0);
+  const bool                       refine           = state.range(1) != 0;
+  std::vector<std::pair<int, int>> points;
+  std::vector<int>                 labels;
+  for (int i = 0; i < max_click_number; ++i)
+  {
+    points.emplace_back(225 + (i % 2) * 20, 370 + i * 30);
+    labels.push_back(1);
+  }
+
+  SamRefinementSession session;
+  session.embedding = sam_model->EncodeImage(image);
+  int click_number  = 0;
+  for (auto _ : state)
+  {
+    click_number = click_number % max_click_number + 1;
+    cv::Mat mask;
+    if (refine)
+    {
+      if (click_number == 1)
+      {
+        session.Reset();
+      }
+      sam_model->RefineMask(session, {points[click_number - 1]}, {labels[click_number - 1]},
+                            mask);
+    } else
+    {
+      const std::vector<std::pair<int, int>> history_points(points.begin(),
+                                                            points.begin() + click_number);
+      const std::vector<int> history_labels(labels.begin(), labels.begin() + click_number);
+      sam_model->DecodeMask(session.embedding, history_points, history_labels, mask);
+    }
+  }
+
+  state.counters["clicks/sec"] =
+      benchmark::Counter(static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+// Automatic mask generation on one image, `state.range(0)` points per side of the grid,
+// `state.range(1)` crop layers, and `state.range(2)` grid points per point decoder inference for
+// the model creators. Reports the decoded masks/sec over the whole call (encoding
+// included) and the masks kept after filtering and NMS.
+static void benchmark_sam_auto_masks(benchmark::State                    &state,
+                                     std::shared_ptr<BaseMobileSamModel> sam_model)
+{
+  cv::Mat image = cv::imread("/workspace/test_data/persons.jpg");
+
+  SamAutoMaskConfig config;
+  config.points_per_side = state.range(0);
+  config.crop_layers     = state.range(1);
+  const size_t decoded_masks_per_image =
+      GenerateSamCropBoxes(image.rows, image.cols, config.crop_layers, config.crop_overlap_ratio)
+          .size() *
+      config.points_per_side * config.points_per_side;
+
+  std::vector<SamAutoMask> masks;
+  for (auto _ : state)
+  {
+    state.PauseTiming();
+    sam_model->ClearEmbeddingCache();
+    state.ResumeTiming();
+    sam_model->GenerateAutoMasks(image, config, masks);
+  }
+
+  state.counters["masks/sec"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * decoded_masks_per_image),
+      benchmark::Counter::kIsRate);
+  state.counters["kept_masks"] = masks.size();
+}
+
+// Video mode on a 30-frame clip panning over the image by 4 pixels per frame, the box prompt is
+// given on the first frame. `state.range(0)` is the keyframe interval and `state.range(1)`
+// enables (1) the decoding of the tracked boxes on the cached keyframe embedding, else frames
+// between keyframes are warped. Reports the effective fps against the mean IoU with the masks of
+// every frame encoded on its own.
+static void benchmark_sam_video(benchmark::State                    &state,
+                                std::shared_ptr<BaseMobileSamModel> sam_model)
+{
+  cv::Mat image = cv::imread("/workspace/test_data/persons.jpg");
+  BBox2D  box;
+  box.x = 225;
+  box.y = 370;
+  box.w = 110;
+  box.h = 300;
+
+  const int            clip_length = 30;
+  std::vector<cv::Mat> clip(clip_length);
+  std::vector<cv::Mat> reference_masks(clip_length);
+  for (int i = 0; i < clip_length; ++i)
+  {
+    cv::Mat translation = (cv::Mat_<double>(2, 3) << 1, 0, 4 * i, 0, 1, 0);
+    cv::warpAffine(image, clip[i], translation, image.size());
+    BBox2D shifted_box = box;
+    shifted_box.x += 4 * i;
+    sam_model->GenerateMask(clip[i], std::vector<BBox2D>{shifted_box}, reference_masks[i]);
+  }
+
+  SamVideoConfig config;
+  config.keyframe_interval    = state.range(0);
+  config.cached_decode_thresh = state.range(1) != 0 ? config.cached_decode_thresh : -1.f;
+  auto video_segmenter        = CreateSamVideoSegmenter(sam_model, config);
+
+  SamVideoFrameResult result;
+  double              iou_sum     = 0;
+  int64_t             keyframes   = 0;
+  int                 frame_index = 0;
+  cv::Mat             mask        = cv::Mat::zeros(image.size(), CV_8UC1);
+  for (auto _ : state)
+  {
+    if (frame_index == 0)
+    {
+      state.PauseTiming();
+      sam_model->ClearEmbeddingCache();
+      state.ResumeTiming();
+      video_segmenter->Start(clip[0], {box}, result);
+    } else
+    {
+      video_segmenter->Track(clip[frame_index], result);
+    }
+
+    state.PauseTiming();
+    keyframes += result.type == SamVideoFrameType::KEYFRAME;
+    mask.setTo(0);
+    if (!result.masks.empty() && !result.masks[0].roi.empty())
+    {
+      result.masks[0].mask.copyTo(mask(result.masks[0].roi));
+    }
+    const double intersection = cv::countNonZero(mask & reference_masks[frame_index]);
+    const double union_area   = cv::countNonZero(mask | reference_masks[frame_index]);
+    iou_sum += union_area > 0 ? intersection / union_area : 1.;
+    frame_index = (frame_index + 1) % clip_length;
+    state.ResumeTiming();
+  }
+
+  const double frames              = static_cast<double>(state.iterations());
+  state.counters["fps"]            = benchmark::Counter(frames, benchmark::Counter::kIsRate);
+  state.counters["mask_iou"]       = iou_sum / frames;
+  state.counters["keyframe_ratio"] = keyframes / frames;
+}
+
 #ifdef ENABLE_TENSORRT
 
 #include "trt_core/trt_core.hpp"
 
-std::shared_ptr<BaseSamModel> CreateSAMTensorRTModel(const std::string &image_encoder_model_path)
+// `point_prompt_batch` prompts per inference of the point decoder, on its first dimension
+std::shared_ptr<BaseMobileSamModel> CreateSAMTensorRTModel(
+    const std::string &image_encoder_model_path,
+    bool               bucket_prompts     = false,
+    uint64_t           point_prompt_batch = 1)
 {
   auto box_decoder_model_path   = "/workspace/models/modified_mobile_sam_box.engine";
   auto point_decoder_model_path = "/workspace/models/modified_mobile_sam_point.engine";
 
   auto image_encoder = CreateTrtInferCore(image_encoder_model_path);
 
-  const int SAM_MAX_BOX    = 1;
+  const int SAM_MAX_BOX    = 8;
   const int SAM_MAX_POINTS = 8;
 
   auto box_decoder_factory =
@@ -28,23 +323,35 @@ std::shared_ptr<BaseSamModel> CreateSAMTensorRTModel(const std::string &image_en
                                     {"mask_input", {1, 1, 256, 256}},
                                     {"has_mask_input", {1}},
                                 },
-                                {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
+                                {{"masks", {1, SAM_MAX_BOX, 256, 256}},
+                                 {"scores", {1, SAM_MAX_BOX}}});
 
   auto point_decoder_factory =
       CreateTrtInferCoreFactory(point_decoder_model_path,
                                 {
                                     {"image_embeddings", {1, 256, 64, 64}},
-                                    {"point_coords", {1, SAM_MAX_POINTS, 2}},
-                                    {"point_labels", {1, SAM_MAX_POINTS}},
+                                    {"point_coords", {point_prompt_batch, SAM_MAX_POINTS, 2}},
+                                    {"point_labels", {point_prompt_batch, SAM_MAX_POINTS}},
                                     {"mask_input", {1, 1, 256, 256}},
                                     {"has_mask_input", {1}},
                                 },
-                                {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
+                                {{"masks", {point_prompt_batch, 1, 256, 256}},
+                                 {"scores", {point_prompt_batch, 1}}});
 
   auto image_preprocess_factory = CreateCudaDetPreProcessFactory();
 
-  return CreateMobileSamModel(image_encoder, point_decoder_factory->Create(),
-                              box_decoder_factory->Create(), image_preprocess_factory->Create());
+  MobileSamConfig sam_config;
+  sam_config.max_box_number = SAM_MAX_BOX;
+  if (bucket_prompts)
+  {
+    sam_config.point_prompt_buckets = {1, 2, 4, SAM_MAX_POINTS};
+    sam_config.box_prompt_buckets   = {1, 2, 4, SAM_MAX_BOX};
+  }
+
+  return CreateMobileSamModel(
+      image_encoder, point_decoder_factory->Create(), box_decoder_factory->Create(),
+      image_preprocess_factory->Create(), kMobileSamEncoderBlobNames, kMobileSamBoxDecoderBlobNames,
+      kMobileSamPointDecoderBlobNames, sam_config);
 }
 
 // benchmark sam_mobilesam
@@ -60,6 +367,61 @@ static void benchmark_sam_mobilesam_tensorrt_async(benchmark::State &state)
 }
 BENCHMARK(benchmark_sam_mobilesam_tensorrt_sync)->Arg(100)->UseRealTime();
 BENCHMARK(benchmark_sam_mobilesam_tensorrt_async)->Arg(100)->UseRealTime();
+static void benchmark_sam_mobilesam_tensorrt_cached_prompts(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.engine";
+  benchmark_sam_cached_prompts(state, CreateSAMTensorRTModel(mobilesam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_mobilesam_tensorrt_cached_prompts)->Arg(1)->Arg(5)->Arg(20)->UseRealTime();
+static void benchmark_sam_mobilesam_tensorrt_multi_box(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.engine";
+  benchmark_sam_multi_box(state, CreateSAMTensorRTModel(mobilesam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_mobilesam_tensorrt_multi_box)
+    ->ArgsProduct({{1, 2, 4, 8}, {0, 1}})
+    ->UseRealTime();
+static void benchmark_sam_mobilesam_tensorrt_pipelined(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.engine";
+  benchmark_sam_pipelined(state, CreateSAMTensorRTModel(mobilesam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_mobilesam_tensorrt_pipelined)->Arg(20)->UseRealTime();
+static void benchmark_sam_mobilesam_tensorrt_prompt_bucketing(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.engine";
+  benchmark_sam_prompt_bucketing(
+      state, CreateSAMTensorRTModel(mobilesam_image_encoder_model_path, state.range(1) != 0));
+}
+BENCHMARK(benchmark_sam_mobilesam_tensorrt_prompt_bucketing)
+    ->ArgsProduct({{1, 3, 8}, {0, 1}})
+    ->UseRealTime();
+static void benchmark_sam_mobilesam_tensorrt_refinement(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.engine";
+  benchmark_sam_refinement(state, CreateSAMTensorRTModel(mobilesam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_mobilesam_tensorrt_refinement)
+    ->ArgsProduct({{3, 8}, {0, 1}})
+    ->UseRealTime();
+static void benchmark_sam_mobilesam_tensorrt_auto_masks(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.engine";
+  benchmark_sam_auto_masks(
+      state, CreateSAMTensorRTModel(mobilesam_image_encoder_model_path, false, state.range(2)));
+}
+BENCHMARK(benchmark_sam_mobilesam_tensorrt_auto_masks)
+    ->ArgsProduct({{16, 32}, {0, 1}, {1, 64}})
+    ->UseRealTime();
+static void benchmark_sam_mobilesam_tensorrt_video(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.engine";
+  benchmark_sam_video(state, CreateSAMTensorRTModel(mobilesam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_mobilesam_tensorrt_video)
+    ->ArgsProduct({{1, 5, 15, 30}, {0, 1}})
+    ->Iterations(300)
+    ->UseRealTime();
 
 // benchmark sam_nanosam
 static void benchmark_sam_nanosam_tensorrt_sync(benchmark::State &state)
@@ -81,14 +443,18 @@ BENCHMARK(benchmark_sam_nanosam_tensorrt_async)->Arg(200)->UseRealTime();
 
 #include "ort_core/ort_core.hpp"
 
-std::shared_ptr<BaseSamModel> CreateSAMOnnxRuntimeModel(const std::string &image_encoder_model_path)
+// `point_prompt_batch` prompts per inference of the point decoder, on its first dimension
+std::shared_ptr<BaseMobileSamModel> CreateSAMOnnxRuntimeModel(
+    const std::string &image_encoder_model_path,
+    bool               bucket_prompts     = false,
+    uint64_t           point_prompt_batch = 1)
 {
   auto box_decoder_model_path   = "/workspace/models/modified_mobile_sam_box.onnx";
   auto point_decoder_model_path = "/workspace/models/modified_mobile_sam_point.onnx";
 
   auto image_encoder = CreateOrtInferCore(image_encoder_model_path);
 
-  const int SAM_MAX_BOX    = 1;
+  const int SAM_MAX_BOX    = 8;
   const int SAM_MAX_POINTS = 8;
 
   auto box_decoder_factory =
@@ -99,24 +465,36 @@ std::shared_ptr<BaseSamModel> CreateSAMOnnxRuntimeModel(const std::string &image
                                     {"mask_input", {1, 1, 256, 256}},
                                     {"has_mask_input", {1}},
                                 },
-                                {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
+                                {{"masks", {1, SAM_MAX_BOX, 256, 256}},
+                                 {"scores", {1, SAM_MAX_BOX}}});
 
   auto point_decoder_factory =
       CreateOrtInferCoreFactory(point_decoder_model_path,
                                 {
                                     {"image_embeddings", {1, 256, 64, 64}},
-                                    {"point_coords", {1, SAM_MAX_POINTS, 2}},
-                                    {"point_labels", {1, SAM_MAX_POINTS}},
+                                    {"point_coords", {point_prompt_batch, SAM_MAX_POINTS, 2}},
+                                    {"point_labels", {point_prompt_batch, SAM_MAX_POINTS}},
                                     {"mask_input", {1, 1, 256, 256}},
                                     {"has_mask_input", {1}},
                                 },
-                                {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
+                                {{"masks", {point_prompt_batch, 1, 256, 256}},
+                                 {"scores", {point_prompt_batch, 1}}});
 
   auto image_preprocess_factory =
       CreateCpuDetPreProcessFactory({0, 0, 0}, {255, 255, 255}, true, true);
 
-  return CreateMobileSamModel(image_encoder, point_decoder_factory->Create(),
-                              box_decoder_factory->Create(), image_preprocess_factory->Create());
+  MobileSamConfig sam_config;
+  sam_config.max_box_number = SAM_MAX_BOX;
+  if (bucket_prompts)
+  {
+    sam_config.point_prompt_buckets = {1, 2, 4, SAM_MAX_POINTS};
+    sam_config.box_prompt_buckets   = {1, 2, 4, SAM_MAX_BOX};
+  }
+
+  return CreateMobileSamModel(
+      image_encoder, point_decoder_factory->Create(), box_decoder_factory->Create(),
+      image_preprocess_factory->Create(), kMobileSamEncoderBlobNames, kMobileSamBoxDecoderBlobNames,
+      kMobileSamPointDecoderBlobNames, sam_config);
 }
 
 // benchmark sam_mobilesam
@@ -132,6 +510,66 @@ static void benchmark_sam_mobilesam_onnxruntime_async(benchmark::State &state)
 }
 BENCHMARK(benchmark_sam_mobilesam_onnxruntime_sync)->Arg(20)->UseRealTime();
 BENCHMARK(benchmark_sam_mobilesam_onnxruntime_async)->Arg(20)->UseRealTime();
+static void benchmark_sam_mobilesam_onnxruntime_cached_prompts(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.onnx";
+  benchmark_sam_cached_prompts(state,
+                               CreateSAMOnnxRuntimeModel(mobilesam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_mobilesam_onnxruntime_cached_prompts)
+    ->Arg(1)
+    ->Arg(5)
+    ->Arg(20)
+    ->UseRealTime();
+static void benchmark_sam_mobilesam_onnxruntime_multi_box(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.onnx";
+  benchmark_sam_multi_box(state, CreateSAMOnnxRuntimeModel(mobilesam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_mobilesam_onnxruntime_multi_box)
+    ->ArgsProduct({{1, 2, 4, 8}, {0, 1}})
+    ->UseRealTime();
+static void benchmark_sam_mobilesam_onnxruntime_pipelined(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.onnx";
+  benchmark_sam_pipelined(state, CreateSAMOnnxRuntimeModel(mobilesam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_mobilesam_onnxruntime_pipelined)->Arg(5)->UseRealTime();
+static void benchmark_sam_mobilesam_onnxruntime_prompt_bucketing(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.onnx";
+  benchmark_sam_prompt_bucketing(
+      state, CreateSAMOnnxRuntimeModel(mobilesam_image_encoder_model_path, state.range(1) != 0));
+}
+BENCHMARK(benchmark_sam_mobilesam_onnxruntime_prompt_bucketing)
+    ->ArgsProduct({{1, 3, 8}, {0, 1}})
+    ->UseRealTime();
+static void benchmark_sam_mobilesam_onnxruntime_refinement(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.onnx";
+  benchmark_sam_refinement(state, CreateSAMOnnxRuntimeModel(mobilesam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_mobilesam_onnxruntime_refinement)
+    ->ArgsProduct({{3, 8}, {0, 1}})
+    ->UseRealTime();
+static void benchmark_sam_mobilesam_onnxruntime_auto_masks(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.onnx";
+  benchmark_sam_auto_masks(
+      state, CreateSAMOnnxRuntimeModel(mobilesam_image_encoder_model_path, false, state.range(2)));
+}
+BENCHMARK(benchmark_sam_mobilesam_onnxruntime_auto_masks)
+    ->ArgsProduct({{16}, {0, 1}, {1, 64}})
+    ->UseRealTime();
+static void benchmark_sam_mobilesam_onnxruntime_video(benchmark::State &state)
+{
+  auto mobilesam_image_encoder_model_path = "/workspace/models/mobile_sam_encoder.onnx";
+  benchmark_sam_video(state, CreateSAMOnnxRuntimeModel(mobilesam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_mobilesam_onnxruntime_video)
+    ->ArgsProduct({{5, 15, 30}, {0, 1}})
+    ->Iterations(60)
+    ->UseRealTime();
 
 // benchmark sam_nanosam
 static void benchmark_sam_nanosam_onnxruntime_sync(benchmark::State &state)
@@ -153,7 +591,8 @@ BENCHMARK(benchmark_sam_nanosam_onnxruntime_async)->Arg(50)->UseRealTime();
 
 #include "rknn_core/rknn_core.hpp"
 
-std::shared_ptr<BaseSamModel> CreateSAMRknnModel(const std::string &image_encoder_model_path)
+std::shared_ptr<BaseMobileSamModel> CreateSAMRknnModel(
+    const std::string &image_encoder_model_path)
 {
   auto box_decoder_model_path   = "/workspace/models/modified_mobile_sam_box.rknn";
   auto point_decoder_model_path = "/workspace/models/modified_mobile_sam_point.rknn";
@@ -168,8 +607,15 @@ std::shared_ptr<BaseSamModel> CreateSAMRknnModel(const std::string &image_encode
   auto image_preprocess_factory =
       CreateCpuDetPreProcessFactory({0, 0, 0}, {255, 255, 255}, false, false);
 
-  return CreateMobileSamModel(nanosam_image_encoder, point_decoder_factory->Create(),
-                              box_decoder_factory->Create(), image_preprocess_factory->Create());
+  // transpose image features on the four big cores of rk3588
+  MobileSamConfig sam_config;
+  sam_config.feature_transpose_threads = 4;
+  sam_config.cpu_affinity.transpose    = "big";
+
+  return CreateMobileSamModel(
+      nanosam_image_encoder, point_decoder_factory->Create(), box_decoder_factory->Create(),
+      image_preprocess_factory->Create(), kMobileSamEncoderBlobNames, kMobileSamBoxDecoderBlobNames,
+      kMobileSamPointDecoderBlobNames, sam_config);
 }
 
 // benchmark sam_nanosam
@@ -185,6 +631,18 @@ static void benchmark_sam_nanosam_rknn_async(benchmark::State &state)
 }
 BENCHMARK(benchmark_sam_nanosam_rknn_sync)->Arg(50)->UseRealTime();
 BENCHMARK(benchmark_sam_nanosam_rknn_async)->Arg(100)->UseRealTime();
+static void benchmark_sam_nanosam_rknn_cached_prompts(benchmark::State &state)
+{
+  auto nanosam_image_encoder_model_path = "/workspace/models/nanosam_image_encoder_opset11.rknn";
+  benchmark_sam_cached_prompts(state, CreateSAMRknnModel(nanosam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_nanosam_rknn_cached_prompts)->Arg(1)->Arg(5)->Arg(20)->UseRealTime();
+static void benchmark_sam_nanosam_rknn_pipelined(benchmark::State &state)
+{
+  auto nanosam_image_encoder_model_path = "/workspace/models/nanosam_image_encoder_opset11.rknn";
+  benchmark_sam_pipelined(state, CreateSAMRknnModel(nanosam_image_encoder_model_path));
+}
+BENCHMARK(benchmark_sam_nanosam_rknn_pipelined)->Arg(20)->UseRealTime();
 
 #endif
 
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "sam_mobilesam/mask_postprocess.hpp"
+
+namespace easy_deploy {
+
+/**
+ * @brief Params of the automatic ("segment everything") mask generation, defaults follow the
+ * `SamAutomaticMaskGenerator` of segment-anything.
+ *
+ */
+struct SamAutoMaskConfig {
+  // the point grid is `points_per_side x points_per_side` on every crop
+  int points_per_side = 32;
+  // points decoded in one inference of the point decoder, one prompt each, batched on the first
+  // dimension of `point_coords` and capped by its size in the decoder. The batches are spread
+  // over the decoder instances of the model
+  size_t points_per_batch = 64;
+  // layer `i` (from 1) adds `2^i x 2^i` crops of the image, each encoded on its own, `0` only
+  // uses the full image
+  int crop_layers = 0;
+  // overlap of neighbouring crops, as a ratio of the shorter image side
+  float crop_overlap_ratio = 512.f / 1500.f;
+  // masks whose box is this close to a crop edge inside the image are dropped, the neighbouring
+  // crop sees the whole object
+  int crop_edge_tolerance = 20;
+  // masks with a predicted IoU (the `scores` output of the decoder) below it are dropped
+  float pred_iou_thresh = 0.88f;
+  // masks with a stability score below it are dropped, the score is the IoU of the mask
+  // thresholded at `+offset` and at `-offset` of the logits
+  float stability_score_thresh = 0.95f;
+  float stability_score_offset = 1.f;
+  // a mask is dropped if its box overlaps a better mask's box by more than `box_nms_thresh`, or
+  // their masks overlap by more than `mask_nms_thresh`, `1` disables the mask check
+  float box_nms_thresh  = 0.7f;
+  float mask_nms_thresh = 1.f;
+};
+
+/**
+ * @brief One mask of the automatic mask generation.
+ *
+ */
+struct SamAutoMask {
+  // cropped to its tight bounding box in the original image
+  SamCroppedMask mask;
+  float          predicted_iou   = 0.f;
+  float          stability_score = 0.f;
+  // the grid point the mask was prompted with, in the original image
+  std::pair<int, int> point;
+  // the crop the mask was decoded on
+  cv::Rect crop_box;
+};
+
+/**
+ * @brief Stats of one low-res mask, computed on the logits of the valid block of the encoder
+ * input, before any upsampling.
+ *
+ */
+struct SamLowResMaskStats {
+  float stability_score = 0.f;
+  // bounding box of the positive logits in the low-res mask, empty if there is none
+  cv::Rect low_res_box;
+};
+
+/**
+ * @brief Centers of a `points_per_side x points_per_side` grid, normalized to [0, 1].
+ *
+ * @param points_per_side
+ * @return std::vector<std::pair<float, float>> `(x, y)` in row-major order.
+ */
+std::vector<std::pair<float, float>> BuildSamPointGrid(int points_per_side);
+
+/**
+ * @brief The full image, then the overlapping crops of every crop layer.
+ *
+ * @param image_height
+ * @param image_width
+ * @param crop_layers
+ * @param overlap_ratio
+ * @return std::vector<cv::Rect>
+ */
+std::vector<cv::Rect> GenerateSamCropBoxes(int   image_height,
+                                           int   image_width,
+                                           int   crop_layers,
+                                           float overlap_ratio);
+
+/**
+ * @brief Stability score and box of a low-res mask, in one pass over its valid block.
+ *
+ * @param low_res_mask
+ * @param geometry
+ * @param stability_offset
+ * @return SamLowResMaskStats
+ */
+SamLowResMaskStats ComputeLowResMaskStats(const float           *low_res_mask,
+                                          const SamMaskGeometry &geometry,
+                                          float                  stability_offset);
+
+/**
+ * @brief Map a box of the low-res mask back to the original image, expanded by one low-res pixel
+ * on each side so that bilinear sampling in it misses no mask pixel.
+ *
+ * @param low_res_box
+ * @param geometry
+ * @return cv::Rect Not clipped to the image.
+ */
+cv::Rect LowResBoxToImage(const cv::Rect &low_res_box, const SamMaskGeometry &geometry);
+
+/**
+ * @brief Whether `box` is within `tolerance` of an edge of `crop_box` which is not an edge of
+ * the image.
+ *
+ * @param box
+ * @param crop_box
+ * @param image_size
+ * @param tolerance
+ * @return true
+ * @return false
+ */
+bool IsBoxNearCropEdge(const cv::Rect &box,
+                       const cv::Rect &crop_box,
+                       const cv::Size &image_size,
+                       int             tolerance);
+
+/**
+ * @brief Greedy NMS of masks by `predicted_iou`. The box IoU is checked first, the mask IoU is
+ * only computed on the intersection of overlapping boxes, and only if `mask_iou_thresh < 1`.
+ *
+ * @param masks
+ * @param box_iou_thresh
+ * @param mask_iou_thresh
+ * @return std::vector<size_t> Indices of the kept masks, by decreasing `predicted_iou`.
+ */
+std::vector<size_t> SamMaskNms(const std::vector<SamAutoMask> &masks,
+                               float                           box_iou_thresh,
+                               float                           mask_iou_thresh);
+
+} // namespace easy_deploy
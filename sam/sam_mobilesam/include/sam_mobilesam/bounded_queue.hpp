@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+
+namespace easy_deploy {
+
+/**
+ * @brief A blocking FIFO queue with a fixed capacity, used to hand off work between pipeline
+ * stages. Producers block while it is full, so a slow stage throttles the stages before it.
+ *
+ */
+template <typename T>
+class BoundedQueue {
+public:
+  explicit BoundedQueue(size_t capacity) : capacity_(capacity)
+  {
+    // the first `Push` of a queue without room would block forever
+    if (capacity_ == 0)
+    {
+      throw std::invalid_argument("[BoundedQueue] `capacity` should be positive!!!");
+    }
+  }
+
+  /**
+   * @brief Block while the queue is full.
+   *
+   * @param item
+   * @return false if the queue is closed, `item` is dropped.
+   */
+  bool Push(T item)
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    not_full_.wait(lock, [this]() { return closed_ || items_.size() < capacity_; });
+    if (closed_)
+    {
+      return false;
+    }
+    items_.push_back(std::move(item));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Block while the queue is empty. Items pushed before `Close` are still popped.
+   *
+   * @param item
+   * @return false if the queue is closed and drained.
+   */
+  bool Pop(T &item)
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    not_empty_.wait(lock, [this]() { return closed_ || !items_.empty(); });
+    if (items_.empty())
+    {
+      return false;
+    }
+    item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  /**
+   * @brief Wake up all the blocked callers, the following `Push` fail.
+   *
+   */
+  void Close()
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    closed_ = true;
+    not_full_.notify_all();
+    not_empty_.notify_all();
+  }
+
+  size_t Size() const
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return items_.size();
+  }
+
+private:
+  const size_t            capacity_;
+  mutable std::mutex      mtx_;
+  std::condition_variable not_full_;
+  std::condition_variable not_empty_;
+  std::deque<T>           items_;
+  bool                    closed_ = false;
+};
+
+} // namespace easy_deploy
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <sched.h>
+
+namespace easy_deploy {
+
+/**
+ * @brief The cpu cores of this machine grouped by core class. Cores are classified by their
+ * `cpu_capacity` (within 20%) and their L2 cache size, so that `big.LITTLE` socs like rk3588 get
+ * two classes, and x86 machines whose favored cores only turbo a bit higher get a single one.
+ *
+ */
+class CpuTopology {
+public:
+  /**
+   * @brief The topology of this machine, discovered on the first call.
+   *
+   * @return const CpuTopology&
+   */
+  static const CpuTopology &Instance();
+
+  /**
+   * @brief Discover the topology under `sysfs_cpu_root`, i.e. `/sys/devices/system/cpu`.
+   *
+   * @param sysfs_cpu_root
+   */
+  explicit CpuTopology(const std::string &sysfs_cpu_root);
+
+  const std::vector<int> &OnlineCpus() const
+  {
+    return online_cpus_;
+  }
+
+  // every core but the slowest class, all cores on homogeneous machines
+  const std::vector<int> &BigCpus() const
+  {
+    return big_cpus_;
+  }
+
+  // the slowest class, all cores on homogeneous machines
+  const std::vector<int> &LittleCpus() const
+  {
+    return little_cpus_;
+  }
+
+  bool IsHomogeneous() const
+  {
+    return big_cpus_.size() == online_cpus_.size();
+  }
+
+  /**
+   * @brief Resolve a cpu set spec into online cpu ids. `spec` is one of `big`, `little`, `all`, or
+   * a cpu list like `0-3,6`. An empty spec, or a set covering every online cpu, resolves to an
+   * empty set, which means "do not pin".
+   *
+   * @param spec
+   * @return std::vector<int>
+   * @throw std::invalid_argument if `spec` is malformed or selects no online cpu.
+   */
+  std::vector<int> ResolveCpuSet(const std::string &spec) const;
+
+private:
+  std::vector<int> online_cpus_;
+  std::vector<int> big_cpus_;
+  std::vector<int> little_cpus_;
+};
+
+/**
+ * @brief Cpu sets of the pipeline stages, each one is a spec of `CpuTopology::ResolveCpuSet`.
+ * Stages with an empty spec run wherever the calling thread is allowed to.
+ *
+ */
+struct StageCpuAffinityConfig {
+  std::string preprocess;
+  std::string infer;
+  std::string postprocess;
+  // feature layout conversion, memory bound and much faster on big cores of rk3588 (`big`)
+  std::string transpose;
+};
+
+/**
+ * @brief Pin the calling thread to `cpus` during the scope, and restore its original mask on
+ * exit. Nothing is changed if `cpus` is empty or the thread already runs within `cpus`, so the
+ * pinning the caller has set is kept.
+ *
+ */
+class ScopedCpuAffinity {
+public:
+  explicit ScopedCpuAffinity(const std::vector<int> &cpus);
+
+  ~ScopedCpuAffinity();
+
+  ScopedCpuAffinity(const ScopedCpuAffinity &)            = delete;
+  ScopedCpuAffinity &operator=(const ScopedCpuAffinity &) = delete;
+
+private:
+  bool      applied_ = false;
+  cpu_set_t saved_mask_;
+};
+
+} // namespace easy_deploy
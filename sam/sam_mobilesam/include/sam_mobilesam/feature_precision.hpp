@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace easy_deploy {
+
+/**
+ * @brief Storage precision of sam image features kept between the encoder and the decoders.
+ * `FP16` halves the memory of an embedding, `INT8` (symmetric, one scale per channel) quarters
+ * it. Decoders always take `FP32`, compressed features are expanded on demand.
+ *
+ */
+enum class SamFeaturePrecision { FP32, FP16, INT8 };
+
+/**
+ * @brief Convert floats to IEEE half, rounding to nearest even. Uses F16C on x86 cpus that
+ * support it and NEON on aarch64.
+ *
+ * @param src
+ * @param dst
+ * @param count
+ */
+void ConvertFp32ToFp16(const float *src, uint16_t *dst, size_t count);
+
+/**
+ * @brief Convert IEEE half to floats, exact. Uses F16C on x86 cpus that support it and NEON on
+ * aarch64.
+ *
+ * @param src
+ * @param dst
+ * @param count
+ */
+void ConvertFp16ToFp32(const uint16_t *src, float *dst, size_t count);
+
+/**
+ * @brief Quantize features of `channels x spatial` elements into int8 with a symmetric scale per
+ * channel, `value = q * scales[c]`.
+ *
+ * @param src
+ * @param dst
+ * @param scales `channels` floats.
+ * @param channels
+ * @param spatial
+ * @param channels_last `NHWC` features if true, `NCHW` otherwise.
+ */
+void QuantizeInt8PerChannel(const float *src,
+                            int8_t      *dst,
+                            float       *scales,
+                            size_t       channels,
+                            size_t       spatial,
+                            bool         channels_last);
+
+/**
+ * @brief Expand features quantized by `QuantizeInt8PerChannel` back to floats. Uses AVX2 on x86
+ * cpus that support it and NEON on aarch64.
+ *
+ */
+void DequantizeInt8PerChannel(const int8_t *src,
+                              const float  *scales,
+                              float        *dst,
+                              size_t        channels,
+                              size_t        spatial,
+                              bool          channels_last);
+
+} // namespace easy_deploy
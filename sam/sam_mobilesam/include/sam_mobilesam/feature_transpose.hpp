@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+
+namespace easy_deploy {
+
+/**
+ * @brief Transpose `NCHW` features into `NHWC`, out-of-place. The feature map is walked in
+ * cache-sized tiles, and each tile is transposed with SIMD blocks : AVX on x86 cpus that support
+ * it else SSE, NEON on arm.
+ *
+ * @param nchw Source buffer, `N * C * H * W` floats.
+ * @param nhwc Destination buffer, should not overlap with `nchw`.
+ * @param N
+ * @param C
+ * @param H
+ * @param W
+ * @param num_threads Split the `H * W` dimension across threads, the workers are kept alive
+ * between calls. `<= 1` runs on the caller thread, and so does a call made while another one
+ * uses the workers.
+ */
+void TransposeNchwToNhwc(
+    const float *nchw, float *nhwc, int N, int C, int H, int W, int num_threads = 1);
+
+/**
+ * @brief The straightforward element by element transpose, kept as reference for tests and
+ * benchmarks.
+ *
+ */
+void TransposeNchwToNhwcNaive(const float *nchw, float *nhwc, int N, int C, int H, int W);
+
+} // namespace easy_deploy
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+namespace easy_deploy {
+
+/**
+ * @brief Geometry of a sam low-res mask : the decoder outputs `low_res_height x low_res_width`
+ * logits of the `input_height x input_width` encoder input, where the original image was scaled
+ * by `scale` and placed at the top-left corner.
+ *
+ */
+struct SamMaskGeometry {
+  int   low_res_height = 256;
+  int   low_res_width  = 256;
+  int   input_height   = 1024;
+  int   input_width    = 1024;
+  float scale          = 1.f;
+  int   image_height   = 0;
+  int   image_width    = 0;
+};
+
+/**
+ * @brief A binary mask cropped to its tight bounding box.
+ *
+ */
+struct SamCroppedMask {
+  // tight bounding box in the original image, `roi.tl()` is the offset of `mask`, empty if no
+  // pixel is in the mask
+  cv::Rect roi;
+  // `CV_8U` (0/255) of `roi` size
+  cv::Mat mask;
+};
+
+/**
+ * @brief A binary mask in COCO run-length encoding.
+ *
+ */
+struct SamRleMask {
+  int height = 0;
+  int width  = 0;
+  // alternating run lengths of 0s and 1s in column-major order, starting with 0s
+  std::vector<uint32_t> counts;
+
+  /**
+   * @brief The compressed `counts` string of `pycocotools`.
+   *
+   * @return std::string
+   */
+  std::string ToCocoString() const;
+};
+
+/**
+ * @brief Convert the low-res mask logits into a binary `CV_8U` mask (0/255) at original image
+ * size, in one pass. Every output pixel is mapped back to the logits and sampled bilinearly,
+ * rows are processed in parallel. `mask` is reused if it already has the right size and type.
+ *
+ * @param low_res_mask
+ * @param geometry
+ * @param mask
+ */
+void ConvertLowResMaskFused(const float           *low_res_mask,
+                            const SamMaskGeometry &geometry,
+                            cv::Mat               &mask);
+
+/**
+ * @brief Same as `ConvertLowResMaskFused`, but only the pixels in `sample_roi` are sampled, the
+ * others are treated as background. The result is cropped to the tight bounding box of the mask.
+ *
+ * @param low_res_mask
+ * @param geometry
+ * @param sample_roi In the original image, clipped to the image.
+ * @param mask
+ */
+void ConvertLowResMaskCropped(const float           *low_res_mask,
+                              const SamMaskGeometry &geometry,
+                              const cv::Rect        &sample_roi,
+                              SamCroppedMask        &mask);
+
+/**
+ * @brief Encode the mask of the low-res logits as COCO RLE of the original image size, only the
+ * pixels in `sample_roi` are sampled, no full size mask is made.
+ *
+ * @param low_res_mask
+ * @param geometry
+ * @param sample_roi In the original image, clipped to the image.
+ * @param rle
+ */
+void ConvertLowResMaskRle(const float           *low_res_mask,
+                          const SamMaskGeometry &geometry,
+                          const cv::Rect        &sample_roi,
+                          SamRleMask            &rle);
+
+/**
+ * @brief The resize-crop-resize-threshold chain with OpenCV, kept as reference for tests and
+ * benchmarks.
+ *
+ */
+void ConvertLowResMaskReference(const float           *low_res_mask,
+                                const SamMaskGeometry &geometry,
+                                cv::Mat               &mask);
+
+} // namespace easy_deploy
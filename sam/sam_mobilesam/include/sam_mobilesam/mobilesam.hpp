@@ -1,32 +1,349 @@
 #pragma once
 
+#include <future>
+
 #include "deploy_core/base_sam.hpp"
 #include "deploy_core/base_detection.hpp"
 
+#include "sam_mobilesam/auto_mask.hpp"
+#include "sam_mobilesam/cpu_affinity.hpp"
+#include "sam_mobilesam/mask_postprocess.hpp"
+#include "sam_mobilesam/sam_embedding_cache.hpp"
+
 namespace easy_deploy {
 
-std::shared_ptr<BaseSamModel> CreateMobileSamModel(
+/**
+ * @brief Input and output sizes the sam models were exported with, checked against the blob shapes
+ * of the infer cores. Defaults are the 1024x1024 encoders of mobilesam and nanosam.
+ *
+ */
+struct MobileSamResolution {
+  int image_input_height   = 1024;
+  int image_input_width    = 1024;
+  int image_features_len   = 256;
+  int image_feature_height = 64;
+  int image_feature_width  = 64;
+  int mask_low_res_height  = 256;
+  int mask_low_res_width   = 256;
+};
+
+/**
+ * @brief Optional construction params of `MobileSam`.
+ *
+ */
+struct MobileSamConfig {
+  // sizes of the exported models, e.g. an encoder exported at 512x512 input
+  MobileSamResolution resolution;
+  // memory cap of the image embedding cache, `0` disables the cache
+  size_t embedding_cache_capacity_bytes = 32 * 1024 * 1024;
+  // max boxes decoded in one box decoder call, should not exceed the `boxes` blob shape the
+  // decoder core was built with
+  size_t max_box_number = 1;
+  // threads used to convert image features to the layout a decoder takes (`NHWC` for rknn)
+  int feature_transpose_threads = 1;
+  // cpu sets of each stage, resolved against the topology of this machine at construction
+  StageCpuAffinityConfig cpu_affinity;
+  // compact masks of a box are only sampled in the box expanded by this ratio of its size on
+  // each side
+  float mask_roi_margin = 0.1f;
+  // instances of the image encoder and of the mask decoders used by the pipelined execution,
+  // `CreateSamMobileSamModelFactory` creates one infer core per instance
+  size_t encoder_instances = 1;
+  size_t decoder_instances = 1;
+  // max encoded images waiting for a decoder, also the max pending requests
+  size_t pipeline_queue_capacity = 2;
+  // pad the prompts up to the smallest bucket not less than their number, e.g. {1, 2, 4, 8}, so
+  // the decoders only see a few static shapes, each with its own pre-shaped buffer. Pad points
+  // are labeled -1, pad boxes repeat the last box and their masks are dropped. Prompts beyond the
+  // largest bucket, or with no buckets, keep their exact number. Buckets must fit the max prompt
+  // shapes of the decoders, box buckets must not exceed `max_box_number`.
+  std::vector<size_t> point_prompt_buckets;
+  std::vector<size_t> box_prompt_buckets;
+  // precision the features of `EncodeImage` embeddings are kept in, `FP16` and `INT8` cut the
+  // memory of cached embeddings by 2x and 4x, and are expanded when copied to a decoder
+  SamFeaturePrecision embedding_precision = SamFeaturePrecision::FP32;
+};
+
+/**
+ * @brief The extra instances of the pipelined execution, the cores and preprocess block the model
+ * is created with are the first instance of each stage.
+ *
+ */
+struct MobileSamPipelineInstances {
+  std::vector<std::shared_ptr<BaseInferCore>>        image_encoder_cores;
+  std::vector<std::shared_ptr<IDetectionPreProcess>> image_preprocess_blocks;
+  std::vector<std::shared_ptr<BaseInferCore>>        mask_points_decoder_cores;
+  std::vector<std::shared_ptr<BaseInferCore>>        mask_boxes_decoder_cores;
+};
+
+/**
+ * @brief Busy time of one stage of the pipelined execution since its workers started.
+ *
+ */
+struct SamPipelineStageStats {
+  std::string stage;
+  size_t      instances  = 0;
+  uint64_t    processed  = 0;
+  double      busy_ms    = 0;
+  double      elapsed_ms = 0;
+  // busy time over the elapsed time of all the instances, in [0, 1]
+  double utilisation = 0;
+};
+
+/**
+ * @brief An interactive refinement on one encoded image. The low-res logits of the last mask are
+ * fed back to the point decoder as its `mask_input` prior, so a corrective click is decoded alone
+ * instead of with the whole click history.
+ *
+ */
+struct SamRefinementSession {
+  std::shared_ptr<const SamImageEmbedding> embedding;
+  // `mask_low_res_height x mask_low_res_width` logits of the last mask, empty before the first
+  // click
+  std::vector<float> prior_logits;
+
+  /**
+   * @brief Drop the prior, the next click starts from scratch.
+   *
+   */
+  void Reset()
+  {
+    prior_logits.clear();
+  }
+};
+
+/**
+ * @brief `BaseSamModel` with the image encoder and the mask decoder exposed as two steps, so
+ * that one encoded image could be decoded with many prompts. Encoded images are kept in a
+ * bounded LRU cache, keyed by a caller-supplied image id or by the content of the image.
+ *
+ */
+class BaseMobileSamModel : public BaseSamModel {
+public:
+  /**
+   * @brief Run the image encoder on `image`, or fetch its embedding from the cache.
+   *
+   * @param image
+   * @param image_id Used as the cache key. The content hash of `image` is used if empty.
+   * @param isRGB
+   * @return std::shared_ptr<const SamImageEmbedding> nullptr if failed.
+   */
+  virtual std::shared_ptr<const SamImageEmbedding> EncodeImage(const cv::Mat     &image,
+                                                               const std::string &image_id = "",
+                                                               bool isRGB = false) = 0;
+
+  /**
+   * @brief `EncodeImage` on a downscaled copy of an image, e.g. a level of a resize pyramid shared
+   * with another model. The embedding maps prompts and masks to the original image, as if it was
+   * encoded directly.
+   *
+   * @param scaled_image The original image resized by `image_scale` on both axes, its sides
+   * rounded to the nearest pixel. Images whose aspect ratio changed are rejected.
+   * @param image_scale
+   * @param image_size Size of the original image.
+   * @param image_id Used as the cache key. The content hash of `scaled_image` is used if empty.
+   * @param isRGB
+   * @return std::shared_ptr<const SamImageEmbedding> nullptr if failed.
+   */
+  virtual std::shared_ptr<const SamImageEmbedding> EncodeScaledImage(
+      const cv::Mat     &scaled_image,
+      float              image_scale,
+      const cv::Size    &image_size,
+      const std::string &image_id = "",
+      bool               isRGB    = false) = 0;
+
+  /**
+   * @brief Run only the mask decoder with box prompts on an encoded image.
+   *
+   * @param embedding
+   * @param boxes
+   * @param result
+   * @return true
+   * @return false
+   */
+  virtual bool DecodeMask(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                          const std::vector<BBox2D>                      &boxes,
+                          cv::Mat                                        &result) = 0;
+
+  /**
+   * @brief Run the box decoder once for up to `max_box_number` boxes, and get one mask per box.
+   * More boxes are split into several decoder calls.
+   *
+   * @param embedding
+   * @param boxes
+   * @param results Masks in the same order as `boxes`.
+   * @return true
+   * @return false
+   */
+  virtual bool DecodeMasks(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                           const std::vector<BBox2D>                      &boxes,
+                           std::vector<cv::Mat>                           &results) = 0;
+
+  /**
+   * @brief `DecodeMasks`, but every mask is cropped to its tight bounding box. Only the pixels in
+   * the box prompt (expanded by `mask_roi_margin`) are upsampled.
+   *
+   * @param embedding
+   * @param boxes
+   * @param results Masks in the same order as `boxes`.
+   * @return true
+   * @return false
+   */
+  virtual bool DecodeCroppedMasks(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                                  const std::vector<BBox2D>                      &boxes,
+                                  std::vector<SamCroppedMask>                    &results) = 0;
+
+  /**
+   * @brief `DecodeMasks`, but every mask is encoded as COCO RLE straight from the decoder
+   * logits. Only the pixels in the box prompt (expanded by `mask_roi_margin`) are upsampled.
+   *
+   * @param embedding
+   * @param boxes
+   * @param results Masks in the same order as `boxes`.
+   * @return true
+   * @return false
+   */
+  virtual bool DecodeRleMasks(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                              const std::vector<BBox2D>                      &boxes,
+                              std::vector<SamRleMask>                        &results) = 0;
+
+  /**
+   * @brief `EncodeImage` and `DecodeMasks` in one call.
+   *
+   * @param image
+   * @param boxes
+   * @param results Masks in the same order as `boxes`.
+   * @param isRGB
+   * @return true
+   * @return false
+   */
+  virtual bool GenerateMasks(const cv::Mat             &image,
+                             const std::vector<BBox2D> &boxes,
+                             std::vector<cv::Mat>      &results,
+                             bool                       isRGB = false) = 0;
+
+  /**
+   * @brief Run only the mask decoder with point prompts on an encoded image.
+   *
+   * @param embedding
+   * @param points
+   * @param labels
+   * @param result
+   * @return true
+   * @return false
+   */
+  virtual bool DecodeMask(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                          const std::vector<std::pair<int, int>>         &points,
+                          const std::vector<int>                         &labels,
+                          cv::Mat                                        &result) = 0;
+
+  /**
+   * @brief Decode `points` on the image of `session` with the mask of the previous call as prior,
+   * and keep the new mask logits as the prior of the next call. Without a prior it is the same as
+   * `DecodeMask` with points.
+   *
+   * @param session
+   * @param points Only the new clicks, or the whole history.
+   * @param labels
+   * @param result
+   * @return true
+   * @return false
+   */
+  virtual bool RefineMask(SamRefinementSession                   &session,
+                          const std::vector<std::pair<int, int>> &points,
+                          const std::vector<int>                 &labels,
+                          cv::Mat                                &result) = 0;
+
+  /**
+   * @brief Segment everything in `image` without prompts : the image (and every crop) is encoded
+   * once, a grid of points is decoded in batches spread over the decoder instances, one inference
+   * per batch with a single-point prompt per grid point on the first dimension of the prompts,
+   * masks are filtered by predicted IoU and stability, then de-duplicated by NMS. Needs the point
+   * decoder, whose first prompt dimension bounds the batches.
+   *
+   * @param image
+   * @param config
+   * @param results Compact masks by decreasing predicted IoU.
+   * @param isRGB
+   * @return true
+   * @return false
+   */
+  virtual bool GenerateAutoMasks(const cv::Mat            &image,
+                                 const SamAutoMaskConfig  &config,
+                                 std::vector<SamAutoMask> &results,
+                                 bool                      isRGB = false) = 0;
+
+  /**
+   * @brief Queue `image` into the pipelined execution : the encoder and the decoder run on their
+   * own workers, so the encoder works on the next image while the decoder works on this one.
+   * Blocks while `pipeline_queue_capacity` requests are pending. `image` is referenced, not
+   * copied, do not write it before the result is ready.
+   *
+   * @param image
+   * @param boxes
+   * @param isRGB
+   * @return std::future<std::vector<cv::Mat>> Masks in the same order as `boxes`.
+   */
+  virtual std::future<std::vector<cv::Mat>> GenerateMasksPipelined(
+      const cv::Mat &image, const std::vector<BBox2D> &boxes, bool isRGB = false) = 0;
+
+  /**
+   * @brief `GenerateMasksPipelined` with point prompts.
+   *
+   * @param image
+   * @param points
+   * @param labels
+   * @param isRGB
+   * @return std::future<std::vector<cv::Mat>> One mask.
+   */
+  virtual std::future<std::vector<cv::Mat>> GenerateMaskPipelined(
+      const cv::Mat                          &image,
+      const std::vector<std::pair<int, int>> &points,
+      const std::vector<int>                 &labels,
+      bool                                    isRGB = false) = 0;
+
+  /**
+   * @brief Stats of the `encoder` and `decoder` stages, empty before the first pipelined call.
+   *
+   * @return std::vector<SamPipelineStageStats>
+   */
+  virtual std::vector<SamPipelineStageStats> GetPipelineStats() const = 0;
+
+  virtual SamEmbeddingCacheStats GetEmbeddingCacheStats() const = 0;
+
+  virtual void ClearEmbeddingCache() = 0;
+
+protected:
+  using BaseSamModel::BaseSamModel;
+};
+
+// blob names of the exported encoder and decoders, the defaults of the factories
+inline const std::vector<std::string> kMobileSamEncoderBlobNames    = {"images", "features"};
+inline const std::vector<std::string> kMobileSamBoxDecoderBlobNames = {
+    "image_embeddings", "boxes", "mask_input", "has_mask_input", "masks", "scores"};
+inline const std::vector<std::string> kMobileSamPointDecoderBlobNames = {
+    "image_embeddings", "point_coords", "point_labels", "mask_input",
+    "has_mask_input",   "masks",        "scores"};
+
+std::shared_ptr<BaseMobileSamModel> CreateMobileSamModel(
     std::shared_ptr<BaseInferCore>        image_encoder_core,
     std::shared_ptr<BaseInferCore>        mask_points_decoder_core,
     std::shared_ptr<BaseInferCore>        mask_boxes_decoder_core,
     std::shared_ptr<IDetectionPreProcess> image_preprocess_block,
-    const std::vector<std::string>       &encoder_blob_names = {"images", "features"},
-    const std::vector<std::string> &box_dec_blob_names = {"image_embeddings", "boxes", "mask_input",
-                                                          "has_mask_input", "masks", "scores"},
-    const std::vector<std::string> &point_dec_blob_names = {"image_embeddings", "point_coords",
-                                                            "point_labels", "mask_input",
-                                                            "has_mask_input", "masks", "scores"});
+    const std::vector<std::string>       &encoder_blob_names   = kMobileSamEncoderBlobNames,
+    const std::vector<std::string>       &box_dec_blob_names   = kMobileSamBoxDecoderBlobNames,
+    const std::vector<std::string>       &point_dec_blob_names = kMobileSamPointDecoderBlobNames,
+    const MobileSamConfig                &config               = {},
+    const MobileSamPipelineInstances     &pipeline_instances   = {});
 
 std::shared_ptr<BaseSamFactory> CreateSamMobileSamModelFactory(
     std::shared_ptr<BaseInferCoreFactory>           image_encoder_core_factory,
     std::shared_ptr<BaseInferCoreFactory>           mask_points_decoder_core_factory,
     std::shared_ptr<BaseInferCoreFactory>           mask_boxes_decoder_core_factory,
     std::shared_ptr<BaseDetectionPreprocessFactory> image_preprocess_block_factory,
-    const std::vector<std::string>                 &encoder_blob_names = {"images", "features"},
-    const std::vector<std::string> &box_dec_blob_names = {"image_embeddings", "boxes", "mask_input",
-                                                          "has_mask_input", "masks", "scores"},
-    const std::vector<std::string> &point_dec_blob_names = {"image_embeddings", "point_coords",
-                                                            "point_labels", "mask_input",
-                                                            "has_mask_input", "masks", "scores"});
+    const std::vector<std::string> &encoder_blob_names   = kMobileSamEncoderBlobNames,
+    const std::vector<std::string> &box_dec_blob_names   = kMobileSamBoxDecoderBlobNames,
+    const std::vector<std::string> &point_dec_blob_names = kMobileSamPointDecoderBlobNames,
+    const MobileSamConfig          &config               = {});
 
 } // namespace easy_deploy
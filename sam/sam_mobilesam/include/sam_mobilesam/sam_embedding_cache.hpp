@@ -0,0 +1,161 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "sam_mobilesam/feature_precision.hpp"
+
+namespace easy_deploy {
+
+enum class SamFeatureLayout { NCHW, NHWC };
+
+/**
+ * @brief The output of sam image encoder on one image, together with the information needed to
+ * map prompts and masks between the original image and the encoder input.
+ *
+ */
+struct SamImageEmbedding {
+  // image features in `layout`, as outputed by the image encoder, released by `Compress`
+  std::vector<float> features;
+  SamFeatureLayout   layout           = SamFeatureLayout::NCHW;
+  int                feature_channels = 0;
+  int                feature_height   = 0;
+  int                feature_width    = 0;
+  // the scale factor in image preprocess
+  float transform_scale = 1.f;
+  // original image size
+  int image_height = 0;
+  int image_width  = 0;
+
+  /**
+   * @brief Get the features in `target_layout`. The first request of a layout other than
+   * `layout` converts the features, the converted copy is kept for the later requests.
+   *
+   * @param target_layout
+   * @param num_threads Threads used by the conversion.
+   * @return const float* nullptr if the features are compressed, use `CopyFeatures` instead.
+   */
+  const float *GetFeatures(SamFeatureLayout target_layout, int num_threads = 1) const;
+
+  // whether `target_layout` is available without conversion
+  bool HasFeatures(SamFeatureLayout target_layout) const;
+
+  /**
+   * @brief Write the `FP32` features in `target_layout` to `dst`, expanding compressed features
+   * on the fly. Compressed features in another layout are expanded and transposed on every call,
+   * so they should be compressed in the layout of the decoders.
+   *
+   * @param target_layout
+   * @param dst `FeaturesNum()` floats.
+   * @param num_threads Threads used by the layout conversion.
+   */
+  void CopyFeatures(SamFeatureLayout target_layout, float *dst, int num_threads = 1) const;
+
+  /**
+   * @brief Store the features in `precision` and `storage_layout`, the `FP32` features and their
+   * converted copies are released. Compressing twice is not supported.
+   *
+   * @param precision
+   * @param storage_layout
+   * @param num_threads Threads used by the layout conversion.
+   */
+  void Compress(SamFeaturePrecision precision,
+                SamFeatureLayout    storage_layout,
+                int                 num_threads = 1);
+
+  SamFeaturePrecision Precision() const
+  {
+    return precision_;
+  }
+
+  size_t FeaturesNum() const
+  {
+    return static_cast<size_t>(feature_channels) * feature_height * feature_width;
+  }
+
+  size_t ByteSize() const;
+
+private:
+  mutable std::mutex         convert_mtx_;
+  mutable std::vector<float> converted_features_;
+
+  // compressed features in `layout`
+  SamFeaturePrecision   precision_ = SamFeaturePrecision::FP32;
+  std::vector<uint16_t> fp16_features_;
+  std::vector<int8_t>   int8_features_;
+  std::vector<float>    int8_scales_;
+};
+
+struct SamEmbeddingCacheStats {
+  uint64_t hits           = 0;
+  uint64_t misses         = 0;
+  uint64_t evictions      = 0;
+  size_t   entries        = 0;
+  size_t   memory_bytes   = 0;
+  size_t   capacity_bytes = 0;
+};
+
+/**
+ * @brief A thread-safe LRU cache of sam image embeddings, bounded by the memory used by the
+ * cached features.
+ *
+ */
+class SamEmbeddingCache {
+public:
+  explicit SamEmbeddingCache(size_t capacity_bytes);
+
+  /**
+   * @brief Look up `key`, refresh its recency on hit.
+   *
+   * @param key
+   * @return std::shared_ptr<const SamImageEmbedding> nullptr if missed.
+   */
+  std::shared_ptr<const SamImageEmbedding> Get(const std::string &key);
+
+  /**
+   * @brief Insert or replace `key`, evicting the least recently used entries to respect the
+   * memory cap. Embeddings larger than the whole capacity are not cached. Layout copies made
+   * after insertion are charged at the next insertion.
+   *
+   * @param key
+   * @param embedding
+   */
+  void Put(const std::string &key, std::shared_ptr<const SamImageEmbedding> embedding);
+
+  void Clear();
+
+  SamEmbeddingCacheStats GetStats() const;
+
+private:
+  using EntryList = std::list<std::pair<std::string, std::shared_ptr<const SamImageEmbedding>>>;
+
+  // embeddings grow when they are converted to another layout, so the memory is summed on
+  // demand instead of being tracked at insertion
+  size_t MemoryBytes() const;
+
+  const size_t capacity_bytes_;
+
+  mutable std::mutex                                   mtx_;
+  EntryList                                            lru_list_;
+  std::unordered_map<std::string, EntryList::iterator> entries_;
+  uint64_t                                             hits_      = 0;
+  uint64_t                                             misses_    = 0;
+  uint64_t                                             evictions_ = 0;
+};
+
+/**
+ * @brief Build a cache key from the content of `image`. Images with the same size, type and
+ * pixels share the same key.
+ *
+ * @param image
+ * @return std::string
+ */
+std::string ComputeImageContentKey(const cv::Mat &image);
+
+} // namespace easy_deploy
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "sam_mobilesam/mobilesam.hpp"
+
+namespace easy_deploy {
+
+/**
+ * @brief Params of the sam video mode. The image encoder only runs on keyframes, the frames in
+ * between reuse the keyframe embedding or warp the previous masks.
+ *
+ */
+struct SamVideoConfig {
+  // a keyframe at least every `keyframe_interval` frames, `0` only starts one on scene changes
+  int keyframe_interval = 15;
+  // a frame whose scene change to the last keyframe reaches it starts a new keyframe
+  float scene_change_thresh = 0.12f;
+  // below it, the tracked boxes are decoded again on the keyframe embedding, above it the
+  // previous masks are only warped to the tracked boxes, negative always warps
+  float cached_decode_thresh = 0.05f;
+  // side of the grayscale thumbnail the scene change is measured on
+  int thumbnail_size = 64;
+  // the optical flow runs on the frames resized to this width
+  int flow_image_width = 320;
+  // features tracked in every box
+  int flow_max_points = 32;
+};
+
+/**
+ * @brief How the masks of a video frame were produced, from the most to the least expensive.
+ *
+ */
+enum class SamVideoFrameType {
+  KEYFRAME,      // image encoder and decoder on the frame
+  CACHED_DECODE, // decoder on the keyframe embedding, with the tracked boxes
+  WARPED,        // previous masks moved and scaled with the tracked boxes
+};
+
+/**
+ * @brief Masks of one video frame.
+ *
+ */
+struct SamVideoFrameResult {
+  SamVideoFrameType type = SamVideoFrameType::KEYFRAME;
+  // the tracked boxes, and their masks in the same order
+  std::vector<BBox2D>         boxes;
+  std::vector<SamCroppedMask> masks;
+  // to the last keyframe, before this frame was made a keyframe
+  float scene_change = 0.f;
+};
+
+/**
+ * @brief Segment objects through a video stream with `BaseMobileSamModel`. The objects are
+ * prompted by boxes on the first frame, then their boxes are tracked with sparse optical flow
+ * and their masks re-decoded or warped, the image encoder only runs on keyframes.
+ *
+ */
+class BaseSamVideoSegmenter {
+public:
+  /**
+   * @brief Start a new track on `frame`, always a keyframe.
+   *
+   * @param frame
+   * @param boxes The objects to segment.
+   * @param result
+   * @param isRGB
+   * @return true
+   * @return false
+   */
+  virtual bool Start(const cv::Mat             &frame,
+                     const std::vector<BBox2D> &boxes,
+                     SamVideoFrameResult       &result,
+                     bool                       isRGB = false) = 0;
+
+  /**
+   * @brief Segment the objects on the next frame of the stream.
+   *
+   * @param frame
+   * @param result
+   * @param isRGB
+   * @return true
+   * @return false if `Start` was not called or a model call failed.
+   */
+  virtual bool Track(const cv::Mat &frame, SamVideoFrameResult &result, bool isRGB = false) = 0;
+
+  virtual ~BaseSamVideoSegmenter() = default;
+};
+
+/**
+ * @brief Create a sam video segmenter, `sam_model` could be shared with other users.
+ *
+ * @param sam_model
+ * @param config
+ * @return std::shared_ptr<BaseSamVideoSegmenter>
+ */
+std::shared_ptr<BaseSamVideoSegmenter> CreateSamVideoSegmenter(
+    const std::shared_ptr<BaseMobileSamModel> &sam_model,
+    const SamVideoConfig                      &config = {});
+
+/**
+ * @brief Grayscale `size x size` thumbnail of `frame`, the input of `ComputeSamSceneChange`.
+ *
+ * @param frame
+ * @param size
+ * @param isRGB
+ * @return cv::Mat `CV_8UC1`
+ */
+cv::Mat MakeSamSceneThumbnail(const cv::Mat &frame, int size, bool isRGB = false);
+
+/**
+ * @brief Mean absolute difference of two thumbnails, normalized to [0, 1].
+ *
+ * @param thumbnail_a
+ * @param thumbnail_b
+ * @return float
+ */
+float ComputeSamSceneChange(const cv::Mat &thumbnail_a, const cv::Mat &thumbnail_b);
+
+/**
+ * @brief Track `boxes` from `prev_gray` to `gray` : features inside every box are tracked with
+ * pyramidal Lucas-Kanade, the box is moved by their median shift and scaled by the median
+ * change of their spread. A box with too few tracked features is kept as is.
+ *
+ * @param prev_gray
+ * @param gray
+ * @param boxes In `prev_gray` pixels, moved to `gray` in place.
+ * @param max_points
+ */
+void TrackSamBoxesByFlow(const cv::Mat       &prev_gray,
+                         const cv::Mat       &gray,
+                         std::vector<BBox2D> &boxes,
+                         int                  max_points);
+
+/**
+ * @brief Move and scale `mask` by the transform from `from_box` to `to_box`, clipped to the
+ * image.
+ *
+ * @param mask
+ * @param from_box
+ * @param to_box
+ * @param image_size
+ * @return SamCroppedMask
+ */
+SamCroppedMask WarpSamCroppedMask(const SamCroppedMask &mask,
+                                  const BBox2D         &from_box,
+                                  const BBox2D         &to_box,
+                                  const cv::Size       &image_size);
+
+} // namespace easy_deploy
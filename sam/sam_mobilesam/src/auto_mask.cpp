@@ -0,0 +1,197 @@
+#include "sam_mobilesam/auto_mask.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace easy_deploy {
+
+std::vector<std::pair<float, float>> BuildSamPointGrid(int points_per_side)
+{
+  std::vector<std::pair<float, float>> grid;
+  if (points_per_side <= 0)
+  {
+    return grid;
+  }
+  grid.reserve(static_cast<size_t>(points_per_side) * points_per_side);
+  const float step = 1.f / points_per_side;
+  for (int y = 0; y < points_per_side; ++y)
+  {
+    for (int x = 0; x < points_per_side; ++x)
+    {
+      grid.emplace_back((x + 0.5f) * step, (y + 0.5f) * step);
+    }
+  }
+  return grid;
+}
+
+std::vector<cv::Rect> GenerateSamCropBoxes(int   image_height,
+                                           int   image_width,
+                                           int   crop_layers,
+                                           float overlap_ratio)
+{
+  std::vector<cv::Rect> crop_boxes{cv::Rect(0, 0, image_width, image_height)};
+  const int             short_side = std::min(image_height, image_width);
+  for (int layer = 1; layer <= crop_layers; ++layer)
+  {
+    const int crops_per_side = 1 << layer;
+    const int overlap = static_cast<int>(overlap_ratio * short_side * 2.f / crops_per_side);
+    const int crop_width =
+        (overlap * (crops_per_side - 1) + image_width + crops_per_side - 1) / crops_per_side;
+    const int crop_height =
+        (overlap * (crops_per_side - 1) + image_height + crops_per_side - 1) / crops_per_side;
+    for (int j = 0; j < crops_per_side; ++j)
+    {
+      for (int i = 0; i < crops_per_side; ++i)
+      {
+        const int x0 = (crop_width - overlap) * i;
+        const int y0 = (crop_height - overlap) * j;
+        const int x1 = std::min(x0 + crop_width, image_width);
+        const int y1 = std::min(y0 + crop_height, image_height);
+        crop_boxes.emplace_back(x0, y0, x1 - x0, y1 - y0);
+      }
+    }
+  }
+  return crop_boxes;
+}
+
+SamLowResMaskStats ComputeLowResMaskStats(const float           *low_res_mask,
+                                          const SamMaskGeometry &geometry,
+                                          float                  stability_offset)
+{
+  // the logits of the padding are not part of the image
+  const int valid_height = std::min(
+      geometry.low_res_height,
+      static_cast<int>(std::ceil(geometry.image_height * geometry.scale *
+                                 geometry.low_res_height / geometry.input_height)));
+  const int valid_width = std::min(
+      geometry.low_res_width,
+      static_cast<int>(std::ceil(geometry.image_width * geometry.scale * geometry.low_res_width /
+                                 geometry.input_width)));
+
+  uint64_t high_count = 0;
+  uint64_t low_count  = 0;
+  int      x0 = valid_width, y0 = valid_height, x1 = -1, y1 = -1;
+  for (int y = 0; y < valid_height; ++y)
+  {
+    const float *row = low_res_mask + y * geometry.low_res_width;
+    for (int x = 0; x < valid_width; ++x)
+    {
+      const float logit = row[x];
+      high_count += logit > stability_offset;
+      low_count += logit > -stability_offset;
+      if (logit > 0.f)
+      {
+        x0 = std::min(x0, x);
+        x1 = std::max(x1, x);
+        y0 = std::min(y0, y);
+        y1 = std::max(y1, y);
+      }
+    }
+  }
+
+  SamLowResMaskStats stats;
+  stats.stability_score = low_count > 0 ? static_cast<float>(high_count) / low_count : 0.f;
+  if (x1 >= 0)
+  {
+    stats.low_res_box = cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+  }
+  return stats;
+}
+
+cv::Rect LowResBoxToImage(const cv::Rect &low_res_box, const SamMaskGeometry &geometry)
+{
+  // one low-res pixel covers `ratio` pixels of the original image
+  const float ratio_x = static_cast<float>(geometry.input_width) /
+                        (geometry.low_res_width * geometry.scale);
+  const float ratio_y = static_cast<float>(geometry.input_height) /
+                        (geometry.low_res_height * geometry.scale);
+  const int x0 = static_cast<int>(std::floor((low_res_box.x - 1) * ratio_x));
+  const int y0 = static_cast<int>(std::floor((low_res_box.y - 1) * ratio_y));
+  const int x1 = static_cast<int>(std::ceil((low_res_box.x + low_res_box.width + 1) * ratio_x));
+  const int y1 = static_cast<int>(std::ceil((low_res_box.y + low_res_box.height + 1) * ratio_y));
+  return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+bool IsBoxNearCropEdge(const cv::Rect &box,
+                       const cv::Rect &crop_box,
+                       const cv::Size &image_size,
+                       int             tolerance)
+{
+  auto near = [tolerance](int a, int b) { return std::abs(a - b) <= tolerance; };
+  const int box_x1  = box.x + box.width;
+  const int box_y1  = box.y + box.height;
+  const int crop_x1 = crop_box.x + crop_box.width;
+  const int crop_y1 = crop_box.y + crop_box.height;
+  return (near(box.x, crop_box.x) && !near(box.x, 0)) ||
+         (near(box.y, crop_box.y) && !near(box.y, 0)) ||
+         (near(box_x1, crop_x1) && !near(box_x1, image_size.width)) ||
+         (near(box_y1, crop_y1) && !near(box_y1, image_size.height));
+}
+
+std::vector<size_t> SamMaskNms(const std::vector<SamAutoMask> &masks,
+                               float                           box_iou_thresh,
+                               float                           mask_iou_thresh)
+{
+  std::vector<size_t> order(masks.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&masks](size_t a, size_t b) {
+    return masks[a].predicted_iou > masks[b].predicted_iou;
+  });
+
+  const bool       check_masks = mask_iou_thresh < 1.f;
+  std::vector<int> mask_areas(check_masks ? masks.size() : 0);
+  for (size_t i = 0; i < mask_areas.size(); ++i)
+  {
+    mask_areas[i] = masks[i].mask.mask.empty() ? 0 : cv::countNonZero(masks[i].mask.mask);
+  }
+
+  std::vector<size_t> keep;
+  for (const size_t candidate : order)
+  {
+    const cv::Rect &candidate_roi = masks[candidate].mask.roi;
+    if (candidate_roi.empty())
+    {
+      continue;
+    }
+
+    bool suppressed = false;
+    for (const size_t kept : keep)
+    {
+      const cv::Rect &kept_roi     = masks[kept].mask.roi;
+      const cv::Rect  intersection = candidate_roi & kept_roi;
+      if (intersection.empty())
+      {
+        continue;
+      }
+      const float box_iou = static_cast<float>(intersection.area()) /
+                            (candidate_roi.area() + kept_roi.area() - intersection.area());
+      if (box_iou > box_iou_thresh)
+      {
+        suppressed = true;
+        break;
+      }
+      if (check_masks)
+      {
+        cv::Mat overlap;
+        cv::bitwise_and(masks[candidate].mask.mask(intersection - candidate_roi.tl()),
+                        masks[kept].mask.mask(intersection - kept_roi.tl()), overlap);
+        const int   inter    = cv::countNonZero(overlap);
+        const int   uni      = mask_areas[candidate] + mask_areas[kept] - inter;
+        const float mask_iou = uni > 0 ? static_cast<float>(inter) / uni : 0.f;
+        if (mask_iou > mask_iou_thresh)
+        {
+          suppressed = true;
+          break;
+        }
+      }
+    }
+    if (!suppressed)
+    {
+      keep.push_back(candidate);
+    }
+  }
+  return keep;
+}
+
+} // namespace easy_deploy
@@ -0,0 +1,247 @@
+#include "sam_mobilesam/cpu_affinity.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#include <unistd.h>
+
+namespace easy_deploy {
+
+namespace {
+
+std::string Trim(const std::string &str)
+{
+  const auto begin = str.find_first_not_of(" \t\n");
+  if (begin == std::string::npos)
+  {
+    return "";
+  }
+  const auto end = str.find_last_not_of(" \t\n");
+  return str.substr(begin, end - begin + 1);
+}
+
+std::string ReadSysfsValue(const std::string &path)
+{
+  std::ifstream file(path);
+  std::string   value;
+  std::getline(file, value);
+  return Trim(value);
+}
+
+// Parse the kernel cpu list format, e.g. `0-3,6`. Return false if malformed.
+bool ParseCpuList(const std::string &cpu_list, std::vector<int> &cpus)
+{
+  cpus.clear();
+  size_t start = 0;
+  while (start <= cpu_list.size())
+  {
+    size_t end = cpu_list.find(',', start);
+    if (end == std::string::npos)
+    {
+      end = cpu_list.size();
+    }
+    const std::string range = Trim(cpu_list.substr(start, end - start));
+    int               first = 0, last = 0;
+    char              tail  = 0;
+    if (sscanf(range.c_str(), "%d-%d%c", &first, &last, &tail) == 2 && first <= last)
+    {
+      for (int cpu = first; cpu <= last; ++cpu)
+      {
+        cpus.push_back(cpu);
+      }
+    } else if (sscanf(range.c_str(), "%d%c", &first, &tail) == 1)
+    {
+      cpus.push_back(first);
+    } else
+    {
+      return false;
+    }
+    start = end + 1;
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return !cpus.empty() && cpus.front() >= 0;
+}
+
+// L2 cache size of `cpu_dir` in KB, 0 if unknown
+uint64_t ReadL2CacheSize(const std::string &cpu_dir)
+{
+  for (int index = 0; index < 8; ++index)
+  {
+    const std::string cache_dir = cpu_dir + "/cache/index" + std::to_string(index);
+    const std::string level     = ReadSysfsValue(cache_dir + "/level");
+    if (level.empty())
+    {
+      break;
+    }
+    if (level == "2")
+    {
+      return strtoull(ReadSysfsValue(cache_dir + "/size").c_str(), nullptr, 10);
+    }
+  }
+  return 0;
+}
+
+struct CoreClass {
+  uint64_t         capacity;
+  uint64_t         l2_size;
+  std::vector<int> cpus;
+};
+
+// `cpu_capacity` is relative to the fastest core (1024) and some kernels scale it by the max
+// frequency, so close values are the same core design. big.LITTLE clusters differ by 2x or more.
+bool SimilarCapacity(uint64_t a, uint64_t b)
+{
+  const uint64_t high = std::max(a, b);
+  const uint64_t low  = std::min(a, b);
+  return (high - low) * 5 <= high;
+}
+
+} // namespace
+
+const CpuTopology &CpuTopology::Instance()
+{
+  static const CpuTopology topology("/sys/devices/system/cpu");
+  return topology;
+}
+
+CpuTopology::CpuTopology(const std::string &sysfs_cpu_root)
+{
+  if (!ParseCpuList(ReadSysfsValue(sysfs_cpu_root + "/online"), online_cpus_))
+  {
+    online_cpus_.clear();
+    const long cpu_num = sysconf(_SC_NPROCESSORS_ONLN);
+    for (long cpu = 0; cpu < cpu_num; ++cpu)
+    {
+      online_cpus_.push_back(static_cast<int>(cpu));
+    }
+  }
+
+  // core class = {capacity, L2 size}, either could be missing on some platforms. The max
+  // frequency is not used : favored cores of x86 turbo differ by a few percent of it only.
+  std::vector<CoreClass> classes;
+  for (const int cpu : online_cpus_)
+  {
+    const std::string cpu_dir = sysfs_cpu_root + "/cpu" + std::to_string(cpu);
+    const uint64_t    capacity =
+        strtoull(ReadSysfsValue(cpu_dir + "/cpu_capacity").c_str(), nullptr, 10);
+    const uint64_t    l2_size = ReadL2CacheSize(cpu_dir);
+    auto iter = std::find_if(classes.begin(), classes.end(), [&](const CoreClass &core_class) {
+      return core_class.l2_size == l2_size && SimilarCapacity(core_class.capacity, capacity);
+    });
+    if (iter == classes.end())
+    {
+      classes.push_back({capacity, l2_size, {}});
+      iter = std::prev(classes.end());
+    }
+    iter->cpus.push_back(cpu);
+  }
+  std::sort(classes.begin(), classes.end(), [](const CoreClass &a, const CoreClass &b) {
+    return std::make_pair(a.capacity, a.l2_size) < std::make_pair(b.capacity, b.l2_size);
+  });
+
+  if (classes.size() <= 1)
+  {
+    big_cpus_    = online_cpus_;
+    little_cpus_ = online_cpus_;
+    return;
+  }
+
+  little_cpus_ = classes.front().cpus;
+  for (auto iter = std::next(classes.begin()); iter != classes.end(); ++iter)
+  {
+    big_cpus_.insert(big_cpus_.end(), iter->cpus.begin(), iter->cpus.end());
+  }
+  std::sort(big_cpus_.begin(), big_cpus_.end());
+}
+
+std::vector<int> CpuTopology::ResolveCpuSet(const std::string &spec) const
+{
+  const std::string trimmed_spec = Trim(spec);
+  if (trimmed_spec.empty())
+  {
+    return {};
+  }
+
+  std::vector<int> cpus;
+  if (trimmed_spec == "all")
+  {
+    cpus = online_cpus_;
+  } else if (trimmed_spec == "big")
+  {
+    cpus = big_cpus_;
+  } else if (trimmed_spec == "little")
+  {
+    cpus = little_cpus_;
+  } else
+  {
+    std::vector<int> listed_cpus;
+    if (!ParseCpuList(trimmed_spec, listed_cpus))
+    {
+      throw std::invalid_argument("[CpuTopology] Got malformed cpu set spec : " + spec);
+    }
+    for (const int cpu : listed_cpus)
+    {
+      if (std::binary_search(online_cpus_.begin(), online_cpus_.end(), cpu))
+      {
+        cpus.push_back(cpu);
+      }
+    }
+    if (cpus.empty())
+    {
+      throw std::invalid_argument("[CpuTopology] No online cpu in cpu set spec : " + spec);
+    }
+  }
+
+  // pinning to every cpu only overrides the mask the caller may have set
+  if (cpus.size() == online_cpus_.size())
+  {
+    return {};
+  }
+  return cpus;
+}
+
+ScopedCpuAffinity::ScopedCpuAffinity(const std::vector<int> &cpus)
+{
+  if (cpus.empty() || sched_getaffinity(0, sizeof(saved_mask_), &saved_mask_) != 0)
+  {
+    return;
+  }
+
+  cpu_set_t target_mask;
+  CPU_ZERO(&target_mask);
+  for (const int cpu : cpus)
+  {
+    CPU_SET(cpu, &target_mask);
+  }
+
+  // already running within `cpus`
+  cpu_set_t intersection;
+  CPU_AND(&intersection, &saved_mask_, &target_mask);
+  if (CPU_EQUAL(&intersection, &saved_mask_))
+  {
+    return;
+  }
+
+  if (sched_setaffinity(0, sizeof(target_mask), &target_mask) == -1)
+  {
+    perror("sched_setaffinity failed");
+    return;
+  }
+  applied_ = true;
+}
+
+ScopedCpuAffinity::~ScopedCpuAffinity()
+{
+  if (applied_ && sched_setaffinity(0, sizeof(saved_mask_), &saved_mask_) == -1)
+  {
+    perror("sched_setaffinity failed");
+  }
+}
+
+} // namespace easy_deploy
@@ -0,0 +1,329 @@
+#include "sam_mobilesam/feature_precision.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#define SAM_PRECISION_NEON
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+// F16C and AVX2 are not in the baseline x86 flags, the kernels are compiled for them with target
+// attributes and picked at runtime
+#define SAM_PRECISION_X86_DISPATCH
+#endif
+
+namespace easy_deploy {
+
+namespace {
+
+uint16_t FloatToHalf(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  const uint16_t sign = (bits >> 16) & 0x8000;
+  uint32_t       abs  = bits & 0x7fffffff;
+
+  // inf and nan, nan keeps a quiet bit
+  if (abs >= 0x7f800000)
+  {
+    return sign | 0x7c00 | (abs > 0x7f800000 ? 0x200 : 0);
+  }
+  // rounds to inf from 65520
+  if (abs >= 0x477ff000)
+  {
+    return sign | 0x7c00;
+  }
+  // half subnormals and zero : adding 0.5 aligns the half ulp (2^-24) to the float ulp, the
+  // float addition rounds to nearest even
+  if (abs < 0x38800000)
+  {
+    float abs_value;
+    memcpy(&abs_value, &abs, sizeof(abs_value));
+    abs_value += 0.5f;
+    uint32_t rounded;
+    memcpy(&rounded, &abs_value, sizeof(rounded));
+    return sign | static_cast<uint16_t>(rounded - 0x3f000000);
+  }
+  // normals : rebias the exponent, round the 13 dropped mantissa bits to nearest even
+  const uint32_t mantissa_odd = (abs >> 13) & 1;
+  abs += 0xc8000fff + mantissa_odd;
+  return sign | static_cast<uint16_t>(abs >> 13);
+}
+
+float HalfToFloat(uint16_t half)
+{
+  const uint32_t sign     = static_cast<uint32_t>(half & 0x8000) << 16;
+  const uint32_t exponent = (half >> 10) & 0x1f;
+  const uint32_t mantissa = half & 0x3ff;
+
+  uint32_t bits;
+  if (exponent == 0)
+  {
+    // zero and subnormals, exact in float
+    const float value = std::ldexp(static_cast<float>(mantissa), -24);
+    memcpy(&bits, &value, sizeof(bits));
+    bits |= sign;
+  } else if (exponent == 0x1f)
+  {
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else
+  {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  }
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+void ConvertFp32ToFp16Scalar(const float *src, uint16_t *dst, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    dst[i] = FloatToHalf(src[i]);
+  }
+}
+
+void ConvertFp16ToFp32Scalar(const uint16_t *src, float *dst, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    dst[i] = HalfToFloat(src[i]);
+  }
+}
+
+// `dst[i] = src[i] * scale`, or `src[i] * scales[i]` if `scales` is not null
+void DequantizeRowScalar(
+    const int8_t *src, const float *scales, float scale, float *dst, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    dst[i] = static_cast<float>(src[i]) * (scales != nullptr ? scales[i] : scale);
+  }
+}
+
+#if defined(SAM_PRECISION_X86_DISPATCH)
+
+__attribute__((target("avx,f16c"))) void ConvertFp32ToFp16F16c(const float *src,
+                                                                uint16_t    *dst,
+                                                                size_t       count)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), half);
+  }
+  ConvertFp32ToFp16Scalar(src + i, dst + i, count - i);
+}
+
+__attribute__((target("avx,f16c"))) void ConvertFp16ToFp32F16c(const uint16_t *src,
+                                                                float          *dst,
+                                                                size_t          count)
+{
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m128i half = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+    _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(half));
+  }
+  ConvertFp16ToFp32Scalar(src + i, dst + i, count - i);
+}
+
+__attribute__((target("avx2"))) void DequantizeRowAvx2(
+    const int8_t *src, const float *scales, float scale, float *dst, size_t count)
+{
+  const __m256 scale_vec = _mm256_set1_ps(scale);
+  size_t       i         = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    const __m128i q8 = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i));
+    const __m256  v  = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(q8));
+    const __m256  s  = scales != nullptr ? _mm256_loadu_ps(scales + i) : scale_vec;
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(v, s));
+  }
+  DequantizeRowScalar(src + i, scales != nullptr ? scales + i : nullptr, scale, dst + i,
+                      count - i);
+}
+
+bool CpuHasF16c()
+{
+  static const bool has_f16c = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  }();
+  return has_f16c;
+}
+
+bool CpuHasAvx2()
+{
+  static const bool has_avx2 = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+  }();
+  return has_avx2;
+}
+
+void ConvertFp32ToFp16Impl(const float *src, uint16_t *dst, size_t count)
+{
+  if (CpuHasF16c())
+  {
+    ConvertFp32ToFp16F16c(src, dst, count);
+  } else
+  {
+    ConvertFp32ToFp16Scalar(src, dst, count);
+  }
+}
+
+void ConvertFp16ToFp32Impl(const uint16_t *src, float *dst, size_t count)
+{
+  if (CpuHasF16c())
+  {
+    ConvertFp16ToFp32F16c(src, dst, count);
+  } else
+  {
+    ConvertFp16ToFp32Scalar(src, dst, count);
+  }
+}
+
+void DequantizeRow(const int8_t *src, const float *scales, float scale, float *dst, size_t count)
+{
+  if (CpuHasAvx2())
+  {
+    DequantizeRowAvx2(src, scales, scale, dst, count);
+  } else
+  {
+    DequantizeRowScalar(src, scales, scale, dst, count);
+  }
+}
+
+#elif defined(SAM_PRECISION_NEON)
+
+void ConvertFp32ToFp16Impl(const float *src, uint16_t *dst, size_t count)
+{
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    vst1_u16(dst + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(src + i))));
+  }
+  ConvertFp32ToFp16Scalar(src + i, dst + i, count - i);
+}
+
+void ConvertFp16ToFp32Impl(const uint16_t *src, float *dst, size_t count)
+{
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4)
+  {
+    vst1q_f32(dst + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(src + i))));
+  }
+  ConvertFp16ToFp32Scalar(src + i, dst + i, count - i);
+}
+
+void DequantizeRow(const int8_t *src, const float *scales, float scale, float *dst, size_t count)
+{
+  const float32x4_t scale_vec = vdupq_n_f32(scale);
+  size_t            i         = 0;
+  for (; i + 8 <= count; i += 8)
+  {
+    const int16x8_t   q16 = vmovl_s8(vld1_s8(src + i));
+    const float32x4_t v0  = vcvtq_f32_s32(vmovl_s16(vget_low_s16(q16)));
+    const float32x4_t v1  = vcvtq_f32_s32(vmovl_s16(vget_high_s16(q16)));
+    const float32x4_t s0  = scales != nullptr ? vld1q_f32(scales + i) : scale_vec;
+    const float32x4_t s1  = scales != nullptr ? vld1q_f32(scales + i + 4) : scale_vec;
+    vst1q_f32(dst + i, vmulq_f32(v0, s0));
+    vst1q_f32(dst + i + 4, vmulq_f32(v1, s1));
+  }
+  DequantizeRowScalar(src + i, scales != nullptr ? scales + i : nullptr, scale, dst + i,
+                      count - i);
+}
+
+#else
+
+void ConvertFp32ToFp16Impl(const float *src, uint16_t *dst, size_t count)
+{
+  ConvertFp32ToFp16Scalar(src, dst, count);
+}
+
+void ConvertFp16ToFp32Impl(const uint16_t *src, float *dst, size_t count)
+{
+  ConvertFp16ToFp32Scalar(src, dst, count);
+}
+
+void DequantizeRow(const int8_t *src, const float *scales, float scale, float *dst, size_t count)
+{
+  DequantizeRowScalar(src, scales, scale, dst, count);
+}
+
+#endif
+
+} // namespace
+
+void ConvertFp32ToFp16(const float *src, uint16_t *dst, size_t count)
+{
+  ConvertFp32ToFp16Impl(src, dst, count);
+}
+
+void ConvertFp16ToFp32(const uint16_t *src, float *dst, size_t count)
+{
+  ConvertFp16ToFp32Impl(src, dst, count);
+}
+
+void QuantizeInt8PerChannel(const float *src,
+                            int8_t      *dst,
+                            float       *scales,
+                            size_t       channels,
+                            size_t       spatial,
+                            bool         channels_last)
+{
+  // element `s` of channel `c`
+  auto index = [&](size_t c, size_t s) {
+    return channels_last ? s * channels + c : c * spatial + s;
+  };
+
+  std::vector<float> max_abs(channels, 0.f);
+  for (size_t c = 0; c < channels; ++c)
+  {
+    for (size_t s = 0; s < spatial; ++s)
+    {
+      max_abs[c] = std::max(max_abs[c], std::fabs(src[index(c, s)]));
+    }
+  }
+
+  for (size_t c = 0; c < channels; ++c)
+  {
+    scales[c]             = max_abs[c] / 127.f;
+    const float inv_scale = scales[c] > 0.f ? 1.f / scales[c] : 0.f;
+    for (size_t s = 0; s < spatial; ++s)
+    {
+      const float q = std::nearbyint(src[index(c, s)] * inv_scale);
+      dst[index(c, s)] = static_cast<int8_t>(std::min(127.f, std::max(-127.f, q)));
+    }
+  }
+}
+
+void DequantizeInt8PerChannel(const int8_t *src,
+                              const float  *scales,
+                              float        *dst,
+                              size_t        channels,
+                              size_t        spatial,
+                              bool          channels_last)
+{
+  if (channels_last)
+  {
+    // every pixel is a row of all the channels
+    for (size_t s = 0; s < spatial; ++s)
+    {
+      DequantizeRow(src + s * channels, scales, 0.f, dst + s * channels, channels);
+    }
+  } else
+  {
+    for (size_t c = 0; c < channels; ++c)
+    {
+      DequantizeRow(src + c * spatial, nullptr, scales[c], dst + c * spatial, spatial);
+    }
+  }
+}
+
+} // namespace easy_deploy
@@ -0,0 +1,351 @@
+#include "sam_mobilesam/feature_transpose.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SAM_TRANSPOSE_NEON
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+// SSE is in the baseline x86 flags, AVX is not : its kernel is compiled with a target attribute
+// and picked at runtime
+#define SAM_TRANSPOSE_SSE
+#define SAM_TRANSPOSE_AVX_DISPATCH
+#endif
+
+namespace easy_deploy {
+
+namespace {
+
+// Tile edge (in elements) of the outer blocking. A 64x64 float tile of source and destination
+// takes 32KB, which fits L1/L2 on both the x86 and the rk3588 cores.
+constexpr size_t kTileSize = 64;
+
+// Transpose the [rows, cols] matrix `src` into [cols, rows] matrix `dst`, only for the source
+// columns in [col_begin, col_end). Every `BlockSize x BlockSize` block is done by `Block`.
+template <size_t BlockSize, void (*Block)(const float *, size_t, float *, size_t)>
+inline void TransposeTiles(
+    const float *src, float *dst, size_t rows, size_t cols, size_t col_begin, size_t col_end)
+{
+  for (size_t col_tile = col_begin; col_tile < col_end; col_tile += kTileSize)
+  {
+    const size_t col_tile_end = std::min(col_tile + kTileSize, col_end);
+    for (size_t row_tile = 0; row_tile < rows; row_tile += kTileSize)
+    {
+      const size_t row_tile_end = std::min(row_tile + kTileSize, rows);
+
+      size_t row = row_tile;
+      for (; row + BlockSize <= row_tile_end; row += BlockSize)
+      {
+        size_t col = col_tile;
+        for (; col + BlockSize <= col_tile_end; col += BlockSize)
+        {
+          Block(src + row * cols + col, cols, dst + col * rows + row, rows);
+        }
+        for (; col < col_tile_end; ++col)
+        {
+          for (size_t r = row; r < row + BlockSize; ++r)
+          {
+            dst[col * rows + r] = src[r * cols + col];
+          }
+        }
+      }
+      for (; row < row_tile_end; ++row)
+      {
+        for (size_t col = col_tile; col < col_tile_end; ++col)
+        {
+          dst[col * rows + row] = src[row * cols + col];
+        }
+      }
+    }
+  }
+}
+
+#if defined(SAM_TRANSPOSE_AVX_DISPATCH)
+
+__attribute__((target("avx"))) inline void TransposeBlockAvx(const float *src,
+                                                              size_t       src_stride,
+                                                              float       *dst,
+                                                              size_t       dst_stride)
+{
+  __m256 r0 = _mm256_loadu_ps(src + 0 * src_stride);
+  __m256 r1 = _mm256_loadu_ps(src + 1 * src_stride);
+  __m256 r2 = _mm256_loadu_ps(src + 2 * src_stride);
+  __m256 r3 = _mm256_loadu_ps(src + 3 * src_stride);
+  __m256 r4 = _mm256_loadu_ps(src + 4 * src_stride);
+  __m256 r5 = _mm256_loadu_ps(src + 5 * src_stride);
+  __m256 r6 = _mm256_loadu_ps(src + 6 * src_stride);
+  __m256 r7 = _mm256_loadu_ps(src + 7 * src_stride);
+
+  __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+  __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+  __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+  __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+  __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+  __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+  __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+  __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+
+  __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+  _mm256_storeu_ps(dst + 0 * dst_stride, _mm256_permute2f128_ps(s0, s4, 0x20));
+  _mm256_storeu_ps(dst + 1 * dst_stride, _mm256_permute2f128_ps(s1, s5, 0x20));
+  _mm256_storeu_ps(dst + 2 * dst_stride, _mm256_permute2f128_ps(s2, s6, 0x20));
+  _mm256_storeu_ps(dst + 3 * dst_stride, _mm256_permute2f128_ps(s3, s7, 0x20));
+  _mm256_storeu_ps(dst + 4 * dst_stride, _mm256_permute2f128_ps(s0, s4, 0x31));
+  _mm256_storeu_ps(dst + 5 * dst_stride, _mm256_permute2f128_ps(s1, s5, 0x31));
+  _mm256_storeu_ps(dst + 6 * dst_stride, _mm256_permute2f128_ps(s2, s6, 0x31));
+  _mm256_storeu_ps(dst + 7 * dst_stride, _mm256_permute2f128_ps(s3, s7, 0x31));
+}
+
+// flattened, so the tile walk and the blocks are all inlined into AVX enabled code
+__attribute__((target("avx"), flatten)) void TransposeColumnsAvx(
+    const float *src, float *dst, size_t rows, size_t cols, size_t col_begin, size_t col_end)
+{
+  TransposeTiles<8, TransposeBlockAvx>(src, dst, rows, cols, col_begin, col_end);
+}
+
+bool CpuHasAvx()
+{
+  static const bool has_avx = []() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx");
+  }();
+  return has_avx;
+}
+
+#endif
+
+#if defined(SAM_TRANSPOSE_SSE)
+
+constexpr size_t kBlockSize = 4;
+
+inline void TransposeBlock(const float *src, size_t src_stride, float *dst, size_t dst_stride)
+{
+  __m128 r0 = _mm_loadu_ps(src + 0 * src_stride);
+  __m128 r1 = _mm_loadu_ps(src + 1 * src_stride);
+  __m128 r2 = _mm_loadu_ps(src + 2 * src_stride);
+  __m128 r3 = _mm_loadu_ps(src + 3 * src_stride);
+  _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+  _mm_storeu_ps(dst + 0 * dst_stride, r0);
+  _mm_storeu_ps(dst + 1 * dst_stride, r1);
+  _mm_storeu_ps(dst + 2 * dst_stride, r2);
+  _mm_storeu_ps(dst + 3 * dst_stride, r3);
+}
+
+#elif defined(SAM_TRANSPOSE_NEON)
+
+constexpr size_t kBlockSize = 4;
+
+inline void TransposeBlock(const float *src, size_t src_stride, float *dst, size_t dst_stride)
+{
+  float32x4_t   r0  = vld1q_f32(src + 0 * src_stride);
+  float32x4_t   r1  = vld1q_f32(src + 1 * src_stride);
+  float32x4_t   r2  = vld1q_f32(src + 2 * src_stride);
+  float32x4_t   r3  = vld1q_f32(src + 3 * src_stride);
+  float32x4x2_t t01 = vtrnq_f32(r0, r1);
+  float32x4x2_t t23 = vtrnq_f32(r2, r3);
+  vst1q_f32(dst + 0 * dst_stride,
+            vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0])));
+  vst1q_f32(dst + 1 * dst_stride,
+            vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1])));
+  vst1q_f32(dst + 2 * dst_stride,
+            vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0])));
+  vst1q_f32(dst + 3 * dst_stride,
+            vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1])));
+}
+
+#else
+
+constexpr size_t kBlockSize = 1;
+
+inline void TransposeBlock(const float *src, size_t, float *dst, size_t)
+{
+  *dst = *src;
+}
+
+#endif
+
+void TransposeColumns(
+    const float *src, float *dst, size_t rows, size_t cols, size_t col_begin, size_t col_end)
+{
+#if defined(SAM_TRANSPOSE_AVX_DISPATCH)
+  if (CpuHasAvx())
+  {
+    TransposeColumnsAvx(src, dst, rows, cols, col_begin, col_end);
+    return;
+  }
+#endif
+  TransposeTiles<kBlockSize, TransposeBlock>(src, dst, rows, cols, col_begin, col_end);
+}
+
+// Workers kept alive across calls, the transpose of one embedding takes about a millisecond and
+// starting threads for every call would be a good part of it.
+class TransposeWorkers {
+public:
+  static TransposeWorkers &Instance()
+  {
+    static TransposeWorkers workers;
+    return workers;
+  }
+
+  ~TransposeWorkers()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mtx_);
+      stop_ = true;
+    }
+    job_cv_.notify_all();
+    for (auto &thread : threads_)
+    {
+      thread.join();
+    }
+  }
+
+  // Run `task(i)` for every `i` in [0, tasks_num), on the workers and the caller thread. Returns
+  // false without running anything if another caller holds the workers.
+  bool TryRun(size_t tasks_num, const std::function<void(size_t)> &task)
+  {
+    std::unique_lock<std::mutex> run_lock(run_mtx_, std::try_to_lock);
+    if (!run_lock.owns_lock())
+    {
+      return false;
+    }
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (threads_.size() + 1 < tasks_num)
+    {
+      threads_.emplace_back(&TransposeWorkers::WorkerLoop, this);
+    }
+    task_      = &task;
+    tasks_num_ = tasks_num;
+    next_task_ = 0;
+    pending_   = tasks_num;
+    ++generation_;
+    job_cv_.notify_all();
+
+    RunTasks(lock);
+    done_cv_.wait(lock, [this]() { return pending_ == 0; });
+    task_ = nullptr;
+    return true;
+  }
+
+private:
+  TransposeWorkers() = default;
+
+  // takes the tasks left in the current job, `lock` holds `mtx_`
+  void RunTasks(std::unique_lock<std::mutex> &lock)
+  {
+    while (next_task_ < tasks_num_)
+    {
+      const size_t index = next_task_++;
+      lock.unlock();
+      (*task_)(index);
+      lock.lock();
+      if (--pending_ == 0)
+      {
+        done_cv_.notify_all();
+      }
+    }
+  }
+
+  void WorkerLoop()
+  {
+    std::unique_lock<std::mutex> lock(mtx_);
+    size_t                       seen_generation = 0;
+    while (true)
+    {
+      job_cv_.wait(lock, [&]() { return stop_ || generation_ != seen_generation; });
+      if (stop_)
+      {
+        return;
+      }
+      seen_generation = generation_;
+      RunTasks(lock);
+    }
+  }
+
+  // one job at a time, the job state below is shared by the workers
+  std::mutex run_mtx_;
+
+  std::mutex                         mtx_;
+  std::condition_variable            job_cv_;
+  std::condition_variable            done_cv_;
+  std::vector<std::thread>           threads_;
+  const std::function<void(size_t)> *task_       = nullptr;
+  size_t                             tasks_num_  = 0;
+  size_t                             next_task_  = 0;
+  size_t                             pending_    = 0;
+  size_t                             generation_ = 0;
+  bool                               stop_       = false;
+};
+
+} // namespace
+
+void TransposeNchwToNhwc(
+    const float *nchw, float *nhwc, int N, int C, int H, int W, int num_threads)
+{
+  const size_t channels   = C;
+  const size_t spatial    = static_cast<size_t>(H) * W;
+  const size_t batch_size = channels * spatial;
+
+  // every thread owns a contiguous part of `H * W`, aligned to the tile edge
+  const size_t tiles_num = (spatial + kTileSize - 1) / kTileSize;
+  const size_t workers   = std::max<size_t>(1, std::min<size_t>(num_threads, tiles_num));
+  const size_t tiles_per_worker = (tiles_num + workers - 1) / workers;
+
+  for (int n = 0; n < N; ++n)
+  {
+    const float *src = nchw + n * batch_size;
+    float       *dst = nhwc + n * batch_size;
+
+    if (workers == 1)
+    {
+      TransposeColumns(src, dst, channels, spatial, 0, spatial);
+      continue;
+    }
+
+    const std::function<void(size_t)> task = [&](size_t i) {
+      const size_t begin = std::min(spatial, i * tiles_per_worker * kTileSize);
+      const size_t end   = std::min(spatial, (i + 1) * tiles_per_worker * kTileSize);
+      TransposeColumns(src, dst, channels, spatial, begin, end);
+    };
+    // the workers are busy with another transpose, do it on the caller thread
+    if (!TransposeWorkers::Instance().TryRun(workers, task))
+    {
+      TransposeColumns(src, dst, channels, spatial, 0, spatial);
+    }
+  }
+}
+
+void TransposeNchwToNhwcNaive(const float *nchw, float *nhwc, int N, int C, int H, int W)
+{
+  for (int ni = 0; ni < N; ni++)
+  {
+    for (int hi = 0; hi < H; hi++)
+    {
+      for (int wi = 0; wi < W; wi++)
+      {
+        for (int ci = 0; ci < C; ci++)
+        {
+          nhwc[ni * H * W * C + hi * W * C + wi * C + ci] =
+              nchw[ni * C * H * W + ci * H * W + hi * W + wi];
+        }
+      }
+    }
+  }
+}
+
+} // namespace easy_deploy
@@ -0,0 +1,234 @@
+#include "sam_mobilesam/mask_postprocess.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace easy_deploy {
+
+namespace {
+
+// Bilinear source index and weight of one output coordinate, with the same half-pixel centers
+// and border clamping as `cv::resize`.
+struct SampleTap {
+  int   index0;
+  int   index1;
+  float weight1;
+};
+
+// taps of the output coordinates in [begin, begin + len)
+std::vector<SampleTap> BuildSampleTaps(int begin, int len, float ratio, int source_len)
+{
+  std::vector<SampleTap> taps(len);
+  for (int i = 0; i < len; ++i)
+  {
+    const float coord = (begin + i + 0.5f) * ratio - 0.5f;
+    int         index = static_cast<int>(std::floor(coord));
+    float       w     = coord - index;
+    if (index < 0)
+    {
+      index = 0;
+      w     = 0.f;
+    }
+    if (index >= source_len - 1)
+    {
+      index = source_len - 1;
+      w     = 0.f;
+    }
+    taps[i] = {index, std::min(index + 1, source_len - 1), w};
+  }
+  return taps;
+}
+
+// Sample the pixels of `roi` (in the original image) into `mask` of `roi` size.
+void SampleLowResMask(const float           *low_res_mask,
+                      const SamMaskGeometry &geometry,
+                      const cv::Rect        &roi,
+                      cv::Mat               &mask)
+{
+  mask.create(roi.height, roi.width, CV_8UC1);
+  if (roi.empty())
+  {
+    return;
+  }
+
+  // valid block of the encoder input, then back to the low-res logits
+  const int   image_height = geometry.image_height;
+  const int   image_width  = geometry.image_width;
+  const int   valid_height = static_cast<int>(image_height * geometry.scale);
+  const int   valid_width  = static_cast<int>(image_width * geometry.scale);
+  const float ratio_y      = static_cast<float>(valid_height) / image_height *
+                        geometry.low_res_height / geometry.input_height;
+  const float ratio_x = static_cast<float>(valid_width) / image_width * geometry.low_res_width /
+                        geometry.input_width;
+
+  const auto row_taps = BuildSampleTaps(roi.y, roi.height, ratio_y, geometry.low_res_height);
+  const auto col_taps = BuildSampleTaps(roi.x, roi.width, ratio_x, geometry.low_res_width);
+
+  const int low_res_width = geometry.low_res_width;
+  cv::parallel_for_(
+      cv::Range(0, roi.height),
+      [&](const cv::Range &range) {
+        // vertical blend of two logits rows, reused by every pixel of the output row
+        std::vector<float> blended_row(low_res_width);
+        for (int y = range.start; y < range.end; ++y)
+        {
+          const SampleTap &row_tap = row_taps[y];
+          const float     *row0    = low_res_mask + row_tap.index0 * low_res_width;
+          const float     *row1    = low_res_mask + row_tap.index1 * low_res_width;
+          const float      w1      = row_tap.weight1;
+          for (int x = 0; x < low_res_width; ++x)
+          {
+            blended_row[x] = row0[x] + (row1[x] - row0[x]) * w1;
+          }
+
+          uint8_t *mask_row = mask.ptr<uint8_t>(y);
+          for (int x = 0; x < roi.width; ++x)
+          {
+            const SampleTap &col_tap = col_taps[x];
+            const float      v0      = blended_row[col_tap.index0];
+            const float      v1      = blended_row[col_tap.index1];
+            mask_row[x]              = (v0 + (v1 - v0) * col_tap.weight1) > 0.f ? 255 : 0;
+          }
+        }
+      },
+      // a few stripes per thread, each stripe amortizes its row buffer
+      std::max(1, roi.height / 64));
+}
+
+cv::Rect ClipToImage(const cv::Rect &roi, const SamMaskGeometry &geometry)
+{
+  return roi & cv::Rect(0, 0, geometry.image_width, geometry.image_height);
+}
+
+} // namespace
+
+std::string SamRleMask::ToCocoString() const
+{
+  // same as `rleToString` of pycocotools : deltas of the counts in 5-bit groups, 48-based chars
+  std::string coco_string;
+  for (size_t i = 0; i < counts.size(); ++i)
+  {
+    long value = static_cast<long>(counts[i]);
+    if (i > 2)
+    {
+      value -= static_cast<long>(counts[i - 2]);
+    }
+    bool more = true;
+    while (more)
+    {
+      char c = value & 0x1f;
+      value >>= 5;
+      more = (c & 0x10) ? value != -1 : value != 0;
+      if (more)
+      {
+        c |= 0x20;
+      }
+      coco_string.push_back(static_cast<char>(c + 48));
+    }
+  }
+  return coco_string;
+}
+
+void ConvertLowResMaskFused(const float           *low_res_mask,
+                            const SamMaskGeometry &geometry,
+                            cv::Mat               &mask)
+{
+  SampleLowResMask(low_res_mask, geometry,
+                   cv::Rect(0, 0, geometry.image_width, geometry.image_height), mask);
+}
+
+void ConvertLowResMaskCropped(const float           *low_res_mask,
+                              const SamMaskGeometry &geometry,
+                              const cv::Rect        &sample_roi,
+                              SamCroppedMask        &mask)
+{
+  const cv::Rect roi = ClipToImage(sample_roi, geometry);
+  cv::Mat        roi_mask;
+  SampleLowResMask(low_res_mask, geometry, roi, roi_mask);
+
+  const cv::Rect tight_roi = roi.empty() ? cv::Rect() : cv::boundingRect(roi_mask);
+  if (tight_roi.empty())
+  {
+    mask.roi  = cv::Rect();
+    mask.mask = cv::Mat();
+    return;
+  }
+  // own a compact buffer instead of a view on the sampled roi
+  mask.mask = roi_mask(tight_roi).clone();
+  mask.roi  = tight_roi + roi.tl();
+}
+
+void ConvertLowResMaskRle(const float           *low_res_mask,
+                          const SamMaskGeometry &geometry,
+                          const cv::Rect        &sample_roi,
+                          SamRleMask            &rle)
+{
+  const cv::Rect roi = ClipToImage(sample_roi, geometry);
+  cv::Mat        roi_mask;
+  SampleLowResMask(low_res_mask, geometry, roi, roi_mask);
+
+  rle.height = geometry.image_height;
+  rle.width  = geometry.image_width;
+  rle.counts.clear();
+
+  uint8_t  current_value = 0;
+  uint32_t run_length    = 0;
+  auto     append_run    = [&](uint8_t value, uint32_t length) {
+    // an empty run would flip the value, only the first count of a canonical rle may be zero
+    if (length == 0)
+    {
+      return;
+    }
+    if (value != current_value)
+    {
+      rle.counts.push_back(run_length);
+      current_value = value;
+      run_length    = 0;
+    }
+    run_length += length;
+  };
+
+  // column-major, pixels out of `roi` are background
+  const uint32_t rows_above = roi.y;
+  const uint32_t rows_below = rle.height - roi.y - roi.height;
+  append_run(0, static_cast<uint32_t>(roi.x) * rle.height);
+  for (int x = 0; x < roi.width; ++x)
+  {
+    append_run(0, rows_above);
+    for (int y = 0; y < roi.height; ++y)
+    {
+      append_run(roi_mask.at<uint8_t>(y, x) ? 1 : 0, 1);
+    }
+    append_run(0, rows_below);
+  }
+  append_run(0, static_cast<uint32_t>(rle.width - roi.x - roi.width) * rle.height);
+  rle.counts.push_back(run_length);
+}
+
+void ConvertLowResMaskReference(const float           *low_res_mask,
+                                const SamMaskGeometry &geometry,
+                                cv::Mat               &mask)
+{
+  cv::Mat masks_output(geometry.low_res_height, geometry.low_res_width, CV_32FC1,
+                       const_cast<float *>(low_res_mask));
+
+  // 1. resize to encoder input size
+  cv::resize(masks_output, masks_output, {geometry.input_width, geometry.input_height});
+
+  // 2. crop valid block
+  masks_output = masks_output(cv::Range(0, geometry.image_height * geometry.scale),
+                              cv::Range(0, geometry.image_width * geometry.scale));
+
+  // 3. resize to original size
+  cv::resize(masks_output, masks_output, {geometry.image_width, geometry.image_height});
+
+  // 4. convert to binary mask
+  cv::threshold(masks_output, masks_output, 0, 1, cv::THRESH_BINARY);
+
+  // 5. convert to CV_8U
+  masks_output = masks_output * 255;
+  masks_output.convertTo(mask, CV_8U);
+}
+
+} // namespace easy_deploy
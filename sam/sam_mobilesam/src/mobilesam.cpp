@@ -1,9 +1,20 @@
 #include "sam_mobilesam/mobilesam.hpp"
 
 #include "deploy_core/wrapper.hpp"
-
-#include <sched.h>
-#include <unistd.h>
+#include "sam_mobilesam/bounded_queue.hpp"
+#include "sam_mobilesam/feature_transpose.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <thread>
 
 namespace easy_deploy {
 
@@ -38,60 +49,67 @@ static void CheckBlobNameMatched(const std::string                    &infer_cor
   }
 }
 
-// Bind transpose processing to big core
-static void bind_to_big_core()
+static std::string ShapeToString(const std::vector<uint64_t> &shape)
 {
-  cpu_set_t mask;
-  CPU_ZERO(&mask);
+  std::string str = "{";
+  for (size_t i = 0; i < shape.size(); ++i)
+  {
+    str += (i == 0 ? "" : ", ") + std::to_string(shape[i]);
+  }
+  return str + "}";
+}
 
-  CPU_SET(4, &mask);
-  CPU_SET(5, &mask);
-  CPU_SET(6, &mask);
-  CPU_SET(7, &mask);
+// The blob should be `height x width` on its last two dims (`NCHW`), or on the two before the last
+// (`NHWC`), and hold `elements_num` elements if not zero.
+static void CheckBlobShapeMatched(const std::string                   &infer_core_name,
+                                  const std::shared_ptr<IBlobsBuffer> &blobs_tensor,
+                                  const std::string                   &blob_name,
+                                  uint64_t                             height,
+                                  uint64_t                             width,
+                                  uint64_t                             elements_num)
+{
+  const auto &shape = blobs_tensor->GetTensor(blob_name)->GetShape();
+  const auto  rank  = shape.size();
 
-  if (sched_setaffinity(0, sizeof(mask), &mask) == -1)
+  uint64_t shape_elements_num = 1;
+  for (const auto dim : shape)
   {
-    perror("sched_setaffinity failed");
+    shape_elements_num *= dim;
+  }
+  const bool spatial_matched =
+      rank >= 2 && ((shape[rank - 2] == height && shape[rank - 1] == width) ||
+                    (rank >= 3 && shape[rank - 3] == height && shape[rank - 2] == width));
+  if (!spatial_matched || (elements_num != 0 && shape_elements_num != elements_num))
+  {
+    ThrowRuntimeError(infer_core_name + " blob `" + blob_name + "` got shape " +
+                          ShapeToString(shape) + " not matching the configured resolution " +
+                          std::to_string(height) + "x" + std::to_string(width),
+                      __LINE__);
   }
 }
 
-// Unbind
-static void unbind_from_big_core()
+// The layout of image features a decoder core takes, rknn decoders take `NHWC` features.
+static SamFeatureLayout GetDecoderFeatureLayout(const std::shared_ptr<BaseInferCore> &decoder_core)
 {
-  cpu_set_t mask;
-  CPU_ZERO(&mask);
-  for (int i = 0; i < sysconf(_SC_NPROCESSORS_ONLN); ++i)
+  if (decoder_core != nullptr && decoder_core->GetType() == InferCoreType::RKNN)
   {
-    CPU_SET(i, &mask);
+    return SamFeatureLayout::NHWC;
   }
-  sched_setaffinity(0, sizeof(mask), &mask);
-  sched_yield();
+  return SamFeatureLayout::NCHW;
 }
 
-static void rknn_nchw_2_nhwc(float *nchw, float *nhwc, int N, int C, int H, int W)
+static std::vector<size_t> SortPromptBuckets(std::vector<size_t> buckets)
 {
-  // only neccessary on `rk3588` platform.
-  bind_to_big_core();
-
-  for (int ni = 0; ni < N; ni++)
+  std::sort(buckets.begin(), buckets.end());
+  buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+  if (!buckets.empty() && buckets.front() == 0)
   {
-    for (int hi = 0; hi < H; hi++)
-    {
-      for (int wi = 0; wi < W; wi++)
-      {
-        for (int ci = 0; ci < C; ci++)
-        {
-          memcpy(nhwc + ni * H * W * C + hi * W * C + wi * C + ci,
-                 nchw + ni * C * H * W + ci * H * W + hi * W + wi, sizeof(float));
-        }
-      }
-    }
+    throw std::invalid_argument("[MobileSAM] prompt buckets should be positive!!!");
   }
-
-  unbind_from_big_core();
+  return buckets;
 }
 
-class MobileSam : public BaseSamModel {
+class MobileSam : public BaseMobileSamModel {
 public:
   MobileSam(std::shared_ptr<BaseInferCore>        image_encoder_core,
             std::shared_ptr<BaseInferCore>        mask_points_decoder_core,
@@ -99,9 +117,73 @@ public:
             std::shared_ptr<IDetectionPreProcess> image_preprocess_block,
             const std::vector<std::string>       &encoder_blob_names,
             const std::vector<std::string>       &box_dec_blob_names,
-            const std::vector<std::string>       &point_dec_blob_names);
+            const std::vector<std::string>       &point_dec_blob_names,
+            const MobileSamConfig                &config,
+            const MobileSamPipelineInstances     &pipeline_instances);
+
+  ~MobileSam();
+
+  std::shared_ptr<const SamImageEmbedding> EncodeImage(const cv::Mat     &image,
+                                                       const std::string &image_id,
+                                                       bool               isRGB) override;
+
+  std::shared_ptr<const SamImageEmbedding> EncodeScaledImage(const cv::Mat     &scaled_image,
+                                                             float              image_scale,
+                                                             const cv::Size    &image_size,
+                                                             const std::string &image_id,
+                                                             bool               isRGB) override;
+
+  bool DecodeMask(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                  const std::vector<BBox2D>                      &boxes,
+                  cv::Mat                                        &result) override;
+
+  bool DecodeMask(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                  const std::vector<std::pair<int, int>>         &points,
+                  const std::vector<int>                         &labels,
+                  cv::Mat                                        &result) override;
+
+  bool DecodeMasks(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                   const std::vector<BBox2D>                      &boxes,
+                   std::vector<cv::Mat>                           &results) override;
+
+  bool DecodeCroppedMasks(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                          const std::vector<BBox2D>                      &boxes,
+                          std::vector<SamCroppedMask>                    &results) override;
+
+  bool DecodeRleMasks(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                      const std::vector<BBox2D>                      &boxes,
+                      std::vector<SamRleMask>                        &results) override;
+
+  bool GenerateMasks(const cv::Mat             &image,
+                     const std::vector<BBox2D> &boxes,
+                     std::vector<cv::Mat>      &results,
+                     bool                       isRGB) override;
+
+  std::future<std::vector<cv::Mat>> GenerateMasksPipelined(const cv::Mat             &image,
+                                                           const std::vector<BBox2D> &boxes,
+                                                           bool isRGB) override;
+
+  std::future<std::vector<cv::Mat>> GenerateMaskPipelined(
+      const cv::Mat                          &image,
+      const std::vector<std::pair<int, int>> &points,
+      const std::vector<int>                 &labels,
+      bool                                    isRGB) override;
+
+  bool RefineMask(SamRefinementSession                   &session,
+                  const std::vector<std::pair<int, int>> &points,
+                  const std::vector<int>                 &labels,
+                  cv::Mat                                &result) override;
 
-  ~MobileSam() = default;
+  bool GenerateAutoMasks(const cv::Mat            &image,
+                         const SamAutoMaskConfig  &config,
+                         std::vector<SamAutoMask> &results,
+                         bool                      isRGB) override;
+
+  std::vector<SamPipelineStageStats> GetPipelineStats() const override;
+
+  SamEmbeddingCacheStats GetEmbeddingCacheStats() const override;
+
+  void ClearEmbeddingCache() override;
 
 private:
   bool ImagePreProcess(ParsingType pipeline_unit) override;
@@ -112,6 +194,176 @@ private:
 
   bool MaskPostProcess(ParsingType pipeline_unit) override;
 
+private:
+  bool PreprocessImage(const std::shared_ptr<SamPipelinePackage> &package,
+                       IDetectionPreProcess                      *preprocess_block);
+
+  // `bucket` is the prompt number `decoder_blobs_tensor` is shaped to, the prompts are padded up
+  // to it. With a zero `bucket` the tensor is shaped to the exact prompt number. `boxes` should
+  // not be empty.
+  void SetBoxPrompts(const std::shared_ptr<IBlobsBuffer> &decoder_blobs_tensor,
+                     const std::vector<BBox2D>           &boxes,
+                     float                                scale,
+                     size_t                               bucket);
+
+  // `mask_prior` is the low-res logits of the previous mask, or null for no prior
+  void SetPointPrompts(const std::shared_ptr<IBlobsBuffer>    &decoder_blobs_tensor,
+                       const std::vector<std::pair<int, int>> &points,
+                       const std::vector<int>                 &labels,
+                       float                                   scale,
+                       size_t                                  bucket,
+                       const float                            *mask_prior = nullptr);
+
+  void SetMaskPrior(const std::shared_ptr<IBlobsBuffer> &decoder_blobs_tensor,
+                    const std::string                   &mask_input_blob_name,
+                    const std::string                   &has_mask_input_blob_name,
+                    const float                         *mask_prior);
+
+  void SetBoxPromptShape(const std::shared_ptr<IBlobsBuffer> &decoder_blobs_tensor,
+                         size_t                               box_number);
+
+  // `prompt_batch` prompts of `point_number` points each, batched on the first dimension
+  void SetPointPromptShape(const std::shared_ptr<IBlobsBuffer> &decoder_blobs_tensor,
+                           size_t                               point_number,
+                           size_t                               prompt_batch = 1);
+
+  // a prompt of one foreground point per grid point, `prompt_batch` prompts padded with the last
+  // point, and each prompt padded to `prompt_points` points
+  void SetGridPointPrompts(const std::shared_ptr<IBlobsBuffer>    &decoder_blobs_tensor,
+                           const std::vector<std::pair<int, int>> &points,
+                           size_t                                  prompt_batch,
+                           size_t                                  prompt_points,
+                           float                                   scale);
+
+  // the smallest bucket not less than `prompt_number`, zero if there is none
+  static size_t GetPromptBucket(const std::vector<size_t> &buckets, size_t prompt_number);
+
+  // a dedicated decoder buffer and the embedding whose features it holds, so the following
+  // prompts on the same image skip the copy
+  struct DecoderBuffer {
+    std::shared_ptr<IBlobsBuffer>          blobs;
+    std::weak_ptr<const SamImageEmbedding> features_owner;
+  };
+  // by prompt bucket, the zero bucket holds the buffer of the exact prompt numbers
+  using DecoderBuffers = std::map<size_t, DecoderBuffer>;
+
+  // allocated on first use, buffers of a bucket are shaped once
+  DecoderBuffer &GetBoxDecoderBuffer(DecoderBuffers                       &buffers,
+                                     const std::shared_ptr<BaseInferCore> &core,
+                                     size_t                                bucket);
+
+  DecoderBuffer &GetPointDecoderBuffer(DecoderBuffers                       &buffers,
+                                       const std::shared_ptr<BaseInferCore> &core,
+                                       size_t                                bucket);
+
+  bool SetPackageFeatures(const std::shared_ptr<SamPipelinePackage> &package,
+                          SamFeatureLayout                           decoder_layout,
+                          const std::string                         &features_blob_name);
+
+  void CopyImageFeatures(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                         SamFeatureLayout                                decoder_layout,
+                         const std::shared_ptr<IBlobsBuffer>            &decoder_blobs_tensor,
+                         const std::string                              &features_blob_name,
+                         std::weak_ptr<const SamImageEmbedding>         &buffer_features_owner);
+
+  // inference on `infer_cpus_`
+  bool Infer(const std::shared_ptr<BaseInferCore> &infer_core, IBlobsBuffer *blobs_buffer);
+
+  SamMaskGeometry MakeMaskGeometry(int image_height, int image_width, float scale) const;
+
+  // the region masks of `box` are sampled in, `box` expanded by `mask_roi_margin_`
+  cv::Rect MakeMaskSampleRoi(const BBox2D &box) const;
+
+  // run the box decoder on chunks of `max_box_number_` boxes, `convert` gets the low-res mask
+  // of each box
+  bool DecodeBoxBatches(const std::shared_ptr<const SamImageEmbedding>   &embedding,
+                        const std::vector<BBox2D>                        &boxes,
+                        const std::function<void(size_t, const float *)> &convert);
+
+private:
+  // pipelined execution : requests -> encoder workers -> encoded requests -> decoder workers
+  struct PipelineRequest {
+    std::shared_ptr<SamPipelinePackage> package;
+    bool                                with_boxes = true;
+    std::promise<std::vector<cv::Mat>>  promise;
+  };
+
+  struct EncoderInstance {
+    std::shared_ptr<BaseInferCore>        core;
+    std::shared_ptr<IDetectionPreProcess> preprocess_block;
+    // encoder buffers not in use, bounds the encoded images of this instance in flight
+    std::unique_ptr<BoundedQueue<std::shared_ptr<IBlobsBuffer>>> free_buffers;
+  };
+
+  struct DecoderInstance {
+    std::shared_ptr<BaseInferCore> box_core;
+    std::shared_ptr<BaseInferCore> point_core;
+    DecoderBuffers                 box_buffers;
+    DecoderBuffers                 point_buffers;
+    // `GenerateAutoMasks` owns other buffers : the features of the pipeline buffers may be
+    // zero-copy views of pooled encoder buffers, which hold another image once given back
+    DecoderBuffers auto_mask_point_buffers;
+    // guards the cores and buffers above, which are shared by the pipeline worker,
+    // `GenerateAutoMasks` and, for the first instance, the dedicated `DecodeMask` calls. Instances
+    // sharing a core with the first one share its mutex too.
+    std::shared_ptr<std::mutex> mtx;
+  };
+
+  // the encoder buffer of `request` goes back to `encoder` once decoded
+  struct EncodedRequest {
+    std::shared_ptr<PipelineRequest> request;
+    EncoderInstance                 *encoder = nullptr;
+  };
+
+  struct StageCounter {
+    std::atomic<int64_t>  busy_ns{0};
+    std::atomic<uint64_t> processed{0};
+  };
+
+  std::future<std::vector<cv::Mat>> SubmitPipelineRequest(
+      std::shared_ptr<PipelineRequest> request);
+
+  void StartPipeline();
+
+  void StopPipeline();
+
+  void RunEncoderWorker(EncoderInstance &encoder);
+
+  void RunDecoderWorker(DecoderInstance &decoder);
+
+  bool DecodePipelineRequest(DecoderInstance       &decoder,
+                             const PipelineRequest &request,
+                             std::vector<cv::Mat>  &masks);
+
+  // decode the grid `points` of one crop, the masks passing the filters are appended to
+  // `results` in original image coordinates
+  bool DecodeAutoMaskPoints(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                            const cv::Rect                                 &crop_box,
+                            const cv::Size                                 &image_size,
+                            const std::vector<std::pair<int, int>>         &points,
+                            const SamAutoMaskConfig                        &config,
+                            std::vector<SamAutoMask>                       &results);
+
+  // one inference of the point decoder on `points`, padded to `batch_size` prompts
+  bool DecodeAutoMaskBatch(DecoderInstance                                &decoder,
+                           const std::shared_ptr<const SamImageEmbedding> &embedding,
+                           const cv::Rect                                 &crop_box,
+                           const cv::Size                                 &image_size,
+                           const std::vector<std::pair<int, int>>         &points,
+                           size_t                                          batch_size,
+                           const SamAutoMaskConfig                        &config,
+                           std::vector<SamAutoMask>                       &results);
+
+  // filter the mask of one grid point, append it to `results` if kept
+  void FilterAutoMask(const float                                    *low_res_mask,
+                      float                                           predicted_iou,
+                      const std::shared_ptr<const SamImageEmbedding> &embedding,
+                      const cv::Rect                                 &crop_box,
+                      const cv::Size                                 &image_size,
+                      const std::pair<int, int>                      &point,
+                      const SamAutoMaskConfig                        &config,
+                      std::vector<SamAutoMask>                       &results);
+
 public:
   static const std::string model_name_;
 
@@ -122,16 +374,64 @@ private:
 
   std::shared_ptr<IDetectionPreProcess> image_preprocess_block_;
 
+  // sizes of the exported models
+  const int IMAGE_INPUT_HEIGHT;
+  const int IMAGE_INPUT_WIDTH;
+  const int IMAGE_FEATURES_LEN;
+  const int IMAGE_FEATURE_HEIGHT;
+  const int IMAGE_FEATURE_WIDTH;
+  const int MASK_LOW_RES_HEIGHT;
+  const int MASK_LOW_RES_WIDTH;
+
+  const size_t              max_box_number_;
+  const int                 feature_transpose_threads_;
+  const float               mask_roi_margin_;
+  const SamFeaturePrecision embedding_precision_;
+
+  // sorted prompt buckets, empty if the prompts are not padded
+  const std::vector<size_t> point_prompt_buckets_;
+  const std::vector<size_t> box_prompt_buckets_;
+
+  // resolved cpu sets of each stage, empty if not pinned
+  const std::vector<int> preprocess_cpus_;
+  const std::vector<int> infer_cpus_;
+  const std::vector<int> postprocess_cpus_;
+  const std::vector<int> transpose_cpus_;
+
+  // layout of the features outputed by the encoder, and the layouts each decoder takes
+  const SamFeatureLayout encoder_features_layout_ = SamFeatureLayout::NCHW;
+  const SamFeatureLayout box_decoder_features_layout_;
+  const SamFeatureLayout point_decoder_features_layout_;
+
+  // prompts every point decoder instance takes in one inference, the first dimension of its
+  // `point_coords` blob
+  size_t point_prompt_batch_capacity_ = 1;
+
+  std::unique_ptr<SamEmbeddingCache> embedding_cache_;
+
+  // dedicated buffers of `EncodeImage` and `DecodeMask`, allocated on first use. The decoder ones
+  // are used under `pipeline_decoders_[0].mtx`, the instance owning the same cores.
+  std::mutex                    encoder_mtx_;
+  std::shared_ptr<IBlobsBuffer> encoder_blobs_buffer_;
+  DecoderBuffers                box_decoder_buffers_;
+  DecoderBuffers                point_decoder_buffers_;
+
+  // pipelined execution, workers are started by the first pipelined call
+  const size_t                                                    pipeline_queue_capacity_;
+  std::vector<EncoderInstance>                                    pipeline_encoders_;
+  std::vector<DecoderInstance>                                    pipeline_decoders_;
+  std::once_flag                                                  pipeline_start_flag_;
+  std::atomic<bool>                                               pipeline_started_{false};
+  std::unique_ptr<BoundedQueue<std::shared_ptr<PipelineRequest>>> pipeline_requests_;
+  std::unique_ptr<BoundedQueue<EncodedRequest>>                   pipeline_encoded_requests_;
+  std::vector<std::thread>                                        pipeline_encoder_workers_;
+  std::vector<std::thread>                                        pipeline_decoder_workers_;
+  std::chrono::steady_clock::time_point                           pipeline_start_time_;
+  StageCounter                                                    encoder_stage_counter_;
+  StageCounter                                                    decoder_stage_counter_;
+
 private:
-  // defualt params, no access provided to user
-  const int         IMAGE_INPUT_HEIGHT   = 1024;
-  const int         IMAGE_INPUT_WIDTH    = 1024;
-  const int         IMAGE_FEATURE_HEIGHT = 64;
-  const int         IMAGE_FEATURE_WIDTH  = 64;
-  const int         IMAGE_FEATURES_LEN   = 256;
-  const int         MASK_LOW_RES_HEIGHT  = 256;
-  const int         MASK_LOW_RES_WIDTH   = 256;
-  const std::string MASK_OUT_BLOB_NAME   = "masks";
+  const std::string MASK_OUT_BLOB_NAME = "masks";
 };
 
 const std::string MobileSam::model_name_ = "MobileSam";
@@ -142,13 +442,35 @@ MobileSam::MobileSam(std::shared_ptr<BaseInferCore>        image_encoder_core,
                      std::shared_ptr<IDetectionPreProcess> image_preprocess_block,
                      const std::vector<std::string>       &encoder_blob_names,
                      const std::vector<std::string>       &box_dec_blob_names,
-                     const std::vector<std::string>       &point_dec_blob_names)
-    : BaseSamModel(
+                     const std::vector<std::string>       &point_dec_blob_names,
+                     const MobileSamConfig                &config,
+                     const MobileSamPipelineInstances     &pipeline_instances)
+    : BaseMobileSamModel(
           model_name_, image_encoder_core, mask_points_decoder_core, mask_boxes_decoder_core),
       image_preprocess_block_(image_preprocess_block),
       encoder_blob_names_(encoder_blob_names),
       box_dec_blob_names_(box_dec_blob_names),
-      point_dec_blob_names_(point_dec_blob_names)
+      point_dec_blob_names_(point_dec_blob_names),
+      IMAGE_INPUT_HEIGHT(config.resolution.image_input_height),
+      IMAGE_INPUT_WIDTH(config.resolution.image_input_width),
+      IMAGE_FEATURES_LEN(config.resolution.image_features_len),
+      IMAGE_FEATURE_HEIGHT(config.resolution.image_feature_height),
+      IMAGE_FEATURE_WIDTH(config.resolution.image_feature_width),
+      MASK_LOW_RES_HEIGHT(config.resolution.mask_low_res_height),
+      MASK_LOW_RES_WIDTH(config.resolution.mask_low_res_width),
+      max_box_number_(config.max_box_number),
+      feature_transpose_threads_(config.feature_transpose_threads),
+      mask_roi_margin_(config.mask_roi_margin),
+      embedding_precision_(config.embedding_precision),
+      point_prompt_buckets_(SortPromptBuckets(config.point_prompt_buckets)),
+      box_prompt_buckets_(SortPromptBuckets(config.box_prompt_buckets)),
+      preprocess_cpus_(CpuTopology::Instance().ResolveCpuSet(config.cpu_affinity.preprocess)),
+      infer_cpus_(CpuTopology::Instance().ResolveCpuSet(config.cpu_affinity.infer)),
+      postprocess_cpus_(CpuTopology::Instance().ResolveCpuSet(config.cpu_affinity.postprocess)),
+      transpose_cpus_(CpuTopology::Instance().ResolveCpuSet(config.cpu_affinity.transpose)),
+      box_decoder_features_layout_(GetDecoderFeatureLayout(mask_boxes_decoder_core)),
+      point_decoder_features_layout_(GetDecoderFeatureLayout(mask_points_decoder_core)),
+      pipeline_queue_capacity_(config.pipeline_queue_capacity)
 {
   // Check
   CheckBlobNameMatched("image_encoder", image_encoder_core, encoder_blob_names);
@@ -157,10 +479,127 @@ MobileSam::MobileSam(std::shared_ptr<BaseInferCore>        image_encoder_core,
   if (mask_points_decoder_core != nullptr)
     CheckBlobNameMatched("point_decoder", mask_points_decoder_core, point_dec_blob_names);
 
+  if (IMAGE_INPUT_HEIGHT <= 0 || IMAGE_INPUT_WIDTH <= 0 || IMAGE_FEATURES_LEN <= 0 ||
+      IMAGE_FEATURE_HEIGHT <= 0 || IMAGE_FEATURE_WIDTH <= 0 || MASK_LOW_RES_HEIGHT <= 0 ||
+      MASK_LOW_RES_WIDTH <= 0)
+  {
+    throw std::invalid_argument("[MobileSAM] `resolution` sizes should be positive!!!");
+  }
+  const uint64_t features_elements_num =
+      static_cast<uint64_t>(IMAGE_FEATURES_LEN) * IMAGE_FEATURE_HEIGHT * IMAGE_FEATURE_WIDTH;
+  {
+    auto blobs_tensor = image_encoder_core->AllocBlobsBuffer();
+    CheckBlobShapeMatched("image_encoder", blobs_tensor, encoder_blob_names[0],
+                          IMAGE_INPUT_HEIGHT, IMAGE_INPUT_WIDTH,
+                          3ull * IMAGE_INPUT_HEIGHT * IMAGE_INPUT_WIDTH);
+    CheckBlobShapeMatched("image_encoder", blobs_tensor, encoder_blob_names[1],
+                          IMAGE_FEATURE_HEIGHT, IMAGE_FEATURE_WIDTH, features_elements_num);
+  }
+  // features, mask_input and the output masks of each decoder, masks hold a dynamic prompt number
+  auto check_decoder_shapes = [&](const std::string                    &infer_core_name,
+                                  const std::shared_ptr<BaseInferCore> &infer_core,
+                                  const std::vector<std::string>       &blob_names,
+                                  const std::string                    &mask_input_blob_name) {
+    auto blobs_tensor = infer_core->AllocBlobsBuffer();
+    CheckBlobShapeMatched(infer_core_name, blobs_tensor, blob_names[0], IMAGE_FEATURE_HEIGHT,
+                          IMAGE_FEATURE_WIDTH, features_elements_num);
+    CheckBlobShapeMatched(infer_core_name, blobs_tensor, mask_input_blob_name,
+                          MASK_LOW_RES_HEIGHT, MASK_LOW_RES_WIDTH,
+                          static_cast<uint64_t>(MASK_LOW_RES_HEIGHT) * MASK_LOW_RES_WIDTH);
+    CheckBlobShapeMatched(infer_core_name, blobs_tensor, MASK_OUT_BLOB_NAME, MASK_LOW_RES_HEIGHT,
+                          MASK_LOW_RES_WIDTH, 0);
+  };
+  if (mask_boxes_decoder_core != nullptr)
+    check_decoder_shapes("box_decoder", mask_boxes_decoder_core, box_dec_blob_names,
+                         box_dec_blob_names[2]);
+  if (mask_points_decoder_core != nullptr)
+    check_decoder_shapes("point_decoder", mask_points_decoder_core, point_dec_blob_names,
+                         point_dec_blob_names[3]);
+
   if (image_preprocess_block_ == nullptr)
   {
     throw std::invalid_argument("[MobileSAM] Got INVALID preprocess_block ptr!!!");
   }
+
+  if (max_box_number_ == 0)
+  {
+    throw std::invalid_argument("[MobileSAM] `max_box_number` should be positive!!!");
+  }
+
+  if (!box_prompt_buckets_.empty() && box_prompt_buckets_.back() > max_box_number_)
+  {
+    throw std::invalid_argument("[MobileSAM] box prompt buckets exceed `max_box_number`!!!");
+  }
+
+  if (config.embedding_cache_capacity_bytes > 0)
+  {
+    embedding_cache_ = std::make_unique<SamEmbeddingCache>(config.embedding_cache_capacity_bytes);
+  }
+
+  if (pipeline_queue_capacity_ == 0)
+  {
+    throw std::invalid_argument("[MobileSAM] `pipeline_queue_capacity` should be positive!!!");
+  }
+
+  // the first instance of each stage is the cores the model is created with, extra instances
+  // without their own preprocess block share the first one
+  pipeline_encoders_.resize(1 + pipeline_instances.image_encoder_cores.size());
+  for (size_t i = 0; i < pipeline_encoders_.size(); ++i)
+  {
+    auto &encoder = pipeline_encoders_[i];
+    encoder.core  = i == 0 ? image_encoder_core : pipeline_instances.image_encoder_cores[i - 1];
+    encoder.preprocess_block = image_preprocess_block_;
+    if (i > 0 && i - 1 < pipeline_instances.image_preprocess_blocks.size())
+    {
+      encoder.preprocess_block = pipeline_instances.image_preprocess_blocks[i - 1];
+    }
+    if (encoder.core == nullptr || encoder.preprocess_block == nullptr)
+    {
+      throw std::invalid_argument("[MobileSAM] Got INVALID pipeline encoder instance!!!");
+    }
+  }
+
+  // extra decoder instances missing one of the decoders share the first instance's one
+  pipeline_decoders_.resize(1 + std::max(pipeline_instances.mask_boxes_decoder_cores.size(),
+                                         pipeline_instances.mask_points_decoder_cores.size()));
+  for (size_t i = 0; i < pipeline_decoders_.size(); ++i)
+  {
+    auto &decoder      = pipeline_decoders_[i];
+    decoder.box_core   = mask_boxes_decoder_core;
+    decoder.point_core = mask_points_decoder_core;
+    if (i > 0 && i - 1 < pipeline_instances.mask_boxes_decoder_cores.size())
+    {
+      decoder.box_core = pipeline_instances.mask_boxes_decoder_cores[i - 1];
+    }
+    if (i > 0 && i - 1 < pipeline_instances.mask_points_decoder_cores.size())
+    {
+      decoder.point_core = pipeline_instances.mask_points_decoder_cores[i - 1];
+    }
+    const bool shares_box_core =
+        decoder.box_core != nullptr && decoder.box_core == mask_boxes_decoder_core;
+    const bool shares_point_core =
+        decoder.point_core != nullptr && decoder.point_core == mask_points_decoder_core;
+    const bool shares_first_cores = i > 0 && (shares_box_core || shares_point_core);
+    decoder.mtx = shares_first_cores ? pipeline_decoders_[0].mtx : std::make_shared<std::mutex>();
+  }
+
+  // `GenerateAutoMasks` batches its single-point prompts up to the smallest capacity
+  if (mask_points_decoder_core != nullptr)
+  {
+    point_prompt_batch_capacity_ = std::numeric_limits<size_t>::max();
+    for (const auto &decoder : pipeline_decoders_)
+    {
+      auto        blobs_tensor = decoder.point_core->AllocBlobsBuffer();
+      const auto &coords_shape = blobs_tensor->GetTensor(point_dec_blob_names_[1])->GetShape();
+      point_prompt_batch_capacity_ =
+          std::min<size_t>(point_prompt_batch_capacity_, std::max<uint64_t>(1, coords_shape[0]));
+    }
+  }
+}
+
+MobileSam::~MobileSam()
+{
+  StopPipeline();
 }
 
 bool MobileSam::ImagePreProcess(ParsingType package)
@@ -169,6 +608,13 @@ bool MobileSam::ImagePreProcess(ParsingType package)
   CHECK_STATE(p_package != nullptr,
               "[MobileSam Image PreProcess] the `package` instance \
                                     is not a instance of `SamPipelinePackage`!");
+  return PreprocessImage(p_package, image_preprocess_block_.get());
+}
+
+bool MobileSam::PreprocessImage(const std::shared_ptr<SamPipelinePackage> &p_package,
+                                IDetectionPreProcess                      *preprocess_block)
+{
+  ScopedCpuAffinity affinity(preprocess_cpus_);
 
   auto encoder_blobs_tensor = p_package->image_encoder_blobs_buffer;
   // make the output buffer at device side
@@ -176,7 +622,7 @@ bool MobileSam::ImagePreProcess(ParsingType package)
   encoder_blobs_tensor->GetTensor(encoder_blob_names_[1])->SetBufferLocation(DataLocation::DEVICE);
 
   // preprocess image and write into buffer
-  const auto scale = image_preprocess_block_->Preprocess(
+  const auto scale = preprocess_block->Preprocess(
       p_package->input_image_data, encoder_blobs_tensor->GetTensor(encoder_blob_names_[0]),
       IMAGE_INPUT_HEIGHT, IMAGE_INPUT_WIDTH);
   // set the inference buffer
@@ -193,55 +639,53 @@ bool MobileSam::PromptBoxPreProcess(ParsingType package)
   CHECK_STATE(p_package != nullptr,
               "[MobileSam Prompt PreProcess] the `package` instance \
                           is not a instance of `SamPipelinePackage`!");
+  ScopedCpuAffinity affinity(preprocess_cpus_);
 
-  // 0. Get the decoder and encoder buffer
+  // 0. Share or convert the image features
   auto decoder_blobs_tensor = p_package->mask_decoder_blobs_buffer;
+  CHECK_STATE(SetPackageFeatures(p_package, box_decoder_features_layout_, box_dec_blob_names_[0]),
+              "[MobileSam Prompt PreProcess] set image features failed!");
 
-  auto encoder_blobs_tensor  = p_package->image_encoder_blobs_buffer;
-  auto encoder_output_tensor = encoder_blobs_tensor->GetTensor(encoder_blob_names_[1]);
-  auto image_features_ptr    = encoder_output_tensor->Cast<float>();
-
-  ////////////////// Transpose if decoder is rknn framework //////////////////
-  if (mask_boxes_decoder_core_->GetType() == InferCoreType::RKNN)
+  // 1. Set prompt
+  // the bucket padding repeats the last box, there must be one
+  CHECK_STATE(!p_package->boxes.empty() && p_package->boxes.size() <= max_box_number_,
+              "[MobileSam Prompt PreProcess] got empty boxes or more than `max_box_number`!");
+  // the package buffer is shared by every prompt number, so it is shaped to the bucket each time
+  const size_t bucket = GetPromptBucket(box_prompt_buckets_, p_package->boxes.size());
+  if (bucket > 0)
   {
-    LOG_DEBUG(
-        "[MobileSAM] Got rknn mask box decoder! Transposing Image Features to `NHWC` format!!!");
-    const size_t total_image_feature_elements_num =
-        IMAGE_FEATURE_HEIGHT * IMAGE_FEATURE_WIDTH * IMAGE_FEATURES_LEN;
-    std::vector<float> hwc_buffer(total_image_feature_elements_num);
-    rknn_nchw_2_nhwc(image_features_ptr, hwc_buffer.data(), 1, IMAGE_FEATURES_LEN,
-                     IMAGE_FEATURE_HEIGHT, IMAGE_FEATURE_WIDTH);
-    memcpy(image_features_ptr, hwc_buffer.data(), total_image_feature_elements_num * sizeof(float));
+    SetBoxPromptShape(decoder_blobs_tensor, bucket);
   }
-  ////////////////////////////////////////////////////////////////////////////
+  SetBoxPrompts(decoder_blobs_tensor, p_package->boxes, p_package->transform_scale, bucket);
 
-  // Zero-Copy Feature : let decoder use the buffer which encoder outputs
-  // Encoder/Decoder with different infer_core are supported. (if the hardware support)
-  decoder_blobs_tensor->GetTensor(box_dec_blob_names_[0])->ZeroCopy(encoder_output_tensor);
+  // 2. Set inference buffer
+  p_package->infer_buffer = decoder_blobs_tensor.get();
 
-  // 1. Set prompt
-  const auto    &boxes     = p_package->boxes;
-  const auto    &scale     = p_package->transform_scale;
-  float         *boxes_ptr = decoder_blobs_tensor->GetTensor(box_dec_blob_names_[1])->Cast<float>();
-  const uint64_t dynmaic_box_number = boxes.size();
-  for (uint64_t i = 0; i < dynmaic_box_number; ++i)
-  {
-    const auto &box      = boxes[i];
-    boxes_ptr[i * 4 + 0] = (box.x - box.w / 2.f) * scale;
-    boxes_ptr[i * 4 + 1] = (box.y - box.h / 2.f) * scale;
-    boxes_ptr[i * 4 + 2] = (box.x + box.w / 2.f) * scale;
-    boxes_ptr[i * 4 + 3] = (box.y + box.h / 2.f) * scale;
-  }
+  return true;
+}
 
-  // Set dynamic shape
-  std::vector<uint64_t> dynamic_shape{1, dynmaic_box_number, 4};
-  decoder_blobs_tensor->GetTensor(box_dec_blob_names_[1])->SetShape(dynamic_shape);
+bool MobileSam::PromptPointPreProcess(ParsingType package)
+{
+  auto p_package = std::dynamic_pointer_cast<SamPipelinePackage>(package);
+  CHECK_STATE(p_package != nullptr,
+              "[MobileSam Prompt PreProcess] the `package` instance \
+                          is not a instance of `SamPipelinePackage`!");
+  ScopedCpuAffinity affinity(preprocess_cpus_);
 
-  float *mask_input = decoder_blobs_tensor->GetTensor(box_dec_blob_names_[2])->Cast<float>();
-  memset(mask_input, 0, MASK_LOW_RES_WIDTH * MASK_LOW_RES_HEIGHT * sizeof(float));
+  // 0. Share or convert the image features
+  auto decoder_blobs_tensor = p_package->mask_decoder_blobs_buffer;
+  CHECK_STATE(
+      SetPackageFeatures(p_package, point_decoder_features_layout_, point_dec_blob_names_[0]),
+      "[MobileSam Prompt PreProcess] set image features failed!");
 
-  float *has_mask_input = decoder_blobs_tensor->GetTensor(box_dec_blob_names_[3])->Cast<float>();
-  has_mask_input[0]     = 1.f;
+  // 1. Set prompt
+  const size_t bucket = GetPromptBucket(point_prompt_buckets_, p_package->points.size());
+  if (bucket > 0)
+  {
+    SetPointPromptShape(decoder_blobs_tensor, bucket);
+  }
+  SetPointPrompts(decoder_blobs_tensor, p_package->points, p_package->labels,
+                  p_package->transform_scale, bucket);
 
   // 2. Set inference buffer
   p_package->infer_buffer = decoder_blobs_tensor.get();
@@ -249,44 +693,70 @@ bool MobileSam::PromptBoxPreProcess(ParsingType package)
   return true;
 }
 
-bool MobileSam::PromptPointPreProcess(ParsingType package)
+bool MobileSam::MaskPostProcess(ParsingType package)
 {
   auto p_package = std::dynamic_pointer_cast<SamPipelinePackage>(package);
   CHECK_STATE(p_package != nullptr,
-              "[MobileSam Prompt PreProcess] the `package` instance \
+              "[MobileSam Mask PostProcess] the `package` instance \
                           is not a instance of `SamPipelinePackage`!");
+  ScopedCpuAffinity affinity(postprocess_cpus_);
 
-  // 0. Get the decoder and encoder buffer
   auto decoder_blobs_tensor = p_package->mask_decoder_blobs_buffer;
 
-  auto encoder_blobs_tensor  = p_package->image_encoder_blobs_buffer;
-  auto encoder_output_tensor = encoder_blobs_tensor->GetTensor(encoder_blob_names_[1]);
-  auto image_features_ptr    = encoder_output_tensor->Cast<float>();
+  // 1. Get the output masks buffer
+  const float *decoder_output_masks_ptr =
+      static_cast<const float *>(decoder_blobs_tensor->GetTensor(MASK_OUT_BLOB_NAME)->RawPtr());
+
+  // 2. Convert to binary mask at original size
+  const auto &input_image_info = p_package->input_image_data->GetImageDataInfo();
+  // single pass from logits to the binary mask, the package mask buffer is reused
+  ConvertLowResMaskFused(decoder_output_masks_ptr,
+                         MakeMaskGeometry(input_image_info.image_height,
+                                          input_image_info.image_width, p_package->transform_scale),
+                         p_package->mask);
+
+  return true;
+}
+
+void MobileSam::SetBoxPrompts(const std::shared_ptr<IBlobsBuffer> &decoder_blobs_tensor,
+                              const std::vector<BBox2D>           &boxes,
+                              float                                scale,
+                              size_t                               bucket)
+{
+  float *boxes_ptr = decoder_blobs_tensor->GetTensor(box_dec_blob_names_[1])->Cast<float>();
+  const uint64_t dynmaic_box_number = boxes.size();
+  for (uint64_t i = 0; i < dynmaic_box_number; ++i)
+  {
+    const auto &box      = boxes[i];
+    boxes_ptr[i * 4 + 0] = (box.x - box.w / 2.f) * scale;
+    boxes_ptr[i * 4 + 1] = (box.y - box.h / 2.f) * scale;
+    boxes_ptr[i * 4 + 2] = (box.x + box.w / 2.f) * scale;
+    boxes_ptr[i * 4 + 3] = (box.y + box.h / 2.f) * scale;
+  }
 
-  ////////////////// Transpose if decoder is rknn framework //////////////////
-  if (mask_boxes_decoder_core_->GetType() == InferCoreType::RKNN)
+  if (bucket == 0)
+  {
+    SetBoxPromptShape(decoder_blobs_tensor, dynmaic_box_number);
+  }
+  // pad with the last box, a valid prompt whose mask is never read
+  for (uint64_t i = dynmaic_box_number; i < bucket; ++i)
   {
-    LOG_DEBUG(
-        "[MobileSAM] Got rknn mask box decoder! Transposing Image Features to `NHWC` format!!!");
-    const size_t total_image_feature_elements_num =
-        IMAGE_FEATURE_HEIGHT * IMAGE_FEATURE_WIDTH * IMAGE_FEATURES_LEN;
-    std::vector<float> hwc_buffer(total_image_feature_elements_num);
-    rknn_nchw_2_nhwc(image_features_ptr, hwc_buffer.data(), 1, IMAGE_FEATURES_LEN,
-                     IMAGE_FEATURE_HEIGHT, IMAGE_FEATURE_WIDTH);
-    memcpy(image_features_ptr, hwc_buffer.data(), total_image_feature_elements_num * sizeof(float));
+    std::copy(boxes_ptr + (dynmaic_box_number - 1) * 4, boxes_ptr + dynmaic_box_number * 4,
+              boxes_ptr + i * 4);
   }
-  ////////////////////////////////////////////////////////////////////////////
 
-  // Zero-Copy Feature : let decoder use the buffer which encoder outputs
-  // Encoder/Decoder with different infer_core are supported. (if the hardware support)
-  decoder_blobs_tensor->GetTensor(box_dec_blob_names_[0])->ZeroCopy(encoder_output_tensor);
+  SetMaskPrior(decoder_blobs_tensor, box_dec_blob_names_[2], box_dec_blob_names_[3], nullptr);
+}
 
-  // 1. Set prompt
-  const auto &points     = p_package->points;
-  const auto &labels     = p_package->labels;
-  const auto &scale      = p_package->transform_scale;
-  float      *points_ptr = decoder_blobs_tensor->GetTensor(point_dec_blob_names_[1])->Cast<float>();
-  float      *labels_ptr = decoder_blobs_tensor->GetTensor(point_dec_blob_names_[2])->Cast<float>();
+void MobileSam::SetPointPrompts(const std::shared_ptr<IBlobsBuffer>    &decoder_blobs_tensor,
+                                const std::vector<std::pair<int, int>> &points,
+                                const std::vector<int>                 &labels,
+                                float                                   scale,
+                                size_t                                  bucket,
+                                const float                            *mask_prior)
+{
+  float *points_ptr = decoder_blobs_tensor->GetTensor(point_dec_blob_names_[1])->Cast<float>();
+  float *labels_ptr = decoder_blobs_tensor->GetTensor(point_dec_blob_names_[2])->Cast<float>();
 
   const uint64_t dynamic_point_number = points.size();
   for (uint64_t i = 0; i < dynamic_point_number; ++i)
@@ -298,74 +768,984 @@ bool MobileSam::PromptPointPreProcess(ParsingType package)
     labels_ptr[i]         = static_cast<float>(lab);
   }
 
-  // Set dynamic shape
-  std::vector<uint64_t> coords_dynamic_shape{1, dynamic_point_number, 2};
+  if (bucket == 0)
+  {
+    SetPointPromptShape(decoder_blobs_tensor, dynamic_point_number);
+  }
+  // pad points are labeled -1, which the sam prompt encoder ignores
+  for (uint64_t i = dynamic_point_number; i < bucket; ++i)
+  {
+    points_ptr[i * 2 + 0] = 0.f;
+    points_ptr[i * 2 + 1] = 0.f;
+    labels_ptr[i]         = -1.f;
+  }
+
+  SetMaskPrior(decoder_blobs_tensor, point_dec_blob_names_[3], point_dec_blob_names_[4],
+               mask_prior);
+}
+
+void MobileSam::SetMaskPrior(const std::shared_ptr<IBlobsBuffer> &decoder_blobs_tensor,
+                             const std::string                   &mask_input_blob_name,
+                             const std::string                   &has_mask_input_blob_name,
+                             const float                         *mask_prior)
+{
+  // without a prior the decoder must be told so, a zero `mask_input` is not an empty prior
+  const size_t mask_elements_num = MASK_LOW_RES_HEIGHT * MASK_LOW_RES_WIDTH;
+  float       *mask_input = decoder_blobs_tensor->GetTensor(mask_input_blob_name)->Cast<float>();
+  if (mask_prior != nullptr)
+  {
+    memcpy(mask_input, mask_prior, mask_elements_num * sizeof(float));
+  } else
+  {
+    memset(mask_input, 0, mask_elements_num * sizeof(float));
+  }
+
+  float *has_mask_input =
+      decoder_blobs_tensor->GetTensor(has_mask_input_blob_name)->Cast<float>();
+  has_mask_input[0] = mask_prior != nullptr ? 1.f : 0.f;
+}
+
+void MobileSam::SetBoxPromptShape(const std::shared_ptr<IBlobsBuffer> &decoder_blobs_tensor,
+                                  size_t                               box_number)
+{
+  std::vector<uint64_t> dynamic_shape{1, box_number, 4};
+  decoder_blobs_tensor->GetTensor(box_dec_blob_names_[1])->SetShape(dynamic_shape);
+}
+
+void MobileSam::SetPointPromptShape(const std::shared_ptr<IBlobsBuffer> &decoder_blobs_tensor,
+                                    size_t                               point_number,
+                                    size_t                               prompt_batch)
+{
+  std::vector<uint64_t> coords_dynamic_shape{prompt_batch, point_number, 2};
   decoder_blobs_tensor->GetTensor(point_dec_blob_names_[1])->SetShape(coords_dynamic_shape);
-  std::vector<uint64_t> labels_dynamic_shape{1, dynamic_point_number};
+  std::vector<uint64_t> labels_dynamic_shape{prompt_batch, point_number};
   decoder_blobs_tensor->GetTensor(point_dec_blob_names_[2])->SetShape(labels_dynamic_shape);
+}
 
-  float *mask_input = decoder_blobs_tensor->GetTensor(point_dec_blob_names_[3])->Cast<float>();
-  memset(mask_input, 0, MASK_LOW_RES_HEIGHT * MASK_LOW_RES_WIDTH * sizeof(float));
+void MobileSam::SetGridPointPrompts(const std::shared_ptr<IBlobsBuffer>    &decoder_blobs_tensor,
+                                    const std::vector<std::pair<int, int>> &points,
+                                    size_t                                  prompt_batch,
+                                    size_t                                  prompt_points,
+                                    float                                   scale)
+{
+  float *points_ptr = decoder_blobs_tensor->GetTensor(point_dec_blob_names_[1])->Cast<float>();
+  float *labels_ptr = decoder_blobs_tensor->GetTensor(point_dec_blob_names_[2])->Cast<float>();
 
-  float *has_mask_input = decoder_blobs_tensor->GetTensor(point_dec_blob_names_[4])->Cast<float>();
-  has_mask_input[0]     = 1.f;
+  SetPointPromptShape(decoder_blobs_tensor, prompt_points, prompt_batch);
+  for (size_t b = 0; b < prompt_batch; ++b)
+  {
+    // pad prompts repeat the last point, their masks are never read
+    const auto &point             = points[std::min(b, points.size() - 1)];
+    float      *prompt_points_ptr = points_ptr + b * prompt_points * 2;
+    float      *prompt_labels_ptr = labels_ptr + b * prompt_points;
+    prompt_points_ptr[0]          = static_cast<float>(point.first * scale);
+    prompt_points_ptr[1]          = static_cast<float>(point.second * scale);
+    prompt_labels_ptr[0]          = 1.f;
+    // pad points are labeled -1, which the sam prompt encoder ignores
+    for (size_t i = 1; i < prompt_points; ++i)
+    {
+      prompt_points_ptr[i * 2 + 0] = 0.f;
+      prompt_points_ptr[i * 2 + 1] = 0.f;
+      prompt_labels_ptr[i]         = -1.f;
+    }
+  }
 
-  // 2. Set inference buffer
-  p_package->infer_buffer = decoder_blobs_tensor.get();
+  SetMaskPrior(decoder_blobs_tensor, point_dec_blob_names_[3], point_dec_blob_names_[4], nullptr);
+}
+
+size_t MobileSam::GetPromptBucket(const std::vector<size_t> &buckets, size_t prompt_number)
+{
+  auto iter = std::lower_bound(buckets.begin(), buckets.end(), prompt_number);
+  return iter == buckets.end() ? 0 : *iter;
+}
+
+MobileSam::DecoderBuffer &MobileSam::GetBoxDecoderBuffer(
+    DecoderBuffers &buffers, const std::shared_ptr<BaseInferCore> &core, size_t bucket)
+{
+  auto &buffer = buffers[bucket];
+  if (buffer.blobs == nullptr)
+  {
+    buffer.blobs = core->AllocBlobsBuffer();
+    if (bucket > 0)
+    {
+      SetBoxPromptShape(buffer.blobs, bucket);
+    }
+  }
+  return buffer;
+}
+
+MobileSam::DecoderBuffer &MobileSam::GetPointDecoderBuffer(
+    DecoderBuffers &buffers, const std::shared_ptr<BaseInferCore> &core, size_t bucket)
+{
+  auto &buffer = buffers[bucket];
+  if (buffer.blobs == nullptr)
+  {
+    buffer.blobs = core->AllocBlobsBuffer();
+    if (bucket > 0)
+    {
+      SetPointPromptShape(buffer.blobs, bucket);
+    }
+  }
+  return buffer;
+}
+
+bool MobileSam::SetPackageFeatures(const std::shared_ptr<SamPipelinePackage> &package,
+                                   SamFeatureLayout                           decoder_layout,
+                                   const std::string                         &features_blob_name)
+{
+  auto encoder_output_tensor =
+      package->image_encoder_blobs_buffer->GetTensor(encoder_blob_names_[1]);
+  auto decoder_features_tensor =
+      package->mask_decoder_blobs_buffer->GetTensor(features_blob_name);
 
+  if (decoder_layout == encoder_features_layout_)
+  {
+    // Zero-Copy Feature : let decoder use the buffer which encoder outputs
+    // Encoder/Decoder with different infer_core are supported. (if the hardware support)
+    decoder_features_tensor->ZeroCopy(encoder_output_tensor);
+    return true;
+  }
+
+  CHECK_STATE(encoder_features_layout_ == SamFeatureLayout::NCHW,
+              "[MobileSam] only `NCHW` encoder features could be converted!");
+  LOG_DEBUG("[MobileSAM] Decoder takes `NHWC` features! Transposing Image Features!!!");
+  // out-of-place into the decoder buffer held by this package, the encoder output is kept
+  // untouched, so it is converted once per package whatever the number of prompts
+  ScopedCpuAffinity affinity(transpose_cpus_);
+  TransposeNchwToNhwc(encoder_output_tensor->Cast<float>(), decoder_features_tensor->Cast<float>(),
+                      1, IMAGE_FEATURES_LEN, IMAGE_FEATURE_HEIGHT, IMAGE_FEATURE_WIDTH,
+                      feature_transpose_threads_);
   return true;
 }
 
-bool MobileSam::MaskPostProcess(ParsingType package)
+void MobileSam::CopyImageFeatures(
+    const std::shared_ptr<const SamImageEmbedding> &embedding,
+    SamFeatureLayout                                decoder_layout,
+    const std::shared_ptr<IBlobsBuffer>            &decoder_blobs_tensor,
+    const std::string                              &features_blob_name,
+    std::weak_ptr<const SamImageEmbedding>         &buffer_features_owner)
 {
-  auto p_package = std::dynamic_pointer_cast<SamPipelinePackage>(package);
-  CHECK_STATE(p_package != nullptr,
-              "[MobileSam Mask PostProcess] the `package` instance \
-                          is not a instance of `SamPipelinePackage`!");
+  if (buffer_features_owner.lock() == embedding)
+  {
+    return;
+  }
 
-  auto decoder_blobs_tensor = p_package->mask_decoder_blobs_buffer;
+  // the embedding keeps the converted features, so each image is converted at most once,
+  // compressed features are expanded into the decoder buffer
+  float *decoder_features_ptr = decoder_blobs_tensor->GetTensor(features_blob_name)->Cast<float>();
+  if (!embedding->HasFeatures(decoder_layout) ||
+      embedding->Precision() != SamFeaturePrecision::FP32)
+  {
+    ScopedCpuAffinity affinity(transpose_cpus_);
+    embedding->CopyFeatures(decoder_layout, decoder_features_ptr, feature_transpose_threads_);
+  } else
+  {
+    embedding->CopyFeatures(decoder_layout, decoder_features_ptr);
+  }
+  buffer_features_owner = embedding;
+}
 
-  // 1. Get the output masks buffer
-  void   *decoder_output_masks_ptr = decoder_blobs_tensor->GetTensor(MASK_OUT_BLOB_NAME)->RawPtr();
-  cv::Mat masks_output(MASK_LOW_RES_HEIGHT, MASK_LOW_RES_WIDTH, CV_32FC1, decoder_output_masks_ptr);
+bool MobileSam::Infer(const std::shared_ptr<BaseInferCore> &infer_core, IBlobsBuffer *blobs_buffer)
+{
+  ScopedCpuAffinity affinity(infer_cpus_);
+  return infer_core->SyncInfer(blobs_buffer);
+}
 
-  // 2. resize to 1024,1024
-  cv::resize(masks_output, masks_output, {IMAGE_INPUT_WIDTH, IMAGE_INPUT_HEIGHT});
+SamMaskGeometry MobileSam::MakeMaskGeometry(int image_height, int image_width, float scale) const
+{
+  SamMaskGeometry geometry;
+  geometry.low_res_height = MASK_LOW_RES_HEIGHT;
+  geometry.low_res_width  = MASK_LOW_RES_WIDTH;
+  geometry.input_height   = IMAGE_INPUT_HEIGHT;
+  geometry.input_width    = IMAGE_INPUT_WIDTH;
+  geometry.scale          = scale;
+  geometry.image_height   = image_height;
+  geometry.image_width    = image_width;
+  return geometry;
+}
 
-  // 3. crop valid block
-  const auto &input_image_info = p_package->input_image_data->GetImageDataInfo();
-  const auto &scale            = p_package->transform_scale;
-  masks_output                 = masks_output(cv::Range(0, input_image_info.image_height * scale),
-                                              cv::Range(0, input_image_info.image_width * scale));
+cv::Rect MobileSam::MakeMaskSampleRoi(const BBox2D &box) const
+{
+  const float half_w = box.w * (0.5f + mask_roi_margin_);
+  const float half_h = box.h * (0.5f + mask_roi_margin_);
+  const int   x0     = static_cast<int>(std::floor(box.x - half_w));
+  const int   y0     = static_cast<int>(std::floor(box.y - half_h));
+  const int   x1     = static_cast<int>(std::ceil(box.x + half_w));
+  const int   y1     = static_cast<int>(std::ceil(box.y + half_h));
+  return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+std::shared_ptr<const SamImageEmbedding> MobileSam::EncodeImage(const cv::Mat     &image,
+                                                                const std::string &image_id,
+                                                                bool               isRGB)
+{
+  return EncodeScaledImage(image, 1.f, image.size(), image_id, isRGB);
+}
+
+std::shared_ptr<const SamImageEmbedding> MobileSam::EncodeScaledImage(
+    const cv::Mat     &image,
+    float              image_scale,
+    const cv::Size    &image_size,
+    const std::string &image_id,
+    bool               isRGB)
+{
+  if (image.empty() || image_scale <= 0.f)
+  {
+    LOG_ERROR("[MobileSam] EncodeImage got empty image or invalid scale!!!");
+    return nullptr;
+  }
+  // the embedding maps both axes by one scale, the sides of `image` may only be rounded
+  if (std::abs(image.cols - image_size.width * image_scale) >= 1.f ||
+      std::abs(image.rows - image_size.height * image_scale) >= 1.f)
+  {
+    LOG_ERROR("[MobileSam] EncodeScaledImage got an image not scaled by `image_scale` on both "
+              "axes!!!");
+    return nullptr;
+  }
+
+  // the same scaled content stands for another image at another scale, and the same pixels are
+  // another image in the other channel order
+  std::string cache_key = image_id.empty() ? ComputeImageContentKey(image) : image_id;
+  if (image_scale != 1.f)
+  {
+    cache_key += "@" + std::to_string(image_size.width) + "x" + std::to_string(image_size.height);
+  }
+  cache_key += isRGB ? "#rgb" : "#bgr";
+  if (embedding_cache_ != nullptr)
+  {
+    auto cached_embedding = embedding_cache_->Get(cache_key);
+    if (cached_embedding != nullptr)
+    {
+      return cached_embedding;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(encoder_mtx_);
+  if (encoder_blobs_buffer_ == nullptr)
+  {
+    encoder_blobs_buffer_ = image_encoder_core_->AllocBlobsBuffer();
+  }
+
+  auto package                        = std::make_shared<SamPipelinePackage>();
+  package->input_image_data           = std::make_shared<PipelineCvImageWrapper>(image, isRGB);
+  package->image_encoder_blobs_buffer = encoder_blobs_buffer_;
+
+  if (!ImagePreProcess(package))
+  {
+    LOG_ERROR("[MobileSam] EncodeImage image preprocess failed!!!");
+    return nullptr;
+  }
+  // features are copied out to host memory, which will be kept by the embedding
+  auto encoder_output_tensor = encoder_blobs_buffer_->GetTensor(encoder_blob_names_[1]);
+  encoder_output_tensor->SetBufferLocation(DataLocation::HOST);
+  if (!Infer(image_encoder_core_, package->GetInferBuffer()))
+  {
+    LOG_ERROR("[MobileSam] EncodeImage image encoder inference failed!!!");
+    return nullptr;
+  }
+
+  auto         embedding = std::make_shared<SamImageEmbedding>();
+  const float *features  = encoder_output_tensor->Cast<float>();
+  embedding->features.assign(
+      features, features + IMAGE_FEATURES_LEN * IMAGE_FEATURE_HEIGHT * IMAGE_FEATURE_WIDTH);
+  embedding->layout           = encoder_features_layout_;
+  embedding->feature_channels = IMAGE_FEATURES_LEN;
+  embedding->feature_height   = IMAGE_FEATURE_HEIGHT;
+  embedding->feature_width    = IMAGE_FEATURE_WIDTH;
+  // from the original image to the encoder input
+  embedding->transform_scale = package->transform_scale * image_scale;
+  embedding->image_height    = image_size.height;
+  embedding->image_width     = image_size.width;
+
+  if (embedding_precision_ != SamFeaturePrecision::FP32)
+  {
+    // compressed in the layout of the decoders, so decoding only expands them
+    ScopedCpuAffinity affinity(transpose_cpus_);
+    embedding->Compress(embedding_precision_,
+                        mask_boxes_decoder_core_ != nullptr ? box_decoder_features_layout_
+                                                            : point_decoder_features_layout_,
+                        feature_transpose_threads_);
+  }
+
+  if (embedding_cache_ != nullptr)
+  {
+    embedding_cache_->Put(cache_key, embedding);
+  }
+  return embedding;
+}
+
+bool MobileSam::DecodeMask(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                           const std::vector<BBox2D>                      &boxes,
+                           cv::Mat                                        &result)
+{
+  CHECK_STATE(embedding != nullptr, "[MobileSam] DecodeMask got invalid embedding!!!");
+  CHECK_STATE(mask_boxes_decoder_core_ != nullptr,
+              "[MobileSam] DecodeMask with boxes but box decoder is not provided!!!");
+  CHECK_STATE(!boxes.empty() && boxes.size() <= max_box_number_,
+              "[MobileSam] DecodeMask got empty boxes or more than `max_box_number`!!!");
+
+  std::lock_guard<std::mutex> lock(*pipeline_decoders_[0].mtx);
+  const size_t                bucket = GetPromptBucket(box_prompt_buckets_, boxes.size());
+  auto                       &decoder_buffer =
+      GetBoxDecoderBuffer(box_decoder_buffers_, mask_boxes_decoder_core_, bucket);
+
+  CopyImageFeatures(embedding, box_decoder_features_layout_, decoder_buffer.blobs,
+                    box_dec_blob_names_[0], decoder_buffer.features_owner);
+  SetBoxPrompts(decoder_buffer.blobs, boxes, embedding->transform_scale, bucket);
+  CHECK_STATE(Infer(mask_boxes_decoder_core_, decoder_buffer.blobs.get()),
+              "[MobileSam] DecodeMask box decoder inference failed!!!");
+
+  const float *low_res_mask = decoder_buffer.blobs->GetTensor(MASK_OUT_BLOB_NAME)->Cast<float>();
+  ScopedCpuAffinity affinity(postprocess_cpus_);
+  ConvertLowResMaskFused(
+      low_res_mask,
+      MakeMaskGeometry(embedding->image_height, embedding->image_width, embedding->transform_scale),
+      result);
+  return true;
+}
+
+bool MobileSam::DecodeBoxBatches(const std::shared_ptr<const SamImageEmbedding>   &embedding,
+                                 const std::vector<BBox2D>                        &boxes,
+                                 const std::function<void(size_t, const float *)> &convert)
+{
+  CHECK_STATE(embedding != nullptr, "[MobileSam] DecodeMasks got invalid embedding!!!");
+  CHECK_STATE(mask_boxes_decoder_core_ != nullptr,
+              "[MobileSam] DecodeMasks with boxes but box decoder is not provided!!!");
+
+  std::lock_guard<std::mutex> lock(*pipeline_decoders_[0].mtx);
+
+  const size_t mask_elements_num = MASK_LOW_RES_HEIGHT * MASK_LOW_RES_WIDTH;
+  for (size_t start = 0; start < boxes.size(); start += max_box_number_)
+  {
+    const size_t              end = std::min(boxes.size(), start + max_box_number_);
+    const std::vector<BBox2D> batch_boxes(boxes.begin() + start, boxes.begin() + end);
+
+    // features are copied once per buffer, full chunks share the same one
+    const size_t bucket = GetPromptBucket(box_prompt_buckets_, batch_boxes.size());
+    auto        &decoder_buffer =
+        GetBoxDecoderBuffer(box_decoder_buffers_, mask_boxes_decoder_core_, bucket);
+    CopyImageFeatures(embedding, box_decoder_features_layout_, decoder_buffer.blobs,
+                      box_dec_blob_names_[0], decoder_buffer.features_owner);
+
+    SetBoxPrompts(decoder_buffer.blobs, batch_boxes, embedding->transform_scale, bucket);
+    CHECK_STATE(Infer(mask_boxes_decoder_core_, decoder_buffer.blobs.get()),
+                "[MobileSam] DecodeMasks box decoder inference failed!!!");
+
+    // masks are outputed as {1, box_number, low_res_height, low_res_width}, pad boxes come last
+    const float *low_res_masks =
+        decoder_buffer.blobs->GetTensor(MASK_OUT_BLOB_NAME)->Cast<float>();
+    ScopedCpuAffinity affinity(postprocess_cpus_);
+    for (size_t i = 0; i < batch_boxes.size(); ++i)
+    {
+      convert(start + i, low_res_masks + i * mask_elements_num);
+    }
+  }
+
+  return true;
+}
+
+bool MobileSam::DecodeMasks(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                            const std::vector<BBox2D>                      &boxes,
+                            std::vector<cv::Mat>                           &results)
+{
+  results.resize(boxes.size());
+  return DecodeBoxBatches(embedding, boxes, [&](size_t index, const float *low_res_mask) {
+    ConvertLowResMaskFused(low_res_mask,
+                           MakeMaskGeometry(embedding->image_height, embedding->image_width,
+                                            embedding->transform_scale),
+                           results[index]);
+  });
+}
+
+bool MobileSam::DecodeCroppedMasks(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                                   const std::vector<BBox2D>                      &boxes,
+                                   std::vector<SamCroppedMask>                    &results)
+{
+  results.resize(boxes.size());
+  return DecodeBoxBatches(embedding, boxes, [&](size_t index, const float *low_res_mask) {
+    ConvertLowResMaskCropped(low_res_mask,
+                             MakeMaskGeometry(embedding->image_height, embedding->image_width,
+                                              embedding->transform_scale),
+                             MakeMaskSampleRoi(boxes[index]), results[index]);
+  });
+}
+
+bool MobileSam::DecodeRleMasks(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                               const std::vector<BBox2D>                      &boxes,
+                               std::vector<SamRleMask>                        &results)
+{
+  results.resize(boxes.size());
+  return DecodeBoxBatches(embedding, boxes, [&](size_t index, const float *low_res_mask) {
+    ConvertLowResMaskRle(low_res_mask,
+                         MakeMaskGeometry(embedding->image_height, embedding->image_width,
+                                          embedding->transform_scale),
+                         MakeMaskSampleRoi(boxes[index]), results[index]);
+  });
+}
+
+bool MobileSam::GenerateMasks(const cv::Mat             &image,
+                              const std::vector<BBox2D> &boxes,
+                              std::vector<cv::Mat>      &results,
+                              bool                       isRGB)
+{
+  auto embedding = EncodeImage(image, "", isRGB);
+  CHECK_STATE(embedding != nullptr, "[MobileSam] GenerateMasks encode image failed!!!");
+  return DecodeMasks(embedding, boxes, results);
+}
+
+bool MobileSam::DecodeMask(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                           const std::vector<std::pair<int, int>>         &points,
+                           const std::vector<int>                         &labels,
+                           cv::Mat                                        &result)
+{
+  CHECK_STATE(embedding != nullptr, "[MobileSam] DecodeMask got invalid embedding!!!");
+  CHECK_STATE(mask_points_decoder_core_ != nullptr,
+              "[MobileSam] DecodeMask with points but point decoder is not provided!!!");
+  CHECK_STATE(!points.empty() && points.size() == labels.size(),
+              "[MobileSam] DecodeMask got invalid points or labels!!!");
+
+  std::lock_guard<std::mutex> lock(*pipeline_decoders_[0].mtx);
+  const size_t                bucket = GetPromptBucket(point_prompt_buckets_, points.size());
+  auto                       &decoder_buffer =
+      GetPointDecoderBuffer(point_decoder_buffers_, mask_points_decoder_core_, bucket);
+
+  CopyImageFeatures(embedding, point_decoder_features_layout_, decoder_buffer.blobs,
+                    point_dec_blob_names_[0], decoder_buffer.features_owner);
+  SetPointPrompts(decoder_buffer.blobs, points, labels, embedding->transform_scale, bucket);
+  CHECK_STATE(Infer(mask_points_decoder_core_, decoder_buffer.blobs.get()),
+              "[MobileSam] DecodeMask point decoder inference failed!!!");
+
+  const float *low_res_mask = decoder_buffer.blobs->GetTensor(MASK_OUT_BLOB_NAME)->Cast<float>();
+  ScopedCpuAffinity affinity(postprocess_cpus_);
+  ConvertLowResMaskFused(
+      low_res_mask,
+      MakeMaskGeometry(embedding->image_height, embedding->image_width, embedding->transform_scale),
+      result);
+  return true;
+}
+
+bool MobileSam::RefineMask(SamRefinementSession                   &session,
+                           const std::vector<std::pair<int, int>> &points,
+                           const std::vector<int>                 &labels,
+                           cv::Mat                                &result)
+{
+  const auto &embedding = session.embedding;
+  CHECK_STATE(embedding != nullptr, "[MobileSam] RefineMask got invalid embedding!!!");
+  CHECK_STATE(mask_points_decoder_core_ != nullptr,
+              "[MobileSam] RefineMask but point decoder is not provided!!!");
+  CHECK_STATE(!points.empty() && points.size() == labels.size(),
+              "[MobileSam] RefineMask got invalid points or labels!!!");
+  const size_t mask_elements_num = MASK_LOW_RES_HEIGHT * MASK_LOW_RES_WIDTH;
+  CHECK_STATE(session.prior_logits.empty() || session.prior_logits.size() == mask_elements_num,
+              "[MobileSam] RefineMask got prior logits of another resolution!!!");
+
+  std::lock_guard<std::mutex> lock(*pipeline_decoders_[0].mtx);
+  const size_t                bucket = GetPromptBucket(point_prompt_buckets_, points.size());
+  auto                       &decoder_buffer =
+      GetPointDecoderBuffer(point_decoder_buffers_, mask_points_decoder_core_, bucket);
+
+  CopyImageFeatures(embedding, point_decoder_features_layout_, decoder_buffer.blobs,
+                    point_dec_blob_names_[0], decoder_buffer.features_owner);
+  SetPointPrompts(decoder_buffer.blobs, points, labels, embedding->transform_scale, bucket,
+                  session.prior_logits.empty() ? nullptr : session.prior_logits.data());
+  CHECK_STATE(Infer(mask_points_decoder_core_, decoder_buffer.blobs.get()),
+              "[MobileSam] RefineMask point decoder inference failed!!!");
+
+  const float *low_res_mask = decoder_buffer.blobs->GetTensor(MASK_OUT_BLOB_NAME)->Cast<float>();
+  session.prior_logits.assign(low_res_mask, low_res_mask + mask_elements_num);
+
+  ScopedCpuAffinity affinity(postprocess_cpus_);
+  ConvertLowResMaskFused(
+      low_res_mask,
+      MakeMaskGeometry(embedding->image_height, embedding->image_width, embedding->transform_scale),
+      result);
+  return true;
+}
+
+std::future<std::vector<cv::Mat>> MobileSam::GenerateMasksPipelined(
+    const cv::Mat &image, const std::vector<BBox2D> &boxes, bool isRGB)
+{
+  auto request                       = std::make_shared<PipelineRequest>();
+  request->package                   = std::make_shared<SamPipelinePackage>();
+  request->package->input_image_data = std::make_shared<PipelineCvImageWrapper>(image, isRGB);
+  request->package->boxes            = boxes;
+  request->with_boxes                = true;
+  return SubmitPipelineRequest(request);
+}
+
+std::future<std::vector<cv::Mat>> MobileSam::GenerateMaskPipelined(
+    const cv::Mat                          &image,
+    const std::vector<std::pair<int, int>> &points,
+    const std::vector<int>                 &labels,
+    bool                                    isRGB)
+{
+  auto request                       = std::make_shared<PipelineRequest>();
+  request->package                   = std::make_shared<SamPipelinePackage>();
+  request->package->input_image_data = std::make_shared<PipelineCvImageWrapper>(image, isRGB);
+  request->package->points           = points;
+  request->package->labels           = labels;
+  request->with_boxes                = false;
+  return SubmitPipelineRequest(request);
+}
+
+std::future<std::vector<cv::Mat>> MobileSam::SubmitPipelineRequest(
+    std::shared_ptr<PipelineRequest> request)
+{
+  auto future = request->promise.get_future();
+
+  const auto &package = request->package;
+  const bool  valid_prompts =
+      request->with_boxes
+          ? !package->boxes.empty()
+          : !package->points.empty() && package->points.size() == package->labels.size();
+  if (package->input_image_data->GetImageDataInfo().image_height <= 0 || !valid_prompts)
+  {
+    request->promise.set_exception(std::make_exception_ptr(
+        std::invalid_argument("[MobileSam] Pipelined call got empty image or invalid prompts!")));
+    return future;
+  }
+
+  std::call_once(pipeline_start_flag_, [this]() { StartPipeline(); });
+  if (!pipeline_requests_->Push(request))
+  {
+    request->promise.set_exception(std::make_exception_ptr(
+        std::runtime_error("[MobileSam] Pipelined call after the pipeline stopped!")));
+  }
+  return future;
+}
+
+void MobileSam::StartPipeline()
+{
+  pipeline_requests_ =
+      std::make_unique<BoundedQueue<std::shared_ptr<PipelineRequest>>>(pipeline_queue_capacity_);
+  pipeline_encoded_requests_ =
+      std::make_unique<BoundedQueue<EncodedRequest>>(pipeline_queue_capacity_);
+
+  // one buffer being encoded, the others waiting in or for the hand-off queue
+  const size_t buffers_per_encoder = pipeline_queue_capacity_ + 1;
+  for (auto &encoder : pipeline_encoders_)
+  {
+    encoder.free_buffers =
+        std::make_unique<BoundedQueue<std::shared_ptr<IBlobsBuffer>>>(buffers_per_encoder);
+    for (size_t i = 0; i < buffers_per_encoder; ++i)
+    {
+      encoder.free_buffers->Push(encoder.core->AllocBlobsBuffer());
+    }
+  }
+
+  pipeline_start_time_ = std::chrono::steady_clock::now();
+  for (auto &encoder : pipeline_encoders_)
+  {
+    pipeline_encoder_workers_.emplace_back([this, &encoder]() { RunEncoderWorker(encoder); });
+  }
+  for (auto &decoder : pipeline_decoders_)
+  {
+    pipeline_decoder_workers_.emplace_back([this, &decoder]() { RunDecoderWorker(decoder); });
+  }
+  pipeline_started_ = true;
+}
+
+void MobileSam::StopPipeline()
+{
+  if (!pipeline_started_)
+  {
+    return;
+  }
+  // pending requests are still processed, stages are drained in order
+  pipeline_requests_->Close();
+  for (auto &worker : pipeline_encoder_workers_)
+  {
+    worker.join();
+  }
+  pipeline_encoded_requests_->Close();
+  for (auto &worker : pipeline_decoder_workers_)
+  {
+    worker.join();
+  }
+  pipeline_started_ = false;
+}
+
+static void AddBusyTime(std::atomic<int64_t>                        &busy_ns,
+                        const std::chrono::steady_clock::time_point &begin)
+{
+  busy_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now() - begin)
+                 .count();
+}
+
+void MobileSam::RunEncoderWorker(EncoderInstance &encoder)
+{
+  std::shared_ptr<PipelineRequest> request;
+  while (pipeline_requests_->Pop(request))
+  {
+    std::shared_ptr<IBlobsBuffer> encoder_buffer;
+    encoder.free_buffers->Pop(encoder_buffer);
+
+    const auto begin                            = std::chrono::steady_clock::now();
+    request->package->image_encoder_blobs_buffer = encoder_buffer;
+    bool               encoded                   = false;
+    std::exception_ptr error;
+    // an exception would terminate the worker thread, the caller gets it through its future
+    try
+    {
+      encoded = PreprocessImage(request->package, encoder.preprocess_block.get()) &&
+                Infer(encoder.core, request->package->GetInferBuffer());
+    } catch (...)
+    {
+      error = std::current_exception();
+    }
+    AddBusyTime(encoder_stage_counter_.busy_ns, begin);
+    ++encoder_stage_counter_.processed;
+
+    if (!encoded || !pipeline_encoded_requests_->Push({request, &encoder}))
+    {
+      request->package->image_encoder_blobs_buffer = nullptr;
+      encoder.free_buffers->Push(encoder_buffer);
+      request->promise.set_exception(
+          error != nullptr ? error
+                           : std::make_exception_ptr(std::runtime_error(
+                                 "[MobileSam] Pipelined image encoding failed!")));
+    }
+  }
+}
+
+void MobileSam::RunDecoderWorker(DecoderInstance &decoder)
+{
+  EncodedRequest encoded_request;
+  while (pipeline_encoded_requests_->Pop(encoded_request))
+  {
+    const auto          &request = *encoded_request.request;
+    std::vector<cv::Mat> masks;
+
+    const auto         begin   = std::chrono::steady_clock::now();
+    bool               decoded = false;
+    std::exception_ptr error;
+    try
+    {
+      std::lock_guard<std::mutex> lock(*decoder.mtx);
+      decoded = DecodePipelineRequest(decoder, request, masks);
+    } catch (...)
+    {
+      error = std::current_exception();
+    }
+    AddBusyTime(decoder_stage_counter_.busy_ns, begin);
+    ++decoder_stage_counter_.processed;
+
+    // the image features are consumed, give the encoder buffer back
+    encoded_request.encoder->free_buffers->Push(request.package->image_encoder_blobs_buffer);
+    request.package->image_encoder_blobs_buffer = nullptr;
+
+    if (decoded)
+    {
+      encoded_request.request->promise.set_value(std::move(masks));
+    } else
+    {
+      encoded_request.request->promise.set_exception(
+          error != nullptr ? error
+                           : std::make_exception_ptr(std::runtime_error(
+                                 "[MobileSam] Pipelined mask decoding failed!")));
+    }
+  }
+}
+
+bool MobileSam::DecodePipelineRequest(DecoderInstance       &decoder,
+                                      const PipelineRequest &request,
+                                      std::vector<cv::Mat>  &masks)
+{
+  const auto  &package    = request.package;
+  const auto  &image_info = package->input_image_data->GetImageDataInfo();
+  const auto   geometry   = MakeMaskGeometry(image_info.image_height, image_info.image_width,
+                                             package->transform_scale);
+  const size_t mask_elements_num = MASK_LOW_RES_HEIGHT * MASK_LOW_RES_WIDTH;
+
+  if (!request.with_boxes)
+  {
+    CHECK_STATE(decoder.point_core != nullptr,
+                "[MobileSam] Pipelined call with points but point decoder is not provided!!!");
+    const size_t bucket = GetPromptBucket(point_prompt_buckets_, package->points.size());
+    const auto  &decoder_blobs =
+        GetPointDecoderBuffer(decoder.point_buffers, decoder.point_core, bucket).blobs;
+    package->mask_decoder_blobs_buffer = decoder_blobs;
+    CHECK_STATE(
+        SetPackageFeatures(package, point_decoder_features_layout_, point_dec_blob_names_[0]),
+        "[MobileSam] Pipelined set image features failed!!!");
+    SetPointPrompts(decoder_blobs, package->points, package->labels, package->transform_scale,
+                    bucket);
+    CHECK_STATE(Infer(decoder.point_core, decoder_blobs.get()),
+                "[MobileSam] Pipelined point decoder inference failed!!!");
+
+    ScopedCpuAffinity affinity(postprocess_cpus_);
+    masks.resize(1);
+    ConvertLowResMaskFused(decoder_blobs->GetTensor(MASK_OUT_BLOB_NAME)->Cast<float>(), geometry,
+                           masks[0]);
+    return true;
+  }
+
+  CHECK_STATE(decoder.box_core != nullptr,
+              "[MobileSam] Pipelined call with boxes but box decoder is not provided!!!");
+
+  const auto &boxes = package->boxes;
+  masks.resize(boxes.size());
+  for (size_t start = 0; start < boxes.size(); start += max_box_number_)
+  {
+    const size_t              end = std::min(boxes.size(), start + max_box_number_);
+    const std::vector<BBox2D> batch_boxes(boxes.begin() + start, boxes.begin() + end);
+
+    const size_t bucket = GetPromptBucket(box_prompt_buckets_, batch_boxes.size());
+    const auto  &decoder_blobs =
+        GetBoxDecoderBuffer(decoder.box_buffers, decoder.box_core, bucket).blobs;
+    package->mask_decoder_blobs_buffer = decoder_blobs;
+    CHECK_STATE(SetPackageFeatures(package, box_decoder_features_layout_, box_dec_blob_names_[0]),
+                "[MobileSam] Pipelined set image features failed!!!");
+
+    SetBoxPrompts(decoder_blobs, batch_boxes, package->transform_scale, bucket);
+    CHECK_STATE(Infer(decoder.box_core, decoder_blobs.get()),
+                "[MobileSam] Pipelined box decoder inference failed!!!");
+
+    const float *low_res_masks = decoder_blobs->GetTensor(MASK_OUT_BLOB_NAME)->Cast<float>();
+    ScopedCpuAffinity affinity(postprocess_cpus_);
+    for (size_t i = 0; i < batch_boxes.size(); ++i)
+    {
+      ConvertLowResMaskFused(low_res_masks + i * mask_elements_num, geometry, masks[start + i]);
+    }
+  }
+  return true;
+}
+
+bool MobileSam::GenerateAutoMasks(const cv::Mat            &image,
+                                  const SamAutoMaskConfig  &config,
+                                  std::vector<SamAutoMask> &results,
+                                  bool                      isRGB)
+{
+  CHECK_STATE(!image.empty(), "[MobileSam] GenerateAutoMasks got empty image!!!");
+  CHECK_STATE(mask_points_decoder_core_ != nullptr,
+              "[MobileSam] GenerateAutoMasks but point decoder is not provided!!!");
+  CHECK_STATE(point_dec_blob_names_.size() > 6,
+              "[MobileSam] GenerateAutoMasks needs the `scores` output of the point decoder!!!");
+  CHECK_STATE(config.points_per_side > 0 && config.points_per_batch > 0 && config.crop_layers >= 0,
+              "[MobileSam] GenerateAutoMasks got invalid config!!!");
+
+  results.clear();
+  const auto grid       = BuildSamPointGrid(config.points_per_side);
+  const auto crop_boxes = GenerateSamCropBoxes(image.rows, image.cols, config.crop_layers,
+                                               config.crop_overlap_ratio);
+
+  std::vector<SamAutoMask> candidates;
+  for (const auto &crop_box : crop_boxes)
+  {
+    // crops are copied, the preprocess blocks take continuous images
+    const bool    full_image = crop_box == cv::Rect(0, 0, image.cols, image.rows);
+    const cv::Mat crop_image = full_image ? image : image(crop_box).clone();
+    auto          embedding  = EncodeImage(crop_image, "", isRGB);
+    CHECK_STATE(embedding != nullptr, "[MobileSam] GenerateAutoMasks encode image failed!!!");
+
+    std::vector<std::pair<int, int>> points;
+    points.reserve(grid.size());
+    for (const auto &grid_point : grid)
+    {
+      points.emplace_back(static_cast<int>(grid_point.first * crop_box.width),
+                          static_cast<int>(grid_point.second * crop_box.height));
+    }
+    CHECK_STATE(
+        DecodeAutoMaskPoints(embedding, crop_box, image.size(), points, config, candidates),
+        "[MobileSam] GenerateAutoMasks decode points failed!!!");
+  }
 
-  // 4. resize to original size
-  cv::resize(masks_output, masks_output,
-             {input_image_info.image_width, input_image_info.image_height});
+  // masks of all the crops are de-duplicated together
+  const auto keep = SamMaskNms(candidates, config.box_nms_thresh, config.mask_nms_thresh);
+  results.reserve(keep.size());
+  for (const size_t index : keep)
+  {
+    results.push_back(std::move(candidates[index]));
+  }
+  return true;
+}
 
-  // 5. convert to binary mask
-  cv::threshold(masks_output, masks_output, 0, 1, cv::THRESH_BINARY);
+bool MobileSam::DecodeAutoMaskPoints(const std::shared_ptr<const SamImageEmbedding> &embedding,
+                                     const cv::Rect                                 &crop_box,
+                                     const cv::Size                                 &image_size,
+                                     const std::vector<std::pair<int, int>>         &points,
+                                     const SamAutoMaskConfig                        &config,
+                                     std::vector<SamAutoMask>                       &results)
+{
+  // every decoder instance takes the next batch of points until all are decoded, a batch is one
+  // inference, the features are copied once per instance
+  const size_t batch_size   = std::min(config.points_per_batch, point_prompt_batch_capacity_);
+  const size_t batch_number = (points.size() + batch_size - 1) / batch_size;
+  std::atomic<size_t>                   next_batch{0};
+  std::atomic<bool>                     failed{false};
+  std::vector<std::vector<SamAutoMask>> instance_results(pipeline_decoders_.size());
+
+  auto run_instance = [&](size_t instance_index) {
+    auto                            &decoder = pipeline_decoders_[instance_index];
+    std::vector<std::pair<int, int>> batch_points;
+    for (size_t batch = next_batch++; batch < batch_number && !failed; batch = next_batch++)
+    {
+      const size_t start = batch * batch_size;
+      const size_t end   = std::min(points.size(), start + batch_size);
+      batch_points.assign(points.begin() + start, points.begin() + end);
 
-  // 6. convert to CV_8U
-  masks_output = masks_output * 255;
-  masks_output.convertTo(masks_output, CV_8U);
+      std::lock_guard<std::mutex> lock(*decoder.mtx);
+      if (!DecodeAutoMaskBatch(decoder, embedding, crop_box, image_size, batch_points, batch_size,
+                               config, instance_results[instance_index]))
+      {
+        failed = true;
+        return;
+      }
+    }
+  };
 
-  p_package->mask = masks_output;
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < pipeline_decoders_.size() && i < batch_number; ++i)
+  {
+    workers.emplace_back(run_instance, i);
+  }
+  run_instance(0);
+  for (auto &worker : workers)
+  {
+    worker.join();
+  }
+  CHECK_STATE(!failed, "[MobileSam] GenerateAutoMasks point decoding failed!!!");
+
+  for (auto &masks : instance_results)
+  {
+    std::move(masks.begin(), masks.end(), std::back_inserter(results));
+  }
+  return true;
+}
 
+bool MobileSam::DecodeAutoMaskBatch(DecoderInstance                                &decoder,
+                                    const std::shared_ptr<const SamImageEmbedding> &embedding,
+                                    const cv::Rect                                 &crop_box,
+                                    const cv::Size                                 &image_size,
+                                    const std::vector<std::pair<int, int>>         &points,
+                                    size_t                                          batch_size,
+                                    const SamAutoMaskConfig                        &config,
+                                    std::vector<SamAutoMask>                       &results)
+{
+  // the last batch is padded to `batch_size` too, static-shape decoders keep a single shape
+  const size_t bucket = GetPromptBucket(point_prompt_buckets_, 1);
+  auto        &decoder_buffer =
+      GetPointDecoderBuffer(decoder.auto_mask_point_buffers, decoder.point_core, bucket);
+  CopyImageFeatures(embedding, point_decoder_features_layout_, decoder_buffer.blobs,
+                    point_dec_blob_names_[0], decoder_buffer.features_owner);
+  SetGridPointPrompts(decoder_buffer.blobs, points, batch_size, bucket > 0 ? bucket : 1,
+                      embedding->transform_scale);
+  CHECK_STATE(Infer(decoder.point_core, decoder_buffer.blobs.get()),
+              "[MobileSam] GenerateAutoMasks point decoder inference failed!!!");
+
+  // masks are outputed as {prompt_batch, 1, low_res_height, low_res_width} and scores as
+  // {prompt_batch, 1}, pad prompts come last
+  const size_t mask_elements_num = MASK_LOW_RES_HEIGHT * MASK_LOW_RES_WIDTH;
+  const float *low_res_masks =
+      decoder_buffer.blobs->GetTensor(MASK_OUT_BLOB_NAME)->Cast<float>();
+  const float *predicted_ious =
+      decoder_buffer.blobs->GetTensor(point_dec_blob_names_[6])->Cast<float>();
+  ScopedCpuAffinity affinity(postprocess_cpus_);
+  for (size_t i = 0; i < points.size(); ++i)
+  {
+    FilterAutoMask(low_res_masks + i * mask_elements_num, predicted_ious[i], embedding, crop_box,
+                   image_size, points[i], config, results);
+  }
   return true;
 }
 
-std::shared_ptr<BaseSamModel> CreateMobileSamModel(
+void MobileSam::FilterAutoMask(const float                                    *low_res_mask,
+                               float                                           predicted_iou,
+                               const std::shared_ptr<const SamImageEmbedding> &embedding,
+                               const cv::Rect                                 &crop_box,
+                               const cv::Size                                 &image_size,
+                               const std::pair<int, int>                      &point,
+                               const SamAutoMaskConfig                        &config,
+                               std::vector<SamAutoMask>                       &results)
+{
+  // cheap filters first : predicted IoU, then stability on the low-res logits, only the kept
+  // masks are upsampled, and only in their box
+  if (predicted_iou < config.pred_iou_thresh)
+  {
+    return;
+  }
+
+  const auto geometry =
+      MakeMaskGeometry(embedding->image_height, embedding->image_width, embedding->transform_scale);
+  const auto stats = ComputeLowResMaskStats(low_res_mask, geometry, config.stability_score_offset);
+  if (stats.stability_score < config.stability_score_thresh || stats.low_res_box.empty())
+  {
+    return;
+  }
+
+  SamAutoMask auto_mask;
+  ConvertLowResMaskCropped(low_res_mask, geometry, LowResBoxToImage(stats.low_res_box, geometry),
+                           auto_mask.mask);
+  if (auto_mask.mask.roi.empty())
+  {
+    return;
+  }
+  auto_mask.mask.roi += crop_box.tl();
+  if (IsBoxNearCropEdge(auto_mask.mask.roi, crop_box, image_size, config.crop_edge_tolerance))
+  {
+    return;
+  }
+  auto_mask.predicted_iou   = predicted_iou;
+  auto_mask.stability_score = stats.stability_score;
+  auto_mask.point           = {point.first + crop_box.x, point.second + crop_box.y};
+  auto_mask.crop_box        = crop_box;
+  results.push_back(std::move(auto_mask));
+}
+
+std::vector<SamPipelineStageStats> MobileSam::GetPipelineStats() const
+{
+  if (!pipeline_started_)
+  {
+    return {};
+  }
+
+  const double elapsed_ms = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - pipeline_start_time_)
+                                .count();
+  auto make_stats = [elapsed_ms](const std::string &stage, size_t instances,
+                                 const StageCounter &counter) {
+    SamPipelineStageStats stats;
+    stats.stage       = stage;
+    stats.instances   = instances;
+    stats.processed   = counter.processed;
+    stats.busy_ms     = counter.busy_ns / 1e6;
+    stats.elapsed_ms  = elapsed_ms;
+    stats.utilisation = elapsed_ms > 0 ? stats.busy_ms / (elapsed_ms * instances) : 0;
+    return stats;
+  };
+  return {make_stats("encoder", pipeline_encoders_.size(), encoder_stage_counter_),
+          make_stats("decoder", pipeline_decoders_.size(), decoder_stage_counter_)};
+}
+
+SamEmbeddingCacheStats MobileSam::GetEmbeddingCacheStats() const
+{
+  return embedding_cache_ != nullptr ? embedding_cache_->GetStats() : SamEmbeddingCacheStats{};
+}
+
+void MobileSam::ClearEmbeddingCache()
+{
+  if (embedding_cache_ != nullptr)
+  {
+    embedding_cache_->Clear();
+  }
+}
+
+std::shared_ptr<BaseMobileSamModel> CreateMobileSamModel(
     std::shared_ptr<BaseInferCore>        image_encoder_core,
     std::shared_ptr<BaseInferCore>        mask_points_decoder_core,
     std::shared_ptr<BaseInferCore>        mask_boxes_decoder_core,
     std::shared_ptr<IDetectionPreProcess> image_preprocess_block,
     const std::vector<std::string>       &encoder_blob_names,
     const std::vector<std::string>       &box_dec_blob_names,
-    const std::vector<std::string>       &point_dec_blob_names)
+    const std::vector<std::string>       &point_dec_blob_names,
+    const MobileSamConfig                &config,
+    const MobileSamPipelineInstances     &pipeline_instances)
 {
   return std::make_shared<MobileSam>(image_encoder_core, mask_points_decoder_core,
                                      mask_boxes_decoder_core, image_preprocess_block,
-                                     encoder_blob_names, box_dec_blob_names, point_dec_blob_names);
+                                     encoder_blob_names, box_dec_blob_names, point_dec_blob_names,
+                                     config, pipeline_instances);
 }
 
 } // namespace easy_deploy
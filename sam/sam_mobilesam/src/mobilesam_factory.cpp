@@ -10,6 +10,7 @@ struct SamParams {
   std::vector<std::string>                        encoder_blob_names;
   std::vector<std::string>                        box_dec_blob_names;
   std::vector<std::string>                        point_dec_blob_names;
+  MobileSamConfig                                 config;
 };
 
 class SamMobileSamFactory : public BaseSamFactory {
@@ -19,12 +20,29 @@ public:
 
   std::shared_ptr<BaseSamModel> Create() override
   {
+    // the model owns the first instance of each stage, the others are for pipelined execution
+    MobileSamPipelineInstances pipeline_instances;
+    for (size_t i = 1; i < params_.config.encoder_instances; ++i)
+    {
+      pipeline_instances.image_encoder_cores.push_back(
+          params_.image_encoder_core_factory->Create());
+      pipeline_instances.image_preprocess_blocks.push_back(
+          params_.image_preprocess_block_factory->Create());
+    }
+    for (size_t i = 1; i < params_.config.decoder_instances; ++i)
+    {
+      pipeline_instances.mask_points_decoder_cores.push_back(
+          params_.mask_points_decoder_core_factory->Create());
+      pipeline_instances.mask_boxes_decoder_cores.push_back(
+          params_.mask_boxes_decoder_core_factory->Create());
+    }
+
     return CreateMobileSamModel(params_.image_encoder_core_factory->Create(),
                                 params_.mask_points_decoder_core_factory->Create(),
                                 params_.mask_boxes_decoder_core_factory->Create(),
                                 params_.image_preprocess_block_factory->Create(),
                                 params_.encoder_blob_names, params_.box_dec_blob_names,
-                                params_.point_dec_blob_names);
+                                params_.point_dec_blob_names, params_.config, pipeline_instances);
   }
 
 private:
@@ -38,13 +56,20 @@ std::shared_ptr<BaseSamFactory> CreateSamMobileSamModelFactory(
     std::shared_ptr<BaseDetectionPreprocessFactory> image_preprocess_block_factory,
     const std::vector<std::string>                 &encoder_blob_names,
     const std::vector<std::string>                 &box_dec_blob_names,
-    const std::vector<std::string>                 &point_dec_blob_names)
+    const std::vector<std::string>                 &point_dec_blob_names,
+    const MobileSamConfig                          &config)
 {
   if (image_encoder_core_factory == nullptr || mask_points_decoder_core_factory == nullptr ||
       mask_boxes_decoder_core_factory == nullptr || image_preprocess_block_factory == nullptr)
   {
     throw std::invalid_argument("[CreateSamMobileSamModelFactory] Got invalid input arguments");
   }
+  if (config.encoder_instances == 0 || config.decoder_instances == 0)
+  {
+    throw std::invalid_argument(
+        "[CreateSamMobileSamModelFactory] `encoder_instances` and `decoder_instances` should be "
+        "positive");
+  }
 
   SamParams params;
 
@@ -55,6 +80,7 @@ std::shared_ptr<BaseSamFactory> CreateSamMobileSamModelFactory(
   params.encoder_blob_names               = encoder_blob_names;
   params.box_dec_blob_names               = box_dec_blob_names;
   params.point_dec_blob_names             = point_dec_blob_names;
+  params.config                           = config;
 
   return std::make_shared<SamMobileSamFactory>(params);
 }
@@ -0,0 +1,285 @@
+#include "sam_mobilesam/sam_embedding_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include "sam_mobilesam/feature_transpose.hpp"
+
+namespace easy_deploy {
+
+// `NCHW` <-> `NHWC`
+static void ConvertFeatureLayout(const float     *src,
+                                 SamFeatureLayout src_layout,
+                                 float           *dst,
+                                 int              channels,
+                                 int              height,
+                                 int              width,
+                                 int              num_threads)
+{
+  if (src_layout == SamFeatureLayout::NCHW)
+  {
+    TransposeNchwToNhwc(src, dst, 1, channels, height, width, num_threads);
+  } else
+  {
+    // `NHWC` to `NCHW` is the same transpose on a {H * W, C} matrix
+    TransposeNchwToNhwc(src, dst, 1, height * width, channels, 1, num_threads);
+  }
+}
+
+const float *SamImageEmbedding::GetFeatures(SamFeatureLayout target_layout, int num_threads) const
+{
+  if (precision_ != SamFeaturePrecision::FP32)
+  {
+    return nullptr;
+  }
+  if (target_layout == layout)
+  {
+    return features.data();
+  }
+
+  std::lock_guard<std::mutex> lock(convert_mtx_);
+  if (converted_features_.empty())
+  {
+    converted_features_.resize(features.size());
+    ConvertFeatureLayout(features.data(), layout, converted_features_.data(), feature_channels,
+                         feature_height, feature_width, num_threads);
+  }
+  return converted_features_.data();
+}
+
+bool SamImageEmbedding::HasFeatures(SamFeatureLayout target_layout) const
+{
+  if (target_layout == layout)
+  {
+    return true;
+  }
+  std::lock_guard<std::mutex> lock(convert_mtx_);
+  return !converted_features_.empty();
+}
+
+void SamImageEmbedding::CopyFeatures(SamFeatureLayout target_layout,
+                                     float           *dst,
+                                     int              num_threads) const
+{
+  if (precision_ == SamFeaturePrecision::FP32)
+  {
+    memcpy(dst, GetFeatures(target_layout, num_threads), FeaturesNum() * sizeof(float));
+    return;
+  }
+
+  // expand in `layout`, into a temporary buffer if a conversion follows
+  std::vector<float> expanded;
+  float             *expand_dst = dst;
+  if (target_layout != layout)
+  {
+    expanded.resize(FeaturesNum());
+    expand_dst = expanded.data();
+  }
+  if (precision_ == SamFeaturePrecision::FP16)
+  {
+    ConvertFp16ToFp32(fp16_features_.data(), expand_dst, FeaturesNum());
+  } else
+  {
+    DequantizeInt8PerChannel(int8_features_.data(), int8_scales_.data(), expand_dst,
+                             feature_channels, feature_height * feature_width,
+                             layout == SamFeatureLayout::NHWC);
+  }
+  if (target_layout != layout)
+  {
+    ConvertFeatureLayout(expanded.data(), layout, dst, feature_channels, feature_height,
+                         feature_width, num_threads);
+  }
+}
+
+void SamImageEmbedding::Compress(SamFeaturePrecision precision,
+                                 SamFeatureLayout    storage_layout,
+                                 int                 num_threads)
+{
+  if (precision == SamFeaturePrecision::FP32 || precision_ != SamFeaturePrecision::FP32)
+  {
+    return;
+  }
+
+  const float *src = GetFeatures(storage_layout, num_threads);
+  if (precision == SamFeaturePrecision::FP16)
+  {
+    fp16_features_.resize(FeaturesNum());
+    ConvertFp32ToFp16(src, fp16_features_.data(), FeaturesNum());
+  } else
+  {
+    int8_features_.resize(FeaturesNum());
+    int8_scales_.resize(feature_channels);
+    QuantizeInt8PerChannel(src, int8_features_.data(), int8_scales_.data(), feature_channels,
+                           feature_height * feature_width,
+                           storage_layout == SamFeatureLayout::NHWC);
+  }
+
+  precision_ = precision;
+  layout     = storage_layout;
+  std::vector<float>().swap(features);
+  std::lock_guard<std::mutex> lock(convert_mtx_);
+  std::vector<float>().swap(converted_features_);
+}
+
+size_t SamImageEmbedding::ByteSize() const
+{
+  std::lock_guard<std::mutex> lock(convert_mtx_);
+  return (features.size() + converted_features_.size() + int8_scales_.size()) * sizeof(float) +
+         fp16_features_.size() * sizeof(uint16_t) + int8_features_.size() * sizeof(int8_t);
+}
+
+SamEmbeddingCache::SamEmbeddingCache(size_t capacity_bytes) : capacity_bytes_(capacity_bytes)
+{}
+
+std::shared_ptr<const SamImageEmbedding> SamEmbeddingCache::Get(const std::string &key)
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto                        iter = entries_.find(key);
+  if (iter == entries_.end())
+  {
+    ++misses_;
+    return nullptr;
+  }
+  ++hits_;
+  // move to the front, the list keeps most recently used entry at head
+  lru_list_.splice(lru_list_.begin(), lru_list_, iter->second);
+  return iter->second->second;
+}
+
+void SamEmbeddingCache::Put(const std::string                       &key,
+                            std::shared_ptr<const SamImageEmbedding> embedding)
+{
+  if (embedding == nullptr || embedding->ByteSize() > capacity_bytes_)
+  {
+    return;
+  }
+
+  // replace and evict under one lock, concurrent insertions of the same key leave one entry
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto                        iter = entries_.find(key);
+  if (iter != entries_.end())
+  {
+    iter->second->second = std::move(embedding);
+    lru_list_.splice(lru_list_.begin(), lru_list_, iter->second);
+  } else
+  {
+    lru_list_.emplace_front(key, std::move(embedding));
+    entries_[key] = lru_list_.begin();
+  }
+
+  // summed again after each eviction, the cached embeddings may grow meanwhile, so their sizes
+  // are never subtracted from a stale total
+  while (lru_list_.size() > 1 && MemoryBytes() > capacity_bytes_)
+  {
+    entries_.erase(lru_list_.back().first);
+    lru_list_.pop_back();
+    ++evictions_;
+  }
+}
+
+void SamEmbeddingCache::Clear()
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  lru_list_.clear();
+  entries_.clear();
+}
+
+size_t SamEmbeddingCache::MemoryBytes() const
+{
+  size_t memory_bytes = 0;
+  for (const auto &entry : lru_list_)
+  {
+    memory_bytes += entry.second->ByteSize();
+  }
+  return memory_bytes;
+}
+
+SamEmbeddingCacheStats SamEmbeddingCache::GetStats() const
+{
+  std::lock_guard<std::mutex> lock(mtx_);
+  SamEmbeddingCacheStats      stats;
+  stats.hits           = hits_;
+  stats.misses         = misses_;
+  stats.evictions      = evictions_;
+  stats.entries        = entries_.size();
+  stats.memory_bytes   = MemoryBytes();
+  stats.capacity_bytes = capacity_bytes_;
+  return stats;
+}
+
+// the primes of XXH64
+constexpr uint64_t kHashPrime1 = 0x9e3779b185ebca87ull;
+constexpr uint64_t kHashPrime2 = 0xc2b2ae3d27d4eb4full;
+constexpr uint64_t kHashPrime3 = 0x165667b19e3779f9ull;
+constexpr uint64_t kHashPrime4 = 0x85ebca77c2b2ae63ull;
+
+static inline uint64_t RotateLeft(uint64_t value, int bits)
+{
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// a round of XXH64, the multiplications carry every bit upward and the rotation brings the high
+// bits back down, so that a difference in any bit of `input` spreads over the whole lane
+static inline uint64_t HashRound(uint64_t lane, uint64_t input)
+{
+  lane += input * kHashPrime2;
+  lane = RotateLeft(lane, 31);
+  return lane * kHashPrime1;
+}
+
+std::string ComputeImageContentKey(const cv::Mat &image)
+{
+  // XXH64-like, four independent lanes over 32-byte stripes of each row, so that non-continuous
+  // images are walked row by row. The tail words and bytes of a row go to the first lanes, at
+  // positions fixed by the image size.
+  uint64_t lanes[4] = {kHashPrime1 + kHashPrime2, kHashPrime2, 0, 0 - kHashPrime1};
+  lanes[0]          = HashRound(lanes[0], static_cast<uint64_t>(image.rows));
+  lanes[1]          = HashRound(lanes[1], static_cast<uint64_t>(image.cols));
+  lanes[2]          = HashRound(lanes[2], static_cast<uint64_t>(image.type()));
+
+  const size_t row_bytes = image.cols * image.elemSize();
+  for (int r = 0; r < image.rows; ++r)
+  {
+    const uint8_t *row_ptr = image.ptr<uint8_t>(r);
+    size_t         i       = 0;
+    for (; i + 4 * sizeof(uint64_t) <= row_bytes; i += 4 * sizeof(uint64_t))
+    {
+      uint64_t words[4];
+      memcpy(words, row_ptr + i, sizeof(words));
+      for (int k = 0; k < 4; ++k)
+      {
+        lanes[k] = HashRound(lanes[k], words[k]);
+      }
+    }
+    for (; i + sizeof(uint64_t) <= row_bytes; i += sizeof(uint64_t))
+    {
+      uint64_t word;
+      memcpy(&word, row_ptr + i, sizeof(uint64_t));
+      lanes[0] = HashRound(lanes[0], word);
+    }
+    for (; i < row_bytes; ++i)
+    {
+      lanes[1] = HashRound(lanes[1], row_ptr[i]);
+    }
+  }
+
+  // merge the lanes, then avalanche
+  uint64_t hash = RotateLeft(lanes[0], 1) + RotateLeft(lanes[1], 7) + RotateLeft(lanes[2], 12) +
+                  RotateLeft(lanes[3], 18);
+  for (const uint64_t lane : lanes)
+  {
+    hash ^= HashRound(0, lane);
+    hash = hash * kHashPrime1 + kHashPrime4;
+  }
+  hash ^= hash >> 33;
+  hash *= kHashPrime2;
+  hash ^= hash >> 29;
+  hash *= kHashPrime3;
+  hash ^= hash >> 32;
+
+  char key[32];
+  snprintf(key, sizeof(key), "content:%016llx", static_cast<unsigned long long>(hash));
+  return std::string(key);
+}
+
+} // namespace easy_deploy
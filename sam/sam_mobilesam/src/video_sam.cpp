@@ -0,0 +1,346 @@
+#include "sam_mobilesam/video_sam.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace easy_deploy {
+
+static float Median(std::vector<float> &values)
+{
+  const auto middle = values.begin() + values.size() / 2;
+  std::nth_element(values.begin(), middle, values.end());
+  return *middle;
+}
+
+static cv::Mat ToGray(const cv::Mat &frame, bool isRGB)
+{
+  if (frame.channels() != 3)
+  {
+    return frame;
+  }
+  cv::Mat gray;
+  cv::cvtColor(frame, gray, isRGB ? cv::COLOR_RGB2GRAY : cv::COLOR_BGR2GRAY);
+  return gray;
+}
+
+cv::Mat MakeSamSceneThumbnail(const cv::Mat &frame, int size, bool isRGB)
+{
+  const cv::Mat gray = ToGray(frame, isRGB);
+  cv::Mat thumbnail;
+  cv::resize(gray, thumbnail, {size, size}, 0, 0, cv::INTER_AREA);
+  return thumbnail;
+}
+
+float ComputeSamSceneChange(const cv::Mat &thumbnail_a, const cv::Mat &thumbnail_b)
+{
+  if (thumbnail_a.empty() || thumbnail_a.size() != thumbnail_b.size())
+  {
+    return 1.f;
+  }
+  cv::Mat diff;
+  cv::absdiff(thumbnail_a, thumbnail_b, diff);
+  return static_cast<float>(cv::mean(diff)[0] / 255.);
+}
+
+void TrackSamBoxesByFlow(const cv::Mat       &prev_gray,
+                         const cv::Mat       &gray,
+                         std::vector<BBox2D> &boxes,
+                         int                  max_points)
+{
+  // features of all the boxes are tracked in one pyramidal LK call
+  const cv::Rect           image_rect(0, 0, prev_gray.cols, prev_gray.rows);
+  std::vector<cv::Point2f> prev_points;
+  std::vector<size_t>      box_begin(boxes.size() + 1, 0);
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    box_begin[i] = prev_points.size();
+    const auto    &box = boxes[i];
+    const cv::Rect roi =
+        cv::Rect(static_cast<int>(box.x - box.w / 2), static_cast<int>(box.y - box.h / 2),
+                 static_cast<int>(box.w), static_cast<int>(box.h)) &
+        image_rect;
+    if (roi.width < 8 || roi.height < 8)
+    {
+      continue;
+    }
+    std::vector<cv::Point2f> corners;
+    cv::goodFeaturesToTrack(prev_gray(roi), corners, max_points, 0.01, 3);
+    for (const auto &corner : corners)
+    {
+      prev_points.emplace_back(corner.x + roi.x, corner.y + roi.y);
+    }
+  }
+  box_begin[boxes.size()] = prev_points.size();
+  if (prev_points.empty())
+  {
+    return;
+  }
+
+  std::vector<cv::Point2f> points;
+  std::vector<uint8_t>     status;
+  std::vector<float>       errors;
+  cv::calcOpticalFlowPyrLK(prev_gray, gray, prev_points, points, status, errors, {15, 15}, 2);
+
+  std::vector<cv::Point2f> prev_tracked, tracked;
+  std::vector<float>       shifts_x, shifts_y, scales;
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    prev_tracked.clear();
+    tracked.clear();
+    for (size_t j = box_begin[i]; j < box_begin[i + 1]; ++j)
+    {
+      if (status[j])
+      {
+        prev_tracked.push_back(prev_points[j]);
+        tracked.push_back(points[j]);
+      }
+    }
+    if (tracked.size() < 3)
+    {
+      continue;
+    }
+
+    shifts_x.clear();
+    shifts_y.clear();
+    for (size_t j = 0; j < tracked.size(); ++j)
+    {
+      shifts_x.push_back(tracked[j].x - prev_tracked[j].x);
+      shifts_y.push_back(tracked[j].y - prev_tracked[j].y);
+    }
+    const float shift_x = Median(shifts_x);
+    const float shift_y = Median(shifts_y);
+
+    // the spread of the features around their centroid gives the scale change of the box
+    const cv::Point2f prev_center = std::accumulate(prev_tracked.begin(), prev_tracked.end(),
+                                                    cv::Point2f(0, 0)) /
+                                    static_cast<float>(prev_tracked.size());
+    const cv::Point2f center =
+        std::accumulate(tracked.begin(), tracked.end(), cv::Point2f(0, 0)) /
+        static_cast<float>(tracked.size());
+    scales.clear();
+    for (size_t j = 0; j < tracked.size(); ++j)
+    {
+      const float prev_distance = cv::norm(prev_tracked[j] - prev_center);
+      if (prev_distance > 1.f)
+      {
+        scales.push_back(cv::norm(tracked[j] - center) / prev_distance);
+      }
+    }
+    const float scale = scales.size() < 3 ? 1.f : std::clamp(Median(scales), 0.5f, 2.f);
+
+    boxes[i].x += shift_x;
+    boxes[i].y += shift_y;
+    boxes[i].w *= scale;
+    boxes[i].h *= scale;
+  }
+}
+
+SamCroppedMask WarpSamCroppedMask(const SamCroppedMask &mask,
+                                  const BBox2D         &from_box,
+                                  const BBox2D         &to_box,
+                                  const cv::Size       &image_size)
+{
+  SamCroppedMask warped;
+  if (mask.roi.empty() || from_box.w <= 0 || from_box.h <= 0)
+  {
+    return warped;
+  }
+
+  const float scale_x = to_box.w / from_box.w;
+  const float scale_y = to_box.h / from_box.h;
+  const int   x0 = static_cast<int>(std::round(to_box.x + (mask.roi.x - from_box.x) * scale_x));
+  const int   y0 = static_cast<int>(std::round(to_box.y + (mask.roi.y - from_box.y) * scale_y));
+  const int   width  = std::max(1, static_cast<int>(std::round(mask.roi.width * scale_x)));
+  const int   height = std::max(1, static_cast<int>(std::round(mask.roi.height * scale_y)));
+  const cv::Rect moved_roi(x0, y0, width, height);
+  const cv::Rect visible_roi = moved_roi & cv::Rect(0, 0, image_size.width, image_size.height);
+  if (visible_roi.empty())
+  {
+    return warped;
+  }
+
+  cv::Mat moved_mask;
+  cv::resize(mask.mask, moved_mask, moved_roi.size(), 0, 0, cv::INTER_NEAREST);
+  warped.roi  = visible_roi;
+  warped.mask = moved_mask(visible_roi - moved_roi.tl()).clone();
+  return warped;
+}
+
+class SamVideoSegmenter : public BaseSamVideoSegmenter {
+public:
+  SamVideoSegmenter(const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                    const SamVideoConfig                      &config);
+
+  bool Start(const cv::Mat             &frame,
+             const std::vector<BBox2D> &boxes,
+             SamVideoFrameResult       &result,
+             bool                       isRGB) override;
+
+  bool Track(const cv::Mat &frame, SamVideoFrameResult &result, bool isRGB) override;
+
+private:
+  // grayscale `frame` at the optical flow resolution
+  cv::Mat MakeFlowImage(const cv::Mat &frame, bool isRGB) const;
+
+  bool EncodeKeyframe(const cv::Mat &frame, bool isRGB);
+
+private:
+  const std::shared_ptr<BaseMobileSamModel> sam_model_;
+  const SamVideoConfig                      config_;
+
+  bool     started_ = false;
+  cv::Size frame_size_;
+  // original frame pixels per optical flow pixel
+  float flow_scale_ = 1.f;
+
+  std::shared_ptr<const SamImageEmbedding> keyframe_embedding_;
+  cv::Mat                                  keyframe_thumbnail_;
+  int                                      frames_since_keyframe_ = 0;
+
+  cv::Mat                     prev_flow_image_;
+  std::vector<BBox2D>         prev_boxes_;
+  std::vector<SamCroppedMask> prev_masks_;
+};
+
+SamVideoSegmenter::SamVideoSegmenter(const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                                     const SamVideoConfig                      &config)
+    : sam_model_(sam_model), config_(config)
+{
+  if (sam_model_ == nullptr)
+  {
+    throw std::invalid_argument("[SamVideoSegmenter] Got INVALID sam model ptr!!!");
+  }
+  if (config_.keyframe_interval < 0 || config_.thumbnail_size <= 0 ||
+      config_.flow_image_width <= 0 || config_.flow_max_points <= 0)
+  {
+    throw std::invalid_argument("[SamVideoSegmenter] Got INVALID video config!!!");
+  }
+}
+
+cv::Mat SamVideoSegmenter::MakeFlowImage(const cv::Mat &frame, bool isRGB) const
+{
+  const cv::Mat gray = ToGray(frame, isRGB);
+  if (flow_scale_ == 1.f)
+  {
+    return gray;
+  }
+  cv::Mat flow_image;
+  cv::resize(gray, flow_image,
+             {static_cast<int>(std::round(frame.cols / flow_scale_)),
+              static_cast<int>(std::round(frame.rows / flow_scale_))},
+             0, 0, cv::INTER_AREA);
+  return flow_image;
+}
+
+bool SamVideoSegmenter::EncodeKeyframe(const cv::Mat &frame, bool isRGB)
+{
+  keyframe_embedding_ = sam_model_->EncodeImage(frame, "", isRGB);
+  CHECK_STATE(keyframe_embedding_ != nullptr, "[SamVideoSegmenter] keyframe encoding failed!!!");
+  keyframe_thumbnail_    = MakeSamSceneThumbnail(frame, config_.thumbnail_size, isRGB);
+  frames_since_keyframe_ = 0;
+  return true;
+}
+
+bool SamVideoSegmenter::Start(const cv::Mat             &frame,
+                              const std::vector<BBox2D> &boxes,
+                              SamVideoFrameResult       &result,
+                              bool                       isRGB)
+{
+  CHECK_STATE(!frame.empty(), "[SamVideoSegmenter] Start got empty frame!!!");
+  started_    = false;
+  frame_size_ = frame.size();
+  flow_scale_ = std::max(1.f, static_cast<float>(frame.cols) / config_.flow_image_width);
+
+  CHECK_STATE(EncodeKeyframe(frame, isRGB), "[SamVideoSegmenter] Start failed!!!");
+  prev_boxes_ = boxes;
+  prev_masks_.clear();
+  if (!prev_boxes_.empty())
+  {
+    CHECK_STATE(sam_model_->DecodeCroppedMasks(keyframe_embedding_, prev_boxes_, prev_masks_),
+                "[SamVideoSegmenter] Start mask decoding failed!!!");
+  }
+  prev_flow_image_ = MakeFlowImage(frame, isRGB);
+  started_         = true;
+
+  result.type         = SamVideoFrameType::KEYFRAME;
+  result.boxes        = prev_boxes_;
+  result.masks        = prev_masks_;
+  result.scene_change = 0.f;
+  return true;
+}
+
+bool SamVideoSegmenter::Track(const cv::Mat &frame, SamVideoFrameResult &result, bool isRGB)
+{
+  CHECK_STATE(started_, "[SamVideoSegmenter] Track called before Start!!!");
+  CHECK_STATE(frame.size() == frame_size_,
+              "[SamVideoSegmenter] Track got a frame of another size, call Start again!!!");
+
+  // 1. Track the boxes at the optical flow resolution
+  cv::Mat             flow_image = MakeFlowImage(frame, isRGB);
+  std::vector<BBox2D> boxes      = prev_boxes_;
+  for (auto &box : boxes)
+  {
+    box.x /= flow_scale_;
+    box.y /= flow_scale_;
+    box.w /= flow_scale_;
+    box.h /= flow_scale_;
+  }
+  TrackSamBoxesByFlow(prev_flow_image_, flow_image, boxes, config_.flow_max_points);
+  for (auto &box : boxes)
+  {
+    box.x *= flow_scale_;
+    box.y *= flow_scale_;
+    box.w *= flow_scale_;
+    box.h *= flow_scale_;
+  }
+
+  // 2. The cheapest way to get masks of the tracked boxes that the scene change allows
+  const float scene_change = ComputeSamSceneChange(
+      keyframe_thumbnail_, MakeSamSceneThumbnail(frame, config_.thumbnail_size, isRGB));
+  ++frames_since_keyframe_;
+  const bool is_keyframe =
+      scene_change >= config_.scene_change_thresh ||
+      (config_.keyframe_interval > 0 && frames_since_keyframe_ >= config_.keyframe_interval);
+
+  std::vector<SamCroppedMask> masks;
+  if (is_keyframe || scene_change < config_.cached_decode_thresh)
+  {
+    if (is_keyframe)
+    {
+      CHECK_STATE(EncodeKeyframe(frame, isRGB), "[SamVideoSegmenter] Track failed!!!");
+    }
+    if (!boxes.empty())
+    {
+      CHECK_STATE(sam_model_->DecodeCroppedMasks(keyframe_embedding_, boxes, masks),
+                  "[SamVideoSegmenter] Track mask decoding failed!!!");
+    }
+    result.type = is_keyframe ? SamVideoFrameType::KEYFRAME : SamVideoFrameType::CACHED_DECODE;
+  } else
+  {
+    masks.reserve(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+      masks.push_back(WarpSamCroppedMask(prev_masks_[i], prev_boxes_[i], boxes[i], frame_size_));
+    }
+    result.type = SamVideoFrameType::WARPED;
+  }
+
+  prev_flow_image_ = std::move(flow_image);
+  prev_boxes_      = boxes;
+  prev_masks_      = masks;
+
+  result.boxes        = std::move(boxes);
+  result.masks        = std::move(masks);
+  result.scene_change = scene_change;
+  return true;
+}
+
+std::shared_ptr<BaseSamVideoSegmenter> CreateSamVideoSegmenter(
+    const std::shared_ptr<BaseMobileSamModel> &sam_model,
+    const SamVideoConfig                      &config)
+{
+  return std::make_shared<SamVideoSegmenter>(sam_model, config);
+}
+
+} // namespace easy_deploy
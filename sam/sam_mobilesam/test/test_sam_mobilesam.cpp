@@ -1,11 +1,552 @@
 #include <gtest/gtest.h>
 
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
 #include "detection_2d_util/detection_2d_util.hpp"
 #include "sam_mobilesam/mobilesam.hpp"
+#include "sam_mobilesam/auto_mask.hpp"
+#include "sam_mobilesam/bounded_queue.hpp"
+#include "sam_mobilesam/cpu_affinity.hpp"
+#include "sam_mobilesam/feature_precision.hpp"
+#include "sam_mobilesam/feature_transpose.hpp"
+#include "sam_mobilesam/mask_postprocess.hpp"
+#include "sam_mobilesam/video_sam.hpp"
 #include "test_utils/sam_test_utils.hpp"
 
 using namespace easy_deploy;
 
+static float ComputeMaskIoU(const cv::Mat &mask_a, const cv::Mat &mask_b)
+{
+  const int intersection = cv::countNonZero(mask_a & mask_b);
+  const int union_area   = cv::countNonZero(mask_a | mask_b);
+  return union_area == 0 ? 1.f : static_cast<float>(intersection) / union_area;
+}
+
+static void test_sam_embedding_cache_reuse(const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                                           const std::vector<std::pair<int, int>>    &points,
+                                           const std::vector<int>                    &labels,
+                                           const std::vector<BBox2D>                 &boxes,
+                                           const std::string                         &image_path)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+
+  sam_model->ClearEmbeddingCache();
+  const auto stats_before = sam_model->GetEmbeddingCacheStats();
+
+  // the same content should hit the cache, even in a different `cv::Mat`
+  auto embedding = sam_model->EncodeImage(image);
+  ASSERT_NE(embedding, nullptr);
+  auto cached_embedding = sam_model->EncodeImage(image.clone());
+  EXPECT_EQ(cached_embedding, embedding);
+  // caller-supplied id is another key
+  ASSERT_NE(sam_model->EncodeImage(image, "persons"), nullptr);
+  EXPECT_EQ(sam_model->EncodeImage(image, "persons"), sam_model->EncodeImage(image, "persons"));
+
+  const auto stats_after = sam_model->GetEmbeddingCacheStats();
+  EXPECT_EQ(stats_after.misses - stats_before.misses, 2u);
+  EXPECT_EQ(stats_after.hits - stats_before.hits, 3u);
+  EXPECT_EQ(stats_after.entries, 2u);
+  EXPECT_LE(stats_after.memory_bytes, stats_after.capacity_bytes);
+
+  // the same pixels in the other channel order are another image
+  auto rgb_embedding = sam_model->EncodeImage(image, "", true);
+  ASSERT_NE(rgb_embedding, nullptr);
+  EXPECT_NE(rgb_embedding, embedding);
+
+  // decoding from the embedding should match the full pipeline
+  cv::Mat box_mask, expected_box_mask;
+  ASSERT_TRUE(sam_model->DecodeMask(embedding, boxes, box_mask));
+  ASSERT_TRUE(sam_model->GenerateMask(image, boxes, expected_box_mask));
+  EXPECT_GT(ComputeMaskIoU(box_mask, expected_box_mask), 0.99f);
+
+  cv::Mat point_mask, expected_point_mask;
+  ASSERT_TRUE(sam_model->DecodeMask(embedding, points, labels, point_mask));
+  ASSERT_TRUE(sam_model->GenerateMask(image, points, labels, expected_point_mask));
+  EXPECT_GT(ComputeMaskIoU(point_mask, expected_point_mask), 0.99f);
+
+  // a copy stretched on one axis is not a scaled image
+  cv::Mat stretched_image;
+  cv::resize(image, stretched_image, {image.cols / 2, image.rows});
+  EXPECT_EQ(sam_model->EncodeScaledImage(stretched_image, 0.5f, image.size()), nullptr);
+}
+
+static void test_sam_multi_box_decoding(const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                                        const std::vector<BBox2D>                 &boxes,
+                                        const std::string                         &image_path)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+
+  // append a shifted copy of every box, so that several boxes share one decoder call
+  std::vector<BBox2D> multi_boxes = boxes;
+  for (const auto &box : boxes)
+  {
+    BBox2D shifted_box = box;
+    shifted_box.x      = std::min(box.x + box.w, static_cast<float>(image.cols) - box.w / 2.f);
+    multi_boxes.push_back(shifted_box);
+  }
+
+  std::vector<cv::Mat> masks;
+  ASSERT_TRUE(sam_model->GenerateMasks(image, multi_boxes, masks));
+  ASSERT_EQ(masks.size(), multi_boxes.size());
+
+  // every mask should match the one decoded with its box alone
+  auto embedding = sam_model->EncodeImage(image);
+  ASSERT_NE(embedding, nullptr);
+  for (size_t i = 0; i < multi_boxes.size(); ++i)
+  {
+    EXPECT_EQ(masks[i].rows, image.rows);
+    EXPECT_EQ(masks[i].cols, image.cols);
+    cv::Mat single_box_mask;
+    ASSERT_TRUE(sam_model->DecodeMask(embedding, {multi_boxes[i]}, single_box_mask));
+    EXPECT_GT(ComputeMaskIoU(masks[i], single_box_mask), 0.99f);
+  }
+}
+
+// decode a COCO RLE into a dense 0/255 mask
+static cv::Mat DecodeRle(const SamRleMask &rle)
+{
+  cv::Mat  mask(rle.height, rle.width, CV_8UC1);
+  uint8_t  value = 0;
+  uint32_t pixel = 0;
+  for (const uint32_t count : rle.counts)
+  {
+    for (uint32_t i = 0; i < count; ++i, ++pixel)
+    {
+      // column-major
+      mask.at<uint8_t>(pixel % rle.height, pixel / rle.height) = value;
+    }
+    value = value ? 0 : 255;
+  }
+  return mask;
+}
+
+static void test_sam_compact_masks(const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                                   const std::vector<BBox2D>                 &boxes,
+                                   const std::string                         &image_path)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+  auto embedding = sam_model->EncodeImage(image);
+  ASSERT_NE(embedding, nullptr);
+
+  std::vector<cv::Mat>        dense_masks;
+  std::vector<SamCroppedMask> cropped_masks;
+  std::vector<SamRleMask>     rle_masks;
+  ASSERT_TRUE(sam_model->DecodeMasks(embedding, boxes, dense_masks));
+  ASSERT_TRUE(sam_model->DecodeCroppedMasks(embedding, boxes, cropped_masks));
+  ASSERT_TRUE(sam_model->DecodeRleMasks(embedding, boxes, rle_masks));
+  ASSERT_EQ(cropped_masks.size(), boxes.size());
+  ASSERT_EQ(rle_masks.size(), boxes.size());
+
+  for (size_t i = 0; i < boxes.size(); ++i)
+  {
+    ASSERT_FALSE(cropped_masks[i].roi.empty());
+    cv::Mat cropped_to_dense = cv::Mat::zeros(image.size(), CV_8UC1);
+    cropped_masks[i].mask.copyTo(cropped_to_dense(cropped_masks[i].roi));
+    EXPECT_GT(ComputeMaskIoU(cropped_to_dense, dense_masks[i]), 0.95f);
+
+    EXPECT_EQ(rle_masks[i].height, image.rows);
+    EXPECT_EQ(rle_masks[i].width, image.cols);
+    EXPECT_EQ(cv::countNonZero(DecodeRle(rle_masks[i]) != cropped_to_dense), 0);
+  }
+}
+
+TEST(SamEmbeddingCacheTest, test_lru_eviction_with_memory_cap)
+{
+  auto make_embedding = [](size_t float_num) {
+    auto embedding = std::make_shared<SamImageEmbedding>();
+    embedding->features.resize(float_num);
+    return embedding;
+  };
+
+  SamEmbeddingCache cache(3 * 1024 * sizeof(float));
+  cache.Put("a", make_embedding(1024));
+  cache.Put("b", make_embedding(1024));
+  cache.Put("c", make_embedding(1024));
+  // touch `a`, so `b` is the least recently used one
+  ASSERT_NE(cache.Get("a"), nullptr);
+  cache.Put("d", make_embedding(1024));
+
+  EXPECT_EQ(cache.Get("b"), nullptr);
+  EXPECT_NE(cache.Get("a"), nullptr);
+  EXPECT_NE(cache.Get("c"), nullptr);
+  EXPECT_NE(cache.Get("d"), nullptr);
+
+  // larger than the whole capacity, never cached
+  cache.Put("e", make_embedding(4 * 1024));
+  EXPECT_EQ(cache.Get("e"), nullptr);
+
+  const auto stats = cache.GetStats();
+  EXPECT_EQ(stats.entries, 3u);
+  EXPECT_EQ(stats.evictions, 1u);
+  EXPECT_EQ(stats.hits, 4u);
+  EXPECT_EQ(stats.misses, 2u);
+  EXPECT_EQ(stats.memory_bytes, 3 * 1024 * sizeof(float));
+}
+
+TEST(SamEmbeddingCacheTest, test_concurrent_put_of_the_same_key)
+{
+  SamEmbeddingCache cache(2 * 1024 * sizeof(float));
+
+  auto put_repeatedly = [&cache]() {
+    for (int i = 0; i < 1000; ++i)
+    {
+      auto embedding = std::make_shared<SamImageEmbedding>();
+      embedding->features.resize(1024);
+      cache.Put("a", embedding);
+    }
+  };
+  std::thread worker(put_repeatedly);
+  put_repeatedly();
+  worker.join();
+
+  const auto stats = cache.GetStats();
+  EXPECT_EQ(stats.entries, 1u);
+  EXPECT_EQ(stats.evictions, 0u);
+  EXPECT_EQ(stats.memory_bytes, 1024 * sizeof(float));
+}
+
+TEST(SamEmbeddingCacheTest, test_content_key_of_high_bit_differences)
+{
+  // the same high bit flipped in two words of a row, or in two rows, is another image
+  cv::Mat image(48, 64, CV_8UC3, cv::Scalar(10, 20, 30));
+  cv::Mat flipped_words = image.clone(), flipped_rows = image.clone();
+  flipped_words.ptr<uint8_t>(0)[7] ^= 0x80;
+  flipped_words.ptr<uint8_t>(0)[15] ^= 0x80;
+  flipped_rows.ptr<uint8_t>(0)[7] ^= 0x80;
+  flipped_rows.ptr<uint8_t>(1)[7] ^= 0x80;
+
+  const std::string key = ComputeImageContentKey(image);
+  EXPECT_EQ(ComputeImageContentKey(image.clone()), key);
+  EXPECT_NE(ComputeImageContentKey(flipped_words), key);
+  EXPECT_NE(ComputeImageContentKey(flipped_rows), key);
+  EXPECT_NE(ComputeImageContentKey(flipped_words), ComputeImageContentKey(flipped_rows));
+  // every single bit of a pixel changes the key
+  for (int bit = 0; bit < 8; ++bit)
+  {
+    cv::Mat flipped = image.clone();
+    flipped.ptr<uint8_t>(20)[100] ^= static_cast<uint8_t>(1 << bit);
+    EXPECT_NE(ComputeImageContentKey(flipped), key);
+  }
+}
+
+static void test_sam_pipelined_execution(const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                                         const std::vector<std::pair<int, int>>    &points,
+                                         const std::vector<int>                    &labels,
+                                         const std::vector<BBox2D>                 &boxes,
+                                         const std::string                         &image_path)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+
+  std::vector<cv::Mat> box_masks;
+  cv::Mat              point_mask;
+  ASSERT_TRUE(sam_model->GenerateMasks(image, boxes, box_masks));
+  ASSERT_TRUE(sam_model->GenerateMask(image, points, labels, point_mask));
+
+  // more frames than the queues hold, mixing box and point prompts
+  const int                                      frame_number = 8;
+  std::vector<std::future<std::vector<cv::Mat>>> futures;
+  for (int i = 0; i < frame_number; ++i)
+  {
+    futures.push_back(i % 2 == 0 ? sam_model->GenerateMasksPipelined(image, boxes)
+                                 : sam_model->GenerateMaskPipelined(image, points, labels));
+  }
+  for (int i = 0; i < frame_number; ++i)
+  {
+    const auto masks = futures[i].get();
+    if (i % 2 == 0)
+    {
+      ASSERT_EQ(masks.size(), box_masks.size());
+      for (size_t j = 0; j < masks.size(); ++j)
+      {
+        EXPECT_GT(ComputeMaskIoU(masks[j], box_masks[j]), 0.99f);
+      }
+    } else
+    {
+      ASSERT_EQ(masks.size(), 1u);
+      EXPECT_GT(ComputeMaskIoU(masks[0], point_mask), 0.99f);
+    }
+  }
+
+  const auto stats = sam_model->GetPipelineStats();
+  ASSERT_EQ(stats.size(), 2u);
+  for (const auto &stage_stats : stats)
+  {
+    EXPECT_EQ(stage_stats.processed, static_cast<size_t>(frame_number));
+    EXPECT_GT(stage_stats.utilisation, 0.);
+    EXPECT_LE(stage_stats.utilisation, 1.);
+  }
+
+  EXPECT_THROW(sam_model->GenerateMasksPipelined(image, {}).get(), std::invalid_argument);
+}
+
+// `bucketed_model` pads the prompts up to its buckets, masks should not change
+static void test_sam_prompt_bucketing(const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                                      const std::shared_ptr<BaseMobileSamModel> &bucketed_model,
+                                      const std::vector<BBox2D>                 &boxes,
+                                      const std::string                         &image_path)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+  auto embedding          = sam_model->EncodeImage(image);
+  auto bucketed_embedding = bucketed_model->EncodeImage(image);
+  ASSERT_NE(embedding, nullptr);
+  ASSERT_NE(bucketed_embedding, nullptr);
+
+  // three points in the box are padded to four, three boxes as well
+  const auto                            &box = boxes[0];
+  const int                              x   = static_cast<int>(box.x);
+  const int                              y   = static_cast<int>(box.y);
+  const int                              dy  = static_cast<int>(box.h / 4);
+  const std::vector<std::pair<int, int>> points{{x, y}, {x, y - dy}, {x, y + dy}};
+  const std::vector<int> labels{1, 1, 1};
+  std::vector<BBox2D>    three_boxes{box, box, box};
+  three_boxes[1].x -= box.w / 4;
+  three_boxes[2].x += box.w / 4;
+
+  cv::Mat mask, bucketed_mask;
+  ASSERT_TRUE(sam_model->DecodeMask(embedding, points, labels, mask));
+  ASSERT_TRUE(bucketed_model->DecodeMask(bucketed_embedding, points, labels, bucketed_mask));
+  EXPECT_GT(ComputeMaskIoU(mask, bucketed_mask), 0.99f);
+
+  std::vector<cv::Mat> masks, bucketed_masks;
+  ASSERT_TRUE(sam_model->DecodeMasks(embedding, three_boxes, masks));
+  ASSERT_TRUE(bucketed_model->DecodeMasks(bucketed_embedding, three_boxes, bucketed_masks));
+  ASSERT_EQ(bucketed_masks.size(), three_boxes.size());
+  for (size_t i = 0; i < three_boxes.size(); ++i)
+  {
+    EXPECT_GT(ComputeMaskIoU(masks[i], bucketed_masks[i]), 0.99f);
+  }
+}
+
+// a copy of the fp32 `embedding` compressed into `precision`
+static std::shared_ptr<SamImageEmbedding> CompressEmbedding(const SamImageEmbedding &embedding,
+                                                            SamFeaturePrecision      precision,
+                                                            SamFeatureLayout         layout)
+{
+  auto compressed              = std::make_shared<SamImageEmbedding>();
+  compressed->features         = embedding.features;
+  compressed->layout           = embedding.layout;
+  compressed->feature_channels = embedding.feature_channels;
+  compressed->feature_height   = embedding.feature_height;
+  compressed->feature_width    = embedding.feature_width;
+  compressed->transform_scale  = embedding.transform_scale;
+  compressed->image_height     = embedding.image_height;
+  compressed->image_width      = embedding.image_width;
+  compressed->Compress(precision, layout);
+  return compressed;
+}
+
+// masks decoded from fp16 and int8 embeddings against the fp32 ones, the mean IoU is reported
+static void test_sam_compressed_embeddings(const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                                           const std::vector<BBox2D>                 &boxes,
+                                           const std::string                         &image_path)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+  auto embedding = sam_model->EncodeImage(image);
+  ASSERT_NE(embedding, nullptr);
+  ASSERT_EQ(embedding->Precision(), SamFeaturePrecision::FP32);
+
+  std::vector<cv::Mat> masks;
+  ASSERT_TRUE(sam_model->DecodeMasks(embedding, boxes, masks));
+
+  const std::vector<std::pair<std::string, SamFeaturePrecision>> precisions{
+      {"fp16", SamFeaturePrecision::FP16}, {"int8", SamFeaturePrecision::INT8}};
+  for (const auto &precision : precisions)
+  {
+    auto compressed = CompressEmbedding(*embedding, precision.second, embedding->layout);
+    EXPECT_LT(compressed->ByteSize(), embedding->ByteSize());
+
+    std::vector<cv::Mat> compressed_masks;
+    ASSERT_TRUE(sam_model->DecodeMasks(compressed, boxes, compressed_masks));
+    ASSERT_EQ(compressed_masks.size(), masks.size());
+    float mean_iou = 0.f;
+    for (size_t i = 0; i < masks.size(); ++i)
+    {
+      mean_iou += ComputeMaskIoU(compressed_masks[i], masks[i]) / masks.size();
+    }
+    // the accuracy delta against fp32 is reported in the test xml output
+    const float iou_delta = 1.f - mean_iou;
+    testing::Test::RecordProperty(precision.first + "_iou_delta", std::to_string(iou_delta));
+    EXPECT_LT(iou_delta, precision.second == SamFeaturePrecision::FP16 ? 0.01f : 0.05f);
+  }
+}
+
+// a click refined with the previous mask as prior. Without a prior `RefineMask` is `DecodeMask`,
+// repeating a click on its own mask should keep the mask stable.
+static void test_sam_iterative_refinement(const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                                          const std::vector<std::pair<int, int>>    &points,
+                                          const std::vector<int>                    &labels,
+                                          const std::string                         &image_path)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+
+  SamRefinementSession session;
+  session.embedding = sam_model->EncodeImage(image);
+  ASSERT_NE(session.embedding, nullptr);
+
+  cv::Mat first_mask;
+  ASSERT_TRUE(sam_model->RefineMask(session, points, labels, first_mask));
+  ASSERT_EQ(session.prior_logits.size(), 256u * 256u);
+  cv::Mat decoded_mask;
+  ASSERT_TRUE(sam_model->DecodeMask(session.embedding, points, labels, decoded_mask));
+  EXPECT_EQ(cv::countNonZero(first_mask != decoded_mask), 0);
+
+  // one corrective click only, decoded against the prior
+  cv::Mat refined_mask;
+  ASSERT_TRUE(sam_model->RefineMask(session, {points.front()}, {labels.front()}, refined_mask));
+  EXPECT_GT(cv::countNonZero(refined_mask), 0);
+  EXPECT_GT(ComputeMaskIoU(refined_mask, first_mask), 0.8f);
+
+  session.Reset();
+  cv::Mat reset_mask;
+  ASSERT_TRUE(sam_model->RefineMask(session, points, labels, reset_mask));
+  EXPECT_EQ(cv::countNonZero(reset_mask != first_mask), 0);
+}
+
+// every kept mask passes the filters, lies in the image and survives the box NMS
+static void test_sam_auto_masks(const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                                const std::string                         &image_path)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+
+  SamAutoMaskConfig config;
+  config.points_per_side = 16;
+  for (const int crop_layers : {0, 1})
+  {
+    config.crop_layers = crop_layers;
+    std::vector<SamAutoMask> masks;
+    ASSERT_TRUE(sam_model->GenerateAutoMasks(image, config, masks));
+    // the persons of the test image at least, each segmented once
+    EXPECT_GE(masks.size(), 3u);
+
+    const cv::Rect image_rect(0, 0, image.cols, image.rows);
+    for (size_t i = 0; i < masks.size(); ++i)
+    {
+      const auto &mask = masks[i];
+      EXPECT_GE(mask.predicted_iou, config.pred_iou_thresh);
+      EXPECT_GE(mask.stability_score, config.stability_score_thresh);
+      EXPECT_EQ(mask.mask.roi & image_rect, mask.mask.roi);
+      EXPECT_EQ(mask.mask.mask.size(), mask.mask.roi.size());
+      if (i > 0)
+      {
+        EXPECT_LE(mask.predicted_iou, masks[i - 1].predicted_iou);
+      }
+      for (size_t j = 0; j < i; ++j)
+      {
+        const cv::Rect intersection = mask.mask.roi & masks[j].mask.roi;
+        const float    box_iou      = static_cast<float>(intersection.area()) /
+                              (mask.mask.roi.area() + masks[j].mask.roi.area() -
+                               intersection.area());
+        EXPECT_LE(box_iou, config.box_nms_thresh);
+      }
+    }
+  }
+}
+
+// a point decoder taking a batch of prompts per inference gives the masks of one prompt per
+// inference. Filters and NMS are off so that every grid point is compared, the grid does not fill
+// the last batch.
+static void test_sam_batched_auto_masks(
+    const std::shared_ptr<BaseMobileSamModel> &sam_model,
+    const std::shared_ptr<BaseMobileSamModel> &batched_points_sam_model,
+    const std::string                         &image_path)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+
+  SamAutoMaskConfig config;
+  config.points_per_side        = 10;
+  config.pred_iou_thresh        = 0.f;
+  config.stability_score_thresh = 0.f;
+  config.box_nms_thresh         = 1.f;
+  std::vector<SamAutoMask> expected_masks, masks;
+  ASSERT_TRUE(sam_model->GenerateAutoMasks(image, config, expected_masks));
+  ASSERT_TRUE(batched_points_sam_model->GenerateAutoMasks(image, config, masks));
+  ASSERT_FALSE(expected_masks.empty());
+  ASSERT_EQ(masks.size(), expected_masks.size());
+
+  for (const auto &expected : expected_masks)
+  {
+    const auto iter = std::find_if(masks.begin(), masks.end(), [&](const SamAutoMask &mask) {
+      return mask.point == expected.point;
+    });
+    ASSERT_NE(iter, masks.end());
+    EXPECT_NEAR(iter->predicted_iou, expected.predicted_iou, 1e-3f);
+    EXPECT_NEAR(iter->stability_score, expected.stability_score, 1e-2f);
+
+    cv::Mat mask          = cv::Mat::zeros(image.size(), CV_8UC1);
+    cv::Mat expected_mask = cv::Mat::zeros(image.size(), CV_8UC1);
+    iter->mask.mask.copyTo(mask(iter->mask.roi));
+    expected.mask.mask.copyTo(expected_mask(expected.mask.roi));
+    EXPECT_GT(ComputeMaskIoU(mask, expected_mask), 0.98f);
+  }
+}
+
+// a clip panning over the image : masks between keyframes follow the object and stay close to
+// the masks of every frame encoded on its own, a cut forces a keyframe
+static void test_sam_video_mode(const std::shared_ptr<BaseMobileSamModel> &sam_model,
+                                const std::vector<BBox2D>                 &boxes,
+                                const std::string                         &image_path)
+{
+  cv::Mat image = cv::imread(image_path);
+  ASSERT_FALSE(image.empty());
+  auto make_frame = [&image](int shift) {
+    cv::Mat frame;
+    cv::Mat translation = (cv::Mat_<double>(2, 3) << 1, 0, shift, 0, 1, 0);
+    cv::warpAffine(image, frame, translation, image.size());
+    return frame;
+  };
+
+  SamVideoConfig config;
+  config.keyframe_interval = 5;
+  auto video_segmenter     = CreateSamVideoSegmenter(sam_model, config);
+
+  SamVideoFrameResult result;
+  ASSERT_TRUE(video_segmenter->Start(make_frame(0), boxes, result));
+  EXPECT_EQ(result.type, SamVideoFrameType::KEYFRAME);
+  ASSERT_EQ(result.masks.size(), boxes.size());
+
+  const int shift_per_frame = 3;
+  for (int i = 1; i <= 6; ++i)
+  {
+    const cv::Mat frame = make_frame(i * shift_per_frame);
+    ASSERT_TRUE(video_segmenter->Track(frame, result));
+    EXPECT_EQ(result.type == SamVideoFrameType::KEYFRAME, i == config.keyframe_interval);
+    ASSERT_EQ(result.masks.size(), boxes.size());
+
+    std::vector<BBox2D> shifted_boxes = boxes;
+    for (size_t j = 0; j < boxes.size(); ++j)
+    {
+      shifted_boxes[j].x += i * shift_per_frame;
+      EXPECT_NEAR(result.boxes[j].x, shifted_boxes[j].x, 2.f);
+    }
+    std::vector<SamCroppedMask> expected_masks;
+    auto                        embedding = sam_model->EncodeImage(frame);
+    ASSERT_TRUE(sam_model->DecodeCroppedMasks(embedding, shifted_boxes, expected_masks));
+    for (size_t j = 0; j < boxes.size(); ++j)
+    {
+      cv::Mat mask          = cv::Mat::zeros(image.size(), CV_8UC1);
+      cv::Mat expected_mask = cv::Mat::zeros(image.size(), CV_8UC1);
+      result.masks[j].mask.copyTo(mask(result.masks[j].roi));
+      expected_masks[j].mask.copyTo(expected_mask(expected_masks[j].roi));
+      EXPECT_GT(ComputeMaskIoU(mask, expected_mask), 0.8f);
+    }
+  }
+
+  ASSERT_TRUE(video_segmenter->Track(cv::Mat::zeros(image.size(), image.type()), result));
+  EXPECT_EQ(result.type, SamVideoFrameType::KEYFRAME);
+  EXPECT_GE(result.scene_change, config.scene_change_thresh);
+}
+
 #define GEN_MOBILESAM_TEST_CASES(Tag, FixtureClass)                                             \
   TEST_F(FixtureClass, test_mobilesam_##Tag##_correctness_with_points)                          \
   {                                                                                             \
@@ -28,6 +569,49 @@ using namespace easy_deploy;
   {                                                                                             \
     test_sam_algorithm_async_correctness_with_boxes(mobilesam_model_, boxes_, test_image_path_, \
                                                     test_mobilesam_visual_result_save_path_);   \
+  }                                                                                             \
+  TEST_F(FixtureClass, test_mobilesam_##Tag##_embedding_cache_reuse)                            \
+  {                                                                                             \
+    test_sam_embedding_cache_reuse(mobilesam_model_, points_, labels_, boxes_,                  \
+                                   test_image_path_);                                           \
+  }                                                                                             \
+  TEST_F(FixtureClass, test_mobilesam_##Tag##_multi_box_decoding)                               \
+  {                                                                                             \
+    test_sam_multi_box_decoding(mobilesam_model_, boxes_, test_image_path_);                    \
+  }                                                                                             \
+  TEST_F(FixtureClass, test_mobilesam_##Tag##_compact_masks)                                    \
+  {                                                                                             \
+    test_sam_compact_masks(mobilesam_model_, boxes_, test_image_path_);                         \
+  }                                                                                             \
+  TEST_F(FixtureClass, test_mobilesam_##Tag##_pipelined_execution)                              \
+  {                                                                                             \
+    test_sam_pipelined_execution(mobilesam_model_, points_, labels_, boxes_, test_image_path_); \
+  }                                                                                             \
+  TEST_F(FixtureClass, test_mobilesam_##Tag##_prompt_bucketing)                                 \
+  {                                                                                             \
+    test_sam_prompt_bucketing(mobilesam_model_, mobilesam_bucketed_model_, boxes_,              \
+                              test_image_path_);                                                \
+  }                                                                                             \
+  TEST_F(FixtureClass, test_mobilesam_##Tag##_compressed_embeddings)                            \
+  {                                                                                             \
+    test_sam_compressed_embeddings(mobilesam_model_, boxes_, test_image_path_);                 \
+  }                                                                                             \
+  TEST_F(FixtureClass, test_mobilesam_##Tag##_auto_masks)                                       \
+  {                                                                                             \
+    test_sam_auto_masks(mobilesam_model_, test_image_path_);                                    \
+  }                                                                                             \
+  TEST_F(FixtureClass, test_mobilesam_##Tag##_batched_auto_masks)                               \
+  {                                                                                             \
+    test_sam_batched_auto_masks(mobilesam_model_, mobilesam_batched_points_model_,              \
+                                test_image_path_);                                              \
+  }                                                                                             \
+  TEST_F(FixtureClass, test_mobilesam_##Tag##_iterative_refinement)                             \
+  {                                                                                             \
+    test_sam_iterative_refinement(mobilesam_model_, points_, labels_, test_image_path_);        \
+  }                                                                                             \
+  TEST_F(FixtureClass, test_mobilesam_##Tag##_video_mode)                                       \
+  {                                                                                             \
+    test_sam_video_mode(mobilesam_model_, boxes_, test_image_path_);                            \
   }
 
 #define GEN_NANOSAM_TEST_CASES(Tag, FixtureClass)                                                  \
@@ -51,12 +635,587 @@ using namespace easy_deploy;
   {                                                                                                \
     test_sam_algorithm_async_correctness_with_boxes(nanosam_model_, boxes_, test_image_path_,      \
                                                     test_nanosam_visual_result_save_path_);        \
+  }                                                                                                \
+  TEST_F(FixtureClass, test_nanosam_##Tag##_embedding_cache_reuse)                                 \
+  {                                                                                                \
+    test_sam_embedding_cache_reuse(nanosam_model_, points_, labels_, boxes_, test_image_path_);    \
+  }                                                                                                \
+  TEST_F(FixtureClass, test_nanosam_##Tag##_multi_box_decoding)                                    \
+  {                                                                                                \
+    test_sam_multi_box_decoding(nanosam_model_, boxes_, test_image_path_);                         \
+  }                                                                                                \
+  TEST_F(FixtureClass, test_nanosam_##Tag##_compact_masks)                                         \
+  {                                                                                                \
+    test_sam_compact_masks(nanosam_model_, boxes_, test_image_path_);                              \
+  }                                                                                                \
+  TEST_F(FixtureClass, test_nanosam_##Tag##_pipelined_execution)                                   \
+  {                                                                                                \
+    test_sam_pipelined_execution(nanosam_model_, points_, labels_, boxes_, test_image_path_);      \
+  }                                                                                                \
+  TEST_F(FixtureClass, test_nanosam_##Tag##_compressed_embeddings)                                 \
+  {                                                                                                \
+    test_sam_compressed_embeddings(nanosam_model_, boxes_, test_image_path_);                      \
+  }                                                                                                \
+  TEST_F(FixtureClass, test_nanosam_##Tag##_auto_masks)                                            \
+  {                                                                                                \
+    test_sam_auto_masks(nanosam_model_, test_image_path_);                                         \
+  }                                                                                                \
+  TEST_F(FixtureClass, test_nanosam_##Tag##_iterative_refinement)                                  \
+  {                                                                                                \
+    test_sam_iterative_refinement(nanosam_model_, points_, labels_, test_image_path_);             \
+  }                                                                                                \
+  TEST_F(FixtureClass, test_nanosam_##Tag##_video_mode)                                            \
+  {                                                                                                \
+    test_sam_video_mode(nanosam_model_, boxes_, test_image_path_);                                 \
+  }
+
+TEST(SamFeatureTransposeTest, test_tiled_transpose_matches_naive)
+{
+  // MobileSam features, and odd shapes to cover the scalar tails of the tiled kernel
+  const std::vector<std::vector<int>> shapes = {{1, 256, 64, 64}, {2, 3, 5, 7}, {1, 13, 63, 65}};
+  for (const auto &shape : shapes)
+  {
+    const int          N = shape[0], C = shape[1], H = shape[2], W = shape[3];
+    std::vector<float> nchw(N * C * H * W);
+    for (size_t i = 0; i < nchw.size(); ++i)
+    {
+      nchw[i] = static_cast<float>(i);
+    }
+
+    std::vector<float> expected(nchw.size());
+    TransposeNchwToNhwcNaive(nchw.data(), expected.data(), N, C, H, W);
+    for (const int num_threads : {1, 4})
+    {
+      std::vector<float> nhwc(nchw.size());
+      TransposeNchwToNhwc(nchw.data(), nhwc.data(), N, C, H, W, num_threads);
+      EXPECT_EQ(nhwc, expected);
+    }
+  }
+}
+
+TEST(SamFeatureTransposeTest, test_embedding_converts_layout_once)
+{
+  const int         C = 256, H = 64, W = 64;
+  SamImageEmbedding embedding;
+  embedding.features.resize(C * H * W);
+  for (size_t i = 0; i < embedding.features.size(); ++i)
+  {
+    embedding.features[i] = static_cast<float>(i);
+  }
+  embedding.layout           = SamFeatureLayout::NCHW;
+  embedding.feature_channels = C;
+  embedding.feature_height   = H;
+  embedding.feature_width    = W;
+
+  const size_t nchw_bytes = embedding.ByteSize();
+  EXPECT_EQ(embedding.GetFeatures(SamFeatureLayout::NCHW), embedding.features.data());
+  EXPECT_FALSE(embedding.HasFeatures(SamFeatureLayout::NHWC));
+
+  std::vector<float> expected(embedding.features.size());
+  TransposeNchwToNhwcNaive(embedding.features.data(), expected.data(), 1, C, H, W);
+
+  const float *nhwc = embedding.GetFeatures(SamFeatureLayout::NHWC, 4);
+  EXPECT_TRUE(std::equal(expected.begin(), expected.end(), nhwc));
+  EXPECT_TRUE(embedding.HasFeatures(SamFeatureLayout::NHWC));
+  EXPECT_EQ(embedding.ByteSize(), 2 * nchw_bytes);
+
+  // the later prompts reuse the converted features
+  EXPECT_EQ(embedding.GetFeatures(SamFeatureLayout::NHWC), nhwc);
+  EXPECT_EQ(embedding.ByteSize(), 2 * nchw_bytes);
+}
+
+TEST(SamFeaturePrecisionTest, test_fp16_conversion)
+{
+  // exact values, the largest half, a half subnormal, ties rounding to even, overflow to inf
+  const std::vector<float>    values{0.f,     -0.f,         1.f,           -2.5f,
+                                     65504.f, 5.9604645e-8f, 1.f + 1.f / 2048, 1e6f};
+  const std::vector<uint16_t> halves{0x0000, 0x8000, 0x3c00, 0xc100,
+                                     0x7bff, 0x0001, 0x3c00, 0x7c00};
+  std::vector<uint16_t>       converted(values.size());
+  ConvertFp32ToFp16(values.data(), converted.data(), values.size());
+  EXPECT_EQ(converted, halves);
+
+  // round trip within half an ulp, 2^-11 relative, on a buffer covering the simd tails
+  std::vector<float> src(1003);
+  for (size_t i = 0; i < src.size(); ++i)
+  {
+    src[i] = std::sin(static_cast<float>(i)) * std::pow(2.f, static_cast<float>(i % 20) - 10.f);
+  }
+  std::vector<uint16_t> half(src.size());
+  std::vector<float>    back(src.size());
+  ConvertFp32ToFp16(src.data(), half.data(), src.size());
+  ConvertFp16ToFp32(half.data(), back.data(), src.size());
+  for (size_t i = 0; i < src.size(); ++i)
+  {
+    EXPECT_LE(std::fabs(back[i] - src[i]), std::fabs(src[i]) / 2048.f) << "at " << i;
+  }
+}
+
+TEST(SamFeaturePrecisionTest, test_int8_per_channel_error_bound)
+{
+  const size_t channels = 13;
+  const size_t spatial  = 37;
+  for (const bool channels_last : {false, true})
+  {
+    std::vector<float> src(channels * spatial);
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+      // channels of very different ranges, a per-tensor scale would lose the small ones
+      const size_t c = channels_last ? i % channels : i / spatial;
+      src[i]         = std::cos(static_cast<float>(i)) * std::pow(10.f, static_cast<float>(c % 4));
+    }
+    std::vector<int8_t> quantized(src.size());
+    std::vector<float>  scales(channels);
+    std::vector<float>  back(src.size());
+    QuantizeInt8PerChannel(src.data(), quantized.data(), scales.data(), channels, spatial,
+                           channels_last);
+    DequantizeInt8PerChannel(quantized.data(), scales.data(), back.data(), channels, spatial,
+                             channels_last);
+    for (size_t i = 0; i < src.size(); ++i)
+    {
+      const size_t c = channels_last ? i % channels : i / spatial;
+      EXPECT_LE(std::fabs(back[i] - src[i]), scales[c] / 2.f * 1.001f) << "at " << i;
+    }
+  }
+}
+
+TEST(SamFeaturePrecisionTest, test_compressed_embedding_copy_features)
+{
+  const int C = 24, H = 5, W = 7;
+
+  SamImageEmbedding embedding;
+  embedding.feature_channels = C;
+  embedding.feature_height   = H;
+  embedding.feature_width    = W;
+  embedding.features.resize(C * H * W);
+  for (size_t i = 0; i < embedding.features.size(); ++i)
+  {
+    embedding.features[i] = std::sin(static_cast<float>(i));
+  }
+  const std::vector<float> nchw = embedding.features;
+  std::vector<float>       nhwc(nchw.size());
+  TransposeNchwToNhwcNaive(nchw.data(), nhwc.data(), 1, C, H, W);
+  const size_t fp32_bytes = embedding.ByteSize();
+
+  // stored as `NHWC` fp16, read back in both layouts
+  embedding.Compress(SamFeaturePrecision::FP16, SamFeatureLayout::NHWC);
+  EXPECT_EQ(embedding.Precision(), SamFeaturePrecision::FP16);
+  EXPECT_EQ(embedding.layout, SamFeatureLayout::NHWC);
+  EXPECT_TRUE(embedding.features.empty());
+  EXPECT_EQ(embedding.GetFeatures(SamFeatureLayout::NHWC), nullptr);
+  EXPECT_EQ(embedding.ByteSize(), fp32_bytes / 2);
+
+  std::vector<float> copied(nchw.size());
+  embedding.CopyFeatures(SamFeatureLayout::NHWC, copied.data());
+  for (size_t i = 0; i < copied.size(); ++i)
+  {
+    EXPECT_NEAR(copied[i], nhwc[i], 1e-3f);
+  }
+  embedding.CopyFeatures(SamFeatureLayout::NCHW, copied.data());
+  for (size_t i = 0; i < copied.size(); ++i)
+  {
+    EXPECT_NEAR(copied[i], nchw[i], 1e-3f);
+  }
+}
+
+TEST(SamMaskPostProcessTest, test_fused_matches_reference)
+{
+  // an object blob in the low-res logits
+  std::vector<float> logits(256 * 256);
+  for (int y = 0; y < 256; ++y)
+  {
+    for (int x = 0; x < 256; ++x)
+    {
+      logits[y * 256 + x] = 60.f - std::hypot(y - 80.f, x - 100.f);
+    }
+  }
+
+  const std::vector<std::pair<int, int>> image_sizes = {
+      {720, 1280}, {1080, 1920}, {2160, 3840}, {1000, 300}};
+  for (const auto &image_size : image_sizes)
+  {
+    SamMaskGeometry geometry;
+    geometry.image_height = image_size.first;
+    geometry.image_width  = image_size.second;
+    geometry.scale        = 1024.f / std::max(image_size.first, image_size.second);
+
+    cv::Mat expected_mask, mask;
+    ConvertLowResMaskReference(logits.data(), geometry, expected_mask);
+    ConvertLowResMaskFused(logits.data(), geometry, mask);
+    ASSERT_EQ(mask.type(), CV_8UC1);
+    ASSERT_EQ(mask.size(), expected_mask.size());
+    EXPECT_GT(ComputeMaskIoU(mask, expected_mask), 0.99f);
+
+    // the output buffer is reused across calls
+    const uint8_t *mask_data = mask.data;
+    ConvertLowResMaskFused(logits.data(), geometry, mask);
+    EXPECT_EQ(mask.data, mask_data);
+  }
+}
+
+TEST(SamMaskPostProcessTest, test_compact_masks_match_dense_mask_in_roi)
+{
+  std::vector<float> logits(256 * 256);
+  for (int y = 0; y < 256; ++y)
+  {
+    for (int x = 0; x < 256; ++x)
+    {
+      logits[y * 256 + x] = 20.f - std::hypot(y - 80.f, x - 100.f);
+    }
+  }
+
+  SamMaskGeometry geometry;
+  geometry.image_height = 2160;
+  geometry.image_width  = 3840;
+  geometry.scale        = 1024.f / 3840;
+
+  cv::Mat dense_mask;
+  ConvertLowResMaskFused(logits.data(), geometry, dense_mask);
+  // the object only, and a roi cutting through the object
+  for (const cv::Rect &roi : {cv::Rect(1100, 800, 900, 900), cv::Rect(1500, 1200, 200, 100)})
+  {
+    cv::Mat expected_mask = cv::Mat::zeros(dense_mask.size(), CV_8UC1);
+    dense_mask(roi).copyTo(expected_mask(roi));
+
+    SamCroppedMask cropped_mask;
+    ConvertLowResMaskCropped(logits.data(), geometry, roi, cropped_mask);
+    EXPECT_EQ(cropped_mask.roi, cv::boundingRect(expected_mask));
+    cv::Mat cropped_to_dense = cv::Mat::zeros(dense_mask.size(), CV_8UC1);
+    cropped_mask.mask.copyTo(cropped_to_dense(cropped_mask.roi));
+    EXPECT_EQ(cv::countNonZero(cropped_to_dense != expected_mask), 0);
+
+    SamRleMask rle_mask;
+    ConvertLowResMaskRle(logits.data(), geometry, roi, rle_mask);
+    EXPECT_EQ(cv::countNonZero(DecodeRle(rle_mask) != expected_mask), 0);
+    EXPECT_EQ(std::count(rle_mask.counts.begin() + 1, rle_mask.counts.end(), 0u), 0);
+  }
+
+  // a roi out of the image gives empty masks
+  SamCroppedMask empty_mask;
+  ConvertLowResMaskCropped(logits.data(), geometry, cv::Rect(4000, 0, 10, 10), empty_mask);
+  EXPECT_TRUE(empty_mask.roi.empty());
+  SamRleMask empty_rle;
+  ConvertLowResMaskRle(logits.data(), geometry, cv::Rect(4000, 0, 10, 10), empty_rle);
+  EXPECT_EQ(empty_rle.counts, std::vector<uint32_t>({2160u * 3840u}));
+
+  // `pycocotools` string of a 3x3 mask with the center pixel set
+  SamRleMask coco_rle;
+  coco_rle.height = 3;
+  coco_rle.width  = 3;
+  coco_rle.counts = {4, 1, 4};
+  EXPECT_EQ(coco_rle.ToCocoString(), "414");
+}
+
+TEST(SamMaskPostProcessTest, test_rle_of_full_height_roi_is_canonical)
+{
+  // every pixel of the roi is foreground, in a 4x3 image
+  std::vector<float> logits(256 * 256, 1.f);
+  SamMaskGeometry    geometry;
+  geometry.image_height = 4;
+  geometry.image_width  = 3;
+  geometry.scale        = 1024.f / 4;
+
+  // the runs of consecutive columns are merged, the first count is the only zero one
+  SamRleMask rle_mask;
+  ConvertLowResMaskRle(logits.data(), geometry, cv::Rect(0, 0, 2, 4), rle_mask);
+  EXPECT_EQ(rle_mask.counts, std::vector<uint32_t>({0u, 8u, 4u}));
+  ConvertLowResMaskRle(logits.data(), geometry, cv::Rect(0, 0, 3, 4), rle_mask);
+  EXPECT_EQ(rle_mask.counts, std::vector<uint32_t>({0u, 12u}));
+
+  // a roi starting and ending on column boundaries
+  ConvertLowResMaskRle(logits.data(), geometry, cv::Rect(1, 0, 2, 4), rle_mask);
+  EXPECT_EQ(rle_mask.counts, std::vector<uint32_t>({4u, 8u}));
+  ConvertLowResMaskRle(logits.data(), geometry, cv::Rect(1, 0, 1, 4), rle_mask);
+  EXPECT_EQ(rle_mask.counts, std::vector<uint32_t>({4u, 4u, 4u}));
+}
+
+TEST(SamAutoMaskTest, test_point_grid_and_crop_boxes)
+{
+  const auto grid = BuildSamPointGrid(4);
+  ASSERT_EQ(grid.size(), 16u);
+  EXPECT_FLOAT_EQ(grid[0].first, 0.125f);
+  EXPECT_FLOAT_EQ(grid[0].second, 0.125f);
+  EXPECT_FLOAT_EQ(grid[1].first, 0.375f);
+  EXPECT_FLOAT_EQ(grid[15].first, 0.875f);
+  EXPECT_FLOAT_EQ(grid[15].second, 0.875f);
+
+  // the full image, then 2x2 and 4x4 overlapping crops covering the image
+  const cv::Rect image_rect(0, 0, 1920, 1080);
+  const auto     crop_boxes = GenerateSamCropBoxes(1080, 1920, 2, 512.f / 1500.f);
+  ASSERT_EQ(crop_boxes.size(), 1u + 4u + 16u);
+  EXPECT_EQ(crop_boxes[0], image_rect);
+  for (size_t i = 1; i < crop_boxes.size(); ++i)
+  {
+    EXPECT_EQ(crop_boxes[i] & image_rect, crop_boxes[i]);
+    EXPECT_LT(crop_boxes[i].width, image_rect.width);
+  }
+  // the last crop of each layer reaches the bottom-right corner, neighbours overlap
+  EXPECT_EQ(crop_boxes[4].br(), image_rect.br());
+  EXPECT_EQ(crop_boxes[20].br(), image_rect.br());
+  EXPECT_GT((crop_boxes[1] & crop_boxes[2]).area(), 0);
+
+  // only the edges of a crop inside the image count
+  EXPECT_EQ(crop_boxes[1], cv::Rect(0, 0, 1144, 724));
+  EXPECT_TRUE(IsBoxNearCropEdge(cv::Rect(1000, 100, 140, 100), crop_boxes[1], {1920, 1080}, 20));
+  EXPECT_FALSE(IsBoxNearCropEdge(cv::Rect(0, 0, 100, 100), crop_boxes[1], {1920, 1080}, 20));
+  EXPECT_FALSE(IsBoxNearCropEdge(cv::Rect(0, 0, 1920, 1080), image_rect, {1920, 1080}, 20));
+}
+
+TEST(SamAutoMaskTest, test_low_res_mask_stats)
+{
+  // a disc of radius 20 in the logits, with logits falling by 1 per low-res pixel
+  std::vector<float> logits(256 * 256);
+  for (int y = 0; y < 256; ++y)
+  {
+    for (int x = 0; x < 256; ++x)
+    {
+      logits[y * 256 + x] = 20.f - std::hypot(y - 80.f, x - 100.f);
+    }
   }
 
+  SamMaskGeometry geometry;
+  geometry.image_height = 2160;
+  geometry.image_width  = 3840;
+  geometry.scale        = 1024.f / 3840;
+
+  const auto stats = ComputeLowResMaskStats(logits.data(), geometry, 1.f);
+  EXPECT_EQ(stats.low_res_box, cv::Rect(81, 61, 39, 39));
+  // area ratio of the discs of radius 19 and 21
+  EXPECT_NEAR(stats.stability_score, (19.f * 19.f) / (21.f * 21.f), 0.03f);
+
+  // the mapped box holds the whole upsampled mask
+  cv::Mat dense_mask;
+  ConvertLowResMaskFused(logits.data(), geometry, dense_mask);
+  const cv::Rect mask_box = cv::boundingRect(dense_mask);
+  const cv::Rect image_box = LowResBoxToImage(stats.low_res_box, geometry);
+  EXPECT_EQ(mask_box & image_box, mask_box);
+  EXPECT_LT(image_box.area(), mask_box.area() * 1.5);
+
+  // logits of the padding below the image (from row 144) are ignored
+  std::fill(logits.begin() + 200 * 256, logits.end(), 100.f);
+  EXPECT_EQ(ComputeLowResMaskStats(logits.data(), geometry, 1.f).low_res_box,
+            cv::Rect(81, 61, 39, 39));
+}
+
+TEST(SamAutoMaskTest, test_mask_nms)
+{
+  auto make_mask = [](const cv::Rect &roi, const cv::Rect &filled, float predicted_iou) {
+    SamAutoMask mask;
+    mask.mask.roi  = roi;
+    mask.mask.mask = cv::Mat::zeros(roi.size(), CV_8UC1);
+    mask.mask.mask(filled - roi.tl()).setTo(255);
+    mask.predicted_iou = predicted_iou;
+    return mask;
+  };
+  const cv::Rect square(0, 0, 100, 100);
+  const cv::Rect shifted(50, 0, 100, 100);
+  const cv::Rect strip(50, 0, 50, 100);
+
+  const std::vector<SamAutoMask> masks{
+      make_mask(square, strip, 0.9f),
+      // overlapping box of a worse mask
+      make_mask(cv::Rect(5, 5, 100, 100), cv::Rect(5, 5, 100, 100), 0.8f),
+      // far away, the best one
+      make_mask(cv::Rect(500, 500, 50, 50), cv::Rect(500, 500, 50, 50), 0.95f),
+      // box IoU of 1/3 with the first one, but the same pixels
+      make_mask(shifted, strip, 0.85f),
+      // no pixel
+      SamAutoMask{}};
+
+  EXPECT_EQ(SamMaskNms(masks, 0.7f, 1.f), std::vector<size_t>({2, 0, 3}));
+  EXPECT_EQ(SamMaskNms(masks, 0.7f, 0.8f), std::vector<size_t>({2, 0}));
+  EXPECT_EQ(SamMaskNms(masks, 0.2f, 1.f), std::vector<size_t>({2, 0}));
+}
+
+TEST(SamVideoTest, test_scene_change)
+{
+  cv::Mat frame(120, 160, CV_8UC3, cv::Scalar(100, 100, 100));
+  cv::Mat thumbnail = MakeSamSceneThumbnail(frame, 32);
+  ASSERT_EQ(thumbnail.size(), cv::Size(32, 32));
+  EXPECT_FLOAT_EQ(ComputeSamSceneChange(thumbnail, thumbnail), 0.f);
+
+  cv::Mat brighter(120, 160, CV_8UC3, cv::Scalar(151, 151, 151));
+  EXPECT_NEAR(ComputeSamSceneChange(thumbnail, MakeSamSceneThumbnail(brighter, 32)), 0.2f, 1e-3f);
+  EXPECT_FLOAT_EQ(ComputeSamSceneChange(cv::Mat(), thumbnail), 1.f);
+}
+
+TEST(SamVideoTest, test_flow_tracks_shifted_box)
+{
+  cv::Mat prev_gray(240, 320, CV_8UC1);
+  cv::randu(prev_gray, 0, 255);
+  cv::GaussianBlur(prev_gray, prev_gray, {5, 5}, 1.5);
+  cv::Mat gray;
+  cv::Mat translation = (cv::Mat_<double>(2, 3) << 1, 0, 4, 0, 1, -3);
+  cv::warpAffine(prev_gray, gray, translation, prev_gray.size(), cv::INTER_LINEAR,
+                 cv::BORDER_REFLECT);
+
+  BBox2D box;
+  box.x = 160;
+  box.y = 120;
+  box.w = 80;
+  box.h = 60;
+  // too small to track, kept as is
+  BBox2D tiny = box;
+  tiny.w = tiny.h = 4;
+
+  std::vector<BBox2D> boxes{box, tiny};
+  TrackSamBoxesByFlow(prev_gray, gray, boxes, 32);
+  EXPECT_NEAR(boxes[0].x, box.x + 4, 0.5f);
+  EXPECT_NEAR(boxes[0].y, box.y - 3, 0.5f);
+  EXPECT_NEAR(boxes[0].w, box.w, 2.f);
+  EXPECT_NEAR(boxes[0].h, box.h, 2.f);
+  EXPECT_FLOAT_EQ(boxes[1].x, tiny.x);
+  EXPECT_FLOAT_EQ(boxes[1].y, tiny.y);
+}
+
+TEST(SamVideoTest, test_warp_cropped_mask)
+{
+  SamCroppedMask mask;
+  mask.roi  = cv::Rect(40, 30, 20, 10);
+  mask.mask = cv::Mat(mask.roi.height, mask.roi.width, CV_8UC1, cv::Scalar(255));
+
+  BBox2D from;
+  from.x = 50;
+  from.y = 35;
+  from.w = 20;
+  from.h = 10;
+  BBox2D to = from;
+  to.x      = 70;
+  to.w      = 40;
+  to.h      = 20;
+
+  // moved by the box shift and scaled around the box center
+  SamCroppedMask warped = WarpSamCroppedMask(mask, from, to, {200, 100});
+  EXPECT_EQ(warped.roi, cv::Rect(50, 25, 40, 20));
+  EXPECT_EQ(warped.mask.size(), warped.roi.size());
+  EXPECT_EQ(cv::countNonZero(warped.mask), 40 * 20);
+
+  // clipped to the image
+  to.x   = 190;
+  warped = WarpSamCroppedMask(mask, from, to, {200, 100});
+  EXPECT_EQ(warped.roi, cv::Rect(170, 25, 30, 20));
+  EXPECT_EQ(cv::countNonZero(warped.mask), 30 * 20);
+
+  EXPECT_TRUE(WarpSamCroppedMask(SamCroppedMask{}, from, to, {200, 100}).roi.empty());
+}
+
+static void WriteSysfsFile(const std::filesystem::path &path, const std::string &value)
+{
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream(path) << value << "\n";
+}
+
+TEST(CpuAffinityTest, test_big_little_topology)
+{
+  // a fake rk3588 sysfs tree : 4 x A55 (1.8GHz, 128K L2) + 4 x A76 (2.4GHz, 512K L2)
+  const auto sysfs_root = std::filesystem::temp_directory_path() / "sam_test_sysfs_cpu";
+  std::filesystem::remove_all(sysfs_root);
+  WriteSysfsFile(sysfs_root / "online", "0-7");
+  for (int cpu = 0; cpu < 8; ++cpu)
+  {
+    const auto cpu_dir = sysfs_root / ("cpu" + std::to_string(cpu));
+    WriteSysfsFile(cpu_dir / "cpufreq/cpuinfo_max_freq", cpu < 4 ? "1800000" : "2400000");
+    WriteSysfsFile(cpu_dir / "cpu_capacity", cpu < 4 ? "414" : "1024");
+    WriteSysfsFile(cpu_dir / "cache/index0/level", "1");
+    WriteSysfsFile(cpu_dir / "cache/index1/level", "1");
+    WriteSysfsFile(cpu_dir / "cache/index2/level", "2");
+    WriteSysfsFile(cpu_dir / "cache/index2/size", cpu < 4 ? "128K" : "512K");
+  }
+
+  CpuTopology topology(sysfs_root.string());
+  EXPECT_FALSE(topology.IsHomogeneous());
+  EXPECT_EQ(topology.LittleCpus(), std::vector<int>({0, 1, 2, 3}));
+  EXPECT_EQ(topology.BigCpus(), std::vector<int>({4, 5, 6, 7}));
+  EXPECT_EQ(topology.ResolveCpuSet("big"), std::vector<int>({4, 5, 6, 7}));
+  EXPECT_EQ(topology.ResolveCpuSet("1-2,6,9"), std::vector<int>({1, 2, 6}));
+  EXPECT_TRUE(topology.ResolveCpuSet("all").empty());
+  EXPECT_TRUE(topology.ResolveCpuSet("").empty());
+  EXPECT_THROW(topology.ResolveCpuSet("3-x"), std::invalid_argument);
+  EXPECT_THROW(topology.ResolveCpuSet("12-15"), std::invalid_argument);
+
+  // without cpufreq nor cache info, every core is in the same class
+  std::filesystem::remove_all(sysfs_root);
+  WriteSysfsFile(sysfs_root / "online", "0-3");
+  CpuTopology homogeneous_topology(sysfs_root.string());
+  EXPECT_TRUE(homogeneous_topology.IsHomogeneous());
+  EXPECT_TRUE(homogeneous_topology.ResolveCpuSet("big").empty());
+
+  // x86 with two favored cores turbo-ing 4% higher, the same core design
+  std::filesystem::remove_all(sysfs_root);
+  WriteSysfsFile(sysfs_root / "online", "0-7");
+  for (int cpu = 0; cpu < 8; ++cpu)
+  {
+    const auto cpu_dir = sysfs_root / ("cpu" + std::to_string(cpu));
+    WriteSysfsFile(cpu_dir / "cpufreq/cpuinfo_max_freq", cpu < 2 ? "5000000" : "4800000");
+    WriteSysfsFile(cpu_dir / "cpu_capacity", cpu < 2 ? "1024" : "983");
+    WriteSysfsFile(cpu_dir / "cache/index0/level", "1");
+    WriteSysfsFile(cpu_dir / "cache/index1/level", "1");
+    WriteSysfsFile(cpu_dir / "cache/index2/level", "2");
+    WriteSysfsFile(cpu_dir / "cache/index2/size", "2048K");
+  }
+  CpuTopology turbo_topology(sysfs_root.string());
+  EXPECT_TRUE(turbo_topology.IsHomogeneous());
+  EXPECT_TRUE(turbo_topology.ResolveCpuSet("big").empty());
+  std::filesystem::remove_all(sysfs_root);
+}
+
+TEST(CpuAffinityTest, test_scoped_affinity_restores_caller_mask)
+{
+  cpu_set_t original_mask;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(original_mask), &original_mask), 0);
+  int first_cpu = 0;
+  while (!CPU_ISSET(first_cpu, &original_mask))
+  {
+    ++first_cpu;
+  }
+
+  {
+    ScopedCpuAffinity affinity({first_cpu});
+    cpu_set_t         pinned_mask;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(pinned_mask), &pinned_mask), 0);
+    EXPECT_EQ(CPU_COUNT(&pinned_mask), 1);
+    EXPECT_TRUE(CPU_ISSET(first_cpu, &pinned_mask));
+  }
+
+  cpu_set_t restored_mask;
+  ASSERT_EQ(sched_getaffinity(0, sizeof(restored_mask), &restored_mask), 0);
+  EXPECT_TRUE(CPU_EQUAL(&restored_mask, &original_mask));
+}
+
+TEST(BoundedQueueTest, test_blocking_hand_off_and_close)
+{
+  BoundedQueue<int> queue(2);
+  std::thread       producer([&queue]() {
+    for (int i = 0; i < 100; ++i)
+    {
+      ASSERT_TRUE(queue.Push(i));
+      EXPECT_LE(queue.Size(), 2u);
+    }
+    queue.Close();
+  });
+
+  // items come out in order, the ones pushed before `Close` are drained
+  int item     = -1;
+  int expected = 0;
+  while (queue.Pop(item))
+  {
+    EXPECT_EQ(item, expected++);
+  }
+  producer.join();
+  EXPECT_EQ(expected, 100);
+  EXPECT_FALSE(queue.Push(0));
+
+  EXPECT_THROW(BoundedQueue<int>(0), std::invalid_argument);
+}
+
 class BaseSamFixture : public testing::Test {
 protected:
-  std::shared_ptr<BaseSamModel> mobilesam_model_;
-  std::shared_ptr<BaseSamModel> nanosam_model_;
+  std::shared_ptr<BaseMobileSamModel> mobilesam_model_;
+  std::shared_ptr<BaseMobileSamModel> nanosam_model_;
+  // mobilesam padding its prompts to buckets
+  std::shared_ptr<BaseMobileSamModel> mobilesam_bucketed_model_;
+  // mobilesam whose point decoder takes a batch of single-point prompts per inference
+  std::shared_ptr<BaseMobileSamModel> mobilesam_batched_points_model_;
 
   std::string test_image_path_;
   std::string test_mobilesam_visual_result_save_path_;
@@ -84,8 +1243,9 @@ public:
     auto mobilesam_image_encoder = CreateTrtInferCore(mobilesam_image_encoder_model_path);
     auto nanosam_image_encoder   = CreateTrtInferCore(nanosam_image_encoder_model_path);
 
-    const int SAM_MAX_BOX    = 1;
-    const int SAM_MAX_POINTS = 8;
+    const int SAM_MAX_BOX     = 8;
+    const int SAM_MAX_POINTS  = 8;
+    const int SAM_POINT_BATCH = 16;
 
     auto box_decoder_factory =
         CreateTrtInferCoreFactory(box_decoder_model_path,
@@ -95,7 +1255,8 @@ public:
                                       {"mask_input", {1, 1, 256, 256}},
                                       {"has_mask_input", {1}},
                                   },
-                                  {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
+                                  {{"masks", {1, SAM_MAX_BOX, 256, 256}},
+                                   {"scores", {1, SAM_MAX_BOX}}});
 
     auto point_decoder_factory =
         CreateTrtInferCoreFactory(point_decoder_model_path,
@@ -108,15 +1269,48 @@ public:
                                   },
                                   {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
 
+    // single-point prompts of the automatic mask generation, batched on the first dimension
+    auto batched_point_decoder_factory =
+        CreateTrtInferCoreFactory(point_decoder_model_path,
+                                  {
+                                      {"image_embeddings", {1, 256, 64, 64}},
+                                      {"point_coords", {SAM_POINT_BATCH, 1, 2}},
+                                      {"point_labels", {SAM_POINT_BATCH, 1}},
+                                      {"mask_input", {1, 1, 256, 256}},
+                                      {"has_mask_input", {1}},
+                                  },
+                                  {{"masks", {SAM_POINT_BATCH, 1, 256, 256}},
+                                   {"scores", {SAM_POINT_BATCH, 1}}});
+
     auto image_preprocess_factory = CreateCudaDetPreProcessFactory();
 
-    mobilesam_model_ =
-        CreateMobileSamModel(mobilesam_image_encoder, point_decoder_factory->Create(),
-                             box_decoder_factory->Create(), image_preprocess_factory->Create());
+    MobileSamConfig sam_config;
+    sam_config.max_box_number = SAM_MAX_BOX;
 
-    nanosam_model_ =
-        CreateMobileSamModel(nanosam_image_encoder, point_decoder_factory->Create(),
-                             box_decoder_factory->Create(), image_preprocess_factory->Create());
+    mobilesam_model_ = CreateMobileSamModel(
+        mobilesam_image_encoder, point_decoder_factory->Create(), box_decoder_factory->Create(),
+        image_preprocess_factory->Create(), kMobileSamEncoderBlobNames,
+        kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames, sam_config);
+
+    MobileSamConfig bucketed_sam_config      = sam_config;
+    bucketed_sam_config.point_prompt_buckets = {1, 2, 4, SAM_MAX_POINTS};
+    bucketed_sam_config.box_prompt_buckets   = {1, 2, 4, SAM_MAX_BOX};
+    mobilesam_bucketed_model_ = CreateMobileSamModel(
+        CreateTrtInferCore(mobilesam_image_encoder_model_path), point_decoder_factory->Create(),
+        box_decoder_factory->Create(), image_preprocess_factory->Create(),
+        kMobileSamEncoderBlobNames, kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames,
+        bucketed_sam_config);
+
+    mobilesam_batched_points_model_ = CreateMobileSamModel(
+        CreateTrtInferCore(mobilesam_image_encoder_model_path),
+        batched_point_decoder_factory->Create(), box_decoder_factory->Create(),
+        image_preprocess_factory->Create(), kMobileSamEncoderBlobNames,
+        kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames, sam_config);
+
+    nanosam_model_ = CreateMobileSamModel(
+        nanosam_image_encoder, point_decoder_factory->Create(), box_decoder_factory->Create(),
+        image_preprocess_factory->Create(), kMobileSamEncoderBlobNames,
+        kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames, sam_config);
 
     test_image_path_ = "/workspace/test_data/persons.jpg";
     test_mobilesam_visual_result_save_path_ =
@@ -156,8 +1350,9 @@ public:
     auto mobilesam_image_encoder = CreateOrtInferCore(mobilesam_image_encoder_model_path);
     auto nanosam_image_encoder   = CreateOrtInferCore(nanosam_image_encoder_model_path);
 
-    const int SAM_MAX_BOX    = 1;
-    const int SAM_MAX_POINTS = 8;
+    const int SAM_MAX_BOX     = 8;
+    const int SAM_MAX_POINTS  = 8;
+    const int SAM_POINT_BATCH = 16;
 
     auto box_decoder_factory =
         CreateOrtInferCoreFactory(box_decoder_model_path,
@@ -167,7 +1362,8 @@ public:
                                       {"mask_input", {1, 1, 256, 256}},
                                       {"has_mask_input", {1}},
                                   },
-                                  {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
+                                  {{"masks", {1, SAM_MAX_BOX, 256, 256}},
+                                   {"scores", {1, SAM_MAX_BOX}}});
 
     auto point_decoder_factory =
         CreateOrtInferCoreFactory(point_decoder_model_path,
@@ -180,16 +1376,49 @@ public:
                                   },
                                   {{"masks", {1, 1, 256, 256}}, {"scores", {1, 1}}});
 
+    // single-point prompts of the automatic mask generation, batched on the first dimension
+    auto batched_point_decoder_factory =
+        CreateOrtInferCoreFactory(point_decoder_model_path,
+                                  {
+                                      {"image_embeddings", {1, 256, 64, 64}},
+                                      {"point_coords", {SAM_POINT_BATCH, 1, 2}},
+                                      {"point_labels", {SAM_POINT_BATCH, 1}},
+                                      {"mask_input", {1, 1, 256, 256}},
+                                      {"has_mask_input", {1}},
+                                  },
+                                  {{"masks", {SAM_POINT_BATCH, 1, 256, 256}},
+                                   {"scores", {SAM_POINT_BATCH, 1}}});
+
     auto image_preprocess_factory =
         CreateCpuDetPreProcessFactory({0, 0, 0}, {255, 255, 255}, true, true);
 
-    mobilesam_model_ =
-        CreateMobileSamModel(mobilesam_image_encoder, point_decoder_factory->Create(),
-                             box_decoder_factory->Create(), image_preprocess_factory->Create());
+    MobileSamConfig sam_config;
+    sam_config.max_box_number = SAM_MAX_BOX;
+
+    mobilesam_model_ = CreateMobileSamModel(
+        mobilesam_image_encoder, point_decoder_factory->Create(), box_decoder_factory->Create(),
+        image_preprocess_factory->Create(), kMobileSamEncoderBlobNames,
+        kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames, sam_config);
 
-    nanosam_model_ =
-        CreateMobileSamModel(nanosam_image_encoder, point_decoder_factory->Create(),
-                             box_decoder_factory->Create(), image_preprocess_factory->Create());
+    MobileSamConfig bucketed_sam_config      = sam_config;
+    bucketed_sam_config.point_prompt_buckets = {1, 2, 4, SAM_MAX_POINTS};
+    bucketed_sam_config.box_prompt_buckets   = {1, 2, 4, SAM_MAX_BOX};
+    mobilesam_bucketed_model_ = CreateMobileSamModel(
+        CreateOrtInferCore(mobilesam_image_encoder_model_path), point_decoder_factory->Create(),
+        box_decoder_factory->Create(), image_preprocess_factory->Create(),
+        kMobileSamEncoderBlobNames, kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames,
+        bucketed_sam_config);
+
+    mobilesam_batched_points_model_ = CreateMobileSamModel(
+        CreateOrtInferCore(mobilesam_image_encoder_model_path),
+        batched_point_decoder_factory->Create(), box_decoder_factory->Create(),
+        image_preprocess_factory->Create(), kMobileSamEncoderBlobNames,
+        kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames, sam_config);
+
+    nanosam_model_ = CreateMobileSamModel(
+        nanosam_image_encoder, point_decoder_factory->Create(), box_decoder_factory->Create(),
+        image_preprocess_factory->Create(), kMobileSamEncoderBlobNames,
+        kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames, sam_config);
 
     test_image_path_ = "/workspace/test_data/persons.jpg";
     test_mobilesam_visual_result_save_path_ =
@@ -236,9 +1465,15 @@ public:
     auto image_preprocess_factory =
         CreateCpuDetPreProcessFactory({0, 0, 0}, {255, 255, 255}, false, false);
 
-    nanosam_model_ =
-        CreateMobileSamModel(nanosam_image_encoder, point_decoder_factory->Create(),
-                             box_decoder_factory->Create(), image_preprocess_factory->Create());
+    // transpose image features on the four big cores of rk3588
+    MobileSamConfig sam_config;
+    sam_config.feature_transpose_threads = 4;
+    sam_config.cpu_affinity.transpose    = "big";
+
+    nanosam_model_ = CreateMobileSamModel(
+        nanosam_image_encoder, point_decoder_factory->Create(), box_decoder_factory->Create(),
+        image_preprocess_factory->Create(), kMobileSamEncoderBlobNames,
+        kMobileSamBoxDecoderBlobNames, kMobileSamPointDecoderBlobNames, sam_config);
 
     test_image_path_                        = "/workspace/test_data/persons.jpg";
     test_mobilesam_visual_result_save_path_ = "/workspace/test_data/mobilesam_rknn_test_result.jpg";
@@ -4,6 +4,19 @@ echo "Converting yolov8 ..."
                               --saveEngine=/workspace/models/yolov8n.engine \
                               --fp16
 
+echo "Converting yolov8 dynamic batch ..."
+/usr/src/tensorrt/bin/trtexec --onnx=/workspace/models/yolov8n_dynamic_batch.onnx \
+                              --saveEngine=/workspace/models/yolov8n_dynamic_batch.engine \
+                              --minShapes=images:1x3x640x640 \
+                              --optShapes=images:4x3x640x640 \
+                              --maxShapes=images:8x3x640x640 \
+                              --fp16
+
+echo "Converting yolov8 320 ..."
+/usr/src/tensorrt/bin/trtexec --onnx=/workspace/models/yolov8n_320.onnx \
+                              --saveEngine=/workspace/models/yolov8n_320.engine \
+                              --fp16
+
 echo "Converting rt_detr_v2 ..."
 /usr/src/tensorrt/bin/trtexec --onnx=/workspace/models/rt_detr_v2_single_input.onnx \
                               --saveEngine=/workspace/models/rt_detr_v2_single_input.engine
@@ -20,6 +33,9 @@ echo "Converting nanosam ..."
 echo "Converting mobilesam_box_decoder ..."
 /usr/src/tensorrt/bin/trtexec --onnx=/workspace/models/modified_mobile_sam_box.onnx \
                               --saveEngine=/workspace/models/modified_mobile_sam_box.engine \
+                              --minShapes=boxes:1x1x4 \
+                              --optShapes=boxes:1x4x4 \
+                              --maxShapes=boxes:1x8x4 \
                               --fp16
 
 echo "Converting mobilesam_point_decoder ..."
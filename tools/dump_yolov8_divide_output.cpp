@@ -0,0 +1,108 @@
+// Record the int8 outputs of the rknn "divide" export of yolov8n on `persons.jpg`, as the npu
+// hands them out, for `test_recorded_int8_decode_matches_float` of detection_2d_yolov8. The python
+// runtime only gives dequantized floats, so this goes through the C api. Built and run on the
+// board, the build command being one line :
+//
+//   g++ -O2 -std=c++17 tools/dump_yolov8_divide_output.cpp -o dump_yolov8_divide_output
+//       $(pkg-config --cflags --libs opencv4) -lrknnrt
+//   ./dump_yolov8_divide_output
+//
+// For each of the 9 outputs in the order of the model, the file holds its int32 zero point and
+// float32 scale (from the output tensor attributes), then its int8 values in NCHW.
+
+#include <rknn_api.h>
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+// the "divide" export of `cvt_onnx2rknn_yolov8_quant.py`
+static const char *kRknnModelPath = "/workspace/models/yolov8n_divide_opset11.rknn";
+static const char *kImagePath     = "/workspace/test_data/persons.jpg";
+static const char *kOutputPath    = "/workspace/test_data/yolov8n_divide_outputs.bin";
+
+int main()
+{
+  std::ifstream     model_file(kRknnModelPath, std::ios::binary);
+  std::vector<char> model((std::istreambuf_iterator<char>(model_file)),
+                          std::istreambuf_iterator<char>());
+  rknn_context      ctx = 0;
+  if (model.empty() || rknn_init(&ctx, model.data(), model.size(), 0, nullptr) != RKNN_SUCC)
+  {
+    fprintf(stderr, "failed to load %s\n", kRknnModelPath);
+    return 1;
+  }
+
+  rknn_input_output_num io_num;
+  rknn_query(ctx, RKNN_QUERY_IN_OUT_NUM, &io_num, sizeof(io_num));
+
+  // the same letterbox as the rknn tests, uint8 BGR without normalization
+  // (`CreateCpuDetPreProcess({0, 0, 0}, {1, 1, 1}, false, false)`)
+  const cv::Mat image = cv::imread(kImagePath);
+  if (image.empty())
+  {
+    fprintf(stderr, "failed to read %s\n", kImagePath);
+    return 1;
+  }
+  const float scale = std::min(640.f / image.rows, 640.f / image.cols);
+  cv::Mat     padded(640, 640, CV_8UC3, cv::Scalar(0, 0, 0));
+  cv::Mat     resized = padded(cv::Rect(0, 0, static_cast<int>(std::round(image.cols * scale)),
+                                        static_cast<int>(std::round(image.rows * scale))));
+  cv::resize(image, resized, resized.size());
+
+  rknn_input input   = {};
+  input.index        = 0;
+  input.type         = RKNN_TENSOR_UINT8;
+  input.fmt          = RKNN_TENSOR_NHWC;
+  input.size         = padded.total() * padded.elemSize();
+  input.buf          = padded.data;
+  input.pass_through = 0;
+  if (rknn_inputs_set(ctx, 1, &input) != RKNN_SUCC || rknn_run(ctx, nullptr) != RKNN_SUCC)
+  {
+    fprintf(stderr, "inference failed\n");
+    return 1;
+  }
+
+  // `want_float = 0` : the int8 values themselves, not dequantized
+  std::vector<rknn_output> outputs(io_num.n_output);
+  for (uint32_t i = 0; i < io_num.n_output; ++i)
+  {
+    outputs[i]            = {};
+    outputs[i].index      = i;
+    outputs[i].want_float = 0;
+  }
+  if (rknn_outputs_get(ctx, io_num.n_output, outputs.data(), nullptr) != RKNN_SUCC)
+  {
+    fprintf(stderr, "failed to get outputs\n");
+    return 1;
+  }
+
+  std::ofstream file(kOutputPath, std::ios::binary);
+  for (uint32_t i = 0; i < io_num.n_output; ++i)
+  {
+    rknn_tensor_attr attr = {};
+    attr.index            = i;
+    rknn_query(ctx, RKNN_QUERY_OUTPUT_ATTR, &attr, sizeof(attr));
+    if (attr.type != RKNN_TENSOR_INT8 || attr.qnt_type != RKNN_TENSOR_QNT_AFFINE_ASYMMETRIC ||
+        attr.fmt != RKNN_TENSOR_NCHW || outputs[i].size != attr.n_elems)
+    {
+      fprintf(stderr, "output %u is not an affine int8 NCHW tensor\n", i);
+      return 1;
+    }
+    const int32_t zero_point = attr.zp;
+    const float   out_scale  = attr.scale;
+    file.write(reinterpret_cast<const char *>(&zero_point), sizeof(zero_point));
+    file.write(reinterpret_cast<const char *>(&out_scale), sizeof(out_scale));
+    file.write(static_cast<const char *>(outputs[i].buf), outputs[i].size);
+  }
+
+  rknn_outputs_release(ctx, io_num.n_output, outputs.data());
+  rknn_destroy(ctx);
+  printf("done\n");
+  return 0;
+}
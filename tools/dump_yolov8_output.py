@@ -0,0 +1,23 @@
+import cv2
+import numpy as np
+import onnxruntime as ort
+# onnx model path
+onnx_model_path = '/workspace/models/yolov8n.onnx'
+# test image
+image_path = '/workspace/test_data/persons.jpg'
+# output path, raw float32 `output0` of {84, 8400}
+output_path = '/workspace/test_data/yolov8n_output0.bin'
+
+if __name__ == '__main__':
+    image = cv2.imread(image_path)
+    # the same letterbox as `CreateCpuDetPreProcess`
+    scale = min(640 / image.shape[0], 640 / image.shape[1])
+    resized = cv2.resize(image, (round(image.shape[1] * scale), round(image.shape[0] * scale)))
+    padded = np.zeros((640, 640, 3), dtype=np.uint8)
+    padded[:resized.shape[0], :resized.shape[1]] = resized
+    blob = cv2.cvtColor(padded, cv2.COLOR_BGR2RGB).transpose(2, 0, 1)[None].astype(np.float32) / 255
+
+    session = ort.InferenceSession(onnx_model_path)
+    output = session.run(['output0'], {'images': blob})[0]
+    output.astype(np.float32).tofile(output_path)
+    print('done')
@@ -0,0 +1,23 @@
+import shutil
+from ultralytics import YOLO
+# pretrained weights, downloaded by ultralytics if missing
+yolov8_weights = 'yolov8n.pt'
+# batch, tiled and roi tests : batch and input size are dynamic, the tensorrt engine is built for
+# 640x640 with min/opt/max batch shapes by `cvt_onnx2trt_all.sh`
+dynamic_batch_onnx_path = '/workspace/models/yolov8n_dynamic_batch.onnx'
+# small model of the cascade test and eval, 320x320 input
+small_onnx_path = '/workspace/models/yolov8n_320.onnx'
+
+
+def export(output_path, imgsz, dynamic):
+    model = YOLO(yolov8_weights)
+    # inputs `images`, outputs `output0` {batch, 4 + 80, anchors}, like `yolov8n.onnx`
+    exported_path = model.export(format='onnx', imgsz=imgsz, dynamic=dynamic, simplify=True,
+                                 opset=11)
+    shutil.move(exported_path, output_path)
+
+
+if __name__ == '__main__':
+    export(dynamic_batch_onnx_path, 640, True)
+    export(small_onnx_path, 320, False)
+    print('done')